@@ -0,0 +1,110 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#ifndef NORDI_ALLOWLIST_H_
+#define NORDI_ALLOWLIST_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "nordvpn_api.h"
+#include "str.h"
+
+#define ALLOWLIST_PORT_COUNT     65536
+#define ALLOWLIST_WORD_BITS      64
+#define ALLOWLIST_PROTOCOL_COUNT 2 // TCP, then UDP
+#define ALLOWLIST_TCP            (1 << 0)
+#define ALLOWLIST_UDP            (1 << 1)
+
+typedef struct {
+    uint32_t address; // network address, host byte order
+    uint8_t prefix;   // 0 to 32
+} nordi_allowlist_subnet_t;
+
+/**
+ * @brief An allowlist. Subnets are kept as they are added until aggregated into the fewest subnets covering exactly
+ * the same addresses. Ports are a bitmap per protocol, as the daemon keeps them per port however they were added.
+ */
+typedef struct {
+    nordi_allowlist_subnet_t* subnets;
+    int count;
+    int capacity;
+    uint64_t ports[ALLOWLIST_PROTOCOL_COUNT][ALLOWLIST_PORT_COUNT / ALLOWLIST_WORD_BITS];
+    // counters
+    unsigned int lines;    // lines added
+    unsigned int rejected; // lines that weren't a subnet, a port range or a comment
+} nordi_allowlist_t;
+
+typedef nordi_allowlist_t* nordi_allowlist_ptr;
+
+/**
+ * @brief Creates an empty allowlist.
+ * @return The allowlist, or NULL if it failed to allocate.
+ */
+nordi_allowlist_ptr nordi_allowlist_new();
+
+/**
+ * @brief Adds a single line: an IPv4 subnet ("10.0.0.0/8", or an address for a /32) or a port range ("22",
+ * "3000-3100"), optionally followed by the protocols ("tcp", "(UDP|TCP)"), both when none is given. Blank lines and
+ * `#` comments are skipped. Reads both hand written lists and the entries listed by the settings.
+ * @param allowlist The allowlist to add to.
+ * @param line The line, a trailing new line is ignored.
+ * @return false if the line wasn't understood or the subnet failed to allocate.
+ */
+bool nordi_allowlist_add(nordi_allowlist_ptr, const char*);
+
+/**
+ * @brief Adds every line of a file, in a single streaming pass. The subnets are aggregated whenever their table fills
+ * up, so it only grows with the subnets that don't aggregate.
+ * @param allowlist The allowlist to add to.
+ * @param file The file to read, up to its end.
+ * @return The number of lines read, or `-1` if it failed to allocate.
+ */
+int nordi_allowlist_read(nordi_allowlist_ptr, FILE*);
+
+/**
+ * @brief Adds every entry of another allowlist.
+ * @param allowlist The allowlist to add to.
+ * @param source The allowlist to add.
+ * @return false if it failed to allocate.
+ */
+bool nordi_allowlist_merge(nordi_allowlist_ptr, nordi_allowlist_ptr);
+
+/**
+ * @brief Replaces the subnets with the fewest subnets covering exactly the same addresses: overlapping and adjacent
+ * subnets are merged into address ranges, which are split back into the largest aligned subnets. In place,
+ * O(n log n).
+ * @param allowlist The allowlist to aggregate.
+ */
+void nordi_allowlist_aggregate(nordi_allowlist_ptr);
+
+/**
+ * @brief Lists the `nordvpn allowlist` changes turning one allowlist into another: the subnets of either one missing
+ * from the other as they are, the ports per protocol, as the fewest ranges. Additions come first, so whatever
+ * stays allowed is never briefly dropped. Both subnet tables are sorted.
+ * @param desired The allowlist wanted.
+ * @param current The allowlist in place.
+ * @param changes Where to write the changes to, one per line, as taken by `nordvpn_change_allowlist`.
+ * @return The number of changes, or `-1` if it failed to allocate.
+ */
+int nordi_allowlist_diff(nordi_allowlist_ptr, nordi_allowlist_ptr, str*);
+
+/**
+ * @brief Merges allowlist files into the current allowlist, running only the changes to reach the aggregated union.
+ * Reads the settings first if they aren't known. Blocks for every change, so it is meant for a worker thread.
+ * @param paths The files to import, one path per line.
+ * @return 0 if every change was applied, the error code otherwise, `FAILED_READ` if a file couldn't be read.
+ */
+nordvpn_error_t nordi_allowlist_import(str);
+
+/**
+ * @brief Frees the allowlist.
+ * @param allowlist The allowlist to free.
+ */
+void nordi_allowlist_free(nordi_allowlist_ptr);
+
+#endif /* NORDI_ALLOWLIST_H_ */
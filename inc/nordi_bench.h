@@ -0,0 +1,112 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#ifndef NORDI_BENCH_H_
+#define NORDI_BENCH_H_
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <threads.h>
+#include "nordvpn_api.h"
+
+#define BENCH_MAX_SERVERS            8
+#define BENCH_MAX_SERVER             24
+#define BENCH_DEFAULT_CYCLES         5
+#define BENCH_DEFAULT_RTT_PROBES     5
+#define BENCH_DEFAULT_RTT_TIMEOUT_MS 2000
+
+/**
+ * @brief The technology and protocol combinations benchmarked, in order.
+ */
+typedef enum {
+    BENCH_NORDLYNX = 0,
+    BENCH_OPENVPN_UDP,
+    BENCH_OPENVPN_TCP,
+    BENCH_COMBINATION_COUNT
+} nordi_bench_combination_t;
+
+typedef struct {
+    int cycles;             // connect and disconnect cycles per combination and server
+    const char* rtt_target; // "host[:port]" answering DNS queries, `MONITOR_DEFAULT_TARGET` if NULL
+    int rtt_probes;         // queries sent through the tunnel after each connect
+    int rtt_timeout_ms;     // time after which a query counts as lost
+} nordi_bench_options_t;
+
+/**
+ * @brief The outcome of every cycle of a combination and server.
+ */
+typedef struct {
+    nordi_bench_combination_t combination;
+    char server[BENCH_MAX_SERVER]; // "" for a quick connect
+    unsigned int cycles;           // connects attempted
+    unsigned int failures;         // connects that failed or left the tunnel down
+    unsigned int connect_p50_ms;   // of the connects that went up
+    unsigned int connect_p95_ms;
+    unsigned int rtt_p50_us;       // of the medians measured after each connect, 0 if none was
+    unsigned int rtt_p95_us;
+} nordi_bench_row_t;
+
+typedef struct {
+    nordi_bench_options_t options;
+    nordi_bench_row_t* rows; // every server of a combination, then the next combination
+    int count;
+    mtx_t mutex;             // guards the flags below
+    bool is_cancelled;       // stops the cycles, the settings are still restored
+    bool is_restoring;       // the settings are being restored, a cancel no longer stops anything
+} nordi_bench_t;
+
+typedef const nordi_bench_options_t* nordi_bench_options_ptr;
+typedef nordi_bench_t* nordi_bench_ptr;
+
+extern const nordi_bench_options_t BENCH_DEFAULT_OPTIONS;
+
+/**
+ * @brief The name of a combination, as written in the summary.
+ */
+extern const char* const NORDI_BENCH_COMBINATION_STR[];
+
+/**
+ * @brief Creates a connection benchmark, a row for every combination and server.
+ * @param servers The servers to connect to, as taken by `nordvpn_server_connect`.
+ * @param count The number of servers, only the first `BENCH_MAX_SERVERS` are kept, `0` for a quick connect.
+ * @param options The benchmark options, copied, NULL for `BENCH_DEFAULT_OPTIONS`.
+ * @return The benchmark, or NULL if it failed to allocate.
+ */
+nordi_bench_ptr nordi_bench_new(const char* const*, int, nordi_bench_options_ptr);
+
+/**
+ * @brief Runs the benchmark through the API: for every combination, sets the technology and protocol, then
+ * connects and disconnects every server in turn for the cycles, measuring the round trip through the tunnel
+ * while it is up. A combination that can't be set counts every cycle as failed. The technology and protocol in
+ * place are restored at the end, also once cancelled, and the tunnel is left down. Blocks for every cycle.
+ * @param bench The benchmark to run, its rows are overwritten.
+ * @return 0 if the benchmark ran, `CANCELLED` if it was cancelled and the settings were restored, the error code
+ * if the settings couldn't be read or restored.
+ */
+nordvpn_error_t nordi_bench_run(nordi_bench_ptr);
+
+/**
+ * @brief Cancels a running benchmark, stopping the command in flight, so it goes on to restore the settings.
+ * Safe to call from any thread, such as a signal handler's main loop source, and more than once.
+ * @param bench The running benchmark.
+ */
+void nordi_bench_cancel(nordi_bench_ptr);
+
+/**
+ * @brief Writes the summary table, a line per combination and server.
+ * @param bench The benchmark that ran.
+ * @param file Where to write the table to.
+ */
+void nordi_bench_write(nordi_bench_ptr, FILE*);
+
+/**
+ * @brief Frees the benchmark.
+ * @param bench The benchmark to free.
+ */
+void nordi_bench_free(nordi_bench_ptr);
+
+#endif /* NORDI_BENCH_H_ */
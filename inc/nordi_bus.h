@@ -0,0 +1,131 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#ifndef NORDI_BUS_H_
+#define NORDI_BUS_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#define BUS_MAX_TEXT           64
+#define BUS_MAX_SUBSCRIBERS    16
+#define BUS_DEFAULT_SETTLE_MS  1000 // quiet time before a settled event is delivered
+#define BUS_NO_DEADLINE        -1
+
+/**
+ * @brief The events published on the bus.
+ */
+typedef enum {
+    BUS_CONNECTION = 0, // the tunnel state after a command, `value` is whether it is up, `text` the hostname
+    BUS_ACCOUNT,        // the login state may have changed
+    BUS_PROGRESS,       // a long running task moved on, `value` is a percentage, `text` what it is doing
+    BUS_ERROR,          // a task failed, `value` is the error code, `text` the task
+    BUS_EVENT_COUNT
+} nordi_bus_event_type_t;
+
+/**
+ * @brief How a subscriber gets the events of a batch.
+ */
+typedef enum {
+    BUS_EVERY = 0, // every event, in order
+    BUS_LATEST,    // the latest event of the batch only
+    BUS_SETTLED    // the latest event, once no other came for the settle time, so flapping states show once
+} nordi_bus_policy_t;
+
+typedef struct nordi_bus_event_s {
+    struct nordi_bus_event_s* next; // the event published before it, while queued
+    nordi_bus_event_type_t type;
+    long long time_ms; // monotonic time it was published at
+    int value;
+    char text[BUS_MAX_TEXT];
+} nordi_bus_event_t;
+
+typedef const nordi_bus_event_t* nordi_bus_event_ptr;
+typedef void (*nordi_bus_callback_t)(nordi_bus_event_ptr, void*);
+typedef void (*nordi_bus_wake_t)(void*);
+
+typedef struct {
+    nordi_bus_event_type_t type;
+    nordi_bus_policy_t policy;
+    int settle_ms;
+    nordi_bus_callback_t callback;
+    void* context;
+    nordi_bus_event_t pending; // latest event not delivered yet, for `BUS_LATEST` and `BUS_SETTLED`
+    bool is_pending;
+} nordi_bus_subscriber_t;
+
+typedef struct {
+    _Atomic(nordi_bus_event_t*) head; // latest published event, a stack the dispatcher takes whole
+    nordi_bus_wake_t wake;
+    void* context;
+    nordi_bus_subscriber_t subscribers[BUS_MAX_SUBSCRIBERS];
+    int subscriber_count;
+    // counters
+    atomic_uint published;
+    unsigned int batches;   // dispatches that took any event
+    unsigned int delivered; // callbacks called
+    unsigned int coalesced; // events replaced by a later one before their delivery
+} nordi_bus_t;
+
+typedef nordi_bus_t* nordi_bus_ptr;
+
+/**
+ * @brief Creates an event bus. Any thread may publish, without locking: an event is pushed onto a lock-free stack,
+ * and the wake callback runs on the publishing thread when it lands on an empty one, so a consumer scheduling a
+ * dispatch gets one wakeup per batch. Subscribers are only called by `nordi_bus_dispatch`, on its thread.
+ * @param wake The function called when a dispatch is due, can be null.
+ * @param context The data argument to be passed onto the wake callback.
+ * @return The new bus, or NULL if it failed to allocate.
+ */
+nordi_bus_ptr nordi_bus_new(nordi_bus_wake_t, void*);
+
+/**
+ * @brief Subscribes to an event type. Subscribe before publishing starts, only the dispatching thread may.
+ * @param bus The bus to subscribe to.
+ * @param type The event type.
+ * @param policy How the events of a batch are delivered.
+ * @param settle_ms The quiet time for `BUS_SETTLED`, `BUS_DEFAULT_SETTLE_MS` if < `0`.
+ * @param callback The function called with each delivered event, which is only valid during the call.
+ * @param context The data argument to be passed onto the callback.
+ * @return true if subscribed, false if there are `BUS_MAX_SUBSCRIBERS` already.
+ */
+bool nordi_bus_subscribe(nordi_bus_ptr, nordi_bus_event_type_t, nordi_bus_policy_t, int, nordi_bus_callback_t,
+                         void*);
+
+/**
+ * @brief Publishes an event, from any thread. Never blocks.
+ * @param bus The bus to publish on.
+ * @param type The event type.
+ * @param value The event value, see `nordi_bus_event_type_t`.
+ * @param text The event text, truncated to `BUS_MAX_TEXT`, NULL for "".
+ * @return true if published, false if the event failed to allocate.
+ */
+bool nordi_bus_publish(nordi_bus_ptr, nordi_bus_event_type_t, int, const char*);
+
+/**
+ * @brief Delivers the events published since the last dispatch, in the order they were published, to the
+ * subscribers of their type, then the settled events whose quiet time is over.
+ * @param bus The bus to dispatch.
+ * @param now_ms The current monotonic time, from `nordi_bus_now_ms`.
+ * @return The time in milliseconds until a settled event is due, after which dispatch again, or
+ * `BUS_NO_DEADLINE` if none is pending.
+ */
+int nordi_bus_dispatch(nordi_bus_ptr, long long);
+
+/**
+ * @brief The monotonic clock events are stamped with.
+ * @return The time in milliseconds.
+ */
+long long nordi_bus_now_ms();
+
+/**
+ * @brief Drops the undelivered events and frees the bus. Publishing must have stopped.
+ * @param bus The bus to free.
+ */
+void nordi_bus_free(nordi_bus_ptr);
+
+#endif /* NORDI_BUS_H_ */
@@ -0,0 +1,130 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#ifndef NORDI_CATALOG_H_
+#define NORDI_CATALOG_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <threads.h>
+
+#define CATALOG_MAX_SERVER      24
+#define CATALOG_MAX_PATH        512
+#define CATALOG_MAX_VALIDATOR   64 // longest ETag or Last-Modified kept
+#define CATALOG_MAX_BODY        (8 * 1024 * 1024)
+#define CATALOG_DEFAULT_TIMEOUT_MS 5000
+
+/**
+ * @brief Server features, as a bit mask.
+ */
+typedef enum {
+    FEATURE_STANDARD = 1 << 0,
+    FEATURE_P2P = 1 << 1,
+    FEATURE_DOUBLE_VPN = 1 << 2,
+    FEATURE_ONION = 1 << 3,
+    FEATURE_OBFUSCATED = 1 << 4,
+    FEATURE_DEDICATED_IP = 1 << 5
+} nordi_catalog_feature_t;
+
+/**
+ * @brief The outcome of a refresh.
+ */
+typedef enum {
+    CATALOG_CANCELLED = -2, // the refresh was cancelled, the table is untouched
+    CATALOG_FAILED = -1,    // the endpoint couldn't be reached or answered garbage, the table is untouched
+    CATALOG_UNCHANGED,   // the endpoint answered 304, the table is current
+    CATALOG_FULL,        // the table was replaced
+    CATALOG_DELTA        // changes were merged into the table
+} nordi_catalog_result_t;
+
+/**
+ * @brief A server entry, also the on-disk cache record.
+ */
+typedef struct {
+    char name[CATALOG_MAX_SERVER]; // "de123"
+    int16_t country;               // nordvpn_country_t, -1 if unknown
+    uint8_t load;                  // percentage
+    uint8_t technologies;          // 1 << nordvpn_technology_t mask, 0 if unknown
+    uint32_t features;             // nordi_catalog_feature_t mask
+    int32_t latitude_e6;           // micro degrees
+    int32_t longitude_e6;
+} nordi_catalog_server_t;
+
+typedef struct {
+    mtx_t mutex; // guards the table, refreshes fetch without holding it
+    char path[CATALOG_MAX_PATH];
+    nordi_catalog_server_t* servers; // sorted by name
+    int count;
+    char etag[CATALOG_MAX_VALIDATOR];
+    char last_modified[CATALOG_MAX_VALIDATOR];
+    unsigned int revision; // bumped whenever the table changes
+    // counters
+    unsigned int fetches;   // requests sent to the endpoint
+    unsigned int unchanged; // requests answered with 304
+} nordi_catalog_t;
+
+typedef nordi_catalog_t* nordi_catalog_ptr;
+typedef nordi_catalog_server_t* nordi_catalog_server_ptr;
+
+/**
+ * @brief Opens the server catalog, loading its on-disk cache if there is a valid one.
+ * @param path The cache file path, or NULL to keep the catalog in memory only. Its directory must exist.
+ * @return The catalog, or NULL if it failed to allocate.
+ */
+nordi_catalog_ptr nordi_catalog_open(const char*);
+
+/**
+ * @brief Fetches the catalog from an HTTP endpoint, sending the validators of the current table so an unchanged
+ * catalog costs a 304. The endpoint answers with tab separated lines, "name country load features latitude
+ * longitude [technologies]", after a "#full" or "#delta" line: a full catalog replaces the table, a delta relative to the ETag
+ * sent is merged into it, where a "-name" line removes a server. The cache is rewritten after every change.
+ * Blocks for up to the timeout per step, resolving the host included, the table stays readable meanwhile.
+ * @param catalog The catalog to refresh.
+ * @param url The endpoint, "http://host[:port]/path". Only plain HTTP is spoken.
+ * @param timeout_ms The time each network operation may take, `CATALOG_DEFAULT_TIMEOUT_MS` if <= `0`.
+ * @return How the table changed, `CATALOG_FAILED` if it didn't.
+ */
+nordi_catalog_result_t nordi_catalog_refresh(nordi_catalog_ptr, const char*, int);
+
+/**
+ * @brief Same as `nordi_catalog_refresh`, but gives up as soon as the cancel fd becomes readable. A lookup still
+ * blocking is left to finish on its own thread.
+ * @param catalog The catalog to refresh.
+ * @param url The endpoint, "http://host[:port]/path".
+ * @param timeout_ms The time each network operation may take, `CATALOG_DEFAULT_TIMEOUT_MS` if <= `0`.
+ * @param cancel A descriptor that becomes readable to cancel, usually an eventfd, or `-1` for none.
+ * @return How the table changed, `CATALOG_CANCELLED` if cancelled, `CATALOG_FAILED` if it failed.
+ */
+nordi_catalog_result_t nordi_catalog_refresh_cancellable(nordi_catalog_ptr, const char*, int, int);
+
+/**
+ * @brief Looks a server up by name, with a binary search of the table.
+ * @param catalog The catalog to search.
+ * @param name The server name.
+ * @param server Where to copy the entry to.
+ * @return true if the server is in the catalog.
+ */
+bool nordi_catalog_find(nordi_catalog_ptr, const char*, nordi_catalog_server_ptr);
+
+/**
+ * @brief Lists the least loaded servers of a country having all the given features.
+ * @param catalog The catalog to search.
+ * @param country The nordvpn_country_t, or `-1` for any.
+ * @param features The nordi_catalog_feature_t mask every server must have, `0` for any.
+ * @param servers Where to copy the entries to, least loaded first.
+ * @param max The most entries to copy.
+ * @return The number of entries copied.
+ */
+int nordi_catalog_least_loaded(nordi_catalog_ptr, int, uint32_t, nordi_catalog_server_ptr, int);
+
+/**
+ * @brief Frees the catalog. The cache is already up to date.
+ * @param catalog The catalog to free.
+ */
+void nordi_catalog_close(nordi_catalog_ptr);
+
+#endif /* NORDI_CATALOG_H_ */
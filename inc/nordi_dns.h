@@ -0,0 +1,90 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#ifndef NORDI_DNS_H_
+#define NORDI_DNS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "nordvpn_api.h"
+#include "str.h"
+
+#define DNS_PORT                53
+#define DNS_MAX_MESSAGE         512 // plain UDP, without EDNS
+#define DNS_MAX_QUERIES         65536
+#define DNS_TYPE_A              1
+#define DNS_TYPE_NS             2
+#define DNS_DEFAULT_REPETITIONS 5
+#define DNS_DEFAULT_INTERVAL_MS 50
+#define DNS_DEFAULT_TIMEOUT_MS  1000
+
+/**
+ * @brief The benchmark of a single resolver.
+ */
+typedef struct {
+    str resolver;          // "address[:port]", the address is what gets applied
+    unsigned int sent;     // queries meant for the resolver, all lost if it couldn't be resolved
+    unsigned int answered; // queries answered within the timeout
+    unsigned int p50_us;
+    unsigned int p95_us;
+    float loss; // percentage
+} nordi_dns_result_t;
+
+typedef struct {
+    const char* const* names; // names every resolver is asked for, the root NS records if none
+    int name_count;
+    int repetitions;          // rounds of queries, one per name and resolver each
+    int interval_ms;          // time between rounds
+    int timeout_ms;           // time after which a query counts as lost
+} nordi_dns_options_t;
+
+typedef nordi_dns_result_t* nordi_dns_result_ptr;
+typedef const nordi_dns_options_t* nordi_dns_options_ptr;
+
+extern const nordi_dns_options_t DNS_DEFAULT_OPTIONS;
+
+/**
+ * @brief Writes a DNS query with recursion desired and a single question of class IN.
+ * @param query Where to write the query to.
+ * @param size The size of the query buffer.
+ * @param id The query ID.
+ * @param name The dotted name asked for, "" for the root.
+ * @param type The record type, such as `DNS_TYPE_A`.
+ * @return The length of the query, or `-1` if the name is invalid or doesn't fit.
+ */
+int nordi_dns_build_query(unsigned char*, size_t, uint16_t, const char*, uint16_t);
+
+/**
+ * @brief Benchmarks resolvers against each other: every round sends each name to every resolver at once, from a
+ * single non-blocking IPv4 socket, and the replies are matched back by their source and ID, so resolvers are
+ * measured under the same conditions. Hostnames are resolved before the first round. Blocks until every query
+ * was answered or timed out.
+ * @param results The resolvers to benchmark, their `resolver` set, the rest is filled in.
+ * @param count The number of resolvers.
+ * @param options The benchmark options, NULL for `DNS_DEFAULT_OPTIONS`.
+ * @return The index of the best resolver, or `-1` if none answered.
+ */
+int nordi_dns_benchmark(nordi_dns_result_ptr, int, nordi_dns_options_ptr);
+
+/**
+ * @brief Picks the best of benchmarked resolvers: the least loss, then the lowest median.
+ * @param results The benchmarked resolvers.
+ * @param count The number of resolvers.
+ * @return The index of the best resolver, or `-1` if none answered.
+ */
+int nordi_dns_best(const nordi_dns_result_t*, int);
+
+/**
+ * @brief Sets a resolver as the custom DNS through the settings, turning off threat protection as the daemon
+ * refuses both at once. Reads the settings first if they aren't known. Blocks for every change, so it is meant
+ * for a worker thread.
+ * @param result The resolver to set, its address without any port.
+ * @return 0 if it was set, the error code otherwise.
+ */
+nordvpn_error_t nordi_dns_apply(const nordi_dns_result_t*);
+
+#endif /* NORDI_DNS_H_ */
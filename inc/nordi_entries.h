@@ -0,0 +1,81 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#ifndef NORDI_ENTRIES_H_
+#define NORDI_ENTRIES_H_
+
+#include <gtk/gtk.h>
+#include <stdint.h>
+
+#define NORDI_ENTRIES_TYPE (nordi_entries_get_type())
+
+G_DECLARE_FINAL_TYPE(nordi_entries_t, nordi_entries, NORDI, ENTRIES, GObject)
+
+typedef nordi_entries_t* nordi_entries_ptr;
+
+/**
+ * @brief Creates an empty list of server entries: a GListModel of GtkStringObject labels showing the entries that
+ * match the search. Items are only created for the rows a view asks for, then kept for as long as their entry, and
+ * a change only reports the rows between those kept at both ends, so a selection survives searches that show it.
+ * @return The new list.
+ */
+nordi_entries_ptr nordi_entries_new();
+
+/**
+ * @brief Replaces the entries from an index on, reindexing them for search and searching again. Lifts the
+ * restriction, see `nordi_entries_restrict`.
+ * @param entries The list to change.
+ * @param from The first entry to replace, the entries before it are kept.
+ * @param labels The labels of the new entries, copied.
+ * @param nodes The names to connect to of the new entries, copied, NULL entries for none.
+ * @param count The number of new entries.
+ */
+void nordi_entries_splice(nordi_entries_ptr, int, const char* const*, const char* const*, int);
+
+/**
+ * @brief Shows only the entries matching a query, see `nordi_search_query`.
+ * @param entries The list to search.
+ * @param query The query, empty to show every entry.
+ */
+void nordi_entries_search(nordi_entries_ptr, const char*);
+
+/**
+ * @brief Also hides the entries from an index on whose bit isn't set, whatever the search. A splice lifts the
+ * restriction.
+ * @param entries The list to restrict.
+ * @param from The first entry the bitmap covers, the entries before it aren't restricted.
+ * @param allowed The bitmap of the entries that may show, copied, the entries past its bits are hidden. NULL lifts
+ * the restriction.
+ * @param count The number of bits of the bitmap.
+ */
+void nordi_entries_restrict(nordi_entries_ptr, int, const uint64_t*, int);
+
+/**
+ * @brief The entry shown at a position.
+ * @return The entry index, or `-1` if nothing is shown there.
+ */
+int nordi_entries_entry_at(nordi_entries_ptr, guint);
+
+/**
+ * @brief The position an entry is shown at.
+ * @return The position, or `GTK_INVALID_LIST_POSITION` if the search hides the entry.
+ */
+guint nordi_entries_position_of(nordi_entries_ptr, int);
+
+/**
+ * @brief The name to connect to for an entry.
+ * @return The name, valid until the entry is replaced, or NULL if the entry has none.
+ */
+const char* nordi_entries_node(nordi_entries_ptr, int);
+
+/**
+ * @brief Finds the entry connecting to a name.
+ * @return The entry index, or `-1` if no entry connects to it.
+ */
+int nordi_entries_find(nordi_entries_ptr, const char*);
+
+#endif /* NORDI_ENTRIES_H_ */
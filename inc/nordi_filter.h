@@ -0,0 +1,95 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#ifndef NORDI_FILTER_H_
+#define NORDI_FILTER_H_
+
+#include <stdint.h>
+#include "nordi_catalog.h"
+
+#define FILTER_FEATURE_COUNT    6 // nordi_catalog_feature_t bits
+#define FILTER_TECHNOLOGY_COUNT 4 // nordvpn_technology_t values
+#define FILTER_WORD_BITS        64
+
+/**
+ * @brief A filter over the server table. Each category narrows the result: every feature and technology asked for
+ * is required, while a server in any of the countries and any of the groups asked for is enough.
+ */
+typedef struct {
+    uint32_t features;     // nordi_catalog_feature_t mask, all required
+    uint32_t technologies; // 1 << nordvpn_technology_t mask, all required
+    uint64_t countries;    // 1 << nordvpn_country_t mask, any of them, 0 for any country
+    uint32_t groups;       // 1 << nordvpn_group_t mask, any of them, 0 for any group
+} nordi_filter_query_t;
+
+/**
+ * @brief A columnar server table: a bitmap per feature, technology, country and group, with a bit per server, so a
+ * filter is a word wise AND and OR over a handful of rows.
+ */
+typedef struct {
+    int count;
+    int words; // words per bitmap
+    char (*names)[CATALOG_MAX_SERVER];
+    uint8_t* loads;
+    uint64_t* bitmaps; // rows of words: features, technologies, countries, then groups
+    uint64_t* scratch; // a row's worth of words, for the unions of apply
+} nordi_filter_t;
+
+typedef nordi_filter_t* nordi_filter_ptr;
+typedef nordi_filter_query_t* nordi_filter_query_ptr;
+
+/**
+ * @brief Builds the columnar table over catalog entries. Servers join the region group of their country and the
+ * groups matching their features.
+ * @param servers The catalog entries, copied.
+ * @param count The number of entries.
+ * @return The table, or NULL if it failed to allocate.
+ */
+nordi_filter_ptr nordi_filter_new(const nordi_catalog_server_t*, int);
+
+/**
+ * @brief Builds the columnar table over every entry of a catalog, as it is at the time of the call.
+ * @param catalog The catalog to index.
+ * @return The table, or NULL if it failed to allocate.
+ */
+nordi_filter_ptr nordi_filter_from_catalog(nordi_catalog_ptr);
+
+/**
+ * @brief Applies a filter, writing the bitmap of the matching servers. Not thread safe, it unions in the table.
+ * @param filter The table to filter.
+ * @param query The filter.
+ * @param result Where to write the bitmap to, `words` long.
+ * @return The number of matching servers.
+ */
+int nordi_filter_apply(nordi_filter_ptr, nordi_filter_query_ptr, uint64_t*);
+
+/**
+ * @brief Finds the next matching server of a result bitmap.
+ * @param filter The table filtered.
+ * @param result The bitmap written by apply.
+ * @param from The first server index to consider.
+ * @return The index of the next matching server, or `-1` if there is none left.
+ */
+int nordi_filter_next(nordi_filter_ptr, const uint64_t*, int);
+
+/**
+ * @brief Lists the least loaded matching servers of a result bitmap.
+ * @param filter The table filtered.
+ * @param result The bitmap written by apply.
+ * @param servers Where to write the server indexes to, least loaded first.
+ * @param max The most servers to write.
+ * @return The number of servers written.
+ */
+int nordi_filter_least_loaded(nordi_filter_ptr, const uint64_t*, int*, int);
+
+/**
+ * @brief Frees the table.
+ * @param filter The table to free.
+ */
+void nordi_filter_free(nordi_filter_ptr);
+
+#endif /* NORDI_FILTER_H_ */
@@ -0,0 +1,88 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#ifndef NORDI_GEO_H_
+#define NORDI_GEO_H_
+
+#include <stdbool.h>
+#include "nordi_catalog.h"
+
+#define GEO_EARTH_RADIUS_KM 6371.0088 // mean radius
+
+/**
+ * @brief A server of the index, placed on the unit sphere so the straight line between two points orders them just
+ * like the great circle distance does, with no wrap around at the antimeridian.
+ */
+typedef struct {
+    char name[CATALOG_MAX_SERVER];
+    double latitude;  // degrees
+    double longitude; // degrees
+    double position[3];
+} nordi_geo_point_t;
+
+typedef struct {
+    nordi_geo_point_t* points; // k-d tree laid out in place: each range's median splits the rest, cycling x, y, z
+    int count;
+} nordi_geo_t;
+
+typedef struct {
+    const char* name; // valid until the index is freed
+    double distance_km;
+} nordi_geo_result_t;
+
+typedef nordi_geo_t* nordi_geo_ptr;
+typedef nordi_geo_result_t* nordi_geo_result_ptr;
+
+/**
+ * @brief Builds a nearest server index over the coordinates of catalog entries, in O(n log n).
+ * @param servers The catalog entries, copied.
+ * @param count The number of entries.
+ * @return The index, or NULL if it failed to allocate.
+ */
+nordi_geo_ptr nordi_geo_new(const nordi_catalog_server_t*, int);
+
+/**
+ * @brief Builds a nearest server index over every entry of a catalog, as it is at the time of the call.
+ * @param catalog The catalog to index.
+ * @return The index, or NULL if it failed to allocate.
+ */
+nordi_geo_ptr nordi_geo_from_catalog(nordi_catalog_ptr);
+
+/**
+ * @brief Finds the servers nearest to a location, only visiting the branches of the tree that may hold a nearer
+ * one than those found so far.
+ * @param geo The index to search.
+ * @param latitude The location latitude, in degrees.
+ * @param longitude The location longitude, in degrees.
+ * @param results Where to write the servers to, nearest first, with their haversine distance.
+ * @param max The most servers to write.
+ * @return The number of servers written.
+ */
+int nordi_geo_nearest(nordi_geo_ptr, double, double, nordi_geo_result_ptr, int);
+
+/**
+ * @brief The great circle distance between two locations, by the haversine formula.
+ * @return The distance in kilometres.
+ */
+double nordi_geo_distance_km(double, double, double, double);
+
+/**
+ * @brief Parses a "latitude,longitude" location in degrees, with a '.' decimal separator whatever the locale.
+ * @param text The location text.
+ * @param latitude Where to write the latitude to.
+ * @param longitude Where to write the longitude to.
+ * @return true if the text holds a valid location.
+ */
+bool nordi_geo_parse_location(const char*, double*, double*);
+
+/**
+ * @brief Frees the index.
+ * @param geo The index to free.
+ */
+void nordi_geo_free(nordi_geo_ptr);
+
+#endif /* NORDI_GEO_H_ */
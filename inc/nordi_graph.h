@@ -0,0 +1,40 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#ifndef NORDI_GRAPH_H_
+#define NORDI_GRAPH_H_
+
+#include <gtk/gtk.h>
+
+#define NORDI_GRAPH_TYPE (nordi_graph_get_type())
+
+G_DECLARE_FINAL_TYPE(nordi_graph_t, nordi_graph, NORDI, GRAPH, GtkWidget)
+
+typedef nordi_graph_t* nordi_graph_ptr;
+
+/**
+ * @brief Creates a throughput graph, plotting the last received and sent rates as two lines.
+ * @return The new graph widget.
+ */
+nordi_graph_ptr nordi_graph_new();
+
+/**
+ * @brief Appends a sample to the graph, dropping the oldest once full, and queues a redraw.
+ * The graph only redraws when samples are pushed or it is resized.
+ * @param graph The graph to append to.
+ * @param rx_rate The received bytes per second.
+ * @param tx_rate The sent bytes per second.
+ */
+void nordi_graph_push(nordi_graph_ptr, double, double);
+
+/**
+ * @brief Removes all samples from the graph.
+ * @param graph The graph to clear.
+ */
+void nordi_graph_clear(nordi_graph_ptr);
+
+#endif /* NORDI_GRAPH_H_ */
@@ -0,0 +1,123 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#ifndef NORDI_HISTORY_H_
+#define NORDI_HISTORY_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define HISTORY_MAX_SERVER 24
+#define HISTORY_MAX_PATH   512
+#define HISTORY_BUCKETS    96 // connect time histogram, 4 buckets per power of two up to ~17 minutes
+
+/**
+ * @brief The events recorded in the history.
+ */
+typedef enum {
+    EVENT_CONNECT = 0, // connect or switch to a server
+    EVENT_RECONNECT,   // reconnect after a pause
+    EVENT_DISCONNECT,  // disconnect, ending a session
+    EVENT_PAUSE        // pause, ending a session until the reconnect
+} nordi_history_event_t;
+
+/**
+ * @brief A journal entry, written to disk as is, so its layout is the file format.
+ */
+typedef struct {
+    int64_t time;        // unix time of the event
+    uint8_t event;       // nordi_history_event_t
+    uint8_t technology;  // nordvpn_technology_t
+    int16_t country;     // nordvpn_country_t, -1 if unknown
+    int32_t error;       // nordvpn_error_t of the command, 0 if it succeeded
+    uint32_t connect_ms; // time until the tunnel was up, for successful connects
+    uint32_t session_s;  // length of the session an event ended
+    uint16_t rtt_ms;     // median round trip through the tunnel over the session an event ended, 0 if unknown
+    uint8_t loss;        // percentage of probes lost over the session an event ended
+    uint8_t reserved[5];
+    char server[HISTORY_MAX_SERVER]; // server connected to, or the one requested for failures
+} nordi_history_record_t;
+
+typedef struct {
+    char server[HISTORY_MAX_SERVER];
+    unsigned int attempts;  // connects to the server
+    unsigned int successes; // connects to the server that succeeded
+    uint64_t session_s;     // time spent connected to the server
+    unsigned int buckets[HISTORY_BUCKETS];
+} nordi_history_server_t;
+
+typedef struct {
+    unsigned int attempts;
+    unsigned int successes;
+    float success_rate; // successes over attempts, 0 to 1
+    unsigned int p50_ms; // median connect time of the successes
+    unsigned int p95_ms; // 95th percentile connect time of the successes
+    uint64_t session_s;
+} nordi_history_stats_t;
+
+typedef struct {
+    char path[HISTORY_MAX_PATH];
+    int fd;
+    unsigned int count;              // records in the journal
+    const void* map;                 // read only mapping of the journal
+    size_t map_length;
+    const nordi_history_record_t* records; // records in the mapping, after the header
+    unsigned int mapped;             // records covered by the mapping
+    // per server aggregates, open addressing by server name
+    nordi_history_server_t* servers;
+    unsigned int server_count;
+    unsigned int server_capacity;
+} nordi_history_t;
+
+typedef nordi_history_t* nordi_history_ptr;
+typedef const nordi_history_record_t* nordi_history_record_ptr;
+typedef nordi_history_stats_t* nordi_history_stats_ptr;
+
+/**
+ * @brief Opens the history journal, creating it if needed. The journal is a header followed by fixed size records,
+ * only ever appended to; it is mapped in memory for reading and scanned once to build the per server aggregates,
+ * which appends then keep up to date, so queries never read the journal again. A journal of an older version is
+ * migrated, one of an unknown version is moved aside to "<path>.old" and a new one started.
+ * @param path The journal file path. Its directory must exist.
+ * @return The history, or NULL if the journal failed to open or isn't a history journal.
+ */
+nordi_history_ptr nordi_history_open(const char*);
+
+/**
+ * @brief Appends an event to the journal and to the aggregates.
+ * @param history The history to append to.
+ * @param record The event. A time of `0` is replaced by the current time.
+ * @return true if the event was written.
+ */
+bool nordi_history_append(nordi_history_ptr, const nordi_history_record_t*);
+
+/**
+ * @brief Gets an event by its position in the journal, oldest first, reading the mapping.
+ * @param history The history to read.
+ * @param index The position of the event.
+ * @return The event, valid until the next append, or NULL if out of range.
+ */
+nordi_history_record_ptr nordi_history_get(nordi_history_ptr, unsigned int);
+
+/**
+ * @brief Computes the success rate and connect time percentiles of a server from its aggregates. The percentiles
+ * come from a log bucketed histogram and are accurate to about 12%.
+ * @param history The history to query.
+ * @param server The server name, as in the records.
+ * @param stats Where to write the results.
+ * @return true if the server has any event, false otherwise.
+ */
+bool nordi_history_server_stats(nordi_history_ptr, const char*, nordi_history_stats_ptr);
+
+/**
+ * @brief Closes the journal and frees the history.
+ * @param history The history to close.
+ */
+void nordi_history_close(nordi_history_ptr);
+
+#endif /* NORDI_HISTORY_H_ */
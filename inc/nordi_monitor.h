@@ -0,0 +1,88 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#ifndef NORDI_MONITOR_H_
+#define NORDI_MONITOR_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <threads.h>
+#include "str.h"
+
+/**
+ * @brief NordVPN DNS, only reachable through the tunnel, so its answers measure the tunnel itself.
+ */
+#define MONITOR_DEFAULT_TARGET      "103.86.96.100:53"
+#define MONITOR_DEFAULT_INTERVAL_MS 1000
+#define MONITOR_DEFAULT_TIMEOUT_MS  2000
+#define MONITOR_RING_SIZE           64 // power of two, so sequence numbers wrap onto the same slots
+
+typedef struct {
+    unsigned int seq;
+    long long sent_us;
+    unsigned int rtt_us;
+    bool is_answered;
+} nordi_monitor_sample_t;
+
+typedef struct {
+    unsigned int samples;   // probes answered in the window
+    unsigned int lost;      // probes unanswered past the timeout in the window
+    unsigned int p50_us;    // median round trip
+    unsigned int p95_us;    // 95th percentile round trip
+    unsigned int jitter_us; // mean difference between consecutive round trips
+    float loss;             // percentage of settled probes that were lost
+} nordi_monitor_stats_t;
+
+typedef struct {
+    thrd_t thread;
+    mtx_t mutex;
+    int socket;
+    int timer;
+    int stop;
+    int timeout_ms;
+    nordi_monitor_sample_t ring[MONITOR_RING_SIZE];
+    unsigned int next_seq;
+    atomic_bool is_running;
+    atomic_uint wakeups; // times the thread woke up, for the wakeup accounting
+} nordi_monitor_t;
+
+typedef nordi_monitor_t* nordi_monitor_ptr;
+typedef nordi_monitor_stats_t* nordi_monitor_stats_ptr;
+
+/**
+ * @brief Starts monitoring the connection quality: a thread sends a small DNS query to the target from a
+ * single UDP socket on every interval, keeping the round trips of the last `MONITOR_RING_SIZE` probes.
+ * Anything answering the query or echoing it back works as a target.
+ * @param target The "host[:port]" to probe, `MONITOR_DEFAULT_TARGET` if null.
+ * @param interval_ms The time between probes, `MONITOR_DEFAULT_INTERVAL_MS` if <= `0`.
+ * @param timeout_ms The time after which a probe counts as lost, `MONITOR_DEFAULT_TIMEOUT_MS` if <= `0`.
+ * @return The new monitor, or NULL if the target didn't resolve or the monitor failed to start.
+ */
+nordi_monitor_ptr nordi_monitor_new(str, int, int);
+
+/**
+ * @brief Computes the rolling round trip percentiles, jitter and loss over the probes in the ring.
+ * @param monitor The monitor to read.
+ * @param stats Where to write the results.
+ */
+void nordi_monitor_stats(nordi_monitor_ptr, nordi_monitor_stats_ptr);
+
+/**
+ * @brief Changes the time between probes, starting the new cadence from now. Safe to call from any thread.
+ * @param monitor The monitor to pace.
+ * @param interval_ms The time between probes, `0` to stop probing until paced again.
+ */
+void nordi_monitor_pace(nordi_monitor_ptr, int);
+
+/**
+ * @brief Stops the monitor thread and frees the monitor. Blocks until the thread finishes, unless the thread can't be
+ * woken, in which case the monitor is left to it and only the error is logged.
+ * @param monitor The monitor to free.
+ */
+void nordi_monitor_free(nordi_monitor_ptr);
+
+#endif /* NORDI_MONITOR_H_ */
@@ -0,0 +1,111 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#ifndef NORDI_PROBE_H_
+#define NORDI_PROBE_H_
+
+#include "nordvpn_api.h"
+#include "str.h"
+
+/**
+ * @brief Default port probed when a target doesn't name one (OpenVPN TCP on NordVPN servers).
+ */
+#define PROBE_DEFAULT_PORT        443
+#define PROBE_DEFAULT_CONCURRENCY 16
+#define PROBE_DEFAULT_TIMEOUT_MS  1000
+
+/**
+ * @brief How the round trip to a target is measured.
+ */
+typedef enum {
+    PROBE_TCP = 0, // time until a TCP connection is accepted
+    PROBE_UDP      // time until a datagram is answered
+} nordi_probe_mode_t;
+
+/**
+ * @brief The outcome of a single probe.
+ */
+typedef enum {
+    PROBE_PENDING = 0, // not probed yet
+    PROBE_OK,          // answered, rtt_us is valid
+    PROBE_TIMEOUT,     // no answer before the timeout
+    PROBE_REFUSED,     // the target actively refused
+    PROBE_UNREACHABLE  // could not be resolved or reached
+} nordi_probe_state_t;
+
+typedef struct {
+    str target; // hostname or IP, optionally followed by ":<port>", IPv6 in brackets then ("[::1]:443")
+    nordi_probe_state_t state;
+    unsigned int rtt_us;
+} nordi_probe_result_t;
+
+typedef struct {
+    nordi_probe_mode_t mode;
+    int port;        // port for targets without one
+    int concurrency; // max probes in flight at once
+    int timeout_ms;  // time each probe may take
+} nordi_probe_options_t;
+
+typedef nordi_probe_result_t* nordi_probe_result_ptr;
+typedef const nordi_probe_options_t* nordi_probe_options_ptr;
+
+/**
+ * @brief Options with the default port, concurrency and timeout, probing with TCP.
+ */
+extern const nordi_probe_options_t PROBE_DEFAULT_OPTIONS;
+
+struct addrinfo;
+
+/**
+ * @brief Resolves a "host[:port]" target into the addresses to reach it with, for the given mode.
+ * @param target The hostname or IP, optionally followed by ":<port>", IPv6 in brackets then.
+ * @param mode The protocol the addresses are for.
+ * @param port The port for targets without one.
+ * @return The resolved addresses, to be freed with `freeaddrinfo`, or NULL if it failed to resolve.
+ */
+struct addrinfo* nordi_probe_resolve(str, nordi_probe_mode_t, int);
+
+/**
+ * @brief Probes all targets concurrently from a single epoll loop, keeping at most `concurrency` probes in
+ * flight, then ranks the results in place: answered targets first by lowest round trip, then failures.
+ * Hostnames are resolved on a few threads while the first ones resolved are already probed.
+ * @param results The targets to probe, with their state and rtt filled in on return.
+ * @param count The number of targets.
+ * @param options The probing options, NULL for `PROBE_DEFAULT_OPTIONS`.
+ * @return The number of targets that answered.
+ */
+int nordi_probe_run(nordi_probe_result_ptr, int, nordi_probe_options_ptr);
+
+/**
+ * @brief Same as `nordi_probe_run`, but stops early once the cancel descriptor becomes readable, leaving the
+ * probes it didn't finish pending.
+ * @param results The targets to probe, with their state and rtt filled in on return.
+ * @param count The number of targets.
+ * @param options The probing options, NULL for `PROBE_DEFAULT_OPTIONS`.
+ * @param cancel A descriptor that becomes readable to cancel, usually an eventfd, or `-1` for none.
+ * @return The number of targets that answered, or `-1` if cancelled.
+ */
+int nordi_probe_run_cancellable(nordi_probe_result_ptr, int, nordi_probe_options_ptr, int);
+
+/**
+ * @brief Converts a probed target into the server name nordvpn connects to, dropping the port and the domain
+ * ("de123.nordvpn.com:443" becomes "de123"). IP targets are kept whole, without the port.
+ * @param result The probed target.
+ * @return A new str object with the server name, to be freed by the caller.
+ */
+str nordi_probe_server(const nordi_probe_result_ptr);
+
+/**
+ * @brief Probes the targets and connects to the fastest one that answered with `nordvpn_server_connect`.
+ * @param results The targets to probe, ranked on return.
+ * @param count The number of targets.
+ * @param options The probing options, NULL for `PROBE_DEFAULT_OPTIONS`.
+ * @return 0 if connected, `NOT_FOUND` if no target answered, the connect error code otherwise.
+ */
+nordvpn_error_t nordi_probe_connect_best(nordi_probe_result_ptr, int, nordi_probe_options_ptr);
+
+#endif /* NORDI_PROBE_H_ */
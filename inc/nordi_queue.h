@@ -0,0 +1,119 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#ifndef NORDI_QUEUE_H_
+#define NORDI_QUEUE_H_
+
+#include <stdbool.h>
+#include <threads.h>
+#include "nordi_allowlist.h"
+#include "nordvpn_api.h"
+#include "str.h"
+
+/**
+ * @brief The commands that can be queued, each mapping to a NordVPN API call.
+ */
+typedef enum {
+    COMMAND_NONE = 0,   // empty slot
+    COMMAND_CONNECT,    // nordvpn_server_connect
+    COMMAND_RECONNECT,  // nordvpn_reconnect
+    COMMAND_DISCONNECT, // nordvpn_disconnect
+    COMMAND_LOGIN,      // nordvpn_login
+    COMMAND_LOGOUT,     // nordvpn_logout
+    COMMAND_REFRESH,    // nordvpn_refresh
+    COMMAND_SYNC,       // nordvpn_sync_host
+    COMMAND_ALLOWLIST,  // nordi_allowlist_import
+    COMMAND_STATUS      // nordvpn_read_status, queued by the worker itself to reconcile a cancelled change
+} nordi_command_type_t;
+
+/**
+ * @brief The state each command acts on. A target holds at most one pending command, and worker runs
+ * pending commands by target order, one at a time.
+ */
+typedef enum {
+    TARGET_VPN = 0,  // connection state
+    TARGET_ACCOUNT,  // login state
+    TARGET_HOST,     // host details
+    TARGET_SETTINGS, // daemon settings
+    TARGET_COUNT
+} nordi_target_t;
+
+typedef struct {
+    nordi_command_type_t type;
+    str server;             // server for COMMAND_CONNECT, file paths for COMMAND_ALLOWLIST
+    int tag;                // caller defined value, handed back on completion
+    nordvpn_error_t result; // result of the API call, filled on completion
+    str link;               // login link for COMMAND_LOGIN, filled on completion
+} nordi_command_t;
+
+typedef nordi_command_t* nordi_command_ptr;
+typedef void (*nordi_queue_callback_t)(nordi_command_ptr, void*);
+
+typedef struct {
+    thrd_t thread;
+    mtx_t mutex;
+    cnd_t wakeup;
+    cnd_t idle;
+    nordi_command_t pending[TARGET_COUNT];
+    nordi_command_t inflight;
+    bool is_inflight_cancelled;
+    bool is_reconcile_due;       // a connection change was cancelled, the daemon may still carry it out
+    nordi_command_t last_change; // where the last connection change that ran left it, as the command leading there
+    nordi_queue_callback_t callback;
+    void* context;
+    bool is_running;
+    // counters
+    unsigned int executed;   // commands that reached the API
+    unsigned int superseded; // pending commands replaced by a newer one
+    unsigned int cancelled;  // in flight commands cancelled by a newer one
+    unsigned int skipped;    // commands dropped since the state was already heading there
+    unsigned int reconciles; // status reads after a cancel, counted as executed
+    unsigned int reconciled; // connection changes run again as the daemon ended elsewhere, counted as executed
+} nordi_queue_t;
+
+typedef nordi_queue_t* nordi_queue_ptr;
+
+/**
+ * @brief Creates a command queue with its worker thread. Commands run on the worker, one at a time, and the
+ * callback is called on the worker thread after each one finishes, so it must not touch the UI directly.
+ * The command given to the callback is only valid during the call.
+ * @param callback The function called with each finished command.
+ * @param context The data argument to be passed onto the callback.
+ * @return The new queue, or NULL if it failed to start.
+ */
+nordi_queue_ptr nordi_queue_new(nordi_queue_callback_t, void*);
+
+/**
+ * @brief Queues a command, latest wins: a pending command for the same target is replaced, and a connect or
+ * disconnect already running is cancelled if the new command makes it pointless. A command equal to the one
+ * running, or a disconnect while offline, is dropped without running anything. Imports add up instead, a pending
+ * `COMMAND_ALLOWLIST` takes the new file along.
+ * As the daemon may carry out a cancelled change after all, once the connection commands run out after a cancel
+ * the worker reads the status back with a `COMMAND_STATUS`, and leads the connection back to where the last
+ * change left it if it ended elsewhere.
+ * @param queue The queue to push into.
+ * @param type The command to run.
+ * @param server The server to connect to, for `COMMAND_CONNECT`, or the file to import, for `COMMAND_ALLOWLIST`.
+ * Copied.
+ * @param tag A caller defined value, handed back to the callback.
+ */
+void nordi_queue_push(nordi_queue_ptr, nordi_command_type_t, str, int);
+
+/**
+ * @brief Waits until there are no pending or running commands. Blocks while waiting.
+ * @param queue The queue to wait for.
+ */
+void nordi_queue_wait(nordi_queue_ptr);
+
+/**
+ * @brief Drops the pending commands, cancels the running one and stops the worker, then frees the queue.
+ * Blocks until the worker finishes.
+ * @param queue The queue to free.
+ */
+void nordi_queue_free(nordi_queue_ptr);
+
+#endif /* NORDI_QUEUE_H_ */
@@ -0,0 +1,152 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#ifndef NORDI_REFRESH_H_
+#define NORDI_REFRESH_H_
+
+#include <stdbool.h>
+
+#define REFRESH_MAX_TASKS         8
+#define REFRESH_ALIGN_MS          1000 // deadlines are multiples of this, scaled by the mode, so tasks wake together
+#define REFRESH_BACKGROUND_FACTOR 4    // interval scale while the window is shown but not focused
+#define REFRESH_HIDDEN_FACTOR     30   // interval scale while the window is hidden or in the tray
+#define REFRESH_NO_DEADLINE       -1
+#define REFRESH_NO_TASK           -1
+
+/**
+ * @brief How often tasks run, from the window and session state.
+ */
+typedef enum {
+    REFRESH_FOCUSED = 0, // the base intervals
+    REFRESH_BACKGROUND,  // shown but not focused, `REFRESH_BACKGROUND_FACTOR` times slower
+    REFRESH_HIDDEN,      // hidden or in the tray, `REFRESH_HIDDEN_FACTOR` times slower
+    REFRESH_PAUSED       // battery saver or idle session, nothing runs
+} nordi_refresh_mode_t;
+
+typedef void (*nordi_refresh_func_t)(void*);
+
+typedef struct {
+    int interval_ms; // while focused
+    nordi_refresh_func_t func;
+    void* context;
+    bool is_enabled;
+    long long last_ms;     // when it last ran, or was enabled
+    long long deadline_ms; // when it runs next, while enabled and not paused
+} nordi_refresh_task_t;
+
+typedef struct {
+    nordi_refresh_task_t tasks[REFRESH_MAX_TASKS];
+    int task_count;
+    bool is_focused;
+    bool is_visible;
+    bool is_power_saving;
+    bool is_idle;
+    // counters
+    unsigned long long wakeups; // runs that found any task due
+    unsigned long long runs;    // task calls
+    long long minute_start_ms;  // start of the minute being counted
+    unsigned int minute_wakeups;
+    unsigned int last_minute_wakeups; // wakeups over the previous full minute
+} nordi_refresh_t;
+
+typedef nordi_refresh_t* nordi_refresh_ptr;
+
+/**
+ * @brief The name of a mode, as logged.
+ */
+extern const char* const NORDI_REFRESH_MODE_STR[];
+
+/**
+ * @brief Creates a refresh policy with no tasks, for a focused and visible window.
+ * @return The refresh policy, or NULL if it failed to allocate.
+ */
+nordi_refresh_ptr nordi_refresh_new();
+
+/**
+ * @brief Adds a periodic task, disabled.
+ * @param refresh The refresh policy.
+ * @param interval_ms The time between runs while the window is focused.
+ * @param func The function to run.
+ * @param context The data argument to be passed onto the function.
+ * @return The task, or `REFRESH_NO_TASK` if there are `REFRESH_MAX_TASKS` already.
+ */
+int nordi_refresh_add(nordi_refresh_ptr, int, nordi_refresh_func_t, void*);
+
+/**
+ * @brief Enables or disables a task. An enabled task first runs an interval after.
+ * @param refresh The refresh policy.
+ * @param task The task to enable or disable.
+ * @param is_enabled true to enable, false to disable.
+ * @param now_ms The current monotonic time.
+ */
+void nordi_refresh_enable(nordi_refresh_ptr, int, bool, long long);
+
+/**
+ * @brief Sets the window and session state, rescheduling the tasks for the mode it implies. A task overdue from
+ * the slower mode runs on the next aligned deadline.
+ * @param refresh The refresh policy.
+ * @param is_focused Whether the window has the focus.
+ * @param is_visible Whether the window is shown.
+ * @param is_power_saving Whether the battery saver is on.
+ * @param is_idle Whether the session is idle.
+ * @param now_ms The current monotonic time.
+ */
+void nordi_refresh_set_state(nordi_refresh_ptr, bool, bool, bool, bool, long long);
+
+/**
+ * @brief The mode of the current state.
+ * @param refresh The refresh policy.
+ * @return The mode.
+ */
+nordi_refresh_mode_t nordi_refresh_mode(nordi_refresh_ptr);
+
+/**
+ * @brief How much slower than focused the current mode runs, for samplers paced outside the policy.
+ * @param refresh The refresh policy.
+ * @return The factor to stretch an interval by, or `0` if paused.
+ */
+int nordi_refresh_scale(nordi_refresh_ptr);
+
+/**
+ * @brief The time until the next wakeup.
+ * @param refresh The refresh policy.
+ * @param now_ms The current monotonic time.
+ * @return The time in milliseconds, `0` if a task is due, or `REFRESH_NO_DEADLINE` if paused or no task is enabled.
+ */
+int nordi_refresh_next(nordi_refresh_ptr, long long);
+
+/**
+ * @brief Runs every task that is due, each scheduled again on the first aligned deadline after its interval.
+ * @param refresh The refresh policy.
+ * @param now_ms The current monotonic time.
+ * @return The time until the next wakeup, as `nordi_refresh_next`.
+ */
+int nordi_refresh_run(nordi_refresh_ptr, long long);
+
+/**
+ * @brief The wakeups over the last full minute.
+ * @param refresh The refresh policy.
+ * @param now_ms The current monotonic time.
+ * @return The wakeups, `0` once a whole minute passed without any.
+ */
+unsigned int nordi_refresh_wakeups_per_minute(nordi_refresh_ptr, long long);
+
+/**
+ * @brief Adds wakeups made outside the policy, such as sampler threads, to the wakeup accounting.
+ * @param refresh The refresh policy.
+ * @param count The wakeups since the last count.
+ * @param now_ms The current monotonic time.
+ */
+void nordi_refresh_count_wakeups(nordi_refresh_ptr, unsigned int, long long);
+
+/**
+ * @brief Frees the refresh policy.
+ * @param refresh The refresh policy to free.
+ */
+void nordi_refresh_free(nordi_refresh_ptr);
+
+#endif /* NORDI_REFRESH_H_ */
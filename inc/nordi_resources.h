@@ -0,0 +1,129 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#ifndef NORDI_RESOURCES_H_
+#define NORDI_RESOURCES_H_
+
+#include <stddef.h>
+#include <stdio.h>
+#include "str.h"
+
+#define RESOURCE_SNAPSHOTS  60 // kept for the trends, the oldest dropped first
+#define RESOURCE_UNKNOWN    -1 // a process count that could not be read
+#define RESOURCE_PROC_PATH  "/proc/self"
+
+/**
+ * @brief The parts of the application allocations are accounted to.
+ */
+typedef enum {
+    RESOURCE_API = 0, // nordvpn session, host and settings data
+    RESOURCE_ROUTINES,
+    RESOURCE_GUI,     // dialogs and command results
+    RESOURCE_CATALOG, // the server table
+    RESOURCE_SUBSYSTEMS
+} nordi_resource_subsystem_t;
+
+typedef struct {
+    long long time_ms;                           // monotonic time it was taken at
+    long long allocations[RESOURCE_SUBSYSTEMS]; // live
+    long long bytes[RESOURCE_SUBSYSTEMS];       // live
+    int threads;                                 // of the whole process, or `RESOURCE_UNKNOWN`
+    int fds;                                     // open, or `RESOURCE_UNKNOWN`
+    int children;                                // child processes not reaped yet
+} nordi_resources_snapshot_t;
+
+typedef struct {
+    nordi_resources_snapshot_t snapshots[RESOURCE_SNAPSHOTS];
+    int count;
+    int next; // where the next snapshot goes
+} nordi_resources_t;
+
+typedef nordi_resources_t* nordi_resources_ptr;
+
+/**
+ * @brief The name of a subsystem, as logged.
+ */
+extern const char* const NORDI_RESOURCE_SUBSYSTEM_STR[];
+
+/**
+ * @brief Accounts an allocation as live. Thread safe, as every accounting call.
+ * @param subsystem The subsystem owning it.
+ * @param size Its size in bytes.
+ */
+void nordi_resources_alloc(nordi_resource_subsystem_t, size_t);
+
+/**
+ * @brief Accounts an allocation as freed.
+ * @param subsystem The subsystem that owned it.
+ * @param size The size it was accounted with.
+ */
+void nordi_resources_release(nordi_resource_subsystem_t, size_t);
+
+/**
+ * @brief Copies a string as `str_cpy`, accounting the allocation it replaces and the one it makes.
+ * @param subsystem The subsystem owning the string.
+ * @param target The string to copy into.
+ * @param source The string to copy.
+ */
+void nordi_resources_str_cpy(nordi_resource_subsystem_t, str*, const str);
+
+/**
+ * @brief Clears a string as `str_clear`, accounting its allocation as freed.
+ * @param subsystem The subsystem owning the string.
+ * @param target The string to clear.
+ */
+void nordi_resources_str_clear(nordi_resource_subsystem_t, str*);
+
+/**
+ * @brief Accounts a child process as spawned or reaped.
+ * @param change `1` when spawned, `-1` when reaped.
+ */
+void nordi_resources_child(int);
+
+/**
+ * @brief Reads the live counts now.
+ * @param snapshot Where to store them.
+ * @param now_ms The current monotonic time, stored with them.
+ */
+void nordi_resources_sample(nordi_resources_snapshot_t*, long long);
+
+/**
+ * @brief Creates an empty history of snapshots.
+ * @return The history, or NULL if it failed to allocate.
+ */
+nordi_resources_ptr nordi_resources_new();
+
+/**
+ * @brief Takes a snapshot into the history, over the oldest once it holds `RESOURCE_SNAPSHOTS`.
+ * @param resources The history.
+ * @param now_ms The current monotonic time.
+ */
+void nordi_resources_snapshot(nordi_resources_ptr, long long);
+
+/**
+ * @brief The snapshot taken at a given age.
+ * @param resources The history.
+ * @param age `0` for the latest snapshot, `1` for the one before and so on.
+ * @return The snapshot, or NULL if there are not that many.
+ */
+const nordi_resources_snapshot_t* nordi_resources_at(nordi_resources_ptr, int);
+
+/**
+ * @brief Writes the live counts and how much each changed since the oldest snapshot.
+ * @param resources The history.
+ * @param file Where to write the report to.
+ * @param now_ms The current monotonic time.
+ */
+void nordi_resources_write(nordi_resources_ptr, FILE*, long long);
+
+/**
+ * @brief Frees the history. The counts are process wide and stay.
+ * @param resources The history to free.
+ */
+void nordi_resources_free(nordi_resources_ptr);
+
+#endif /* NORDI_RESOURCES_H_ */
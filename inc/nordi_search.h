@@ -0,0 +1,88 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#ifndef NORDI_SEARCH_H_
+#define NORDI_SEARCH_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SEARCH_MAX_QUERY  64
+#define SEARCH_SHORT_QUERY 3 // shorter queries match word prefixes, longer ones go through the trigrams
+
+typedef struct {
+    uint32_t key; // a trigram or a word prefix, 0 if the slot is empty
+    int* ids;     // ascending
+    int count;
+    int capacity;
+} nordi_search_posting_t;
+
+/**
+ * @brief A case insensitive text index: a posting list per trigram for substring queries, plus one per one and two
+ * letter word prefix for the queries too short to have a trigram.
+ */
+typedef struct {
+    char** texts; // folded: lower case, '_' as ' '
+    int count;
+    int capacity;
+    nordi_search_posting_t* slots; // open addressing by key
+    int slot_capacity;
+    int slot_count;
+    // the last query, refined instead of searched again while the user keeps typing
+    char last[SEARCH_MAX_QUERY];
+    bool is_last_valid;
+    int* results;
+    int result_count;
+} nordi_search_t;
+
+typedef nordi_search_t* nordi_search_ptr;
+
+/**
+ * @brief Creates an empty index.
+ * @return The index, or NULL if it failed to allocate.
+ */
+nordi_search_ptr nordi_search_new();
+
+/**
+ * @brief Adds a text to the index.
+ * @param search The index to add to.
+ * @param text The text.
+ * @return The id of the text, the number of texts added before it, or `-1` if it failed to allocate.
+ */
+int nordi_search_add(nordi_search_ptr, const char*);
+
+/**
+ * @brief Finds the texts matching a query, ignoring case. A query shorter than `SEARCH_SHORT_QUERY` matches the
+ * texts having a word starting with it, a longer one the texts containing it. A longer query containing the
+ * previous one only rechecks the previous matches.
+ * @param search The index to query.
+ * @param query The query, only the first `SEARCH_MAX_QUERY - 1` characters count. Empty matches every text.
+ * @param ids Where to write the pointer to the matching ids to, ascending, valid until the next query or add.
+ * @return The number of matching texts.
+ */
+int nordi_search_query(nordi_search_ptr, const char*, const int**);
+
+/**
+ * @brief Narrows the change between two query results down to the single range between what both start and end
+ * with, so a list showing them only updates the rows in between.
+ * @param previous The ids matched before, ascending.
+ * @param previous_count The number of ids matched before.
+ * @param next The ids matched now, ascending.
+ * @param next_count The number of ids matched now.
+ * @param removed Where to write the number of previous ids the range replaces.
+ * @param added Where to write the number of ids replacing them.
+ * @return The position the range starts at, in both results.
+ */
+int nordi_search_changed_range(const int*, int, const int*, int, int*, int*);
+
+/**
+ * @brief Frees the index.
+ * @param search The index to free.
+ */
+void nordi_search_free(nordi_search_ptr);
+
+#endif /* NORDI_SEARCH_H_ */
@@ -0,0 +1,105 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#ifndef NORDI_SELECTOR_H_
+#define NORDI_SELECTOR_H_
+
+#include <stdint.h>
+#include "nordi_history.h"
+
+#define SELECTOR_DEFAULT_HALF_LIFE_S 604800 // a week old outcome counts half as much as a fresh one
+#define SELECTOR_ANY_COUNTRY         -1
+
+/**
+ * @brief What was learned of a server. The sums are time decayed: each outcome weighs half as much every half
+ * life, applied lazily once the next outcome arrives.
+ */
+typedef struct {
+    char server[HISTORY_MAX_SERVER];
+    int country;     // nordvpn_country_t, -1 until a successful connect reports it
+    int next;        // next server of the same country, -1 at the end
+    int64_t updated; // time the sums are decayed to
+    double attempts;
+    double successes;
+    double connect_ms; // sum over the successes
+    double sessions;   // sessions ended with a quality measure
+    double rtt_ms;     // sum over the sessions
+    double loss;       // sum over the sessions, percentages
+} nordi_selector_server_t;
+
+typedef struct {
+    nordi_selector_server_t* servers; // in order of first appearance
+    int count;
+    int capacity;
+    int* slots; // open addressing by server name, indexes into servers, -1 if empty
+    int slot_capacity;
+    int* heads; // first server of each country, -1 if none
+    double half_life_s;
+} nordi_selector_t;
+
+typedef nordi_selector_t* nordi_selector_ptr;
+
+/**
+ * @brief Creates an empty selector.
+ * @param half_life_s The time an outcome takes to lose half its weight, `SELECTOR_DEFAULT_HALF_LIFE_S` if <= `0`.
+ * @return The selector, or NULL if it failed to allocate.
+ */
+nordi_selector_ptr nordi_selector_new(double);
+
+/**
+ * @brief Learns from every event of a history, oldest first. Done once, later events go through observe.
+ * @param selector The selector to feed.
+ * @param history The history to read.
+ */
+void nordi_selector_load(nordi_selector_ptr, nordi_history_ptr);
+
+/**
+ * @brief Learns from a single event: connects count towards the success rate and connect time of their server,
+ * events ending a session with a quality measure towards its round trip and loss. Constant time.
+ * @param selector The selector to feed.
+ * @param record The event, as appended to the history.
+ */
+void nordi_selector_observe(nordi_selector_ptr, const nordi_history_record_t*);
+
+/**
+ * @brief Scores a server between `0` and `1` from its decayed outcomes: the success rate, starting from even odds,
+ * times factors falling with the mean connect time and the session round trip and loss. Unmeasured factors take a
+ * neutral prior, so a server with old outcomes drifts towards an untried one.
+ * @param selector The selector to query.
+ * @param server The server name.
+ * @param now The current unix time.
+ * @return The score, or `-1` if nothing is known of the server.
+ */
+double nordi_selector_score(nordi_selector_ptr, const char*, int64_t);
+
+/**
+ * @brief Ranks the best scoring servers of a country, only walking the servers known in that country.
+ * @param selector The selector to query.
+ * @param country The nordvpn_country_t to rank in, or `SELECTOR_ANY_COUNTRY`.
+ * @param now The current unix time.
+ * @param servers Where to write the server names, best first, valid until the next observe.
+ * @param max The most servers to write, up to 64.
+ * @return The number of servers written, only those beating an untried one.
+ */
+int nordi_selector_rank(nordi_selector_ptr, int, int64_t, const char**, int);
+
+/**
+ * @brief Picks the best scoring server of a country, only walking the servers known in that country.
+ * @param selector The selector to query.
+ * @param country The nordvpn_country_t to pick in, or `SELECTOR_ANY_COUNTRY`.
+ * @param now The current unix time.
+ * @return The server name, valid until the next observe, or NULL if no known server beats an untried one.
+ */
+const char* nordi_selector_best(nordi_selector_ptr, int, int64_t);
+
+/**
+ * @brief Frees the selector.
+ * @param selector The selector to free.
+ */
+void nordi_selector_free(nordi_selector_ptr);
+
+#endif /* NORDI_SELECTOR_H_ */
@@ -0,0 +1,92 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#ifndef NORDI_SPECULATION_H_
+#define NORDI_SPECULATION_H_
+
+#include <stdbool.h>
+#include <threads.h>
+#include "nordi_probe.h"
+#include "str.h"
+
+#define SPECULATION_MAX_TARGETS    8
+#define SPECULATION_DEFAULT_TTL_MS 60000 // a ranking older than this no longer says much about the servers
+
+typedef struct {
+    thrd_t thread;
+    mtx_t mutex;
+    cnd_t wakeup;
+    cnd_t idle;
+    int cancel; // eventfd, readable once the speculation being worked on went stale
+    bool is_running;
+    bool is_working;
+    nordi_probe_options_t options;
+    // latest request, guarded by the mutex
+    unsigned int generation; // bumped by every request and cancel
+    bool is_requested;       // the latest request waits for the worker
+    int key;
+    nordi_probe_result_t targets[SPECULATION_MAX_TARGETS];
+    int target_count;
+    // outcome of the latest request, guarded by the mutex
+    bool is_ready;
+    int ready_key;
+    str best; // fastest server that answered, str_null if none did
+    long long ready_us;
+    // counters
+    unsigned int completed; // speculations that ranked their targets
+    unsigned int cancelled; // speculations that went stale before finishing
+} nordi_speculation_t;
+
+typedef nordi_speculation_t* nordi_speculation_ptr;
+
+/**
+ * @brief Creates a speculation worker: a thread that probes the candidates of the latest request in the
+ * background, so the fastest one is known before it is asked for.
+ * @param options The probing options, copied, NULL for `PROBE_DEFAULT_OPTIONS`.
+ * @return The speculation worker, or NULL if it failed to start.
+ */
+nordi_speculation_ptr nordi_speculation_new(nordi_probe_options_ptr);
+
+/**
+ * @brief Starts ranking the targets for a key, latest wins: any earlier request is dropped, and one already
+ * probing is cancelled right away.
+ * @param speculation The speculation worker.
+ * @param key A caller defined key the outcome is taken with, such as the selected entry.
+ * @param targets The probe targets, copied. Only the first `SPECULATION_MAX_TARGETS` are probed.
+ * @param count The number of targets, `0` to just cancel.
+ */
+void nordi_speculation_request(nordi_speculation_ptr, int, const str*, int);
+
+/**
+ * @brief Drops the latest request and its outcome, cancelling it if it is probing.
+ * @param speculation The speculation worker.
+ */
+void nordi_speculation_cancel(nordi_speculation_ptr);
+
+/**
+ * @brief Takes the fastest server of the latest request, if it finished for the same key. Never blocks.
+ * @param speculation The speculation worker.
+ * @param key The key of the request.
+ * @param max_age_ms The oldest outcome accepted, `SPECULATION_DEFAULT_TTL_MS` if <= `0`.
+ * @param server Where to copy the server name to.
+ * @return true if a server was copied, false if the outcome isn't ready, is stale or nothing answered.
+ */
+bool nordi_speculation_take(nordi_speculation_ptr, int, int, str*);
+
+/**
+ * @brief Waits until the latest request finished or was cancelled. Blocks while waiting.
+ * @param speculation The speculation worker.
+ */
+void nordi_speculation_wait(nordi_speculation_ptr);
+
+/**
+ * @brief Cancels any work, stops the thread and frees the speculation worker. Blocks until the thread finishes.
+ * @param speculation The speculation worker.
+ */
+void nordi_speculation_free(nordi_speculation_ptr);
+
+#endif /* NORDI_SPECULATION_H_ */
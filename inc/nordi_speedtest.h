@@ -0,0 +1,99 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#ifndef NORDI_SPEEDTEST_H_
+#define NORDI_SPEEDTEST_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <threads.h>
+#include "str.h"
+
+#define SPEEDTEST_MAX_STREAMS          16
+#define SPEEDTEST_MAX_SAMPLES          600
+#define SPEEDTEST_DEFAULT_PORT         5201
+#define SPEEDTEST_DEFAULT_STREAMS      4
+#define SPEEDTEST_DEFAULT_DURATION_MS  10000
+#define SPEEDTEST_DEFAULT_INTERVAL_MS  100
+#define SPEEDTEST_DEFAULT_TIMEOUT_MS   5000
+#define SPEEDTEST_CHUNK                (256 * 1024) // data sent over and over, large enough to never be compressed
+#define SPEEDTEST_RAMP_UP_THRESHOLD    0.9          // share of the steady rate that counts as ramped up
+#define SPEEDTEST_SINK_MAX_CONNECTIONS 64
+
+typedef struct {
+    int streams;     // parallel TCP streams, up to `SPEEDTEST_MAX_STREAMS`
+    int duration_ms; // time spent sending, from the first stream connected
+    int interval_ms; // sampling period of the aggregate rate
+    int timeout_ms;  // time the streams may take to connect
+} nordi_speedtest_options_t;
+
+typedef struct {
+    int streams;                                            // streams that connected
+    bool is_zero_copy;                                      // the data was sent with sendfile
+    unsigned long long bytes;                               // delivered to the sink, over all streams
+    unsigned long long stream_bytes[SPEEDTEST_MAX_STREAMS]; // delivered to the sink, per stream
+    double goodput_bps;                                     // bits per second delivered
+    unsigned int ramp_up_ms;                                // time until the rate reached the threshold
+    double fairness;                                        // Jain's index of the stream shares, 1 if even
+    unsigned int elapsed_ms;
+} nordi_speedtest_result_t;
+
+/**
+ * @brief A sink for speed tests: accepts any number of streams and discards whatever they send.
+ */
+typedef struct {
+    thrd_t thread;
+    int listener;
+    int stop; // eventfd, readable once the sink is being freed
+    int port;
+    atomic_ullong bytes;     // received over all streams
+    atomic_uint connections; // streams accepted
+} nordi_speedtest_sink_t;
+
+typedef const nordi_speedtest_options_t* nordi_speedtest_options_ptr;
+typedef nordi_speedtest_result_t* nordi_speedtest_result_ptr;
+typedef nordi_speedtest_sink_t* nordi_speedtest_sink_ptr;
+
+extern const nordi_speedtest_options_t SPEEDTEST_DEFAULT_OPTIONS;
+
+/**
+ * @brief Measures the throughput to a sink: parallel TCP streams send for the duration, all from a single epoll
+ * loop, with sendfile so the data is never copied through user space. Only what the sink acknowledged counts as
+ * delivered. Blocks for up to the connect timeout plus the duration, so it is meant for a worker thread.
+ * @param target The sink, "host[:port]", `SPEEDTEST_DEFAULT_PORT` if no port is given.
+ * @param options The test options, NULL for `SPEEDTEST_DEFAULT_OPTIONS`.
+ * @param result Where to write the result to, filled in even when the test is cancelled.
+ * @param cancel Stops the test early once set, NULL if it can't be cancelled.
+ * @return true if any stream connected and the test ran for its whole duration.
+ */
+bool nordi_speedtest_run(str, nordi_speedtest_options_ptr, nordi_speedtest_result_ptr, atomic_bool*);
+
+/**
+ * @brief Jain's fairness index of stream shares: (sum x)^2 / (n * sum x^2).
+ * @param bytes The bytes each stream delivered.
+ * @param count The number of streams.
+ * @return The index, from 1 / count when a single stream got everything to 1 when all got the same, 0 if none
+ * delivered anything.
+ */
+double nordi_speedtest_fairness(const unsigned long long*, int);
+
+/**
+ * @brief Starts a speed test sink, serving on a thread.
+ * @param bind_address The IPv4 address to listen on, such as the tunnel's, NULL for the loopback only.
+ * @param port The TCP port to listen on, `0` for any free one.
+ * @return The sink, its `port` set to the one listened on, or NULL if the address is invalid or it failed to listen.
+ */
+nordi_speedtest_sink_ptr nordi_speedtest_sink_new(const char*, int);
+
+/**
+ * @brief Stops the sink, closing every stream, and frees it. Blocks until the thread finishes, unless the thread
+ * can't be woken, in which case the sink is left to it and only the error is logged.
+ * @param sink The sink to free.
+ */
+void nordi_speedtest_sink_free(nordi_speedtest_sink_ptr);
+
+#endif /* NORDI_SPEEDTEST_H_ */
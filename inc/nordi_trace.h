@@ -0,0 +1,135 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#ifndef NORDI_TRACE_H_
+#define NORDI_TRACE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <threads.h>
+
+#define TRACE_MAX_ARGUMENTS 16
+#define TRACE_NO_EXIT       -1 // the process was killed or cancelled before exiting
+#define TRACE_STOPPED       -2 // the sink stopped a replay
+#define TRACE_REPLAY_ENV    "NORDI_REPLAY"       // trace the fake nordvpn binary replays
+#define TRACE_SPEED_ENV     "NORDI_REPLAY_SPEED" // replay speed factor, 1 by default, 0 without any waiting
+#define TRACE_CURSOR_SUFFIX ".cursor"            // next to the trace, where the fake binary left off
+
+/**
+ * @brief Output of a run, as one read returned it.
+ */
+typedef struct {
+    long long offset_us; // since the run started
+    char* data;
+    size_t length;
+} nordi_trace_chunk_t;
+
+/**
+ * @brief A run of the binary: its arguments, the output it streamed and how it exited.
+ */
+typedef struct {
+    long long start_us;                       // since the recording started
+    char* arguments[TRACE_MAX_ARGUMENTS + 1]; // after the binary, NULL terminated
+    int argument_count;
+    nordi_trace_chunk_t* chunks;
+    int chunk_count;
+    int chunk_capacity;
+    long long exit_us; // since the run started
+    int exit_code;     // or `TRACE_NO_EXIT`
+} nordi_trace_run_t;
+
+typedef struct {
+    FILE* file;         // appended to while recording, NULL once loaded
+    mtx_t mutex;        // runs end on any thread
+    long long start_us; // monotonic time the recording started at
+    nordi_trace_run_t* runs;
+    int run_count;
+    int run_capacity;
+    int cursor; // run after the last one found
+} nordi_trace_t;
+
+typedef nordi_trace_t* nordi_trace_ptr;
+
+// Takes replayed output, returns false to stop the replay
+typedef bool (*nordi_trace_sink_t)(void*, const char*, size_t);
+
+/**
+ * @brief Starts recording runs onto the end of a trace file, created if missing.
+ * @param path The trace file.
+ * @return The trace, or NULL if the file couldn't be opened.
+ */
+nordi_trace_ptr nordi_trace_record(const char*);
+
+/**
+ * @brief Starts a run, timed from now. Runs are kept by the caller until they end.
+ * @param run The run to start.
+ * @param arguments The arguments as passed to the binary, the first being the binary, NULL terminated.
+ */
+void nordi_trace_begin(nordi_trace_run_t*, const char**);
+
+/**
+ * @brief Adds output of a run, timed from its start.
+ * @param run The run.
+ * @param data The output.
+ * @param length The output length.
+ * @return false if it failed to allocate, the output is lost.
+ */
+bool nordi_trace_output(nordi_trace_run_t*, const char*, size_t);
+
+/**
+ * @brief Ends a run and appends it to the trace file, then frees what it holds.
+ * @param trace The recording trace.
+ * @param run The run to end.
+ * @param exit_code The exit status of the binary, or `TRACE_NO_EXIT`.
+ */
+void nordi_trace_end(nordi_trace_ptr, nordi_trace_run_t*, int);
+
+/**
+ * @brief Loads a recorded trace for replaying.
+ * @param path The trace file.
+ * @return The trace, or NULL if it couldn't be read or isn't a trace.
+ */
+nordi_trace_ptr nordi_trace_load(const char*);
+
+/**
+ * @brief Finds the next run of the given arguments, from where the last one found was on, going around to the
+ * start once past the last run. Replaying a session in its order gets each command the output it had then.
+ * @param trace The loaded trace.
+ * @param arguments The arguments as passed to the binary, the first being the binary, NULL terminated.
+ * @return The run, or NULL if none has these arguments.
+ */
+const nordi_trace_run_t* nordi_trace_find(nordi_trace_ptr, const char**);
+
+/**
+ * @brief Replays the output of a run into a sink, waiting out the recorded times scaled by the speed.
+ * @param run The run to replay.
+ * @param speed `1` for the original speed, `2` for twice as fast and so on, `0` or less without any waiting.
+ * @param sink The function taking the output.
+ * @param context The data argument to be passed onto the sink.
+ * @return The exit code of the run, or `TRACE_STOPPED` if the sink stopped it.
+ */
+int nordi_trace_play(const nordi_trace_run_t*, double, nordi_trace_sink_t, void*);
+
+/**
+ * @brief Serves a run as the binary would, as a fake binary invoked once per command. Where it left off is kept
+ * next to the trace, so consecutive invocations go through the session in order.
+ * @param path The trace file.
+ * @param speed The replay speed, as `nordi_trace_play`.
+ * @param arguments The arguments the fake binary was invoked with, the first being the binary, NULL terminated.
+ * @param output Where to write the output to.
+ * @return The exit code of the run, `EXIT_FAILURE` if the trace holds none of these arguments.
+ */
+int nordi_trace_serve(const char*, double, const char**, FILE*);
+
+/**
+ * @brief Stops recording or replaying and frees the trace.
+ * @param trace The trace to free.
+ */
+void nordi_trace_free(nordi_trace_ptr);
+
+#endif /* NORDI_TRACE_H_ */
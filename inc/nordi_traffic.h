@@ -0,0 +1,113 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#ifndef NORDI_TRAFFIC_H_
+#define NORDI_TRAFFIC_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <threads.h>
+
+#define TRAFFIC_SYSFS_PATH          "/sys/class/net"
+#define TRAFFIC_DEFAULT_INTERVAL_MS 1000
+#define TRAFFIC_RING_SIZE           64 // power of two, so the indexes can wrap freely
+#define TRAFFIC_MAX_INTERFACE       16
+#define TRAFFIC_MAX_PATH            256
+
+typedef struct {
+    long long time_us;  // monotonic time of the sample
+    double rx_rate;     // received bytes per second since the previous sample
+    double tx_rate;     // sent bytes per second since the previous sample
+} nordi_traffic_sample_t;
+
+typedef void (*nordi_traffic_notify_t)(void*);
+
+typedef struct {
+    thrd_t thread;
+    int timer;
+    int stop;
+    int rx_fd; // open statistics/rx_bytes of the interface
+    int tx_fd; // open statistics/tx_bytes of the interface
+    int interval_ms;
+    bool is_paused; // the timer is disarmed
+    char interface[TRAFFIC_MAX_INTERFACE];
+    // single producer (sampler thread), single consumer ring
+    nordi_traffic_sample_t ring[TRAFFIC_RING_SIZE];
+    atomic_uint head;
+    atomic_uint tail;
+    unsigned int dropped; // samples lost to a full ring
+    // sampler state
+    uint64_t last_rx;
+    uint64_t last_tx;
+    long long last_us;
+    atomic_bool is_rebased; // the next sample only takes a new baseline
+    atomic_bool is_notified;
+    atomic_uint wakeups; // times the thread woke up, for the wakeup accounting
+    nordi_traffic_notify_t notify;
+    void* context;
+} nordi_traffic_t;
+
+typedef nordi_traffic_t* nordi_traffic_ptr;
+typedef nordi_traffic_sample_t* nordi_traffic_sample_ptr;
+
+/**
+ * @brief Starts sampling the byte counters of a network interface on a thread. The counter files are opened
+ * once and re-read with `pread` every interval, so sampling spawns nothing and allocates nothing.
+ * The notify callback runs on the sampler thread when a sample lands while no notification is pending, and is not
+ * called again until the consumer empties the ring, so a consumer scheduling a drain gets one wakeup per batch.
+ * @param base_path The directory holding the interfaces, `TRAFFIC_SYSFS_PATH` if null.
+ * @param interface The interface to sample, or null to pick the first NordVPN tunnel found (nordlynx, nordtun,
+ * tun0).
+ * @param interval_ms The time between samples, `TRAFFIC_DEFAULT_INTERVAL_MS` if <= `0`.
+ * @param notify The function called when new samples are available, can be null.
+ * @param context The data argument to be passed onto the notify callback.
+ * @return The new sampler, or NULL if no interface was found or the sampler failed to start.
+ */
+nordi_traffic_ptr nordi_traffic_new(const char*, const char*, int, nordi_traffic_notify_t, void*);
+
+/**
+ * @brief Takes the oldest sample out of the ring. Only one thread may consume.
+ * @param traffic The sampler to read from.
+ * @param sample Where to write the sample.
+ * @return true if there was a sample, false if the ring is empty, which also re-arms the notify callback.
+ */
+bool nordi_traffic_pop(nordi_traffic_ptr, nordi_traffic_sample_ptr);
+
+/**
+ * @brief Pauses or resumes sampling. While paused the timer is disarmed and the thread sleeps until resumed,
+ * and the first sample after resuming only takes a new baseline.
+ * @param traffic The sampler to pause or resume.
+ * @param is_paused true to pause, false to resume.
+ */
+void nordi_traffic_pause(nordi_traffic_ptr, bool);
+
+/**
+ * @brief Changes the time between samples, starting the new cadence from now unless paused, in which case
+ * resuming picks it up. Rates stay per second, whatever the interval.
+ * @param traffic The sampler to pace, from the thread that pauses it.
+ * @param interval_ms The time between samples, `TRAFFIC_DEFAULT_INTERVAL_MS` if <= `0`.
+ */
+void nordi_traffic_set_interval(nordi_traffic_ptr, int);
+
+/**
+ * @brief Reads the current byte counters of the sampled interface, on the calling thread.
+ * @param traffic The sampler whose interface to read.
+ * @param rx Where to write the received bytes counter.
+ * @param tx Where to write the sent bytes counter.
+ * @return true if both counters were read, false if the interface is gone.
+ */
+bool nordi_traffic_read(nordi_traffic_ptr, uint64_t*, uint64_t*);
+
+/**
+ * @brief Stops the sampler thread, closes the counter files and frees the sampler. Blocks until the thread finishes,
+ * unless the thread can't be woken, in which case the sampler is left to it and only the error is logged.
+ * @param traffic The sampler to free.
+ */
+void nordi_traffic_free(nordi_traffic_ptr);
+
+#endif /* NORDI_TRAFFIC_H_ */
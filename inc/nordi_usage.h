@@ -0,0 +1,101 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#ifndef NORDI_USAGE_H_
+#define NORDI_USAGE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#define USAGE_DEFAULT_FLUSH_S 900 // a write every 15 minutes at most
+#define USAGE_MAX_PATH        512
+#define USAGE_MAX_PENDING     4   // days with unflushed traffic, more than one only around midnight
+
+typedef struct {
+    uint32_t date; // local date as yyyymmdd
+    uint64_t rx;   // received bytes
+    uint64_t tx;   // sent bytes
+} nordi_usage_total_t;
+
+typedef struct {
+    char path[USAGE_MAX_PATH];
+    int fd; // journal opened for appending, -1 while it couldn't be reopened after a compaction
+    nordi_usage_total_t* days; // totals per day, sorted by date
+    int day_count;
+    int day_capacity;
+    nordi_usage_total_t pending[USAGE_MAX_PENDING]; // traffic not yet in the journal, per day
+    int pending_count;
+    unsigned int records; // records in the journal
+    uint64_t last_rx;
+    uint64_t last_tx;
+    bool has_counters;
+    time_t last_flush;
+    int flush_interval_s;
+    unsigned int flushes; // journal writes, compactions included
+} nordi_usage_t;
+
+typedef nordi_usage_t* nordi_usage_ptr;
+typedef nordi_usage_total_t* nordi_usage_total_ptr;
+
+/**
+ * @brief Opens the usage journal at the path, creating it if needed, and loads its totals. The journal is a
+ * series of fixed, checksummed records appended on each flush; a torn record at the end from a crash is dropped.
+ * Once it holds far more records than days, it is rewritten to a temporary file and renamed over.
+ * @param path The journal file path. Its directory must exist.
+ * @param flush_interval_s The least time between journal writes, `USAGE_DEFAULT_FLUSH_S` if < `0`.
+ * @return The usage accounting, or NULL if the journal failed to open.
+ */
+nordi_usage_ptr nordi_usage_open(const char*, int);
+
+/**
+ * @brief Accounts the traffic since the last update to the day of `now`, from the interface byte counters.
+ * The first update only takes a baseline. Counters going back mean the interface was re-created, so all of
+ * their value is new traffic. Flushes if the flush interval has passed since the last write.
+ * @param usage The usage accounting.
+ * @param rx The received bytes counter of the interface.
+ * @param tx The sent bytes counter of the interface.
+ * @param now The current time.
+ */
+void nordi_usage_update(nordi_usage_ptr, uint64_t, uint64_t, time_t);
+
+/**
+ * @brief Marks the counters as coming from a new interface, so the next update counts all of their value.
+ * @param usage The usage accounting.
+ */
+void nordi_usage_reset_counters(nordi_usage_ptr);
+
+/**
+ * @brief Appends the pending traffic to the journal in one write, compacting it if it grew too long.
+ * @param usage The usage accounting.
+ * @return true if the journal is up to date, false if writing failed.
+ */
+bool nordi_usage_flush(nordi_usage_ptr);
+
+/**
+ * @brief Gets the traffic of the day of the given time, flushed or not.
+ * @param usage The usage accounting.
+ * @param when Any time within the day.
+ * @param total Where to write the totals.
+ */
+void nordi_usage_day(nordi_usage_ptr, time_t, nordi_usage_total_ptr);
+
+/**
+ * @brief Gets the traffic of the month of the given time, flushed or not. The date of the totals is yyyymm00.
+ * @param usage The usage accounting.
+ * @param when Any time within the month.
+ * @param total Where to write the totals.
+ */
+void nordi_usage_month(nordi_usage_ptr, time_t, nordi_usage_total_ptr);
+
+/**
+ * @brief Flushes the pending traffic, closes the journal and frees the usage accounting.
+ * @param usage The usage accounting.
+ */
+void nordi_usage_close(nordi_usage_ptr);
+
+#endif /* NORDI_USAGE_H_ */
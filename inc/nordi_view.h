@@ -0,0 +1,144 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#ifndef NORDI_VIEW_H_
+#define NORDI_VIEW_H_
+
+#include <stdbool.h>
+
+#define VIEW_MAX_TEXT      96
+#define VIEW_STATUS_RING   16 // status messages kept, the oldest is overwritten
+#define VIEW_STATUS_SHOWN  5  // status messages listed in the history, newest first
+
+/**
+ * @brief The parts of the view, as a bitmask of what changed between two states.
+ */
+typedef enum {
+    VIEW_ONLINE = 1 << 0,          // disconnect and pause buttons, connect button label
+    VIEW_IP = 1 << 1,
+    VIEW_HOST = 1 << 2,
+    VIEW_CONNECT_VISIBLE = 1 << 3,
+    VIEW_LOGGED_IN = 1 << 4,       // login and logout buttons
+    VIEW_EMAIL = 1 << 5,
+    VIEW_EXPIRY = 1 << 6,
+    VIEW_STATUS = 1 << 7,          // status bar message and its history
+    VIEW_CONNECT_SENSITIVE = 1 << 8,
+    VIEW_ALL = (1 << 9) - 1
+} nordi_view_part_t;
+
+/**
+ * @brief What the widgets show, so two states can be compared without reading the widgets back.
+ */
+typedef struct {
+    bool is_online;
+    bool is_connect_visible;
+    bool is_connect_sensitive; // an entry is selected in the server list
+    bool is_logged_in;
+    char ip[VIEW_MAX_TEXT];
+    char host[VIEW_MAX_TEXT];
+    char email[VIEW_MAX_TEXT];
+    char expiry[VIEW_MAX_TEXT];
+    unsigned int status; // status messages pushed, the latest is the one shown
+} nordi_view_state_t;
+
+typedef struct {
+    nordi_view_state_t desired; // set by updates, as they come
+    nordi_view_state_t applied; // shown by the widgets
+    bool is_applied;            // the widgets were set once, before that every part differs
+    bool is_connection_known;   // the connection was set once
+    char statuses[VIEW_STATUS_RING][VIEW_MAX_TEXT];
+} nordi_view_t;
+
+typedef nordi_view_t* nordi_view_ptr;
+typedef const nordi_view_state_t* nordi_view_state_ptr;
+
+/**
+ * @brief Creates a view model in the state the widgets are created in: offline and logged out, the connect button
+ * shown and clickable, with no status.
+ * @return The view model, or NULL if it failed to allocate.
+ */
+nordi_view_ptr nordi_view_new();
+
+/**
+ * @brief Compares two states.
+ * @param previous The state shown.
+ * @param next The state to show.
+ * @return The mask of `nordi_view_part_t` that differ, `0` if none does.
+ */
+unsigned int nordi_view_diff(nordi_view_state_ptr, nordi_view_state_ptr);
+
+/**
+ * @brief Sets the connection to show.
+ * @param view The view model.
+ * @param is_online Whether the tunnel is up.
+ * @param ip The address of the server, NULL if offline.
+ * @param host The hostname of the server, NULL if offline.
+ * @return true if the tunnel went up or down since the last set, or if it is the first.
+ */
+bool nordi_view_set_connection(nordi_view_ptr, bool, const char*, const char*);
+
+/**
+ * @brief Sets the account to show.
+ * @param view The view model.
+ * @param email The email of the logged in user, NULL or "" if logged out.
+ * @param expiry The expiry of the subscription, NULL if logged out.
+ */
+void nordi_view_set_account(nordi_view_ptr, const char*, const char*);
+
+/**
+ * @brief Sets whether the connect button is shown.
+ * @param view The view model.
+ * @param is_visible Whether it is shown.
+ */
+void nordi_view_set_connect_visible(nordi_view_ptr, bool);
+
+/**
+ * @brief Sets whether the connect button can be clicked.
+ * @param view The view model.
+ * @param is_sensitive Whether it can be clicked.
+ */
+void nordi_view_set_connect_sensitive(nordi_view_ptr, bool);
+
+/**
+ * @brief Pushes a status message into the ring, overwriting the oldest once full. A message equal to the latest
+ * is dropped, so repeated updates don't wash out the history.
+ * @param view The view model.
+ * @param text The message, truncated to `VIEW_MAX_TEXT`.
+ */
+void nordi_view_push_status(nordi_view_ptr, const char*);
+
+/**
+ * @brief The latest status message.
+ * @param view The view model.
+ * @return The message, "" if none was pushed.
+ */
+const char* nordi_view_status(nordi_view_ptr);
+
+/**
+ * @brief Writes the latest status messages, newest first, a line each.
+ * @param view The view model.
+ * @param text Where to write the history to.
+ * @param size The size of the text buffer.
+ * @param count The number of messages, up to `VIEW_STATUS_RING`.
+ * @return The number of messages written.
+ */
+int nordi_view_status_history(nordi_view_ptr, char*, int, int);
+
+/**
+ * @brief Takes the desired state as the applied one.
+ * @param view The view model.
+ * @return The mask of `nordi_view_part_t` the widgets must be set for, `VIEW_ALL` on the first commit.
+ */
+unsigned int nordi_view_commit(nordi_view_ptr);
+
+/**
+ * @brief Frees the view model.
+ * @param view The view model to free.
+ */
+void nordi_view_free(nordi_view_ptr);
+
+#endif /* NORDI_VIEW_H_ */
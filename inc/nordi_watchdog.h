@@ -0,0 +1,101 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#ifndef NORDI_WATCHDOG_H_
+#define NORDI_WATCHDOG_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <threads.h>
+
+#define WATCHDOG_DEFAULT_THRESHOLD_MS 100
+#define WATCHDOG_BUCKETS              8  // stall durations by powers of two of the threshold, the last open ended
+#define WATCHDOG_MAX_OFFENDERS        32
+#define WATCHDOG_MAX_NAME             48
+#define WATCHDOG_UNKNOWN              "(unknown)" // stalls no instrumented handler explains
+#define WATCHDOG_BLAME_SHARE          2           // a handler is blamed if it ran at least 1/share of the threshold
+
+typedef void (*nordi_watchdog_post_t)(void*);
+
+typedef struct {
+    char name[WATCHDOG_MAX_NAME];
+    unsigned int stalls;
+    unsigned long long total_ms;
+    unsigned int max_ms;
+} nordi_watchdog_offender_t;
+
+typedef struct {
+    thrd_t thread;
+    mtx_t mutex;
+    cnd_t wakeup;
+    bool is_running;
+    int threshold_ms;
+    nordi_watchdog_post_t post;
+    void* context;
+    atomic_llong posted_ms; // monotonic time the outstanding heartbeat was posted at, 0 if none is
+    // main thread only
+    const char* handler;    // outermost handler running, NULL if none is
+    long long handler_ms;   // when it started
+    int depth;
+    const char* longest;    // handler that ran the longest since the heartbeat was posted
+    long long longest_ms;
+    unsigned int beats;
+    unsigned int stalls;
+    unsigned int max_ms;
+    unsigned int histogram[WATCHDOG_BUCKETS];
+    nordi_watchdog_offender_t offenders[WATCHDOG_MAX_OFFENDERS];
+    int offender_count;
+} nordi_watchdog_t;
+
+typedef nordi_watchdog_t* nordi_watchdog_ptr;
+
+/**
+ * @brief Starts a watchdog thread heartbeating a main loop. Every half threshold without a heartbeat outstanding,
+ * it calls the post function, which must get `nordi_watchdog_beat` called on the main loop. A heartbeat arriving
+ * a threshold or more after it was posted is a stall, blamed on the handler that ran the longest meanwhile if it ran
+ * for a real share of the threshold, or on `WATCHDOG_UNKNOWN` otherwise.
+ * @param threshold_ms The least heartbeat latency counted as a stall, `WATCHDOG_DEFAULT_THRESHOLD_MS` if <= `0`.
+ * @param post The function posting a heartbeat, called on the watchdog thread.
+ * @param context The data argument to be passed onto the post function.
+ * @return The watchdog, or NULL if it failed to start.
+ */
+nordi_watchdog_ptr nordi_watchdog_new(int, nordi_watchdog_post_t, void*);
+
+/**
+ * @brief Marks a handler as running, on the main loop. Nested handlers are part of the outermost one.
+ * @param watchdog The watchdog, NULL does nothing.
+ * @param name The handler name, such as `__func__`, kept by reference.
+ */
+void nordi_watchdog_enter(nordi_watchdog_ptr, const char*);
+
+/**
+ * @brief Marks the handler entered last as done, on the main loop.
+ * @param watchdog The watchdog, NULL does nothing.
+ */
+void nordi_watchdog_leave(nordi_watchdog_ptr);
+
+/**
+ * @brief Takes the outstanding heartbeat, on the main loop, recording a stall if it came late.
+ * @param watchdog The watchdog.
+ */
+void nordi_watchdog_beat(nordi_watchdog_ptr);
+
+/**
+ * @brief Writes the stall histogram and the offenders, the most stalled time first.
+ * @param watchdog The watchdog.
+ * @param file Where to write the report to.
+ */
+void nordi_watchdog_write(nordi_watchdog_ptr, FILE*);
+
+/**
+ * @brief Stops the watchdog thread and frees the watchdog. Blocks until the thread finishes.
+ * @param watchdog The watchdog to free.
+ */
+void nordi_watchdog_free(nordi_watchdog_ptr);
+
+#endif /* NORDI_WATCHDOG_H_ */
@@ -8,7 +8,9 @@
 #ifndef NORDVPN_API_H_
 #define NORDVPN_API_H_
 
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stdio.h>
 #include "nordvpn_server.h"
 #include "str.h"
 
@@ -17,6 +19,16 @@
  */
 #define NORDVPN "/usr/bin/nordvpn"
 
+/**
+ * @brief Environment variable overriding the nordvpn binary location, such as a fake one replaying a trace.
+ */
+#define NORDVPN_BINARY_ENV "NORDI_NORDVPN"
+
+/**
+ * @brief Environment variable with a trace file to record every nordvpn run of the session into.
+ */
+#define NORDVPN_RECORD_ENV "NORDI_RECORD"
+
 /**
  * @brief The error codes of the API.
  */
@@ -29,16 +41,38 @@ typedef enum {
     FAILED_PIPE,    // failed creating the pipe for the binary
     FAILED_FORK,    // failed forking process
     FAILED_EXECUTE, // binary execution failed
-    FAILED_READ     // failed reading the binary output
+    FAILED_READ,    // failed reading the binary output
+    CANCELLED       // command was cancelled with nordvpn_cancel
 } nordvpn_error_t;
 
+/**
+ * @brief The user actions of the API, used to account the binary spawns each one costs.
+ */
+typedef enum {
+    ACTION_OPEN = 0,   // nordvpn_open
+    ACTION_REFRESH,    // nordvpn_refresh
+    ACTION_LOGIN,      // nordvpn_login
+    ACTION_LOGOUT,     // nordvpn_logout
+    ACTION_CONNECT,    // nordvpn_connect, nordvpn_server_connect and nordvpn_reconnect
+    ACTION_DISCONNECT, // nordvpn_disconnect
+    ACTION_SYNC,       // nordvpn_sync_host
+    ACTION_SETTINGS,   // nordvpn_read_settings
+    ACTION_APPLY,      // nordvpn_apply_settings
+    ACTION_ALLOWLIST,  // nordvpn_change_allowlist
+    ACTION_COUNT
+} nordvpn_action_t;
+
 typedef struct {
     bool is_online;
+    bool is_partial; // fields only reported by status (ip, proto) are not filled yet
     nordvpn_country_t country;
+    nordvpn_technology_t technology;
     str ip;
     str hostname;
     str last_server;
+    str tried_server; // server the last connect went for as it announced it, kept when it failed, str_null if unknown
     str proto;
+    unsigned int connect_ms; // time the last successful connect or switch took until the tunnel was up
 } nordvpn_host_t;
 
 typedef struct {
@@ -47,10 +81,43 @@ typedef struct {
     bool is_active;
     str user;
     str expiry;
+    atomic_bool is_cancelled; // commands fail with CANCELLED until cleared
+    atomic_int child;         // pid of the running nordvpn process, 0 if none
 } nordvpn_session_t;
 
+typedef struct {
+    bool is_known; // filled by a successful read
+    nordvpn_technology_t technology;
+    str protocol;   // "UDP" or "TCP", only reported with OpenVPN
+    bool obfuscate; // only reported with OpenVPN
+    bool firewall;
+    bool routing;
+    bool killswitch;
+    bool threat_protection;
+    bool notify;
+    bool autoconnect;
+    bool ipv6;
+    bool meshnet;
+    bool lan_discovery;
+    str dns;       // custom DNS servers as reported, "1.1.1.1, 8.8.8.8", str_null if disabled
+    str allowlist; // allowlisted ports and subnets as reported, one per line ("22 (UDP|TCP)"), not changed by apply
+} nordvpn_settings_t;
+
+// Counted on the thread running the API calls, read from any other
+typedef struct {
+    atomic_uint calls[ACTION_COUNT];  // times each action was requested
+    atomic_uint spawns[ACTION_COUNT]; // binary executions caused by each action
+} nordvpn_stats_t;
+
 typedef nordvpn_session_t* nordvpn_session_ptr;
 typedef nordvpn_host_t* nordvpn_host_ptr;
+typedef nordvpn_stats_t* nordvpn_stats_ptr;
+typedef nordvpn_settings_t* nordvpn_settings_ptr;
+
+/**
+ * @brief The string value of all actions in `nordvpn_action_t`.
+ */
+extern const str NORDVPN_ACTION_STR[];
 
 /**
  * @brief Getter for the singleton NordVPN session data object.
@@ -63,7 +130,35 @@ nordvpn_session_ptr nordvpn_get_session();
 nordvpn_host_ptr nordvpn_get_host();
 
 /**
- * @brief Starts the session and synchronizes state with NordVPN binary.
+ * @brief Getter for the singleton NordVPN settings data object, filled by `nordvpn_read_settings`.
+ */
+nordvpn_settings_ptr nordvpn_get_settings();
+
+/**
+ * @brief Getter for the singleton counters of binary spawns per user action.
+ */
+nordvpn_stats_ptr nordvpn_get_stats();
+
+/**
+ * @brief Writes the calls and binary spawns of every action requested so far.
+ * @param file Where to write the counters to.
+ */
+void nordvpn_write_stats(FILE*);
+
+/**
+ * @brief Locks the session and host data, so it can be read while other threads run API calls.
+ * Must be paired with `nordvpn_unlock_state`. Can be locked recursively by the same thread.
+ */
+void nordvpn_lock_state();
+
+/**
+ * @brief Unlocks the session and host data, locked with `nordvpn_lock_state`.
+ */
+void nordvpn_unlock_state();
+
+/**
+ * @brief Starts the session and synchronizes state with NordVPN binary. Runs the binary at `NORDVPN_BINARY_ENV` if
+ * set, and records every run into the trace at `NORDVPN_RECORD_ENV` if set, until the session is closed.
  * @return 0 if no error occurred, otherwise, the error code.
  */
 nordvpn_error_t nordvpn_open();
@@ -74,6 +169,13 @@ nordvpn_error_t nordvpn_open();
  */
 str nordvpn_error(nordvpn_error_t);
 
+/**
+ * @brief Cancels the running nordvpn command, if any, by terminating its process. Following commands also fail
+ * with `CANCELLED` until the session's `is_cancelled` flag is cleared. Safe to call from any thread. Only the
+ * command line process is stopped, the daemon may still carry out a change it was asked for.
+ */
+void nordvpn_cancel();
+
 /**
  * @brief Closes session and frees objects used with the NordVPN state.
  */
@@ -84,6 +186,20 @@ void nordvpn_close();
  */
 void nordvpn_refresh();
 
+/**
+ * @brief Fills in the host fields that connecting doesn't report (ip and protocol), by reading the status.
+ * Does nothing if the host data is already complete.
+ * @return 0 if no error occurs, the error code otherwise.
+ */
+nordvpn_error_t nordvpn_sync_host();
+
+/**
+ * @brief Reads the whole status into the host, complete or not, such as after a cancelled command the daemon may
+ * still have carried out.
+ * @return 0 if no error occurs, the error code otherwise.
+ */
+nordvpn_error_t nordvpn_read_status();
+
 /**
  * @brief Requests a link to log in to NordVPN.
  * @param out_link The str object to be filled with the login HTTP link for NordVPN. 
@@ -104,7 +220,10 @@ nordvpn_error_t nordvpn_logout();
 nordvpn_error_t nordvpn_connect();
 
 /**
- * @brief Attempts to connect to the NordVPN's specified server or specialty server.
+ * @brief Attempts to connect to the NordVPN's specified server or specialty server. If already connected, the
+ * daemon switches to the new server directly, without disconnecting first.
+ * The host is updated from the command output, leaving it partial (see `nordvpn_sync_host`). The status is
+ * only read when the output can't be understood.
  * @param server The server name to connect to.
  * @return 0 if no error occurs, the error code otherwise.
  */
@@ -122,4 +241,43 @@ nordvpn_error_t nordvpn_reconnect();
  */
 nordvpn_error_t nordvpn_disconnect();
 
+/**
+ * @brief Reads every setting from a single `nordvpn settings` call.
+ * @return 0 if no error occurs, the error code otherwise.
+ */
+nordvpn_error_t nordvpn_read_settings();
+
+/**
+ * @brief Brings the settings to the desired ones, only running `nordvpn set` for those that differ from the
+ * current settings, then reading them back once. The technology is set first, as the protocol and obfuscation
+ * depend on it, then the settings being disabled before the ones being enabled, so exclusive settings (such as
+ * threat protection and custom DNS) don't refuse each other. A failed setting doesn't stop the independent ones.
+ * The current settings are read first if they aren't known yet, and compared as a copy taken under the state lock.
+ * @param desired The settings to apply. An empty protocol keeps the current one.
+ * @return 0 if every setting was applied, the error code of the first failure otherwise.
+ */
+nordvpn_error_t nordvpn_apply_settings(const nordvpn_settings_t*);
+
+/**
+ * @brief Runs a list of allowlist changes, then reads the settings back once. A failed change doesn't stop the
+ * following ones, as each stands on its own.
+ * @param changes The changes, one per line, as the arguments of `nordvpn allowlist`: "add subnet 10.0.0.0/8",
+ * "remove ports 3000 3100 protocol TCP".
+ * @return 0 if every change was applied, the error code of the first failure otherwise.
+ */
+nordvpn_error_t nordvpn_change_allowlist(str);
+
+/**
+ * @brief Copies settings, such as the current ones to edit into desired ones.
+ * @param target The settings to overwrite, its strings are freed.
+ * @param source The settings to copy.
+ */
+void nordvpn_copy_settings(nordvpn_settings_t*, const nordvpn_settings_t*);
+
+/**
+ * @brief Frees the strings of settings filled by `nordvpn_copy_settings`, leaving them unknown.
+ * @param settings The settings to clear.
+ */
+void nordvpn_clear_settings(nordvpn_settings_t*);
+
 #endif /* NORDVPN_API_H_ */
@@ -89,6 +89,16 @@ typedef enum {
     THE_AMERICAS
 } nordvpn_group_t;
 
+/**
+ * @brief Enum representing the VPN technologies NordVPN connects with.
+ */
+typedef enum {
+    TECHNOLOGY_UNKNOWN = 0,
+    TECHNOLOGY_NORDLYNX,
+    TECHNOLOGY_OPENVPN,
+    TECHNOLOGY_NORDWHISPER
+} nordvpn_technology_t;
+
 /**
  * @brief The number of country options.
  */
@@ -109,10 +119,27 @@ extern const str NORDVPN_COUNTRY_STR[];
  */
 extern const str NORDVPN_GROUP_STR[];
 
+/**
+ * @brief The string value of all technologies in `nordvpn_technology_t`, as written by the nordvpn binary.
+ */
+extern const str NORDVPN_TECHNOLOGY_STR[];
+
 /**
  * @brief Converts the given index into a str object with the corresponding server name, if the index is inside the server count.
  * @return The server name if index matches any COUNTRY or GROUP index, otherwise an empty str.
  */
 str nordvpn_node_from_index(int);
 
+/**
+ * @brief Finds the country matching the given name, as written by the nordvpn binary ("United States" or "United_States").
+ * @return The `nordvpn_country_t` index of the country, or `-1` if there is no match.
+ */
+int nordvpn_country_from_name(str);
+
+/**
+ * @brief Finds the technology matching the given name, as written by the nordvpn binary ("NORDLYNX").
+ * @return The `nordvpn_technology_t` of the name, `TECHNOLOGY_UNKNOWN` if there is no match.
+ */
+nordvpn_technology_t nordvpn_technology_from_name(str);
+
 #endif /* NORDVPN_NODES_H_ */
\ No newline at end of file
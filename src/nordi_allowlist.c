@@ -0,0 +1,417 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "nordi_allowlist.h"
+
+#define MIN_CAPACITY 64
+#define PORT_WORDS   (ALLOWLIST_PORT_COUNT / ALLOWLIST_WORD_BITS)
+
+static const char* PROTOCOL_NAMES[ALLOWLIST_PROTOCOL_COUNT] = {"TCP", "UDP"};
+
+static uint32_t
+prefix_mask(int prefix) {
+    return prefix == 0 ? 0 : 0xffffffffu << (32 - prefix);
+}
+
+// Whether only blanks or a comment are left on the line
+static bool
+is_line_end(const char* text) {
+    text += strspn(text, " \t\r\n");
+    return *text == 0 || *text == '#';
+}
+
+static bool
+parse_number(const char** text, unsigned long max, unsigned long* value) {
+    if (!isdigit((unsigned char)**text)) {
+        return false;
+    }
+    char* end = NULL;
+    *value = strtoul(*text, &end, 10);
+    *text = end;
+    return *value <= max;
+}
+
+static bool
+parse_subnet(const char* text, nordi_allowlist_subnet_t* subnet) {
+    uint32_t address = 0;
+    unsigned long value = 0, prefix = 32;
+    for (int octet = 0; octet < 4; octet++) {
+        if ((octet > 0 && *text++ != '.') || !parse_number(&text, 255, &value)) {
+            return false;
+        }
+        address = address << 8 | (uint32_t)value;
+    }
+    if (*text == '/') {
+        text++;
+        if (!parse_number(&text, 32, &prefix)) {
+            return false;
+        }
+    }
+    if (!is_line_end(text)) {
+        return false;
+    }
+    subnet->prefix = (uint8_t)prefix;
+    subnet->address = address & prefix_mask(prefix);
+    return true;
+}
+
+// Parse "first[-last] [protocols]", where the protocols are any spelling of "tcp" and "udp" between separators
+static bool
+parse_ports(const char* text, int* first, int* last, int* protocols) {
+    unsigned long value = 0;
+    if (!parse_number(&text, ALLOWLIST_PORT_COUNT - 1, &value) || value == 0) {
+        return false;
+    }
+    *first = *last = (int)value;
+    text += strspn(text, " \t");
+    if (*text == '-') {
+        text++;
+        text += strspn(text, " \t");
+        if (!parse_number(&text, ALLOWLIST_PORT_COUNT - 1, &value) || (int)value < *first) {
+            return false;
+        }
+        *last = (int)value;
+    }
+    *protocols = 0;
+    while (!is_line_end(text)) {
+        text += strspn(text, " \t()|/,");
+        if (strncasecmp(text, "tcp", 3) == 0) {
+            *protocols |= ALLOWLIST_TCP;
+        } else if (strncasecmp(text, "udp", 3) == 0) {
+            *protocols |= ALLOWLIST_UDP;
+        } else if (!is_line_end(text)) {
+            return false;
+        } else {
+            break;
+        }
+        text += 3;
+    }
+    if (*protocols == 0) {
+        *protocols = ALLOWLIST_TCP | ALLOWLIST_UDP;
+    }
+    return true;
+}
+
+static void
+set_ports(uint64_t* bitmap, int first, int last) {
+    for (int port = first; port <= last;) {
+        if (port % ALLOWLIST_WORD_BITS == 0 && port + ALLOWLIST_WORD_BITS - 1 <= last) {
+            bitmap[port / ALLOWLIST_WORD_BITS] = ~0ull;
+            port += ALLOWLIST_WORD_BITS;
+        } else {
+            bitmap[port / ALLOWLIST_WORD_BITS] |= 1ull << (port % ALLOWLIST_WORD_BITS);
+            port++;
+        }
+    }
+}
+
+static bool
+has_port(const uint64_t* bitmap, int port) {
+    return (bitmap[port / ALLOWLIST_WORD_BITS] >> (port % ALLOWLIST_WORD_BITS)) & 1;
+}
+
+static bool
+push_subnet(nordi_allowlist_ptr allowlist, nordi_allowlist_subnet_t subnet) {
+    if (allowlist->count == allowlist->capacity) {
+        // aggregate first, the table only grows if that didn't free at least half of it
+        nordi_allowlist_aggregate(allowlist);
+        if (allowlist->capacity == 0 || allowlist->count > allowlist->capacity / 2) {
+            int capacity = allowlist->capacity > 0 ? allowlist->capacity * 2 : MIN_CAPACITY;
+            nordi_allowlist_subnet_t* subnets =
+                (nordi_allowlist_subnet_t*)realloc(allowlist->subnets, capacity * sizeof(nordi_allowlist_subnet_t));
+            if (subnets == NULL) {
+                return false;
+            }
+            allowlist->subnets = subnets;
+            allowlist->capacity = capacity;
+        }
+    }
+    allowlist->subnets[allowlist->count++] = subnet;
+    return true;
+}
+
+nordi_allowlist_ptr
+nordi_allowlist_new() {
+    return (nordi_allowlist_ptr)calloc(1, sizeof(nordi_allowlist_t));
+}
+
+bool
+nordi_allowlist_add(nordi_allowlist_ptr allowlist, const char* line) {
+    allowlist->lines++;
+    line += strspn(line, " \t");
+    if (is_line_end(line)) {
+        return true;
+    }
+    nordi_allowlist_subnet_t subnet = {};
+    if (parse_subnet(line, &subnet)) {
+        return push_subnet(allowlist, subnet);
+    }
+    int first = 0, last = 0, protocols = 0;
+    if (parse_ports(line, &first, &last, &protocols)) {
+        for (int protocol = 0; protocol < ALLOWLIST_PROTOCOL_COUNT; protocol++) {
+            if (protocols & (1 << protocol)) {
+                set_ports(allowlist->ports[protocol], first, last);
+            }
+        }
+        return true;
+    }
+    allowlist->rejected++;
+    return false;
+}
+
+int
+nordi_allowlist_read(nordi_allowlist_ptr allowlist, FILE* file) {
+    char* line = NULL;
+    size_t size = 0;
+    int lines = 0;
+    unsigned int rejected = allowlist->rejected;
+    while (getline(&line, &size, file) >= 0) {
+        lines++;
+        if (!nordi_allowlist_add(allowlist, line) && allowlist->rejected == rejected) {
+            // not rejected, so the table failed to grow
+            free(line);
+            return -1;
+        }
+        rejected = allowlist->rejected;
+    }
+    free(line);
+    return lines;
+}
+
+bool
+nordi_allowlist_merge(nordi_allowlist_ptr allowlist, nordi_allowlist_ptr source) {
+    for (int protocol = 0; protocol < ALLOWLIST_PROTOCOL_COUNT; protocol++) {
+        for (int word = 0; word < PORT_WORDS; word++) {
+            allowlist->ports[protocol][word] |= source->ports[protocol][word];
+        }
+    }
+    for (int index = 0; index < source->count; index++) {
+        if (!push_subnet(allowlist, source->subnets[index])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int
+compare_subnets(const void* left, const void* right) {
+    const nordi_allowlist_subnet_t* a = (const nordi_allowlist_subnet_t*)left;
+    const nordi_allowlist_subnet_t* b = (const nordi_allowlist_subnet_t*)right;
+    if (a->address != b->address) {
+        return a->address < b->address ? -1 : 1;
+    }
+    return (int)a->prefix - (int)b->prefix;
+}
+
+static void
+sort_subnets(nordi_allowlist_ptr allowlist) {
+    if (allowlist->count > 1) {
+        qsort(allowlist->subnets, allowlist->count, sizeof(nordi_allowlist_subnet_t), compare_subnets);
+    }
+}
+
+// Write the range [first, last] as the largest aligned subnets from the given index, returns the index after them.
+// Never writes more subnets than it took to cover the range, so it can overwrite them in place.
+static int
+write_range(nordi_allowlist_subnet_t* subnets, int index, uint64_t first, uint64_t last) {
+    while (first <= last) {
+        uint64_t size = first == 0 ? (1ull << 32) : first & -first;
+        while (size > last - first + 1) {
+            size >>= 1;
+        }
+        subnets[index++] = (nordi_allowlist_subnet_t){.address = (uint32_t)first, .prefix = 32 - __builtin_ctzll(size)};
+        first += size;
+    }
+    return index;
+}
+
+void
+nordi_allowlist_aggregate(nordi_allowlist_ptr allowlist) {
+    if (allowlist->count == 0) {
+        return;
+    }
+    sort_subnets(allowlist);
+    nordi_allowlist_subnet_t* subnets = allowlist->subnets;
+    int written = 0;
+    uint64_t first = subnets[0].address, last = first + (1ull << (32 - subnets[0].prefix)) - 1;
+    for (int index = 1; index < allowlist->count; index++) {
+        uint64_t start = subnets[index].address, end = start + (1ull << (32 - subnets[index].prefix)) - 1;
+        if (start <= last + 1) {
+            last = end > last ? end : last;
+            continue;
+        }
+        written = write_range(subnets, written, first, last);
+        first = start;
+        last = end;
+    }
+    allowlist->count = write_range(subnets, written, first, last);
+}
+
+static void
+print_subnet(FILE* stream, const char* change, nordi_allowlist_subnet_t subnet) {
+    uint32_t address = subnet.address;
+    fprintf(stream, "%s subnet %u.%u.%u.%u/%u\n", change, address >> 24, (address >> 16) & 0xff, (address >> 8) & 0xff,
+            address & 0xff, subnet.prefix);
+}
+
+// Print the ports set in either bitmap as the fewest ranges with the same protocols, returns the number printed
+static int
+print_ports(FILE* stream, const char* change, const uint64_t* tcp, const uint64_t* udp) {
+    int printed = 0;
+    for (int port = 1; port < ALLOWLIST_PORT_COUNT;) {
+        int word = port / ALLOWLIST_WORD_BITS;
+        if (port % ALLOWLIST_WORD_BITS == 0 && (tcp[word] | udp[word]) == 0) {
+            port += ALLOWLIST_WORD_BITS;
+            continue;
+        }
+        int protocols = has_port(tcp, port) * ALLOWLIST_TCP | has_port(udp, port) * ALLOWLIST_UDP;
+        if (protocols == 0) {
+            port++;
+            continue;
+        }
+        int last = port;
+        while (last + 1 < ALLOWLIST_PORT_COUNT
+               && (has_port(tcp, last + 1) * ALLOWLIST_TCP | has_port(udp, last + 1) * ALLOWLIST_UDP) == protocols) {
+            last++;
+        }
+        if (last == port) {
+            fprintf(stream, "%s port %d", change, port);
+        } else {
+            fprintf(stream, "%s ports %d %d", change, port, last);
+        }
+        if (protocols != (ALLOWLIST_TCP | ALLOWLIST_UDP)) {
+            fprintf(stream, " protocol %s", PROTOCOL_NAMES[protocols == ALLOWLIST_TCP ? 0 : 1]);
+        }
+        fputc('\n', stream);
+        printed++;
+        port = last + 1;
+    }
+    return printed;
+}
+
+// Print the subnets of one sorted table missing from the other, returns the number printed
+static int
+print_missing(FILE* stream, const char* change, nordi_allowlist_ptr from, nordi_allowlist_ptr other) {
+    int printed = 0;
+    for (int index = 0, other_index = 0; index < from->count; index++) {
+        if (index > 0 && compare_subnets(&from->subnets[index], &from->subnets[index - 1]) == 0) {
+            continue;
+        }
+        while (other_index < other->count && compare_subnets(&other->subnets[other_index], &from->subnets[index]) < 0) {
+            other_index++;
+        }
+        if (other_index < other->count && compare_subnets(&other->subnets[other_index], &from->subnets[index]) == 0) {
+            continue;
+        }
+        print_subnet(stream, change, from->subnets[index]);
+        printed++;
+    }
+    return printed;
+}
+
+int
+nordi_allowlist_diff(nordi_allowlist_ptr desired, nordi_allowlist_ptr current, str* changes) {
+    char* text = NULL;
+    size_t length = 0;
+    FILE* stream = open_memstream(&text, &length);
+    if (stream == NULL) {
+        return -1;
+    }
+    sort_subnets(desired);
+    sort_subnets(current);
+    uint64_t added[ALLOWLIST_PROTOCOL_COUNT][PORT_WORDS];
+    uint64_t removed[ALLOWLIST_PROTOCOL_COUNT][PORT_WORDS];
+    for (int protocol = 0; protocol < ALLOWLIST_PROTOCOL_COUNT; protocol++) {
+        for (int word = 0; word < PORT_WORDS; word++) {
+            added[protocol][word] = desired->ports[protocol][word] & ~current->ports[protocol][word];
+            removed[protocol][word] = current->ports[protocol][word] & ~desired->ports[protocol][word];
+        }
+    }
+    int count = print_missing(stream, "add", desired, current);
+    count += print_ports(stream, "add", added[0], added[1]);
+    count += print_missing(stream, "remove", current, desired);
+    count += print_ports(stream, "remove", removed[0], removed[1]);
+    if (fclose(stream) != 0) {
+        free(text);
+        return -1;
+    }
+    str_assign(changes, str_acquire_chars(text, length));
+    return count;
+}
+
+// Add the entries listed by the settings, one per line
+static bool
+add_entries(nordi_allowlist_ptr allowlist, str entries) {
+    if (str_is_empty(entries)) {
+        return true;
+    }
+    FILE* stream = fmemopen((void*)str_ptr(entries), str_len(entries), "r");
+    if (stream == NULL) {
+        return false;
+    }
+    int lines = nordi_allowlist_read(allowlist, stream);
+    fclose(stream);
+    return lines >= 0;
+}
+
+nordvpn_error_t
+nordi_allowlist_import(str paths) {
+    nordi_allowlist_ptr current = nordi_allowlist_new();
+    nordi_allowlist_ptr desired = nordi_allowlist_new();
+    nordvpn_error_t result = current != NULL && desired != NULL ? OK : UNKNOWN_ERROR;
+    for (const char* start = str_ptr(paths); result == OK && *start != 0;) {
+        size_t length = strcspn(start, "\n");
+        char* path = strndup(start, length);
+        start += start[length] == '\n' ? length + 1 : length;
+        FILE* file = path != NULL ? fopen(path, "r") : NULL;
+        if (file == NULL || nordi_allowlist_read(desired, file) < 0) {
+            result = FAILED_READ;
+        }
+        if (file != NULL) {
+            fclose(file);
+        }
+        free(path);
+    }
+    if (result == OK && !nordvpn_get_settings()->is_known) {
+        result = nordvpn_read_settings();
+    }
+    if (result == OK) {
+        str entries = str_null;
+        nordvpn_lock_state();
+        str_cpy(&entries, nordvpn_get_settings()->allowlist);
+        nordvpn_unlock_state();
+        if (!add_entries(current, entries) || !nordi_allowlist_merge(desired, current)) {
+            result = UNKNOWN_ERROR;
+        }
+        str_free(entries);
+    }
+    str changes = str_null;
+    if (result == OK) {
+        nordi_allowlist_aggregate(desired);
+        int count = nordi_allowlist_diff(desired, current, &changes);
+        result = count < 0 ? UNKNOWN_ERROR : count > 0 ? nordvpn_change_allowlist(changes) : OK;
+    }
+    str_free(changes);
+    nordi_allowlist_free(current);
+    nordi_allowlist_free(desired);
+    return result;
+}
+
+void
+nordi_allowlist_free(nordi_allowlist_ptr allowlist) {
+    if (allowlist == NULL) {
+        return;
+    }
+    free(allowlist->subnets);
+    free(allowlist);
+}
@@ -5,12 +5,41 @@
  * https://opensource.org/licenses/MIT
  */
 
+#include <glib-unix.h>
 #include <gtk/gtk.h>
+#include <signal.h>
 #include <stdlib.h>
 #include "nordi_app.h"
+#include "nordi_bench.h"
+#include "nordi_dns.h"
 #include "nordi_gui.h"
+#include "nordi_speedtest.h"
+#include "nordi_trace.h"
 #include "nordvpn_api.h"
 
+#define MEGABIT      1000000.0
+#define NORDVPN_NAME "nordvpn" // run under this name, nordi is a fake nordvpn binary replaying a trace
+
+// Command line options, the headless ones run without the window and exit
+static const GOptionEntry OPTIONS[] = {
+    {"speedtest", 0, 0, G_OPTION_ARG_STRING, NULL, "Measure the throughput to a speed test sink, then exit",
+     "HOST[:PORT]"},
+    {"streams", 0, 0, G_OPTION_ARG_INT, NULL, "Parallel streams of the speed test", "COUNT"},
+    {"duration", 0, 0, G_OPTION_ARG_INT, NULL, "Seconds the speed test sends for", "SECONDS"},
+    {"speedtest-sink", 0, 0, G_OPTION_ARG_INT, NULL, "Serve as a speed test sink until interrupted", "PORT"},
+    {"bind", 0, 0, G_OPTION_ARG_STRING, NULL, "Address the speed test sink listens on, the loopback if none",
+     "ADDRESS"},
+    {"bench-connect", 0, 0, G_OPTION_ARG_NONE, NULL,
+     "Benchmark connecting over every technology and protocol, then exit", NULL},
+    {"cycles", 0, 0, G_OPTION_ARG_INT, NULL, "Connect and disconnect cycles per technology and server", "COUNT"},
+    {"servers", 0, 0, G_OPTION_ARG_STRING, NULL, "Servers to benchmark, quick connect if none", "SERVER,..."},
+    {"bench-output", 0, 0, G_OPTION_ARG_STRING, NULL, "File to write the benchmark summary to", "PATH"},
+    {"dns-bench", 0, 0, G_OPTION_ARG_STRING, NULL, "Benchmark DNS resolvers against each other, then exit",
+     "RESOLVER[:PORT],..."},
+    {"apply", 0, 0, G_OPTION_ARG_NONE, NULL, "Set the fastest benchmarked resolver as the custom DNS", NULL},
+    {NULL},
+};
+
 struct _nordi_app_t {
     GtkApplication parent;
 };
@@ -18,7 +47,11 @@ struct _nordi_app_t {
 G_DEFINE_TYPE(nordi_app_t, nordi_app, GTK_TYPE_APPLICATION);
 
 static void
-nordi_app_init(nordi_app_ptr app) {}
+nordi_app_init(nordi_app_ptr app) {
+    g_application_add_main_option_entries(G_APPLICATION(app), OPTIONS);
+    // screensaver-active is only tracked for a registered session
+    g_object_set(app, "register-session", TRUE, NULL);
+}
 
 static void
 nordi_app_activate(GApplication* app) {
@@ -42,6 +75,190 @@ nordi_app_open(GApplication* app, GFile** files, gint n_files, const gchar* hint
     gtk_window_present(GTK_WINDOW(window));
 }
 
+// Run a speed test without the window, printing the result
+static int
+nordi_app_speedtest(GVariantDict* options, const char* target) {
+    nordi_speedtest_options_t test = SPEEDTEST_DEFAULT_OPTIONS;
+    int seconds;
+    g_variant_dict_lookup(options, "streams", "i", &test.streams);
+    if (g_variant_dict_lookup(options, "duration", "i", &seconds)) {
+        test.duration_ms = seconds * 1000;
+    }
+    nordi_speedtest_result_t result;
+    bool is_complete = nordi_speedtest_run(str_ref(target), &test, &result, NULL);
+    if (result.streams == 0) {
+        g_printerr("Couldn't reach the speed test sink at %s\n", target);
+        return EXIT_FAILURE;
+    }
+    g_print("%d streams to %s, %s\n", result.streams, target, result.is_zero_copy ? "sendfile" : "copied");
+    g_print("goodput  %.2f Mbit/s\n", result.goodput_bps / MEGABIT);
+    g_print("ramp-up  %u ms\n", result.ramp_up_ms);
+    g_print("fairness %.3f\n", result.fairness);
+    for (int stream = 0; stream < result.streams; stream++) {
+        double share = result.bytes > 0 ? (double)result.stream_bytes[stream] / result.bytes : 0;
+        g_print("stream %2d %.2f Mbit/s\n", stream + 1, result.goodput_bps * share / MEGABIT);
+    }
+    return is_complete ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static gboolean
+nordi_app_quit_loop(GMainLoop* loop) {
+    g_main_loop_quit(loop);
+    return G_SOURCE_REMOVE;
+}
+
+// Serve as a speed test sink without the window, until interrupted
+static int
+nordi_app_speedtest_sink(GVariantDict* options, int port) {
+    const char* address = NULL;
+    g_variant_dict_lookup(options, "bind", "&s", &address);
+    nordi_speedtest_sink_ptr sink = nordi_speedtest_sink_new(address, port);
+    if (sink == NULL) {
+        g_printerr("Couldn't listen for speed tests on %s port %d\n", address != NULL ? address : "loopback", port);
+        return EXIT_FAILURE;
+    }
+    g_print("Speed test sink listening on %s port %d\n", address != NULL ? address : "loopback", sink->port);
+    GMainLoop* loop = g_main_loop_new(NULL, FALSE);
+    g_unix_signal_add(SIGINT, G_SOURCE_FUNC(nordi_app_quit_loop), loop);
+    g_unix_signal_add(SIGTERM, G_SOURCE_FUNC(nordi_app_quit_loop), loop);
+    g_main_loop_run(loop);
+    g_main_loop_unref(loop);
+    g_print("%u streams, %llu bytes received\n", atomic_load(&sink->connections), atomic_load(&sink->bytes));
+    nordi_speedtest_sink_free(sink);
+    return EXIT_SUCCESS;
+}
+
+typedef struct {
+    nordi_bench_ptr bench;
+    GMainLoop* loop;
+    nordvpn_error_t result;
+} nordi_app_bench_t;
+
+static gpointer
+nordi_app_bench_worker(nordi_app_bench_t* run) {
+    run->result = nordi_bench_run(run->bench);
+    g_idle_add(G_SOURCE_FUNC(nordi_app_quit_loop), run->loop);
+    return NULL;
+}
+
+// Stop the benchmark on an interrupt, it still restores the settings before the summary is written
+static gboolean
+nordi_app_cancel_bench(nordi_app_bench_t* run) {
+    g_printerr("Interrupted, restoring the settings...\n");
+    nordi_bench_cancel(run->bench);
+    return G_SOURCE_CONTINUE;
+}
+
+// Benchmark connecting without the window, writing the summary table
+static int
+nordi_app_bench_connect(GVariantDict* options) {
+    nordi_bench_options_t bench_options = BENCH_DEFAULT_OPTIONS;
+    const char* servers = "";
+    const char* output = NULL;
+    g_variant_dict_lookup(options, "cycles", "i", &bench_options.cycles);
+    g_variant_dict_lookup(options, "servers", "&s", &servers);
+    g_variant_dict_lookup(options, "bench-output", "&s", &output);
+    nordvpn_error_t result = nordvpn_open();
+    if (result != OK) {
+        g_printerr("Couldn't start a NordVPN API session: %s\n", str_ptr(nordvpn_error(result)));
+        return EXIT_FAILURE;
+    }
+    g_auto(GStrv) names = g_strsplit(servers, ",", -1);
+    nordi_bench_ptr bench = nordi_bench_new((const char* const*)names, (int)g_strv_length(names), &bench_options);
+    if (bench == NULL) {
+        return EXIT_FAILURE;
+    }
+    g_print("Benchmarking %d cycles per technology and server...\n", bench_options.cycles);
+    // run aside, so an interrupt is handled on the loop while a command is in flight
+    nordi_app_bench_t run = {.bench = bench, .loop = g_main_loop_new(NULL, FALSE), .result = OK};
+    guint interrupt = g_unix_signal_add(SIGINT, G_SOURCE_FUNC(nordi_app_cancel_bench), &run);
+    guint terminate = g_unix_signal_add(SIGTERM, G_SOURCE_FUNC(nordi_app_cancel_bench), &run);
+    GThread* thread = g_thread_new("bench", (GThreadFunc)nordi_app_bench_worker, &run);
+    g_main_loop_run(run.loop);
+    g_thread_join(thread);
+    g_source_remove(interrupt);
+    g_source_remove(terminate);
+    g_main_loop_unref(run.loop);
+    result = run.result;
+    if (result != OK) {
+        g_printerr("The benchmark didn't finish cleanly: %s\n", str_ptr(nordvpn_error(result)));
+    }
+    FILE* file = output != NULL ? fopen(output, "w") : stdout;
+    if (file == NULL) {
+        g_printerr("Couldn't write the summary to %s\n", output);
+        file = stdout;
+    }
+    nordi_bench_write(bench, file);
+    if (file != stdout) {
+        fclose(file);
+    }
+    nordi_bench_free(bench);
+    return result == OK ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Benchmark DNS resolvers without the window, printing each one and setting the best if asked to
+static int
+nordi_app_dns_bench(GVariantDict* options, const char* resolvers) {
+    g_auto(GStrv) names = g_strsplit(resolvers, ",", -1);
+    int count = (int)g_strv_length(names);
+    if (count == 0) {
+        g_printerr("No DNS resolvers to benchmark\n");
+        return EXIT_FAILURE;
+    }
+    g_autofree nordi_dns_result_t* results = g_new0(nordi_dns_result_t, count);
+    for (int index = 0; index < count; index++) {
+        results[index].resolver = str_ref(names[index]);
+    }
+    g_print("Benchmarking %d DNS resolvers...\n", count);
+    int best = nordi_dns_benchmark(results, count, NULL);
+    for (int index = 0; index < count; index++) {
+        g_print("%-24s p50 %7.2f ms  p95 %7.2f ms  loss %5.1f%%%s\n", names[index], results[index].p50_us / 1000.0,
+                results[index].p95_us / 1000.0, results[index].loss, index == best ? "  (best)" : "");
+    }
+    if (best < 0) {
+        g_printerr("None of the DNS resolvers answered\n");
+        return EXIT_FAILURE;
+    }
+    if (!g_variant_dict_contains(options, "apply")) {
+        return EXIT_SUCCESS;
+    }
+    nordvpn_error_t result = nordvpn_open();
+    if (result == OK) {
+        result = nordi_dns_apply(&results[best]);
+    }
+    if (result != OK) {
+        g_printerr("Couldn't set %s as the custom DNS: %s\n", names[best], str_ptr(nordvpn_error(result)));
+        return EXIT_FAILURE;
+    }
+    g_print("Custom DNS set to %s\n", names[best]);
+    return EXIT_SUCCESS;
+}
+
+// Headless options return their exit status, anything else opens the API session and goes on to the window
+static gint
+nordi_app_handle_local_options(GApplication* app, GVariantDict* options) {
+    const char* target = NULL;
+    int port;
+    if (g_variant_dict_lookup(options, "speedtest", "&s", &target)) {
+        return nordi_app_speedtest(options, target);
+    }
+    if (g_variant_dict_lookup(options, "speedtest-sink", "i", &port)) {
+        return nordi_app_speedtest_sink(options, port);
+    }
+    if (g_variant_dict_contains(options, "bench-connect")) {
+        return nordi_app_bench_connect(options);
+    }
+    if (g_variant_dict_lookup(options, "dns-bench", "&s", &target)) {
+        return nordi_app_dns_bench(options, target);
+    }
+    nordvpn_error_t result = nordvpn_open();
+    if (result != OK) {
+        g_printerr("Couldn't start a NordVPN API session: %s\n", str_ptr(nordvpn_error(result)));
+        return EXIT_FAILURE;
+    }
+    return -1;
+}
+
 // static void
 // nordi_app_shutdown(GApplication* app) {
 //     // close window, but move app to system tray
@@ -51,6 +268,7 @@ static void
 nordi_app_class_init(nordi_app_class class) {
     G_APPLICATION_CLASS(class)->activate = nordi_app_activate;
     G_APPLICATION_CLASS(class)->open = nordi_app_open;
+    G_APPLICATION_CLASS(class)->handle_local_options = nordi_app_handle_local_options;
     // G_APPLICATION_CLASS(class)->shutdown = nordi_app_shutdown;
 }
 
@@ -59,15 +277,41 @@ nordi_app_new() {
     return g_object_new(NORDI_APP_TYPE, "application-id", "com.nordi", "flags", G_APPLICATION_HANDLES_OPEN, NULL);
 }
 
+// Log how many nordvpn spawns each user action cost during the run
+static void
+nordi_app_log_stats() {
+    nordvpn_stats_ptr stats = nordvpn_get_stats();
+    for (int action = 0; action < ACTION_COUNT; action++) {
+        unsigned int calls = atomic_load(&(stats->calls[action])), spawns = atomic_load(&(stats->spawns[action]));
+        if (calls == 0) {
+            continue;
+        }
+        g_debug("%s: %u calls, %u spawns (%.2f per call)", str_ptr(NORDVPN_ACTION_STR[action]), calls, spawns,
+                (double)spawns / calls);
+    }
+}
+
+// Serve a nordvpn command from the trace at TRACE_REPLAY_ENV, as the binary would
+static int
+nordi_app_replay_nordvpn(char** argv) {
+    const char* path = g_getenv(TRACE_REPLAY_ENV);
+    if (path == NULL) {
+        printf("ERROR: %s names no trace to replay\n", TRACE_REPLAY_ENV);
+        return EXIT_FAILURE;
+    }
+    const char* speed = g_getenv(TRACE_SPEED_ENV);
+    return nordi_trace_serve(path, speed != NULL ? g_ascii_strtod(speed, NULL) : 1.0, (const char**)argv, stdout);
+}
+
 int
 nordi_app_run(int argc, char** argv) {
-    nordvpn_error_t result = nordvpn_open();
-    if (result != OK) {
-        g_printerr("Couldn't start a NordVPN API session: %s\n", str_ptr(nordvpn_error(result)));
-        nordvpn_close();
-        return EXIT_FAILURE;
+    // the API runs it as nordvpn when NORDVPN_BINARY_ENV points to it
+    g_autofree char* name = g_path_get_basename(argv[0]);
+    if (g_strcmp0(name, NORDVPN_NAME) == 0) {
+        return nordi_app_replay_nordvpn(argv);
     }
     int status = g_application_run(G_APPLICATION(nordi_app_new()), argc, argv);
+    nordi_app_log_stats();
     nordvpn_close();
     return status;
 }
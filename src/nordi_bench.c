@@ -0,0 +1,239 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include <time.h>
+#include "nordi_bench.h"
+#include "nordi_dns.h"
+#include "nordi_monitor.h"
+
+#define RTT_INTERVAL_MS 10
+
+const nordi_bench_options_t BENCH_DEFAULT_OPTIONS = {
+    .cycles = BENCH_DEFAULT_CYCLES,
+    .rtt_target = NULL,
+    .rtt_probes = BENCH_DEFAULT_RTT_PROBES,
+    .rtt_timeout_ms = BENCH_DEFAULT_RTT_TIMEOUT_MS,
+};
+
+const char* const NORDI_BENCH_COMBINATION_STR[] = {"NordLynx", "OpenVPN UDP", "OpenVPN TCP"};
+
+static const nordvpn_technology_t COMBINATION_TECHNOLOGY[] = {TECHNOLOGY_NORDLYNX, TECHNOLOGY_OPENVPN,
+                                                             TECHNOLOGY_OPENVPN};
+static const char* const COMBINATION_PROTOCOL[] = {"", "UDP", "TCP"};
+
+static long long
+now_ms() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static int
+compare_unsigned(const void* left, const void* right) {
+    unsigned int a = *(const unsigned int*)left, b = *(const unsigned int*)right;
+    return a < b ? -1 : a > b;
+}
+
+// Nearest rank percentile, sorts the values
+static unsigned int
+percentile(unsigned int* values, unsigned int count, unsigned int rank) {
+    if (count == 0) {
+        return 0;
+    }
+    qsort(values, count, sizeof(unsigned int), compare_unsigned);
+    return values[(count * rank + 99) / 100 - 1];
+}
+
+// Median round trip through the tunnel, 0 if nothing answered
+static unsigned int
+bench_rtt(nordi_bench_ptr bench) {
+    nordi_dns_result_t result = {
+        .resolver = str_ref(bench->options.rtt_target != NULL ? bench->options.rtt_target : MONITOR_DEFAULT_TARGET),
+    };
+    nordi_dns_options_t options = {
+        .repetitions = bench->options.rtt_probes,
+        .interval_ms = RTT_INTERVAL_MS,
+        .timeout_ms = bench->options.rtt_timeout_ms,
+    };
+    return nordi_dns_benchmark(&result, 1, &options) == 0 ? result.p50_us : 0;
+}
+
+static bool
+bench_is_cancelled(nordi_bench_ptr bench) {
+    mtx_lock(&bench->mutex);
+    bool is_cancelled = bench->is_cancelled;
+    mtx_unlock(&bench->mutex);
+    return is_cancelled;
+}
+
+// Set the technology and protocol of a combination, leaving every other setting as it is
+static nordvpn_error_t
+bench_set(const nordvpn_settings_t* original, nordvpn_technology_t technology, const char* protocol) {
+    nordvpn_settings_t desired = {.protocol = str_null, .dns = str_null, .allowlist = str_null};
+    nordvpn_copy_settings(&desired, original);
+    desired.technology = technology;
+    str_cpy(&(desired.protocol), str_ref(protocol));
+    nordvpn_error_t result = nordvpn_apply_settings(&desired);
+    nordvpn_clear_settings(&desired);
+    return result;
+}
+
+static void
+bench_row(nordi_bench_ptr bench, nordi_bench_row_t* row, unsigned int* connects, unsigned int* rtts) {
+    unsigned int up = 0, measured = 0;
+    str server = str_ref(row->server);
+    row->cycles = 0;
+    row->failures = 0;
+    for (int cycle = 0; cycle < bench->options.cycles && !bench_is_cancelled(bench); cycle++) {
+        long long start = now_ms();
+        nordvpn_error_t result = nordvpn_server_connect(server);
+        unsigned int elapsed = (unsigned int)(now_ms() - start);
+        row->cycles++;
+        nordvpn_lock_state();
+        bool is_online = nordvpn_get_host()->is_online;
+        nordvpn_unlock_state();
+        if (result != OK || !is_online) {
+            row->failures++;
+            continue;
+        }
+        connects[up++] = elapsed;
+        unsigned int rtt = bench_rtt(bench);
+        if (rtt > 0) {
+            rtts[measured++] = rtt;
+        }
+        nordvpn_disconnect();
+    }
+    row->connect_p50_ms = percentile(connects, up, 50);
+    row->connect_p95_ms = percentile(connects, up, 95);
+    row->rtt_p50_us = percentile(rtts, measured, 50);
+    row->rtt_p95_us = percentile(rtts, measured, 95);
+}
+
+nordi_bench_ptr
+nordi_bench_new(const char* const* servers, int count, nordi_bench_options_ptr options) {
+    nordi_bench_ptr bench = calloc(1, sizeof(nordi_bench_t));
+    if (bench == NULL) {
+        return NULL;
+    }
+    bench->options = options != NULL ? *options : BENCH_DEFAULT_OPTIONS;
+    count = count > BENCH_MAX_SERVERS ? BENCH_MAX_SERVERS : count;
+    int server_count = count > 0 ? count : 1;
+    bench->rows = calloc(BENCH_COMBINATION_COUNT * server_count, sizeof(nordi_bench_row_t));
+    if (bench->rows == NULL || mtx_init(&bench->mutex, mtx_plain) != thrd_success) {
+        free(bench->rows);
+        free(bench);
+        return NULL;
+    }
+    for (int combination = 0; combination < BENCH_COMBINATION_COUNT; combination++) {
+        for (int server = 0; server < server_count; server++) {
+            nordi_bench_row_t* row = &bench->rows[bench->count++];
+            row->combination = (nordi_bench_combination_t)combination;
+            snprintf(row->server, BENCH_MAX_SERVER, "%s", count > 0 ? servers[server] : "");
+        }
+    }
+    return bench;
+}
+
+nordvpn_error_t
+nordi_bench_run(nordi_bench_ptr bench) {
+    if (!nordvpn_get_session()->is_active) {
+        return NO_SESSION;
+    }
+    if (!nordvpn_get_settings()->is_known) {
+        nordvpn_error_t result = nordvpn_read_settings();
+        if (result != OK) {
+            return result;
+        }
+    }
+    nordvpn_settings_t original = {.protocol = str_null, .dns = str_null, .allowlist = str_null};
+    nordvpn_lock_state();
+    nordvpn_copy_settings(&original, nordvpn_get_settings());
+    nordvpn_unlock_state();
+    int cycles = bench->options.cycles > 0 ? bench->options.cycles : 0;
+    unsigned int* connects = calloc(cycles + 1, sizeof(unsigned int));
+    unsigned int* rtts = calloc(cycles + 1, sizeof(unsigned int));
+    if (connects == NULL || rtts == NULL) {
+        free(connects);
+        free(rtts);
+        nordvpn_clear_settings(&original);
+        return UNKNOWN_ERROR;
+    }
+    // start from the tunnel down, so the first connect isn't a switch
+    if (nordvpn_get_host()->is_online) {
+        nordvpn_disconnect();
+    }
+    int servers = bench->count / BENCH_COMBINATION_COUNT;
+    for (int combination = 0; combination < BENCH_COMBINATION_COUNT && !bench_is_cancelled(bench); combination++) {
+        nordi_bench_row_t* rows = &bench->rows[combination * servers];
+        bool is_set =
+            bench_set(&original, COMBINATION_TECHNOLOGY[combination], COMBINATION_PROTOCOL[combination]) == OK;
+        for (int server = 0; server < servers && !bench_is_cancelled(bench); server++) {
+            if (is_set) {
+                bench_row(bench, &rows[server], connects, rtts);
+                continue;
+            }
+            // every cycle fails the same way, no need to spend them
+            rows[server].cycles = rows[server].failures = (unsigned int)cycles;
+            rows[server].connect_p50_ms = rows[server].connect_p95_ms = 0;
+            rows[server].rtt_p50_us = rows[server].rtt_p95_us = 0;
+        }
+    }
+    free(connects);
+    free(rtts);
+    // cancels are ignored from here on as they would stop the restore, an earlier one only stopped a command
+    mtx_lock(&bench->mutex);
+    bench->is_restoring = true;
+    bool is_cancelled = bench->is_cancelled;
+    mtx_unlock(&bench->mutex);
+    if (is_cancelled) {
+        nordvpn_get_session()->is_cancelled = false;
+        // the daemon may still bring up the connect that was stopped
+        nordvpn_disconnect();
+    }
+    nordvpn_error_t result = bench_set(&original, original.technology, str_ptr(original.protocol));
+    nordvpn_clear_settings(&original);
+    return result == OK && is_cancelled ? CANCELLED : result;
+}
+
+void
+nordi_bench_cancel(nordi_bench_ptr bench) {
+    mtx_lock(&bench->mutex);
+    if (!bench->is_cancelled && !bench->is_restoring) {
+        bench->is_cancelled = true;
+        nordvpn_cancel();
+    }
+    mtx_unlock(&bench->mutex);
+}
+
+void
+nordi_bench_write(nordi_bench_ptr bench, FILE* file) {
+    fprintf(file, "%-12s %-16s %6s %7s %12s %12s %10s %10s\n", "technology", "server", "cycles", "failed",
+            "connect p50", "connect p95", "rtt p50", "rtt p95");
+    for (int index = 0; index < bench->count; index++) {
+        const nordi_bench_row_t* row = &bench->rows[index];
+        double failed = row->cycles > 0 ? 100.0 * row->failures / row->cycles : 0;
+        fprintf(file, "%-12s %-16s %6u %6.1f%% %9u ms %9u ms %7.1f ms %7.1f ms\n",
+                NORDI_BENCH_COMBINATION_STR[row->combination], row->server[0] != '\0' ? row->server : "quick",
+                row->cycles, failed, row->connect_p50_ms, row->connect_p95_ms, row->rtt_p50_us / 1000.0,
+                row->rtt_p95_us / 1000.0);
+    }
+}
+
+void
+nordi_bench_free(nordi_bench_ptr bench) {
+    if (bench == NULL) {
+        return;
+    }
+    mtx_destroy(&bench->mutex);
+    free(bench->rows);
+    free(bench);
+}
@@ -0,0 +1,156 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "nordi_bus.h"
+
+static void
+bus_deliver(nordi_bus_ptr bus, nordi_bus_subscriber_t* subscriber, nordi_bus_event_ptr event) {
+    subscriber->callback(event, subscriber->context);
+    bus->delivered++;
+}
+
+static void
+bus_hold(nordi_bus_ptr bus, nordi_bus_subscriber_t* subscriber, nordi_bus_event_ptr event) {
+    if (subscriber->is_pending) {
+        bus->coalesced++;
+    }
+    subscriber->pending = *event;
+    subscriber->pending.next = NULL;
+    subscriber->is_pending = true;
+}
+
+// Takes every published event, oldest first
+static nordi_bus_event_t*
+bus_take(nordi_bus_ptr bus) {
+    nordi_bus_event_t* event = atomic_exchange_explicit(&bus->head, NULL, memory_order_acquire);
+    nordi_bus_event_t* oldest = NULL;
+    while (event != NULL) {
+        nordi_bus_event_t* next = event->next;
+        event->next = oldest;
+        oldest = event;
+        event = next;
+    }
+    return oldest;
+}
+
+nordi_bus_ptr
+nordi_bus_new(nordi_bus_wake_t wake, void* context) {
+    nordi_bus_ptr bus = calloc(1, sizeof(nordi_bus_t));
+    if (bus == NULL) {
+        return NULL;
+    }
+    atomic_init(&bus->head, NULL);
+    atomic_init(&bus->published, 0);
+    bus->wake = wake;
+    bus->context = context;
+    return bus;
+}
+
+bool
+nordi_bus_subscribe(nordi_bus_ptr bus, nordi_bus_event_type_t type, nordi_bus_policy_t policy, int settle_ms,
+                    nordi_bus_callback_t callback, void* context) {
+    if (bus->subscriber_count == BUS_MAX_SUBSCRIBERS) {
+        return false;
+    }
+    nordi_bus_subscriber_t* subscriber = &bus->subscribers[bus->subscriber_count++];
+    subscriber->type = type;
+    subscriber->policy = policy;
+    subscriber->settle_ms = settle_ms < 0 ? BUS_DEFAULT_SETTLE_MS : settle_ms;
+    subscriber->callback = callback;
+    subscriber->context = context;
+    subscriber->is_pending = false;
+    return true;
+}
+
+bool
+nordi_bus_publish(nordi_bus_ptr bus, nordi_bus_event_type_t type, int value, const char* text) {
+    nordi_bus_event_t* event = malloc(sizeof(nordi_bus_event_t));
+    if (event == NULL) {
+        return false;
+    }
+    event->type = type;
+    event->time_ms = nordi_bus_now_ms();
+    event->value = value;
+    snprintf(event->text, BUS_MAX_TEXT, "%s", text != NULL ? text : "");
+    // pushes only, the dispatcher takes the whole stack, so even a head recycled meanwhile is the right next
+    nordi_bus_event_t* head = atomic_load_explicit(&bus->head, memory_order_relaxed);
+    do {
+        event->next = head;
+    } while (!atomic_compare_exchange_weak_explicit(&bus->head, &head, event, memory_order_release,
+                                                    memory_order_relaxed));
+    atomic_fetch_add_explicit(&bus->published, 1, memory_order_relaxed);
+    if (head == NULL && bus->wake != NULL) {
+        bus->wake(bus->context);
+    }
+    return true;
+}
+
+int
+nordi_bus_dispatch(nordi_bus_ptr bus, long long now_ms) {
+    nordi_bus_event_t* event = bus_take(bus);
+    bus->batches += event != NULL;
+    while (event != NULL) {
+        for (int index = 0; index < bus->subscriber_count; index++) {
+            nordi_bus_subscriber_t* subscriber = &bus->subscribers[index];
+            if (subscriber->type != event->type) {
+                continue;
+            }
+            if (subscriber->policy == BUS_EVERY) {
+                bus_deliver(bus, subscriber, event);
+            } else {
+                bus_hold(bus, subscriber, event);
+            }
+        }
+        nordi_bus_event_t* next = event->next;
+        free(event);
+        event = next;
+    }
+    int deadline = BUS_NO_DEADLINE;
+    for (int index = 0; index < bus->subscriber_count; index++) {
+        nordi_bus_subscriber_t* subscriber = &bus->subscribers[index];
+        if (!subscriber->is_pending) {
+            continue;
+        }
+        long long remaining = 0;
+        if (subscriber->policy == BUS_SETTLED) {
+            remaining = subscriber->pending.time_ms + subscriber->settle_ms - now_ms;
+        }
+        if (remaining > 0) {
+            deadline = deadline == BUS_NO_DEADLINE || remaining < deadline ? (int)remaining : deadline;
+            continue;
+        }
+        subscriber->is_pending = false;
+        bus_deliver(bus, subscriber, &subscriber->pending);
+    }
+    return deadline;
+}
+
+long long
+nordi_bus_now_ms() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+void
+nordi_bus_free(nordi_bus_ptr bus) {
+    if (bus == NULL) {
+        return;
+    }
+    nordi_bus_event_t* event = bus_take(bus);
+    while (event != NULL) {
+        nordi_bus_event_t* next = event->next;
+        free(event);
+        event = next;
+    }
+    free(bus);
+}
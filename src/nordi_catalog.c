@@ -0,0 +1,716 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "nordi_catalog.h"
+#include "nordi_resources.h"
+#include "nordvpn_server.h"
+
+#define CATALOG_MAGIC    "NORDICAT"
+#define CATALOG_VERSION  2
+#define TEMPORARY_SUFFIX ".tmp"
+#define MAX_HOST_LENGTH  256
+#define MAX_PORT_LENGTH  8
+#define MAX_REQUEST      2048
+#define MAX_HEADERS      16384
+#define READ_CHUNK       65536
+#define FULL_MARKER      "#full"
+#define DELTA_MARKER     "#delta"
+#define HTTP_PREFIX      "http://"
+#define FIELD_COUNT      6 // technologies are optional
+#define MAX_FIELDS       7
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t count;
+    char etag[CATALOG_MAX_VALIDATOR];
+    char last_modified[CATALOG_MAX_VALIDATOR];
+} catalog_header_t;
+
+typedef struct {
+    int status;
+    char etag[CATALOG_MAX_VALIDATOR];
+    char last_modified[CATALOG_MAX_VALIDATOR];
+    char* body; // NUL terminated
+    size_t body_length;
+} http_response_t;
+
+// A lookup on its own thread, so it can be given up on. The thread or the refresh, whichever lets go last, frees it.
+typedef struct {
+    atomic_int references;
+    atomic_bool is_done;
+    int done; // eventfd, readable once the lookup is done
+    char host[MAX_HOST_LENGTH];
+    char port[MAX_PORT_LENGTH];
+    struct addrinfo* addresses; // NULL if the host didn't resolve
+} http_lookup_t;
+
+// A parsed line: an entry to insert or replace, or a name to remove
+typedef struct {
+    nordi_catalog_server_t server;
+    bool is_removed;
+} catalog_change_t;
+
+static const char* const FEATURE_NAMES[] = {"standard", "p2p", "double_vpn", "onion", "obfuscated", "dedicated_ip"};
+
+static int
+compare_changes(const void* left, const void* right) {
+    return strncmp(((const catalog_change_t*)left)->server.name, ((const catalog_change_t*)right)->server.name,
+                   CATALOG_MAX_SERVER);
+}
+
+// "http://host[:port]/path" into its parts, the path defaults to "/"
+static bool
+parse_url(const char* url, char* host, char* port, const char** path) {
+    if (url == NULL || strncmp(url, HTTP_PREFIX, sizeof(HTTP_PREFIX) - 1) != 0) {
+        return false;
+    }
+    const char* authority = url + sizeof(HTTP_PREFIX) - 1;
+    const char* slash = strchr(authority, '/');
+    size_t authority_length = slash != NULL ? (size_t)(slash - authority) : strlen(authority);
+    const char* colon = memchr(authority, ':', authority_length);
+    size_t host_length = colon != NULL ? (size_t)(colon - authority) : authority_length;
+    size_t port_length = colon != NULL ? authority_length - host_length - 1 : 2;
+    if (host_length == 0 || host_length >= MAX_HOST_LENGTH || port_length == 0 || port_length >= MAX_PORT_LENGTH) {
+        return false;
+    }
+    memcpy(host, authority, host_length);
+    host[host_length] = '\0';
+    memcpy(port, colon != NULL ? colon + 1 : "80", port_length);
+    port[port_length] = '\0';
+    *path = slash != NULL ? slash : "/";
+    return true;
+}
+
+static bool
+is_cancelled(int cancel) {
+    struct pollfd event = {.fd = cancel, .events = POLLIN};
+    return cancel >= 0 && poll(&event, 1, 0) == 1;
+}
+
+// Wait until the fd is ready for the events, up to the timeout. Returns false on timeout, error or cancel.
+static bool
+http_wait(int fd, short events, int cancel, int timeout_ms) {
+    // poll skips a negative cancel fd
+    struct pollfd fds[] = {{.fd = fd, .events = events}, {.fd = cancel, .events = POLLIN}};
+    int ready;
+    do {
+        ready = poll(fds, 2, timeout_ms);
+    } while (ready < 0 && errno == EINTR);
+    return ready > 0 && fds[1].revents == 0 && fds[0].revents != 0;
+}
+
+static void
+lookup_release(http_lookup_t* lookup) {
+    if (atomic_fetch_sub(&lookup->references, 1) > 1) {
+        return;
+    }
+    if (lookup->addresses != NULL) {
+        freeaddrinfo(lookup->addresses);
+    }
+    close(lookup->done);
+    free(lookup);
+}
+
+static int
+lookup_worker(http_lookup_t* lookup) {
+    struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM};
+    if (getaddrinfo(lookup->host, lookup->port, &hints, &lookup->addresses) != 0) {
+        lookup->addresses = NULL;
+    }
+    atomic_store(&lookup->is_done, true);
+    uint64_t signal = 1;
+    // should it still fail, the caller waits out its timeout and finds the lookup done
+    ssize_t written;
+    do {
+        written = write(lookup->done, &signal, sizeof(signal));
+    } while (written < 0 && errno == EINTR);
+    lookup_release(lookup);
+    return thrd_success;
+}
+
+// Resolve the host within the timeout. getaddrinfo can't be interrupted, so it runs on a thread left behind on
+// timeout or cancel, to finish on its own.
+static struct addrinfo*
+http_resolve(const char* host, const char* port, int timeout_ms, int cancel) {
+    http_lookup_t* lookup = (http_lookup_t*)calloc(1, sizeof(http_lookup_t));
+    if (lookup == NULL) {
+        return NULL;
+    }
+    snprintf(lookup->host, MAX_HOST_LENGTH, "%s", host);
+    snprintf(lookup->port, MAX_PORT_LENGTH, "%s", port);
+    lookup->done = eventfd(0, EFD_CLOEXEC);
+    if (lookup->done < 0) {
+        free(lookup);
+        return NULL;
+    }
+    atomic_init(&lookup->references, 2);
+    thrd_t thread;
+    if (thrd_create(&thread, (thrd_start_t)lookup_worker, lookup) == thrd_success) {
+        thrd_detach(thread);
+        http_wait(lookup->done, POLLIN, cancel, timeout_ms);
+    } else {
+        lookup_worker(lookup);
+    }
+    struct addrinfo* addresses = NULL;
+    if (atomic_load(&lookup->is_done)) {
+        addresses = lookup->addresses;
+        lookup->addresses = NULL;
+    }
+    lookup_release(lookup);
+    return addresses;
+}
+
+// Connect with a deadline, leaving the socket non blocking for http_wait to bound every read and write
+static int
+http_connect(const char* host, const char* port, int timeout_ms, int cancel) {
+    struct addrinfo* addresses = http_resolve(host, port, timeout_ms, cancel);
+    if (addresses == NULL) {
+        return -1;
+    }
+    int fd = -1;
+    for (struct addrinfo* address = addresses; address != NULL && fd < 0; address = address->ai_next) {
+        fd = socket(address->ai_family, address->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, address->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        if (connect(fd, address->ai_addr, address->ai_addrlen) == 0) {
+            break;
+        }
+        int error = 0;
+        socklen_t length = sizeof(error);
+        if (errno != EINPROGRESS || !http_wait(fd, POLLOUT, cancel, timeout_ms)
+            || getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) != 0 || error != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(addresses);
+    return fd;
+}
+
+// Copy a header value if the line holds the named header
+static bool
+header_value(const char* line, size_t length, const char* name, char* value, size_t size) {
+    size_t name_length = strlen(name);
+    if (length <= name_length || strncasecmp(line, name, name_length) != 0 || line[name_length] != ':') {
+        return false;
+    }
+    const char* start = line + name_length + 1;
+    const char* end = line + length;
+    while (start < end && *start == ' ') {
+        start++;
+    }
+    while (end > start && end[-1] == ' ') {
+        end--;
+    }
+    snprintf(value, size, "%.*s", (int)(end - start), start);
+    return true;
+}
+
+// Decode a chunked body in place, returns its decoded length or -1 if malformed
+static long
+decode_chunked(char* body, size_t length) {
+    size_t read = 0, written = 0;
+    while (read < length) {
+        char* end = NULL;
+        unsigned long chunk = strtoul(body + read, &end, 16);
+        char* line_end = strstr(end, "\r\n");
+        if (end == body + read || line_end == NULL) {
+            return -1;
+        }
+        read = line_end + 2 - body;
+        if (chunk == 0) {
+            return (long)written;
+        }
+        if (chunk > length - read) {
+            return -1;
+        }
+        memmove(body + written, body + read, chunk);
+        written += chunk;
+        read += chunk + 2; // chunk data is followed by CRLF
+    }
+    return -1;
+}
+
+// Parse the status line and the headers we care about, then move the body to the front of the buffer
+static bool
+http_parse(char* buffer, size_t length, http_response_t* response) {
+    char* headers_end = strstr(buffer, "\r\n\r\n");
+    if (headers_end == NULL || sscanf(buffer, "HTTP/1.%*d %d", &response->status) != 1) {
+        return false;
+    }
+    bool is_chunked = false;
+    long content_length = -1;
+    char value[CATALOG_MAX_VALIDATOR];
+    for (char* line = strstr(buffer, "\r\n") + 2; line < headers_end;) {
+        char* line_end = strstr(line, "\r\n");
+        size_t line_length = line_end - line;
+        header_value(line, line_length, "ETag", response->etag, CATALOG_MAX_VALIDATOR);
+        header_value(line, line_length, "Last-Modified", response->last_modified, CATALOG_MAX_VALIDATOR);
+        if (header_value(line, line_length, "Transfer-Encoding", value, sizeof(value))) {
+            is_chunked = strcasecmp(value, "chunked") == 0;
+        }
+        if (header_value(line, line_length, "Content-Length", value, sizeof(value))) {
+            content_length = strtol(value, NULL, 10);
+        }
+        line = line_end + 2;
+    }
+    char* body = headers_end + 4;
+    long body_length = (long)(length - (body - buffer));
+    if (is_chunked) {
+        body_length = decode_chunked(body, body_length);
+    } else if (content_length >= 0) {
+        body_length = content_length <= body_length ? content_length : -1;
+    }
+    if (body_length < 0) {
+        return false; // cut short
+    }
+    memmove(buffer, body, body_length);
+    buffer[body_length] = '\0';
+    response->body = buffer;
+    response->body_length = body_length;
+    return true;
+}
+
+// A GET over a fresh connection, read until the server closes it
+static bool
+http_get(const char* url, const char* etag, const char* last_modified, int timeout_ms, int cancel,
+         http_response_t* response) {
+    char host[MAX_HOST_LENGTH], port[MAX_PORT_LENGTH], request[MAX_REQUEST];
+    const char* path;
+    if (!parse_url(url, host, port, &path)) {
+        return false;
+    }
+    // a request that doesn't fit is given up on, before the next part is appended past the end
+    int length = snprintf(request, MAX_REQUEST, "GET %s HTTP/1.1\r\nHost: %s\r\nConnection: close\r\n", path, host);
+    if (length >= MAX_REQUEST) {
+        return false;
+    }
+    if (etag[0] != '\0') {
+        length += snprintf(request + length, MAX_REQUEST - length, "If-None-Match: %s\r\n", etag);
+        if (length >= MAX_REQUEST) {
+            return false;
+        }
+    }
+    if (last_modified[0] != '\0') {
+        length += snprintf(request + length, MAX_REQUEST - length, "If-Modified-Since: %s\r\n", last_modified);
+        if (length >= MAX_REQUEST) {
+            return false;
+        }
+    }
+    length += snprintf(request + length, MAX_REQUEST - length, "\r\n");
+    if (length >= MAX_REQUEST) {
+        return false;
+    }
+    int fd = http_connect(host, port, timeout_ms, cancel);
+    if (fd < 0) {
+        return false;
+    }
+    bool is_sent = http_wait(fd, POLLOUT, cancel, timeout_ms) && send(fd, request, length, MSG_NOSIGNAL) == length;
+    size_t capacity = READ_CHUNK, received = 0;
+    char* buffer = (char*)malloc(capacity + 1);
+    while (is_sent && buffer != NULL) {
+        if (received == capacity) {
+            char* grown = capacity < CATALOG_MAX_BODY + MAX_HEADERS ? (char*)realloc(buffer, capacity * 2 + 1) : NULL;
+            if (grown == NULL) {
+                is_sent = false;
+                break;
+            }
+            buffer = grown;
+            capacity *= 2;
+        }
+        if (!http_wait(fd, POLLIN, cancel, timeout_ms)) {
+            is_sent = false; // a timeout or cancel loses the response
+            break;
+        }
+        ssize_t count = recv(fd, buffer + received, capacity - received, 0);
+        if (count < 0 && (errno == EAGAIN || errno == EINTR)) {
+            continue;
+        }
+        if (count <= 0) {
+            is_sent = count == 0; // a timeout or reset loses the response
+            break;
+        }
+        received += count;
+    }
+    close(fd);
+    if (buffer == NULL) {
+        return false;
+    }
+    buffer[received] = '\0';
+    if (!is_sent || !http_parse(buffer, received, response)) {
+        free(buffer);
+        return false;
+    }
+    return true;
+}
+
+// Fixed point degrees, so the current locale's decimal separator doesn't matter
+static int32_t
+parse_e6(const char* text) {
+    bool is_negative = *text == '-';
+    text += is_negative || *text == '+';
+    long long value = 0;
+    for (; *text >= '0' && *text <= '9'; text++) {
+        value = value * 10 + (*text - '0');
+    }
+    value *= 1000000;
+    if (*text == '.') {
+        long long scale = 100000;
+        for (text++; *text >= '0' && *text <= '9' && scale > 0; text++, scale /= 10) {
+            value += (*text - '0') * scale;
+        }
+    }
+    return (int32_t)(is_negative ? -value : value);
+}
+
+static uint8_t
+parse_technologies(const char* text) {
+    uint8_t technologies = 0;
+    while (*text != '\0') {
+        size_t length = strcspn(text, ",");
+        technologies |= 1u << nordvpn_technology_from_name(str_ref_chars(text, length));
+        text += length + (text[length] == ',');
+    }
+    return technologies & ~(1u << TECHNOLOGY_UNKNOWN);
+}
+
+static uint32_t
+parse_features(const char* text, size_t length) {
+    uint32_t features = 0;
+    for (size_t start = 0; start < length;) {
+        const char* comma = memchr(text + start, ',', length - start);
+        size_t end = comma != NULL ? (size_t)(comma - text) : length;
+        for (int feature = 0; feature < (int)(sizeof(FEATURE_NAMES) / sizeof(*FEATURE_NAMES)); feature++) {
+            if (strlen(FEATURE_NAMES[feature]) == end - start && strncmp(FEATURE_NAMES[feature], text + start, end - start) == 0) {
+                features |= 1u << feature;
+            }
+        }
+        start = end + 1;
+    }
+    return features;
+}
+
+// A single catalog line into a change, false if it is malformed
+static bool
+parse_line(char* line, catalog_change_t* change) {
+    *change = (catalog_change_t){.server.country = -1};
+    if (line[0] == '-') {
+        change->is_removed = true;
+        snprintf(change->server.name, CATALOG_MAX_SERVER, "%s", line + 1);
+        return change->server.name[0] != '\0';
+    }
+    char* fields[MAX_FIELDS];
+    int count = 0;
+    for (char* field = line; count < MAX_FIELDS && field != NULL; count++) {
+        fields[count] = field;
+        field = strchr(field, '\t');
+        if (field != NULL) {
+            *field++ = '\0';
+        }
+    }
+    if (count < FIELD_COUNT || fields[0][0] == '\0' || strlen(fields[0]) >= CATALOG_MAX_SERVER) {
+        return false;
+    }
+    snprintf(change->server.name, CATALOG_MAX_SERVER, "%s", fields[0]);
+    change->server.country = (int16_t)nordvpn_country_from_name(str_ref(fields[1]));
+    long load = strtol(fields[2], NULL, 10);
+    change->server.load = (uint8_t)(load < 0 ? 0 : load > 100 ? 100 : load);
+    change->server.features = parse_features(fields[3], strlen(fields[3]));
+    change->server.latitude_e6 = parse_e6(fields[4]);
+    change->server.longitude_e6 = parse_e6(fields[5]);
+    change->server.technologies = count > FIELD_COUNT ? parse_technologies(fields[FIELD_COUNT]) : 0;
+    return true;
+}
+
+// Parse the body into sorted changes, malformed lines are skipped. Returns the count or -1 if not a catalog.
+static int
+parse_body(char* body, bool* is_delta, catalog_change_t** changes) {
+    char* line = strtok(body, "\r\n");
+    if (line == NULL || (strcmp(line, FULL_MARKER) != 0 && strcmp(line, DELTA_MARKER) != 0)) {
+        return -1;
+    }
+    *is_delta = strcmp(line, DELTA_MARKER) == 0;
+    int count = 0, capacity = 256;
+    *changes = (catalog_change_t*)malloc(capacity * sizeof(catalog_change_t));
+    while (*changes != NULL && (line = strtok(NULL, "\r\n")) != NULL) {
+        if (count == capacity) {
+            capacity *= 2;
+            catalog_change_t* grown = (catalog_change_t*)realloc(*changes, capacity * sizeof(catalog_change_t));
+            if (grown == NULL) {
+                break;
+            }
+            *changes = grown;
+        }
+        count += parse_line(line, &(*changes)[count]);
+    }
+    if (*changes == NULL) {
+        return -1;
+    }
+    qsort(*changes, count, sizeof(catalog_change_t), compare_changes);
+    return count;
+}
+
+// Merge sorted changes into the sorted table in one pass, the changes win over equal names
+static nordi_catalog_server_t*
+merge_changes(const nordi_catalog_server_t* servers, int count, const catalog_change_t* changes, int change_count,
+              int* merged_count) {
+    nordi_catalog_server_t* merged = (nordi_catalog_server_t*)malloc((count + change_count + 1) * sizeof(nordi_catalog_server_t));
+    if (merged == NULL) {
+        return NULL;
+    }
+    int index = 0, change = 0, length = 0;
+    while (index < count || change < change_count) {
+        int order = index == count          ? 1
+                    : change == change_count ? -1
+                                             : strncmp(servers[index].name, changes[change].server.name, CATALOG_MAX_SERVER);
+        if (order < 0) {
+            merged[length++] = servers[index++];
+            continue;
+        }
+        index += order == 0; // replaced or removed
+        if (!changes[change].is_removed) {
+            merged[length++] = changes[change].server;
+        }
+        change++;
+    }
+    *merged_count = length;
+    return merged;
+}
+
+static bool
+write_all(int fd, const void* data, size_t length) {
+    const char* bytes = (const char*)data;
+    while (length > 0) {
+        ssize_t written = write(fd, bytes, length);
+        if (written < 0) {
+            return false;
+        }
+        bytes += written;
+        length -= written;
+    }
+    return true;
+}
+
+// Write the table to a temporary file and rename it over the cache, must hold the mutex
+static bool
+catalog_save(nordi_catalog_ptr catalog) {
+    if (catalog->path[0] == '\0') {
+        return true;
+    }
+    char temporary[CATALOG_MAX_PATH + sizeof(TEMPORARY_SUFFIX)];
+    snprintf(temporary, sizeof(temporary), "%s" TEMPORARY_SUFFIX, catalog->path);
+    int fd = open(temporary, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return false;
+    }
+    catalog_header_t header = {
+        .magic = CATALOG_MAGIC,
+        .version = CATALOG_VERSION,
+        .record_size = sizeof(nordi_catalog_server_t),
+        .count = (uint32_t)catalog->count,
+    };
+    memcpy(header.etag, catalog->etag, CATALOG_MAX_VALIDATOR);
+    memcpy(header.last_modified, catalog->last_modified, CATALOG_MAX_VALIDATOR);
+    bool is_written = write_all(fd, &header, sizeof(header))
+                      && write_all(fd, catalog->servers, catalog->count * sizeof(nordi_catalog_server_t)) && fdatasync(fd) == 0;
+    close(fd);
+    if (!is_written || rename(temporary, catalog->path) != 0) {
+        unlink(temporary);
+        return false;
+    }
+    return true;
+}
+
+// Load the cache as is, it was sorted when written. Anything off and the catalog starts empty.
+static void
+catalog_load(nordi_catalog_ptr catalog) {
+    int fd = open(catalog->path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    catalog_header_t header;
+    struct stat info;
+    bool is_valid = read(fd, &header, sizeof(header)) == sizeof(header) && fstat(fd, &info) == 0
+                    && memcmp(header.magic, CATALOG_MAGIC, sizeof(header.magic)) == 0 && header.version == CATALOG_VERSION
+                    && header.record_size == sizeof(nordi_catalog_server_t)
+                    && (off_t)(sizeof(header) + (size_t)header.count * sizeof(nordi_catalog_server_t)) == info.st_size;
+    nordi_catalog_server_t* servers = is_valid ? (nordi_catalog_server_t*)malloc(header.count * sizeof(nordi_catalog_server_t) + 1) : NULL;
+    size_t length = is_valid ? header.count * sizeof(nordi_catalog_server_t) : 0;
+    if (servers != NULL && read(fd, servers, length) == (ssize_t)length) {
+        catalog->servers = servers;
+        catalog->count = (int)header.count;
+        nordi_resources_alloc(RESOURCE_CATALOG, length);
+        // validators only count along with the table they validate
+        header.etag[CATALOG_MAX_VALIDATOR - 1] = header.last_modified[CATALOG_MAX_VALIDATOR - 1] = '\0';
+        memcpy(catalog->etag, header.etag, CATALOG_MAX_VALIDATOR);
+        memcpy(catalog->last_modified, header.last_modified, CATALOG_MAX_VALIDATOR);
+    } else {
+        free(servers);
+    }
+    close(fd);
+}
+
+nordi_catalog_ptr
+nordi_catalog_open(const char* path) {
+    nordi_catalog_ptr catalog = (nordi_catalog_ptr)calloc(1, sizeof(nordi_catalog_t));
+    if (catalog == NULL) {
+        return NULL;
+    }
+    if (mtx_init(&catalog->mutex, mtx_plain) != thrd_success) {
+        free(catalog);
+        return NULL;
+    }
+    nordi_resources_alloc(RESOURCE_CATALOG, sizeof(nordi_catalog_t));
+    if (path != NULL) {
+        snprintf(catalog->path, CATALOG_MAX_PATH, "%s", path);
+        catalog_load(catalog);
+    }
+    return catalog;
+}
+
+nordi_catalog_result_t
+nordi_catalog_refresh(nordi_catalog_ptr catalog, const char* url, int timeout_ms) {
+    return nordi_catalog_refresh_cancellable(catalog, url, timeout_ms, -1);
+}
+
+nordi_catalog_result_t
+nordi_catalog_refresh_cancellable(nordi_catalog_ptr catalog, const char* url, int timeout_ms, int cancel) {
+    if (catalog == NULL) {
+        return CATALOG_FAILED;
+    }
+    char etag[CATALOG_MAX_VALIDATOR], last_modified[CATALOG_MAX_VALIDATOR];
+    mtx_lock(&catalog->mutex);
+    memcpy(etag, catalog->etag, CATALOG_MAX_VALIDATOR);
+    memcpy(last_modified, catalog->last_modified, CATALOG_MAX_VALIDATOR);
+    catalog->fetches++;
+    mtx_unlock(&catalog->mutex);
+    http_response_t response = {};
+    if (!http_get(url, etag, last_modified, timeout_ms > 0 ? timeout_ms : CATALOG_DEFAULT_TIMEOUT_MS, cancel, &response)) {
+        return is_cancelled(cancel) ? CATALOG_CANCELLED : CATALOG_FAILED;
+    }
+    if (response.status == 304) {
+        free(response.body);
+        mtx_lock(&catalog->mutex);
+        catalog->unchanged++;
+        mtx_unlock(&catalog->mutex);
+        return CATALOG_UNCHANGED;
+    }
+    bool is_delta = false;
+    catalog_change_t* changes = NULL;
+    int change_count = response.status == 200 ? parse_body(response.body, &is_delta, &changes) : -1;
+    free(response.body);
+    if (change_count < 0) {
+        free(changes);
+        return CATALOG_FAILED;
+    }
+    mtx_lock(&catalog->mutex);
+    // a delta only applies to the table whose ETag was sent
+    bool is_applicable = !is_delta || strcmp(etag, catalog->etag) == 0;
+    int count = 0;
+    nordi_catalog_server_t* servers =
+        is_applicable ? merge_changes(catalog->servers, is_delta ? catalog->count : 0, changes, change_count, &count) : NULL;
+    free(changes);
+    if (servers == NULL) {
+        mtx_unlock(&catalog->mutex);
+        return CATALOG_FAILED;
+    }
+    if (catalog->servers != NULL) {
+        nordi_resources_release(RESOURCE_CATALOG, catalog->count * sizeof(nordi_catalog_server_t));
+    }
+    free(catalog->servers);
+    catalog->servers = servers;
+    catalog->count = count;
+    nordi_resources_alloc(RESOURCE_CATALOG, count * sizeof(nordi_catalog_server_t));
+    catalog->revision++;
+    memcpy(catalog->etag, response.etag, CATALOG_MAX_VALIDATOR);
+    memcpy(catalog->last_modified, response.last_modified, CATALOG_MAX_VALIDATOR);
+    catalog_save(catalog);
+    mtx_unlock(&catalog->mutex);
+    return is_delta ? CATALOG_DELTA : CATALOG_FULL;
+}
+
+bool
+nordi_catalog_find(nordi_catalog_ptr catalog, const char* name, nordi_catalog_server_ptr server) {
+    if (catalog == NULL || name == NULL) {
+        return false;
+    }
+    mtx_lock(&catalog->mutex);
+    int low = 0, high = catalog->count;
+    while (low < high) {
+        int middle = (low + high) / 2;
+        if (strncmp(catalog->servers[middle].name, name, CATALOG_MAX_SERVER) < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    bool is_found = low < catalog->count && strncmp(catalog->servers[low].name, name, CATALOG_MAX_SERVER) == 0;
+    if (is_found) {
+        *server = catalog->servers[low];
+    }
+    mtx_unlock(&catalog->mutex);
+    return is_found;
+}
+
+int
+nordi_catalog_least_loaded(nordi_catalog_ptr catalog, int country, uint32_t features, nordi_catalog_server_ptr servers,
+                           int max) {
+    if (catalog == NULL || max <= 0) {
+        return 0;
+    }
+    int found = 0;
+    mtx_lock(&catalog->mutex);
+    for (int index = 0; index < catalog->count; index++) {
+        const nordi_catalog_server_t* server = &catalog->servers[index];
+        if ((country >= 0 && server->country != country) || (server->features & features) != features) {
+            continue;
+        }
+        if (found == max && server->load >= servers[max - 1].load) {
+            continue;
+        }
+        // insertion into the few kept so far
+        int position = found < max ? found++ : max - 1;
+        for (; position > 0 && servers[position - 1].load > server->load; position--) {
+            servers[position] = servers[position - 1];
+        }
+        servers[position] = *server;
+    }
+    mtx_unlock(&catalog->mutex);
+    return found;
+}
+
+void
+nordi_catalog_close(nordi_catalog_ptr catalog) {
+    if (catalog == NULL) {
+        return;
+    }
+    mtx_destroy(&catalog->mutex);
+    if (catalog->servers != NULL) {
+        nordi_resources_release(RESOURCE_CATALOG, catalog->count * sizeof(nordi_catalog_server_t));
+    }
+    free(catalog->servers);
+    free(catalog);
+    nordi_resources_release(RESOURCE_CATALOG, sizeof(nordi_catalog_t));
+}
@@ -0,0 +1,302 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "nordi_dns.h"
+#include "nordi_probe.h"
+
+#define HEADER_LENGTH    12
+#define MAX_LABEL_LENGTH 63
+#define CLASS_IN         1
+#define FLAG_RESPONSE    0x80 // first flags byte
+#define FLAG_RECURSION   0x01 // first flags byte
+
+const nordi_dns_options_t DNS_DEFAULT_OPTIONS = {
+    .names = NULL,
+    .name_count = 0,
+    .repetitions = DNS_DEFAULT_REPETITIONS,
+    .interval_ms = DNS_DEFAULT_INTERVAL_MS,
+    .timeout_ms = DNS_DEFAULT_TIMEOUT_MS,
+};
+
+typedef struct {
+    struct sockaddr_in address;
+    bool is_resolved;
+} resolver_t;
+
+typedef struct {
+    long long sent_us;
+    unsigned int rtt_us;
+    bool is_answered;
+} query_t;
+
+static long long
+now_us() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+int
+nordi_dns_build_query(unsigned char* query, size_t size, uint16_t id, const char* name, uint16_t type) {
+    if (size < HEADER_LENGTH) {
+        return -1;
+    }
+    memset(query, 0, HEADER_LENGTH);
+    query[0] = id >> 8;
+    query[1] = id & 0xff;
+    query[2] = FLAG_RECURSION;
+    query[5] = 1; // one question
+    size_t length = HEADER_LENGTH;
+    while (*name != '\0') {
+        size_t label = strcspn(name, ".");
+        // labels, their length bytes, the root label, the type and the class must fit
+        if (label == 0 || label > MAX_LABEL_LENGTH || length + 1 + label + 5 > size) {
+            return -1;
+        }
+        query[length++] = (unsigned char)label;
+        memcpy(query + length, name, label);
+        length += label;
+        name += label;
+        if (*name == '.') {
+            name++;
+        }
+    }
+    if (length + 5 > size) {
+        return -1;
+    }
+    query[length++] = 0; // root label
+    query[length++] = type >> 8;
+    query[length++] = type & 0xff;
+    query[length++] = 0;
+    query[length++] = CLASS_IN;
+    return (int)length;
+}
+
+static bool
+resolve(str target, resolver_t* resolver) {
+    struct addrinfo* addresses = nordi_probe_resolve(target, PROBE_UDP, DNS_PORT);
+    resolver->is_resolved = false;
+    for (struct addrinfo* address = addresses; address != NULL; address = address->ai_next) {
+        // the daemon only takes IPv4 resolvers
+        if (address->ai_family == AF_INET) {
+            memcpy(&resolver->address, address->ai_addr, sizeof(struct sockaddr_in));
+            resolver->is_resolved = true;
+            break;
+        }
+    }
+    if (addresses != NULL) {
+        freeaddrinfo(addresses);
+    }
+    return resolver->is_resolved;
+}
+
+static int
+send_round(int sock, int round, const resolver_t* resolvers, query_t* queries, int count,
+           nordi_dns_options_ptr options) {
+    unsigned char query[DNS_MAX_MESSAGE];
+    int names = options->name_count > 0 ? options->name_count : 1, sent = 0;
+    for (int name = 0; name < names; name++) {
+        const char* asked = options->name_count > 0 ? options->names[name] : "";
+        uint16_t type = options->name_count > 0 ? DNS_TYPE_A : DNS_TYPE_NS;
+        for (int index = 0; index < count; index++) {
+            // the ID is the query index, so replies map straight back to their query
+            int id = (round * names + name) * count + index;
+            int length = nordi_dns_build_query(query, sizeof(query), (uint16_t)id, asked, type);
+            if (!resolvers[index].is_resolved || length < 0) {
+                continue;
+            }
+            queries[id].sent_us = now_us();
+            // a failed send is just a lost query
+            sendto(sock, query, length, 0, (const struct sockaddr*)&resolvers[index].address,
+                   sizeof(struct sockaddr_in));
+            sent++;
+        }
+    }
+    return sent;
+}
+
+static int
+receive_replies(int sock, const resolver_t* resolvers, query_t* queries, int count, int total, int timeout_ms) {
+    unsigned char reply[DNS_MAX_MESSAGE];
+    struct sockaddr_in source;
+    socklen_t source_length = sizeof(source);
+    ssize_t received;
+    int answered = 0;
+    while ((received = recvfrom(sock, reply, sizeof(reply), MSG_DONTWAIT, (struct sockaddr*)&source,
+                                &source_length)) >= 0) {
+        source_length = sizeof(source);
+        if (received < HEADER_LENGTH || !(reply[2] & FLAG_RESPONSE)) {
+            continue;
+        }
+        int id = ((int)reply[0] << 8) | reply[1];
+        if (id >= total) {
+            continue;
+        }
+        // only the resolver asked may answer, anything else is a stray or spoofed reply
+        const struct sockaddr_in* asked = &resolvers[id % count].address;
+        if (source.sin_addr.s_addr != asked->sin_addr.s_addr || source.sin_port != asked->sin_port) {
+            continue;
+        }
+        query_t* query = &queries[id];
+        long long rtt = now_us() - query->sent_us;
+        // late answers were already counted as lost, keep them that way
+        if (query->sent_us > 0 && !query->is_answered && rtt <= timeout_ms * 1000LL) {
+            query->rtt_us = (unsigned int)rtt;
+            query->is_answered = true;
+            answered++;
+        }
+    }
+    return answered;
+}
+
+static int
+compare_rtt(const void* left, const void* right) {
+    unsigned int a = *(const unsigned int*)left, b = *(const unsigned int*)right;
+    return a < b ? -1 : a > b;
+}
+
+static void
+summarize(nordi_dns_result_ptr result, int index, const query_t* queries, int count, int total,
+          unsigned int* rtts) {
+    result->sent = 0;
+    result->answered = 0;
+    result->p50_us = 0;
+    result->p95_us = 0;
+    for (int id = index; id < total; id += count) {
+        result->sent++;
+        if (queries[id].is_answered) {
+            rtts[result->answered++] = queries[id].rtt_us;
+        }
+    }
+    result->loss = result->sent > 0 ? 100.0f * (result->sent - result->answered) / result->sent : 100.0f;
+    if (result->answered == 0) {
+        return;
+    }
+    qsort(rtts, result->answered, sizeof(unsigned int), compare_rtt);
+    // nearest rank percentiles
+    result->p50_us = rtts[(result->answered * 50 + 99) / 100 - 1];
+    result->p95_us = rtts[(result->answered * 95 + 99) / 100 - 1];
+}
+
+int
+nordi_dns_benchmark(nordi_dns_result_ptr results, int count, nordi_dns_options_ptr options) {
+    if (options == NULL) {
+        options = &DNS_DEFAULT_OPTIONS;
+    }
+    int names = options->name_count > 0 ? options->name_count : 1;
+    int rounds = options->repetitions > 0 ? options->repetitions : 1;
+    if (count <= 0) {
+        return -1;
+    }
+    // every query needs its own ID
+    if (rounds * names * count > DNS_MAX_QUERIES) {
+        rounds = DNS_MAX_QUERIES / (names * count);
+        if (rounds == 0) {
+            return -1;
+        }
+    }
+    int total = rounds * names * count;
+    resolver_t* resolvers = calloc(count, sizeof(resolver_t));
+    query_t* queries = calloc(total, sizeof(query_t));
+    unsigned int* rtts = calloc(rounds * names, sizeof(unsigned int));
+    int sock = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (resolvers == NULL || queries == NULL || rtts == NULL || sock < 0) {
+        free(resolvers);
+        free(queries);
+        free(rtts);
+        if (sock >= 0) {
+            close(sock);
+        }
+        return -1;
+    }
+    for (int index = 0; index < count; index++) {
+        resolve(results[index].resolver, &resolvers[index]);
+    }
+    long long interval_us = options->interval_ms * 1000LL, timeout_us = options->timeout_ms * 1000LL;
+    long long next_us = now_us(), last_us = next_us;
+    int round = 0, outstanding = 0;
+    struct pollfd fds = {.fd = sock, .events = POLLIN};
+    while (true) {
+        long long now = now_us();
+        if (round < rounds && now >= next_us) {
+            outstanding += send_round(sock, round++, resolvers, queries, count, options);
+            last_us = now;
+            next_us += interval_us;
+        }
+        // nothing left to wait for once every query was answered
+        if (round == rounds && (outstanding == 0 || now >= last_us + timeout_us)) {
+            break;
+        }
+        long long wait_us = round < rounds ? next_us - now : last_us + timeout_us - now;
+        if (wait_us < 0) {
+            wait_us = 0;
+        }
+        if (poll(&fds, 1, (int)((wait_us + 999) / 1000)) > 0) {
+            outstanding -= receive_replies(sock, resolvers, queries, count, total, options->timeout_ms);
+        }
+    }
+    close(sock);
+    for (int index = 0; index < count; index++) {
+        summarize(&results[index], index, queries, count, total, rtts);
+    }
+    free(resolvers);
+    free(queries);
+    free(rtts);
+    return nordi_dns_best(results, count);
+}
+
+int
+nordi_dns_best(const nordi_dns_result_t* results, int count) {
+    int best = -1;
+    for (int index = 0; index < count; index++) {
+        const nordi_dns_result_t* result = &results[index];
+        if (result->answered == 0) {
+            continue;
+        }
+        if (best < 0 || result->loss < results[best].loss
+            || (result->loss == results[best].loss && result->p50_us < results[best].p50_us)) {
+            best = index;
+        }
+    }
+    return best;
+}
+
+nordvpn_error_t
+nordi_dns_apply(const nordi_dns_result_t* result) {
+    const char* resolver = str_ptr(result->resolver);
+    if (*resolver == '\0') {
+        return UNKNOWN_ERROR;
+    }
+    nordvpn_error_t error = OK;
+    if (!nordvpn_get_settings()->is_known) {
+        error = nordvpn_read_settings();
+        if (error != OK) {
+            return error;
+        }
+    }
+    nordvpn_settings_t desired = {.protocol = str_null, .dns = str_null, .allowlist = str_null};
+    nordvpn_lock_state();
+    nordvpn_copy_settings(&desired, nordvpn_get_settings());
+    nordvpn_unlock_state();
+    // the daemon takes the bare address, and refuses a custom DNS while threat protection is on
+    str_cpy(&desired.dns, str_ref_chars(resolver, strcspn(resolver, ":")));
+    desired.threat_protection = false;
+    error = nordvpn_apply_settings(&desired);
+    nordvpn_clear_settings(&desired);
+    return error;
+}
@@ -0,0 +1,226 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#include <gtk/gtk.h>
+#include <stdbool.h>
+#include <string.h>
+#include "nordi_entries.h"
+#include "nordi_search.h"
+
+struct _nordi_entries_t {
+    GObject parent;
+    GPtrArray* labels; // owned strings
+    GPtrArray* nodes;  // owned strings, or NULL
+    GPtrArray* items;  // the GtkStringObject of each entry once a view asked for it, or NULL
+    nordi_search_ptr search;
+    char query[SEARCH_MAX_QUERY];
+    int* visible; // the entries shown, ascending, a copy as the search reuses its result for the next query
+    int visible_count;
+    uint64_t* allowed; // bitmap of the entries from allowed_from on that may show, NULL if every entry may
+    int allowed_from;
+    int allowed_count;
+};
+
+static void nordi_entries_list_model_init(GListModelInterface*);
+
+G_DEFINE_TYPE_WITH_CODE(nordi_entries_t, nordi_entries, G_TYPE_OBJECT,
+                        G_IMPLEMENT_INTERFACE(G_TYPE_LIST_MODEL, nordi_entries_list_model_init));
+
+static GType
+nordi_entries_get_item_type(GListModel* model) {
+    return GTK_TYPE_STRING_OBJECT;
+}
+
+static guint
+nordi_entries_get_n_items(GListModel* model) {
+    return (guint)NORDI_ENTRIES(model)->visible_count;
+}
+
+// The same item for an entry across searches, so a selection moved by a search stays on it
+static gpointer
+nordi_entries_get_item(GListModel* model, guint position) {
+    nordi_entries_ptr entries = NORDI_ENTRIES(model);
+    int entry = nordi_entries_entry_at(entries, position);
+    if (entry < 0) {
+        return NULL;
+    }
+    if (g_ptr_array_index(entries->items, entry) == NULL) {
+        g_ptr_array_index(entries->items, entry) = gtk_string_object_new(g_ptr_array_index(entries->labels, entry));
+    }
+    return g_object_ref(g_ptr_array_index(entries->items, entry));
+}
+
+static void
+nordi_entries_list_model_init(GListModelInterface* interface) {
+    interface->get_item_type = nordi_entries_get_item_type;
+    interface->get_n_items = nordi_entries_get_n_items;
+    interface->get_item = nordi_entries_get_item;
+}
+
+static void
+nordi_entries_free_item(gpointer item) {
+    if (item != NULL) {
+        g_object_unref(item);
+    }
+}
+
+// Position of the first of the ascending entries at or after the given one
+static int
+nordi_entries_lower_bound(const int* visible, int count, int entry) {
+    int low = 0, high = count;
+    while (low < high) {
+        int middle = (low + high) / 2;
+        if (visible[middle] < entry) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+// Whether the restriction lets an entry show
+static bool
+nordi_entries_is_allowed(nordi_entries_ptr entries, int entry) {
+    if (entries->allowed == NULL || entry < entries->allowed_from) {
+        return true;
+    }
+    int bit = entry - entries->allowed_from;
+    return bit < entries->allowed_count && (entries->allowed[bit / 64] >> (bit % 64) & 1);
+}
+
+// Search again, telling the views only about the rows between the ones kept at both ends. The rows of the entries
+// from `replaced` on change even where the same entries still match.
+static void
+nordi_entries_refresh(nordi_entries_ptr entries, int replaced) {
+    const int* found = NULL;
+    int found_count = nordi_search_query(entries->search, entries->query, &found);
+    // the matches of the search the restriction lets through, still ascending
+    int* matches = g_new(int, found_count + 1);
+    int count = 0;
+    for (int index = 0; index < found_count; index++) {
+        if (nordi_entries_is_allowed(entries, found[index])) {
+            matches[count++] = found[index];
+        }
+    }
+    int removed = 0, added = 0;
+    int position =
+        nordi_search_changed_range(entries->visible, entries->visible_count, matches, count, &removed, &added);
+    int first_replaced = nordi_entries_lower_bound(matches, count, replaced);
+    int previous_replaced = nordi_entries_lower_bound(entries->visible, entries->visible_count, replaced);
+    if (count > first_replaced || previous_replaced < entries->visible_count) {
+        // the entries before the replaced ones match as before, so the replaced ones start at the same position
+        position = MIN(position, first_replaced);
+        removed = entries->visible_count - position;
+        added = count - position;
+    }
+    g_free(entries->visible);
+    entries->visible = matches;
+    entries->visible_count = count;
+    if (removed > 0 || added > 0) {
+        g_list_model_items_changed(G_LIST_MODEL(entries), (guint)position, (guint)removed, (guint)added);
+    }
+}
+
+static void
+nordi_entries_init(nordi_entries_ptr entries) {
+    entries->labels = g_ptr_array_new_with_free_func(g_free);
+    entries->nodes = g_ptr_array_new_with_free_func(g_free);
+    entries->items = g_ptr_array_new_with_free_func(nordi_entries_free_item);
+    entries->search = nordi_search_new();
+}
+
+static void
+nordi_entries_finalize(GObject* object) {
+    nordi_entries_ptr entries = NORDI_ENTRIES(object);
+    g_ptr_array_unref(entries->labels);
+    g_ptr_array_unref(entries->nodes);
+    g_ptr_array_unref(entries->items);
+    g_free(entries->visible);
+    g_free(entries->allowed);
+    nordi_search_free(entries->search);
+    G_OBJECT_CLASS(nordi_entries_parent_class)->finalize(object);
+}
+
+static void
+nordi_entries_class_init(nordi_entries_tClass* class) {
+    G_OBJECT_CLASS(class)->finalize = nordi_entries_finalize;
+}
+
+nordi_entries_ptr
+nordi_entries_new() {
+    return g_object_new(NORDI_ENTRIES_TYPE, NULL);
+}
+
+void
+nordi_entries_splice(nordi_entries_ptr entries, int from, const char* const* labels, const char* const* nodes, int count) {
+    from = CLAMP(from, 0, (int)entries->labels->len);
+    g_ptr_array_set_size(entries->labels, from);
+    g_ptr_array_set_size(entries->nodes, from);
+    g_ptr_array_set_size(entries->items, from);
+    for (int index = 0; index < count; index++) {
+        g_ptr_array_add(entries->labels, g_strdup(labels[index]));
+        g_ptr_array_add(entries->nodes, g_strdup(nodes[index]));
+    }
+    g_ptr_array_set_size(entries->items, from + count);
+    // the bits were for the entries before
+    g_clear_pointer(&entries->allowed, g_free);
+    // the index can't drop texts, so it is built again, in a few milliseconds for thousands of servers
+    nordi_search_free(entries->search);
+    entries->search = nordi_search_new();
+    for (guint entry = 0; entry < entries->labels->len; entry++) {
+        nordi_search_add(entries->search, g_ptr_array_index(entries->labels, entry));
+    }
+    nordi_entries_refresh(entries, from);
+}
+
+void
+nordi_entries_search(nordi_entries_ptr entries, const char* query) {
+    g_strlcpy(entries->query, query != NULL ? query : "", SEARCH_MAX_QUERY);
+    nordi_entries_refresh(entries, G_MAXINT);
+}
+
+void
+nordi_entries_restrict(nordi_entries_ptr entries, int from, const uint64_t* allowed, int count) {
+    g_clear_pointer(&entries->allowed, g_free);
+    if (allowed != NULL) {
+        int words = (count + 63) / 64;
+        // never NULL, even for no bits, as that would lift the restriction
+        entries->allowed = g_new0(uint64_t, words + 1);
+        memcpy(entries->allowed, allowed, words * sizeof(uint64_t));
+        entries->allowed_from = from;
+        entries->allowed_count = count;
+    }
+    nordi_entries_refresh(entries, G_MAXINT);
+}
+
+int
+nordi_entries_entry_at(nordi_entries_ptr entries, guint position) {
+    return position < (guint)entries->visible_count ? entries->visible[position] : -1;
+}
+
+guint
+nordi_entries_position_of(nordi_entries_ptr entries, int entry) {
+    int low = nordi_entries_lower_bound(entries->visible, entries->visible_count, entry);
+    return low < entries->visible_count && entries->visible[low] == entry ? (guint)low : GTK_INVALID_LIST_POSITION;
+}
+
+const char*
+nordi_entries_node(nordi_entries_ptr entries, int entry) {
+    return entry >= 0 && entry < (int)entries->nodes->len ? g_ptr_array_index(entries->nodes, entry) : NULL;
+}
+
+int
+nordi_entries_find(nordi_entries_ptr entries, const char* node) {
+    for (guint entry = 0; node != NULL && entry < entries->nodes->len; entry++) {
+        const char* other = g_ptr_array_index(entries->nodes, entry);
+        if (other != NULL && strcmp(other, node) == 0) {
+            return (int)entry;
+        }
+    }
+    return -1;
+}
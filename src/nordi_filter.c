@@ -0,0 +1,225 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "nordi_filter.h"
+#include "nordvpn_server.h"
+
+#define COUNTRY_ROW(country) (FILTER_FEATURE_COUNT + FILTER_TECHNOLOGY_COUNT + (country))
+#define GROUP_ROW(group)     (COUNTRY_ROW(COUNTRY_COUNT) + (group))
+#define ROW_COUNT            GROUP_ROW(GROUP_COUNT)
+
+// The region group a country is listed under, the rest are European
+static nordvpn_group_t
+region_of(int country) {
+    switch (country) {
+    case ARGENTINA:
+    case BRAZIL:
+    case CANADA:
+    case CHILE:
+    case COLOMBIA:
+    case COSTA_RICA:
+    case MEXICO:
+    case UNITED_STATES:
+        return THE_AMERICAS;
+    case AUSTRALIA:
+    case HONG_KONG:
+    case INDONESIA:
+    case JAPAN:
+    case MALAYSIA:
+    case NEW_ZELAND:
+    case SINGAPORE:
+    case SOUTH_KOREA:
+    case TAIWAN:
+    case THAILAND:
+    case VIETNAM:
+        return ASIA_PACIFIC;
+    case ISRAEL:
+    case SOUTH_AFRICA:
+        return AFRICA_MID_EAST_INDIA;
+    default:
+        return EUROPE;
+    }
+}
+
+static uint64_t*
+row_of(nordi_filter_ptr filter, int row) {
+    return filter->bitmaps + (size_t)row * filter->words;
+}
+
+static void
+set_bit(nordi_filter_ptr filter, int row, int server) {
+    row_of(filter, row)[server / FILTER_WORD_BITS] |= 1ull << (server % FILTER_WORD_BITS);
+}
+
+// The bitmap loops stay this plain so the compiler can vectorize them
+static void
+and_row(uint64_t* restrict result, const uint64_t* restrict row, int words) {
+    for (int word = 0; word < words; word++) {
+        result[word] &= row[word];
+    }
+}
+
+static void
+or_row(uint64_t* restrict result, const uint64_t* restrict row, int words) {
+    for (int word = 0; word < words; word++) {
+        result[word] |= row[word];
+    }
+}
+
+// AND the result with the union of the rows picked by a mask, nothing to do for an empty mask
+static void
+and_any(nordi_filter_ptr filter, uint64_t* result, uint64_t mask, int first_row, int row_count) {
+    if (mask == 0) {
+        return;
+    }
+    memset(filter->scratch, 0, filter->words * sizeof(uint64_t));
+    for (int row = 0; row < row_count && row < FILTER_WORD_BITS; row++) {
+        if (mask & (1ull << row)) {
+            or_row(filter->scratch, row_of(filter, first_row + row), filter->words);
+        }
+    }
+    and_row(result, filter->scratch, filter->words);
+}
+
+nordi_filter_ptr
+nordi_filter_new(const nordi_catalog_server_t* servers, int count) {
+    nordi_filter_ptr filter = (nordi_filter_ptr)calloc(1, sizeof(nordi_filter_t));
+    if (filter == NULL) {
+        return NULL;
+    }
+    filter->count = count > 0 ? count : 0;
+    filter->words = (filter->count + FILTER_WORD_BITS - 1) / FILTER_WORD_BITS;
+    filter->names = calloc(filter->count + 1, CATALOG_MAX_SERVER);
+    filter->loads = (uint8_t*)calloc(filter->count + 1, sizeof(uint8_t));
+    filter->bitmaps = (uint64_t*)calloc((size_t)ROW_COUNT * filter->words + 1, sizeof(uint64_t));
+    filter->scratch = (uint64_t*)calloc(filter->words + 1, sizeof(uint64_t));
+    if (filter->names == NULL || filter->loads == NULL || filter->bitmaps == NULL || filter->scratch == NULL) {
+        nordi_filter_free(filter);
+        return NULL;
+    }
+    for (int server = 0; server < filter->count; server++) {
+        const nordi_catalog_server_t* entry = &servers[server];
+        memcpy(filter->names[server], entry->name, CATALOG_MAX_SERVER);
+        filter->loads[server] = entry->load;
+        for (int feature = 0; feature < FILTER_FEATURE_COUNT; feature++) {
+            if (entry->features & (1u << feature)) {
+                set_bit(filter, feature, server);
+            }
+        }
+        for (int technology = 0; technology < FILTER_TECHNOLOGY_COUNT; technology++) {
+            if (entry->technologies & (1u << technology)) {
+                set_bit(filter, FILTER_FEATURE_COUNT + technology, server);
+            }
+        }
+        if (entry->country >= 0 && entry->country < COUNTRY_COUNT) {
+            set_bit(filter, COUNTRY_ROW(entry->country), server);
+            set_bit(filter, GROUP_ROW(region_of(entry->country)), server);
+        }
+        // the feature groups
+        if (entry->features & FEATURE_STANDARD) {
+            set_bit(filter, GROUP_ROW(STANDARD_SERVERS), server);
+        }
+        if (entry->features & FEATURE_P2P) {
+            set_bit(filter, GROUP_ROW(P2P), server);
+        }
+        if (entry->features & FEATURE_DOUBLE_VPN) {
+            set_bit(filter, GROUP_ROW(DOUBLE_VPN), server);
+        }
+        if (entry->features & FEATURE_ONION) {
+            set_bit(filter, GROUP_ROW(ONION_OVER_VPN), server);
+        }
+    }
+    return filter;
+}
+
+nordi_filter_ptr
+nordi_filter_from_catalog(nordi_catalog_ptr catalog) {
+    if (catalog == NULL) {
+        return NULL;
+    }
+    mtx_lock(&catalog->mutex);
+    nordi_filter_ptr filter = nordi_filter_new(catalog->servers, catalog->count);
+    mtx_unlock(&catalog->mutex);
+    return filter;
+}
+
+int
+nordi_filter_apply(nordi_filter_ptr filter, nordi_filter_query_ptr query, uint64_t* result) {
+    if (filter == NULL || filter->words == 0) {
+        return 0;
+    }
+    memset(result, 0xff, filter->words * sizeof(uint64_t));
+    if (filter->count % FILTER_WORD_BITS != 0) {
+        result[filter->words - 1] = (1ull << (filter->count % FILTER_WORD_BITS)) - 1;
+    }
+    for (int feature = 0; feature < FILTER_FEATURE_COUNT; feature++) {
+        if (query->features & (1u << feature)) {
+            and_row(result, row_of(filter, feature), filter->words);
+        }
+    }
+    for (int technology = 0; technology < FILTER_TECHNOLOGY_COUNT; technology++) {
+        if (query->technologies & (1u << technology)) {
+            and_row(result, row_of(filter, FILTER_FEATURE_COUNT + technology), filter->words);
+        }
+    }
+    and_any(filter, result, query->countries, COUNTRY_ROW(0), COUNTRY_COUNT);
+    and_any(filter, result, query->groups, GROUP_ROW(0), GROUP_COUNT);
+    int matches = 0;
+    for (int word = 0; word < filter->words; word++) {
+        matches += __builtin_popcountll(result[word]);
+    }
+    return matches;
+}
+
+int
+nordi_filter_next(nordi_filter_ptr filter, const uint64_t* result, int from) {
+    if (filter == NULL || from < 0 || from >= filter->count) {
+        return -1;
+    }
+    int word = from / FILTER_WORD_BITS;
+    uint64_t bits = result[word] & (~0ull << (from % FILTER_WORD_BITS));
+    while (bits == 0) {
+        if (++word == filter->words) {
+            return -1;
+        }
+        bits = result[word];
+    }
+    return word * FILTER_WORD_BITS + __builtin_ctzll(bits);
+}
+
+int
+nordi_filter_least_loaded(nordi_filter_ptr filter, const uint64_t* result, int* servers, int max) {
+    if (max <= 0) {
+        return 0;
+    }
+    int found = 0;
+    for (int server = nordi_filter_next(filter, result, 0); server >= 0; server = nordi_filter_next(filter, result, server + 1)) {
+        if (found == max && filter->loads[server] >= filter->loads[servers[max - 1]]) {
+            continue;
+        }
+        int position = found < max ? found++ : max - 1;
+        for (; position > 0 && filter->loads[servers[position - 1]] > filter->loads[server]; position--) {
+            servers[position] = servers[position - 1];
+        }
+        servers[position] = server;
+    }
+    return found;
+}
+
+void
+nordi_filter_free(nordi_filter_ptr filter) {
+    if (filter == NULL) {
+        return;
+    }
+    free(filter->names);
+    free(filter->loads);
+    free(filter->bitmaps);
+    free(filter->scratch);
+    free(filter);
+}
@@ -0,0 +1,263 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nordi_geo.h"
+
+#define DIMENSIONS 3
+#define MICRO      1e-6
+#define RADIANS    (3.14159265358979323846 / 180.0)
+
+static void
+to_position(double latitude, double longitude, double* position) {
+    double phi = latitude * RADIANS, lambda = longitude * RADIANS;
+    position[0] = cos(phi) * cos(lambda);
+    position[1] = cos(phi) * sin(lambda);
+    position[2] = sin(phi);
+}
+
+static double
+chord_squared(const double* left, const double* right) {
+    double sum = 0;
+    for (int axis = 0; axis < DIMENSIONS; axis++) {
+        sum += (left[axis] - right[axis]) * (left[axis] - right[axis]);
+    }
+    return sum;
+}
+
+static void
+swap_points(nordi_geo_point_t* left, nordi_geo_point_t* right) {
+    nordi_geo_point_t swapped = *left;
+    *left = *right;
+    *right = swapped;
+}
+
+// Partially order the range so the point at nth has every lesser point of the axis before it, greater after it
+static void
+select_nth(nordi_geo_point_t* points, int low, int high, int nth, int axis) {
+    while (high - low > 1) {
+        // median of three keeps sorted input linear
+        int middle = low + (high - low) / 2;
+        if (points[middle].position[axis] < points[low].position[axis]) {
+            swap_points(&points[middle], &points[low]);
+        }
+        if (points[high - 1].position[axis] < points[low].position[axis]) {
+            swap_points(&points[high - 1], &points[low]);
+        }
+        if (points[high - 1].position[axis] < points[middle].position[axis]) {
+            swap_points(&points[high - 1], &points[middle]);
+        }
+        swap_points(&points[middle], &points[high - 1]);
+        double pivot = points[high - 1].position[axis];
+        int store = low;
+        for (int index = low; index < high - 1; index++) {
+            if (points[index].position[axis] < pivot) {
+                swap_points(&points[index], &points[store++]);
+            }
+        }
+        swap_points(&points[store], &points[high - 1]);
+        if (store == nth) {
+            return;
+        }
+        if (nth < store) {
+            high = store;
+        } else {
+            low = store + 1;
+        }
+    }
+}
+
+static void
+build_tree(nordi_geo_point_t* points, int low, int high, int depth) {
+    while (high - low > 1) {
+        int middle = low + (high - low) / 2;
+        select_nth(points, low, high, middle, depth % DIMENSIONS);
+        build_tree(points, low, middle, depth + 1);
+        low = middle + 1;
+        depth++;
+    }
+}
+
+// Restore the max heap of results, ordered by the squared chord kept in distance_km while searching
+static void
+sift_down(nordi_geo_result_ptr heap, int size, int index) {
+    while (true) {
+        int largest = index, left = 2 * index + 1, right = left + 1;
+        if (left < size && heap[left].distance_km > heap[largest].distance_km) {
+            largest = left;
+        }
+        if (right < size && heap[right].distance_km > heap[largest].distance_km) {
+            largest = right;
+        }
+        if (largest == index) {
+            return;
+        }
+        nordi_geo_result_t swapped = heap[index];
+        heap[index] = heap[largest];
+        heap[largest] = swapped;
+        index = largest;
+    }
+}
+
+static void
+sift_up(nordi_geo_result_ptr heap, int index) {
+    while (index > 0 && heap[(index - 1) / 2].distance_km < heap[index].distance_km) {
+        nordi_geo_result_t swapped = heap[index];
+        heap[index] = heap[(index - 1) / 2];
+        heap[(index - 1) / 2] = swapped;
+        index = (index - 1) / 2;
+    }
+}
+
+static void
+search_tree(const nordi_geo_point_t* points, int low, int high, int depth, const double* query, nordi_geo_result_ptr heap,
+            int* size, int max) {
+    if (low >= high) {
+        return;
+    }
+    int middle = low + (high - low) / 2, axis = depth % DIMENSIONS;
+    double distance = chord_squared(query, points[middle].position);
+    if (*size < max) {
+        heap[*size] = (nordi_geo_result_t){.name = points[middle].name, .distance_km = distance};
+        sift_up(heap, (*size)++);
+    } else if (distance < heap[0].distance_km) {
+        heap[0] = (nordi_geo_result_t){.name = points[middle].name, .distance_km = distance};
+        sift_down(heap, *size, 0);
+    }
+    double offset = query[axis] - points[middle].position[axis];
+    bool is_left_near = offset < 0;
+    search_tree(points, is_left_near ? low : middle + 1, is_left_near ? middle : high, depth + 1, query, heap, size, max);
+    // the far side can only hold nearer points if the splitting plane is nearer than the worst kept
+    if (*size < max || offset * offset < heap[0].distance_km) {
+        search_tree(points, is_left_near ? middle + 1 : low, is_left_near ? high : middle, depth + 1, query, heap, size, max);
+    }
+}
+
+// Parse a decimal number of degrees, advancing the text past it
+static bool
+parse_degrees(const char** text, double* degrees) {
+    const char* cursor = *text;
+    while (*cursor == ' ') {
+        cursor++;
+    }
+    bool is_negative = *cursor == '-';
+    cursor += is_negative || *cursor == '+';
+    const char* digits = cursor;
+    double value = 0;
+    for (; *cursor >= '0' && *cursor <= '9'; cursor++) {
+        value = value * 10 + (*cursor - '0');
+    }
+    if (*cursor == '.') {
+        double scale = 0.1;
+        for (cursor++; *cursor >= '0' && *cursor <= '9'; cursor++, scale /= 10) {
+            value += (*cursor - '0') * scale;
+        }
+    }
+    if (cursor == digits || (cursor == digits + 1 && *digits == '.')) {
+        return false;
+    }
+    while (*cursor == ' ') {
+        cursor++;
+    }
+    *degrees = is_negative ? -value : value;
+    *text = cursor;
+    return true;
+}
+
+nordi_geo_ptr
+nordi_geo_new(const nordi_catalog_server_t* servers, int count) {
+    nordi_geo_ptr geo = (nordi_geo_ptr)calloc(1, sizeof(nordi_geo_t));
+    if (geo == NULL) {
+        return NULL;
+    }
+    count = count > 0 ? count : 0;
+    geo->points = (nordi_geo_point_t*)malloc((count + 1) * sizeof(nordi_geo_point_t));
+    if (geo->points == NULL) {
+        free(geo);
+        return NULL;
+    }
+    for (int index = 0; index < count; index++) {
+        nordi_geo_point_t* point = &geo->points[index];
+        memcpy(point->name, servers[index].name, CATALOG_MAX_SERVER);
+        point->latitude = servers[index].latitude_e6 * MICRO;
+        point->longitude = servers[index].longitude_e6 * MICRO;
+        to_position(point->latitude, point->longitude, point->position);
+    }
+    geo->count = count;
+    build_tree(geo->points, 0, count, 0);
+    return geo;
+}
+
+nordi_geo_ptr
+nordi_geo_from_catalog(nordi_catalog_ptr catalog) {
+    if (catalog == NULL) {
+        return NULL;
+    }
+    mtx_lock(&catalog->mutex);
+    nordi_geo_ptr geo = nordi_geo_new(catalog->servers, catalog->count);
+    mtx_unlock(&catalog->mutex);
+    return geo;
+}
+
+int
+nordi_geo_nearest(nordi_geo_ptr geo, double latitude, double longitude, nordi_geo_result_ptr results, int max) {
+    if (geo == NULL || max <= 0) {
+        return 0;
+    }
+    double query[DIMENSIONS];
+    to_position(latitude, longitude, query);
+    int size = 0;
+    search_tree(geo->points, 0, geo->count, 0, query, results, &size, max);
+    // heap sort, nearest first
+    for (int last = size - 1; last > 0; last--) {
+        nordi_geo_result_t swapped = results[0];
+        results[0] = results[last];
+        results[last] = swapped;
+        sift_down(results, last, 0);
+    }
+    for (int index = 0; index < size; index++) {
+        // the name is the first member, so it points at its point too
+        const nordi_geo_point_t* point = (const nordi_geo_point_t*)results[index].name;
+        results[index].distance_km = nordi_geo_distance_km(latitude, longitude, point->latitude, point->longitude);
+    }
+    return size;
+}
+
+double
+nordi_geo_distance_km(double latitude, double longitude, double other_latitude, double other_longitude) {
+    double half_phi = (other_latitude - latitude) * RADIANS / 2;
+    double half_lambda = (other_longitude - longitude) * RADIANS / 2;
+    double haversine =
+        sin(half_phi) * sin(half_phi) + cos(latitude * RADIANS) * cos(other_latitude * RADIANS) * sin(half_lambda) * sin(half_lambda);
+    return 2 * GEO_EARTH_RADIUS_KM * asin(sqrt(haversine < 1 ? haversine : 1));
+}
+
+bool
+nordi_geo_parse_location(const char* text, double* latitude, double* longitude) {
+    double parsed_latitude, parsed_longitude;
+    if (text == NULL || !parse_degrees(&text, &parsed_latitude) || *text++ != ','
+        || !parse_degrees(&text, &parsed_longitude) || *text != '\0') {
+        return false;
+    }
+    if (fabs(parsed_latitude) > 90 || fabs(parsed_longitude) > 180) {
+        return false;
+    }
+    *latitude = parsed_latitude;
+    *longitude = parsed_longitude;
+    return true;
+}
+
+void
+nordi_geo_free(nordi_geo_ptr geo) {
+    if (geo == NULL) {
+        return;
+    }
+    free(geo->points);
+    free(geo);
+}
@@ -0,0 +1,108 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#include <gtk/gtk.h>
+#include <stdio.h>
+#include "nordi_graph.h"
+
+#define GRAPH_POINTS    60 // a minute at the default sampling interval
+#define GRAPH_WIDTH     240
+#define GRAPH_HEIGHT    60
+#define GRAPH_MIN_SCALE 1024.0 // bytes per second, so an idle tunnel draws flat lines instead of noise
+#define GRAPH_LINE      1.5
+#define MAX_RATE_TEXT   64
+#define KIBIBYTE        1024.0
+
+struct _nordi_graph_t {
+    GtkWidget parent;
+    double rx[GRAPH_POINTS];
+    double tx[GRAPH_POINTS];
+    int count; // samples held, up to GRAPH_POINTS
+    int next;  // slot of the next sample
+};
+
+G_DEFINE_TYPE(nordi_graph_t, nordi_graph, GTK_TYPE_WIDGET);
+
+static double
+nordi_graph_scale(nordi_graph_ptr graph) {
+    double scale = GRAPH_MIN_SCALE;
+    for (int index = 0; index < graph->count; index++) {
+        scale = MAX(scale, MAX(graph->rx[index], graph->tx[index]));
+    }
+    return scale;
+}
+
+// Plot one series oldest to newest, with the newest sample on the right edge
+static void
+nordi_graph_draw_series(cairo_t* cairo, nordi_graph_ptr graph, const double* values, int width, int height, double scale) {
+    double step = (double)width / (GRAPH_POINTS - 1);
+    int oldest = (graph->next - graph->count + GRAPH_POINTS) % GRAPH_POINTS;
+    for (int index = 0; index < graph->count; index++) {
+        double x = width - (graph->count - 1 - index) * step;
+        double y = height - values[(oldest + index) % GRAPH_POINTS] / scale * (height - GRAPH_LINE) - GRAPH_LINE / 2;
+        if (index == 0) {
+            cairo_move_to(cairo, x, y);
+        } else {
+            cairo_line_to(cairo, x, y);
+        }
+    }
+    cairo_stroke(cairo);
+}
+
+static void
+nordi_graph_snapshot(GtkWidget* widget, GtkSnapshot* snapshot) {
+    nordi_graph_ptr graph = NORDI_GRAPH(widget);
+    int width = gtk_widget_get_width(widget);
+    int height = gtk_widget_get_height(widget);
+    if (graph->count < 2 || width <= 0 || height <= 0) {
+        return;
+    }
+    double scale = nordi_graph_scale(graph);
+    cairo_t* cairo = gtk_snapshot_append_cairo(snapshot, &GRAPHENE_RECT_INIT(0, 0, width, height));
+    cairo_set_line_width(cairo, GRAPH_LINE);
+    cairo_set_line_join(cairo, CAIRO_LINE_JOIN_ROUND);
+    cairo_set_source_rgb(cairo, 0.27, 0.53, 0.90); // received
+    nordi_graph_draw_series(cairo, graph, graph->rx, width, height, scale);
+    cairo_set_source_rgb(cairo, 0.93, 0.55, 0.20); // sent
+    nordi_graph_draw_series(cairo, graph, graph->tx, width, height, scale);
+    cairo_destroy(cairo);
+}
+
+static void
+nordi_graph_init(nordi_graph_ptr graph) {
+    gtk_widget_set_size_request(GTK_WIDGET(graph), GRAPH_WIDTH, GRAPH_HEIGHT);
+}
+
+static void
+nordi_graph_class_init(nordi_graph_tClass* class) {
+    GTK_WIDGET_CLASS(class)->snapshot = nordi_graph_snapshot;
+}
+
+nordi_graph_ptr
+nordi_graph_new() {
+    return g_object_new(NORDI_GRAPH_TYPE, NULL);
+}
+
+void
+nordi_graph_push(nordi_graph_ptr graph, double rx_rate, double tx_rate) {
+    graph->rx[graph->next] = rx_rate;
+    graph->tx[graph->next] = tx_rate;
+    graph->next = (graph->next + 1) % GRAPH_POINTS;
+    graph->count = MIN(graph->count + 1, GRAPH_POINTS);
+    char text[MAX_RATE_TEXT];
+    snprintf(text, MAX_RATE_TEXT, "Received %.1f KiB/s, sent %.1f KiB/s", rx_rate / KIBIBYTE, tx_rate / KIBIBYTE);
+    gtk_widget_set_tooltip_text(GTK_WIDGET(graph), text);
+    gtk_widget_queue_draw(GTK_WIDGET(graph));
+}
+
+void
+nordi_graph_clear(nordi_graph_ptr graph) {
+    graph->count = 0;
+    graph->next = 0;
+    gtk_widget_set_tooltip_text(GTK_WIDGET(graph), NULL);
+    gtk_widget_queue_draw(GTK_WIDGET(graph));
+}
@@ -5,12 +5,35 @@
  * https://opensource.org/licenses/MIT
  */
 
+#include <errno.h>
 #include <gio/gio.h>
+#include <glib-unix.h>
 #include <gtk/gtk.h>
+#include <signal.h>
 #include <stdio.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
 #include "nordi_app.h"
+#include "nordi_bus.h"
+#include "nordi_catalog.h"
+#include "nordi_entries.h"
+#include "nordi_filter.h"
+#include "nordi_graph.h"
+#include "nordi_geo.h"
 #include "nordi_gui.h"
+#include "nordi_history.h"
+#include "nordi_monitor.h"
+#include "nordi_queue.h"
+#include "nordi_refresh.h"
+#include "nordi_resources.h"
 #include "nordi_routines.h"
+#include "nordi_selector.h"
+#include "nordi_speculation.h"
+#include "nordi_speedtest.h"
+#include "nordi_traffic.h"
+#include "nordi_usage.h"
+#include "nordi_view.h"
+#include "nordi_watchdog.h"
 #include "nordvpn_api.h"
 #include "nordvpn_server.h"
 
@@ -18,6 +41,59 @@
 #define ICONS_PATH          "/nordi/icons/"
 #define ICONS_SIZE          24
 #define ICONS_SCALE         1
+#define MAX_STATUS_TEXT     64
+#define MAX_HISTORY_TEXT    (VIEW_MAX_TEXT * VIEW_STATUS_SHOWN)
+#define NO_SELECTION        -1
+#define QUALITY_INTERVAL_MS 1000
+#define MONITOR_TARGET_ENV  "NORDI_MONITOR_TARGET"
+#define USAGE_INTERVAL_MS   60000
+#define RESOURCES_PERIOD_MS 60000 // between snapshots of the resources, for their trends
+#define USAGE_FILE          "usage.dat"
+#define HISTORY_FILE        "history.dat"
+#define SERVER_DOMAIN       ".nordvpn.com"
+#define CATALOG_FILE        "catalog.dat"
+#define CATALOG_URL_ENV     "NORDI_CATALOG_URL"
+#define LOCATION_ENV        "NORDI_LOCATION"
+#define NEAREST_INDEX       (COUNTRY_COUNT + GROUP_COUNT + 1)
+#define SERVER_INDEX        (NEAREST_INDEX + 1) // first catalog server entry
+#define MAX_ENTRY_TEXT      64
+#define FILTER_OPTION_COUNT 5
+#define GIBIBYTE            1073741824.0
+#define MEGABIT             1000000.0
+#define MAX_SPEED_TEXT      96
+#define DIAGNOSTICS_SIGNAL  SIGUSR1 // dumps the diagnostics to the log
+#define WATCHDOG_ENV        "NORDI_WATCHDOG" // stall threshold in ms, starts the main loop watchdog
+
+// What each command failed to do, for the error events
+static const char* const COMMAND_TASKS[] = {
+    "", "connect", "reconnect", "disconnect", "log in", "log out", "refresh the account", "sync the host",
+    "import the allowlist", "read the status",
+};
+
+// A filter check button, narrowing the servers of the selection
+typedef struct {
+    const char* label;
+    uint32_t features;
+    uint32_t technologies;
+} nordi_gui_filter_option_t;
+
+static const nordi_gui_filter_option_t FILTER_OPTIONS[FILTER_OPTION_COUNT] = {
+    {"P2P", FEATURE_P2P, 0},
+    {"Obfuscated", FEATURE_OBFUSCATED, 0},
+    {"Double VPN", FEATURE_DOUBLE_VPN, 0},
+    {"Onion", FEATURE_ONION, 0},
+    {"NordLynx", 0, 1u << TECHNOLOGY_NORDLYNX},
+};
+
+// A finished queue command, handed over from the queue worker to the main thread
+typedef struct {
+    nordi_gui_ptr window;
+    nordi_command_type_t type;
+    nordvpn_error_t result;
+    int tag;
+    str server;
+    str link;
+} nordi_gui_result_t;
 
 struct _nordi_gui_t {
     GtkApplicationWindow parent;
@@ -25,18 +101,79 @@ struct _nordi_gui_t {
     GIcon_autoptr connected_icon;
     GIcon_autoptr disconnected_icon;
     nordi_routine_ptr helper_routine;
+    nordi_queue_ptr queue;
+    int connected_index; // entry of the current connection
+    int paused_index;    // entry to reconnect to after a pause
+    int selected_index;  // entry selected, to tell a new selection from a search that kept it
+    bool is_switching;   // the last connect was requested while online
+    nordi_monitor_ptr monitor;
+    unsigned int monitor_wakeups; // wakeups of the monitor thread already counted by the refresh
+    int quality_task;
+    nordi_traffic_ptr traffic;
+    unsigned int traffic_wakeups; // wakeups of the sampler thread already counted by the refresh
+    nordi_graph_ptr traffic_graph;
+    nordi_usage_ptr usage;
+    int usage_task;
+    bool is_usage_tracked; // usage_task is enabled
+    nordi_history_ptr history;
+    nordi_selector_ptr selector;
+    nordi_speculation_ptr speculation;
+    nordi_catalog_ptr catalog;
+    thrd_t catalog_thread;
+    bool is_catalog_refreshing; // catalog_thread needs joining
+    int catalog_cancel;         // eventfd written to stop the refresh, so closing the window doesn't wait for it
+    nordi_geo_ptr geo;          // built on the first nearest query
+    unsigned int geo_revision;  // catalog revision the index was built from
+    nordi_filter_ptr filter;    // built on the first filtered query
+    unsigned int filter_revision;  // catalog revision the table was built from
+    unsigned int servers_revision; // catalog revision the server entries were filled from
+    GtkCheckButton* filter_checks[FILTER_OPTION_COUNT];
+    char session_server[HISTORY_MAX_SERVER]; // server of the current session, for the event ending it
+    time_t connected_at;                     // start of the current session, 0 if none
+    nordi_monitor_stats_t session_quality;   // last quality measured in the current session
+    thrd_t speed_thread;
+    bool is_speed_testing;    // speed_thread needs joining
+    atomic_bool speed_cancel; // stops the running speed test
+    str speed_endpoint;       // sink of the running speed test
+    int speed_streams_count;
+    nordi_speedtest_result_t speed_result;
+    nordi_view_ptr view;     // what the widgets show and should show, set once per frame
+    guint view_tick;         // tick callback applying the view, 0 if none is pending
+    nordi_bus_ptr bus;       // events from the workers, dispatched on the main loop
+    guint bus_source;        // timeout dispatching a settled event, 0 if none is pending
+    bool is_notified_online; // tunnel state the desktop was last told about
+    nordi_refresh_ptr refresh;                // periodic tasks, paced by the window and power state
+    guint refresh_source;                     // timeout of the next refresh wakeup, 0 if none is due
+    GPowerProfileMonitor* power_monitor;
+    guint diagnostics_source;
+    nordi_resources_ptr resources; // snapshots of the live allocations, threads and fds
+    guint resources_source;        // snapshot timer, kept apart from the refresh so a pause leaves no gap
+    nordi_watchdog_ptr watchdog;   // NULL unless opted in
     // NordVPN API
     nordvpn_session_ptr nordvpn_session;
     nordvpn_host_ptr nordvpn_host;
     // template UI widget references
     // VPN page
-    GtkComboBoxText* country_combo;
+    GtkGrid* vpn_grid;
+    GtkSearchEntry* server_search;
+    GtkListView* server_list;
+    GtkSingleSelection* server_selection;
+    nordi_entries_ptr entries; // automatic, countries, groups, nearest, then the catalog servers
     GtkButton* connect_button;
     GtkButton* disconnect_button;
     GtkButton* pause_button;
+    GtkCheckButton* smart_check;
+    GtkBox* filter_box;
     GtkLabel* ip_label;
     GtkLabel* host_label;
+    GtkLabel* quality_label;
+    GtkLabel* usage_label;
     GtkStatusbar* status_bar;
+    // Speed page
+    GtkEntry* speed_target;
+    GtkSpinButton* speed_streams;
+    GtkLabel* speed_label;
+    GtkButton* speed_button;
     // Account page
     GtkLabel* version_label;
     GtkLabel* email_label;
@@ -57,13 +194,20 @@ get_nordi_gui_from(GtkWidget* widget) {
     return NORDI_GUI(main);
 }
 
+// Bus subscriber, the connection once it stopped flapping
 static void
-nordi_gui_notify(nordi_gui_ptr window) {
+nordi_gui_notify(nordi_bus_event_ptr event, void* context) {
+    nordi_gui_ptr window = NORDI_GUI(context);
+    // syncs and failed commands publish the state too, only a change is news
+    if ((bool)event->value == window->is_notified_online) {
+        return;
+    }
+    window->is_notified_online = event->value;
     GNotification_autoptr notification;
-    if (window->nordvpn_host->is_online) {
+    if (event->value) {
         notification = g_notification_new("NordVPN connected");
         g_notification_set_icon(notification, window->connected_icon);
-        g_notification_set_body(notification, str_ptr(window->nordvpn_host->hostname));
+        g_notification_set_body(notification, event->text);
     } else {
         notification = g_notification_new("NordVPN disconnected");
         g_notification_set_icon(notification, window->disconnected_icon);
@@ -71,78 +215,1036 @@ nordi_gui_notify(nordi_gui_ptr window) {
     g_application_send_notification(gtk_window_get_application(GTK_WINDOW(window)), "nordi-status", notification);
 }
 
+// The entry selected in the server list, NO_SELECTION if none is
+static int
+nordi_gui_selected(nordi_gui_ptr window) {
+    guint position = gtk_single_selection_get_selected(window->server_selection);
+    return position == GTK_INVALID_LIST_POSITION ? NO_SELECTION : nordi_entries_entry_at(window->entries, position);
+}
+
+static void
+nordi_gui_select(nordi_gui_ptr window, int entry) {
+    gtk_single_selection_set_selected(window->server_selection, nordi_entries_position_of(window->entries, entry));
+}
+
+// Set the widgets for the parts of the view that changed since the last frame
+static gboolean
+nordi_gui_apply_view(GtkWidget* widget, GdkFrameClock* clock, gpointer data) {
+    nordi_gui_ptr window = NORDI_GUI(widget);
+    window->view_tick = 0;
+    unsigned int changed = nordi_view_commit(window->view);
+    const nordi_view_state_t* view = &(window->view->applied);
+    if (changed & VIEW_ONLINE) {
+        gtk_button_set_label(window->connect_button, view->is_online ? "Switch" : "Connect");
+        gtk_widget_set_visible(GTK_WIDGET(window->disconnect_button), view->is_online);
+        gtk_widget_set_visible(GTK_WIDGET(window->pause_button), view->is_online);
+    }
+    if (changed & VIEW_IP) {
+        gtk_label_set_label(window->ip_label, view->ip);
+    }
+    if (changed & VIEW_HOST) {
+        gtk_label_set_label(window->host_label, view->host);
+    }
+    if (changed & VIEW_CONNECT_VISIBLE) {
+        gtk_widget_set_visible(GTK_WIDGET(window->connect_button), view->is_connect_visible);
+    }
+    if (changed & VIEW_CONNECT_SENSITIVE) {
+        gtk_widget_set_sensitive(GTK_WIDGET(window->connect_button), view->is_connect_sensitive);
+    }
+    if (changed & VIEW_LOGGED_IN) {
+        gtk_widget_set_visible(GTK_WIDGET(window->login_button), !view->is_logged_in);
+        gtk_widget_set_visible(GTK_WIDGET(window->logout_button), view->is_logged_in);
+    }
+    if (changed & VIEW_EMAIL) {
+        gtk_label_set_label(window->email_label, view->email);
+    }
+    if (changed & VIEW_EXPIRY) {
+        gtk_label_set_label(window->expire_label, view->expiry);
+    }
+    if (changed & VIEW_STATUS) {
+        // a single message on the stack, the ring keeps the ones before it
+        char history[MAX_HISTORY_TEXT];
+        nordi_view_status_history(window->view, history, MAX_HISTORY_TEXT, VIEW_STATUS_SHOWN);
+        gtk_statusbar_remove_all(window->status_bar, 0);
+        gtk_statusbar_push(window->status_bar, 0, nordi_view_status(window->view));
+        gtk_widget_set_tooltip_text(GTK_WIDGET(window->status_bar), history);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+// Apply the view on the next frame, every change until then is applied along
+static void
+nordi_gui_schedule_view(nordi_gui_ptr window) {
+    if (window->view_tick == 0) {
+        window->view_tick = gtk_widget_add_tick_callback(GTK_WIDGET(window), nordi_gui_apply_view, NULL, NULL);
+    }
+}
+
+static void
+nordi_gui_status(nordi_gui_ptr window, const char* text) {
+    nordi_view_push_status(window->view, text);
+    nordi_gui_schedule_view(window);
+}
+
+// Show the connect button while offline, or while online when another server is selected, to switch to it. It
+// can't be clicked while the search hides the selection, nothing would tell what it connects to.
+static void
+nordi_gui_update_connect_button(nordi_gui_ptr window) {
+    bool is_online = window->nordvpn_host->is_online;
+    nordi_view_set_connect_visible(window->view, !is_online || window->selected_index != window->connected_index);
+    nordi_view_set_connect_sensitive(window->view, nordi_gui_selected(window) != NO_SELECTION);
+    nordi_gui_schedule_view(window);
+}
+
+static unsigned int
+nordi_gui_catalog_revision(nordi_gui_ptr window) {
+    mtx_lock(&window->catalog->mutex);
+    unsigned int revision = window->catalog->revision;
+    mtx_unlock(&window->catalog->mutex);
+    return revision;
+}
+
+static nordi_filter_query_t
+nordi_gui_filter_query(nordi_gui_ptr window) {
+    nordi_filter_query_t query = {};
+    for (int option = 0; option < FILTER_OPTION_COUNT; option++) {
+        if (gtk_check_button_get_active(window->filter_checks[option])) {
+            query.features |= FILTER_OPTIONS[option].features;
+            query.technologies |= FILTER_OPTIONS[option].technologies;
+        }
+    }
+    return query;
+}
+
+static bool
+nordi_gui_is_filtering(nordi_gui_ptr window) {
+    nordi_filter_query_t query = nordi_gui_filter_query(window);
+    return window->catalog != NULL && (query.features != 0 || query.technologies != 0);
+}
+
+// The table of the current catalog, its bits in the catalog order the server entries are filled in
+static nordi_filter_ptr
+nordi_gui_filter_table(nordi_gui_ptr window) {
+    if (window->filter != NULL && window->filter_revision == nordi_gui_catalog_revision(window)) {
+        return window->filter;
+    }
+    nordi_filter_free(window->filter);
+    // the revision read with the servers it was built from
+    mtx_lock(&window->catalog->mutex);
+    window->filter = nordi_filter_new(window->catalog->servers, window->catalog->count);
+    window->filter_revision = window->catalog->revision;
+    mtx_unlock(&window->catalog->mutex);
+    return window->filter;
+}
+
+// The least loaded catalog servers of the selected country or group having every checked feature
+static int
+nordi_gui_filtered(nordi_gui_ptr window, int selected, const char** servers, int max) {
+    if (!nordi_gui_is_filtering(window)) {
+        return 0;
+    }
+    nordi_filter_query_t query = nordi_gui_filter_query(window);
+    if (selected >= 1 && selected <= COUNTRY_COUNT) {
+        query.countries = 1ull << (selected - 1);
+    } else if (selected > COUNTRY_COUNT && selected < NEAREST_INDEX) {
+        query.groups = 1u << (selected - COUNTRY_COUNT - 1);
+    }
+    if (nordi_gui_filter_table(window) == NULL || window->filter->words == 0) {
+        return 0;
+    }
+    uint64_t* result = (uint64_t*)malloc(window->filter->words * sizeof(uint64_t));
+    int indexes[SPECULATION_MAX_TARGETS];
+    max = max < SPECULATION_MAX_TARGETS ? max : SPECULATION_MAX_TARGETS;
+    int count = 0;
+    if (result != NULL && nordi_filter_apply(window->filter, &query, result) > 0) {
+        count = nordi_filter_least_loaded(window->filter, result, indexes, max);
+    }
+    for (int index = 0; index < count; index++) {
+        servers[index] = window->filter->names[indexes[index]];
+    }
+    free(result);
+    return count;
+}
+
+// The catalog servers nearest to the configured location, rebuilding the index once the catalog changed
+static int
+nordi_gui_nearest(nordi_gui_ptr window, nordi_geo_result_ptr results, int max) {
+    double latitude, longitude;
+    if (window->catalog == NULL || !nordi_geo_parse_location(getenv(LOCATION_ENV), &latitude, &longitude)) {
+        return 0;
+    }
+    unsigned int revision = nordi_gui_catalog_revision(window);
+    if (window->geo == NULL || window->geo_revision != revision) {
+        nordi_geo_free(window->geo);
+        window->geo = nordi_geo_from_catalog(window->catalog);
+        window->geo_revision = revision;
+    }
+    return nordi_geo_nearest(window->geo, latitude, longitude, results, max);
+}
+
+// Probe the candidates of the highlighted entry in the background, so connecting finds them ranked
+static void
+nordi_gui_speculate(nordi_gui_ptr window) {
+    nordi_watchdog_enter(window->watchdog, __func__);
+    int selected = window->selected_index;
+    bool is_connected = window->nordvpn_host->is_online && selected == window->connected_index;
+    const char* servers[SPECULATION_MAX_TARGETS];
+    nordi_catalog_server_t entries[SPECULATION_MAX_TARGETS]; // the names the catalog top up points into
+    int count = 0;
+    if (selected < 0 || is_connected) {
+        count = 0;
+    } else if (selected == NEAREST_INDEX) {
+        // the nearest servers, ranked by their actual round trip
+        nordi_geo_result_t nearest[SPECULATION_MAX_TARGETS];
+        count = nordi_gui_nearest(window, nearest, SPECULATION_MAX_TARGETS);
+        for (int index = 0; index < count; index++) {
+            servers[index] = nearest[index].name;
+        }
+    } else if (selected < NEAREST_INDEX && nordi_gui_is_filtering(window)) {
+        // the least loaded servers having the checked features
+        count = nordi_gui_filtered(window, selected, servers, SPECULATION_MAX_TARGETS);
+    } else if (gtk_check_button_get_active(window->smart_check) && selected <= COUNTRY_COUNT) {
+        count = nordi_selector_rank(window->selector, selected - 1, time(NULL), servers, SPECULATION_MAX_TARGETS);
+        // top up with the least loaded servers of the catalog, for countries the history knows little of
+        int entry_count =
+            nordi_catalog_least_loaded(window->catalog, selected - 1, 0, entries, SPECULATION_MAX_TARGETS - count);
+        for (int entry = 0, ranked = count; entry < entry_count; entry++) {
+            int index = 0;
+            while (index < ranked && strcmp(servers[index], entries[entry].name) != 0) {
+                index++;
+            }
+            if (index == ranked) {
+                servers[count++] = entries[entry].name;
+            }
+        }
+    }
+    char hosts[SPECULATION_MAX_TARGETS][HISTORY_MAX_SERVER + sizeof(SERVER_DOMAIN)];
+    str targets[SPECULATION_MAX_TARGETS];
+    for (int index = 0; index < count; index++) {
+        snprintf(hosts[index], sizeof(hosts[index]), "%s" SERVER_DOMAIN, servers[index]);
+        targets[index] = str_ref(hosts[index]);
+    }
+    // nothing to probe cancels whatever ran for the previous entry
+    nordi_speculation_request(window->speculation, selected, targets, count);
+    nordi_watchdog_leave(window->watchdog);
+}
+
+// A search hiding the selected entry leaves nothing selected in the list, the selection itself stays on the entry
+static void
+nordi_gui_server_changed(nordi_gui_ptr window) {
+    int selected = nordi_gui_selected(window);
+    if (selected != NO_SELECTION && selected != window->selected_index) {
+        window->selected_index = selected;
+        nordi_gui_speculate(window);
+    }
+    nordi_gui_update_connect_button(window);
+}
+
+// Keep the selected entry selected while the list shows it, and select it again once the list shows it again
+static void
+nordi_gui_keep_selection(nordi_gui_ptr window) {
+    if (window->selected_index != NO_SELECTION && nordi_gui_selected(window) != window->selected_index) {
+        nordi_gui_select(window, window->selected_index);
+    }
+    nordi_gui_update_connect_button(window);
+}
+
+static void
+nordi_gui_server_searched(nordi_gui_ptr window) {
+    nordi_watchdog_enter(window->watchdog, __func__);
+    nordi_entries_search(window->entries, gtk_editable_get_text(GTK_EDITABLE(window->server_search)));
+    nordi_gui_keep_selection(window);
+    nordi_watchdog_leave(window->watchdog);
+}
+
+// List only the catalog servers having every checked feature, the countries and groups stay listed
+static void
+nordi_gui_filter_servers(nordi_gui_ptr window) {
+    if (!nordi_gui_is_filtering(window)) {
+        nordi_entries_restrict(window->entries, SERVER_INDEX, NULL, 0);
+        return;
+    }
+    nordi_filter_ptr filter = nordi_gui_filter_table(window);
+    if (filter == NULL || window->filter_revision != window->servers_revision) {
+        // the entries are about to be filled from a newer catalog, filtered again then
+        return;
+    }
+    nordi_filter_query_t query = nordi_gui_filter_query(window);
+    uint64_t* result = g_new0(uint64_t, filter->words + 1);
+    nordi_filter_apply(filter, &query, result);
+    nordi_entries_restrict(window->entries, SERVER_INDEX, result, filter->count);
+    g_free(result);
+}
+
+static void
+nordi_gui_filter_toggled(nordi_gui_ptr window) {
+    nordi_watchdog_enter(window->watchdog, __func__);
+    nordi_gui_filter_servers(window);
+    nordi_gui_keep_selection(window);
+    nordi_gui_speculate(window);
+    nordi_watchdog_leave(window->watchdog);
+}
+
+static void
+nordi_gui_setup_row(GtkListItemFactory* factory, GtkListItem* item) {
+    GtkWidget* label = gtk_label_new(NULL);
+    gtk_label_set_xalign(GTK_LABEL(label), 0);
+    gtk_list_item_set_child(item, label);
+}
+
+// Rows are recycled while scrolling, binding only swaps the label text
+static void
+nordi_gui_bind_row(GtkListItemFactory* factory, GtkListItem* item) {
+    GtkStringObject* entry = GTK_STRING_OBJECT(gtk_list_item_get_item(item));
+    gtk_label_set_label(GTK_LABEL(gtk_list_item_get_child(item)), gtk_string_object_get_string(entry));
+}
+
+// Replace the server entries with the catalog servers, keeping the entries in use pointing at the same servers
+static void
+nordi_gui_fill_servers(nordi_gui_ptr window) {
+    char connected[CATALOG_MAX_SERVER] = {}, paused[CATALOG_MAX_SERVER] = {}, selected[CATALOG_MAX_SERVER] = {};
+    int* indexes[] = {&window->connected_index, &window->paused_index, &window->selected_index};
+    char* nodes[] = {connected, paused, selected};
+    for (int index = 0; index < 3; index++) {
+        if (*indexes[index] >= SERVER_INDEX) {
+            g_strlcpy(nodes[index], nordi_entries_node(window->entries, *indexes[index]), CATALOG_MAX_SERVER);
+        }
+    }
+    int count = 0;
+    char** labels = NULL;
+    char** names = NULL;
+    if (window->catalog != NULL) {
+        mtx_lock(&window->catalog->mutex);
+        count = window->catalog->count;
+        window->servers_revision = window->catalog->revision;
+        labels = g_new(char*, count + 1);
+        names = g_new(char*, count + 1);
+        for (int server = 0; server < count; server++) {
+            const nordi_catalog_server_t* entry = &window->catalog->servers[server];
+            const char* country = entry->country >= 0 ? str_ptr(NORDVPN_COUNTRY_STR[entry->country]) : "Unknown";
+            labels[server] = g_strdup_printf("%s (%s, %u%% load)", entry->name, country, entry->load);
+            names[server] = g_strdup(entry->name);
+        }
+        mtx_unlock(&window->catalog->mutex);
+    }
+    nordi_entries_splice(window->entries, SERVER_INDEX, (const char* const*)labels, (const char* const*)names, count);
+    for (int server = 0; server < count; server++) {
+        g_free(labels[server]);
+        g_free(names[server]);
+    }
+    g_free(labels);
+    g_free(names);
+    for (int index = 0; index < 3; index++) {
+        if (*indexes[index] >= SERVER_INDEX) {
+            *indexes[index] = nordi_entries_find(window->entries, nodes[index]);
+        }
+    }
+    nordi_gui_filter_servers(window);
+    if (window->selected_index != NO_SELECTION) {
+        nordi_gui_select(window, window->selected_index);
+    }
+}
+
+// Show the servers of a refreshed catalog, on the main thread
+static gboolean
+nordi_gui_catalog_refreshed(nordi_gui_ptr window) {
+    nordi_watchdog_enter(window->watchdog, __func__);
+    if (window->entries != NULL) {
+        nordi_gui_fill_servers(window);
+    }
+    nordi_watchdog_leave(window->watchdog);
+    g_object_unref(window);
+    return G_SOURCE_REMOVE;
+}
+
+static long long
+nordi_gui_now_ms() {
+    return g_get_monotonic_time() / 1000;
+}
+
+static void nordi_gui_schedule_refresh(nordi_gui_ptr, int);
+
+// The sampler threads wake up on their own, count what they did since the last time
+static void
+nordi_gui_count_wakeups(nordi_gui_ptr window) {
+    if (window->refresh == NULL) {
+        return;
+    }
+    unsigned int count = 0;
+    if (window->monitor != NULL) {
+        unsigned int wakeups = atomic_load(&window->monitor->wakeups);
+        count += wakeups - window->monitor_wakeups;
+        window->monitor_wakeups = wakeups;
+    }
+    if (window->traffic != NULL) {
+        unsigned int wakeups = atomic_load(&window->traffic->wakeups);
+        count += wakeups - window->traffic_wakeups;
+        window->traffic_wakeups = wakeups;
+    }
+    nordi_refresh_count_wakeups(window->refresh, count, nordi_gui_now_ms());
+}
+
+static gboolean
+nordi_gui_run_refresh(nordi_gui_ptr window) {
+    nordi_watchdog_enter(window->watchdog, __func__);
+    window->refresh_source = 0;
+    nordi_gui_count_wakeups(window);
+    nordi_gui_schedule_refresh(window, nordi_refresh_run(window->refresh, nordi_gui_now_ms()));
+    nordi_watchdog_leave(window->watchdog);
+    return G_SOURCE_REMOVE;
+}
+
+// A single timer for every task, set to their next aligned deadline
+static void
+nordi_gui_schedule_refresh(nordi_gui_ptr window, int next) {
+    if (window->refresh_source != 0) {
+        g_source_remove(window->refresh_source);
+        window->refresh_source = 0;
+    }
+    if (next != REFRESH_NO_DEADLINE) {
+        window->refresh_source = g_timeout_add(next, G_SOURCE_FUNC(nordi_gui_run_refresh), window);
+    }
+}
+
+static void
+nordi_gui_enable_refresh(nordi_gui_ptr window, int task, bool is_enabled) {
+    // a disposed window stopped refreshing
+    if (window->refresh == NULL) {
+        return;
+    }
+    long long now = nordi_gui_now_ms();
+    nordi_refresh_enable(window->refresh, task, is_enabled, now);
+    nordi_gui_schedule_refresh(window, nordi_refresh_next(window->refresh, now));
+}
+
+// The samplers slow down with the refresh and stop with it, the traffic also while its graph can't be seen
+static void
+nordi_gui_pace_samplers(nordi_gui_ptr window) {
+    if (window->refresh == NULL) {
+        return;
+    }
+    int factor = nordi_refresh_scale(window->refresh);
+    nordi_monitor_pace(window->monitor, MONITOR_DEFAULT_INTERVAL_MS * factor);
+    if (window->traffic != NULL) {
+        nordi_traffic_set_interval(window->traffic, TRAFFIC_DEFAULT_INTERVAL_MS * MAX(factor, 1));
+        bool is_mapped = window->traffic_graph != NULL && gtk_widget_get_mapped(GTK_WIDGET(window->traffic_graph));
+        nordi_traffic_pause(window->traffic, factor == 0 || !is_mapped);
+    }
+}
+
+// Pace the refresh by the focus, visibility, battery saver and session idleness
+static void
+nordi_gui_refresh_state(nordi_gui_ptr window) {
+    if (window->refresh == NULL) {
+        return;
+    }
+    GtkApplication* app = gtk_window_get_application(GTK_WINDOW(window));
+    GdkSurface* surface = gtk_native_get_surface(GTK_NATIVE(window));
+    gboolean is_idle = false;
+    if (app != NULL) {
+        g_object_get(app, "screensaver-active", &is_idle, NULL);
+    }
+    bool is_minimized = surface != NULL && GDK_IS_TOPLEVEL(surface) &&
+                        (gdk_toplevel_get_state(GDK_TOPLEVEL(surface)) & GDK_TOPLEVEL_STATE_MINIMIZED);
+    bool is_power_saving =
+        window->power_monitor != NULL && g_power_profile_monitor_get_power_saver_enabled(window->power_monitor);
+    long long now = nordi_gui_now_ms();
+    nordi_refresh_set_state(window->refresh, gtk_window_is_active(GTK_WINDOW(window)),
+                            gtk_widget_get_visible(GTK_WIDGET(window)) && !is_minimized, is_power_saving, is_idle,
+                            now);
+    nordi_gui_schedule_refresh(window, nordi_refresh_next(window->refresh, now));
+    nordi_gui_pace_samplers(window);
+}
+
+// Follow the minimized state, the surface only exists once realized
+static void
+nordi_gui_watch_surface(nordi_gui_ptr window) {
+    GdkSurface* surface = gtk_native_get_surface(GTK_NATIVE(window));
+    g_signal_connect_object(surface, "notify::state", G_CALLBACK(nordi_gui_refresh_state), window, G_CONNECT_SWAPPED);
+}
+
+// Timer handler, the trends the diagnostics show run on a fixed period whatever the refresh mode
+static gboolean
+nordi_gui_snapshot_resources(nordi_gui_ptr window) {
+    nordi_watchdog_enter(window->watchdog, __func__);
+    long long now = nordi_gui_now_ms();
+    nordi_resources_snapshot(window->resources, now);
+    nordi_refresh_count_wakeups(window->refresh, 1, now);
+    nordi_watchdog_leave(window->watchdog);
+    return G_SOURCE_CONTINUE;
+}
+
+// Signal handler, logs what the window costs while it runs
+static gboolean
+nordi_gui_dump_diagnostics(nordi_gui_ptr window) {
+    nordi_refresh_ptr refresh = window->refresh;
+    nordi_gui_count_wakeups(window);
+    g_message("Refresh: %s, %u wakeups over the last minute, %llu wakeups and %llu task runs in total",
+              NORDI_REFRESH_MODE_STR[nordi_refresh_mode(refresh)],
+              nordi_refresh_wakeups_per_minute(refresh, nordi_gui_now_ms()), refresh->wakeups, refresh->runs);
+    g_message("Events: %u published, %u batches, %u delivered, %u coalesced", atomic_load(&window->bus->published),
+              window->bus->batches, window->bus->delivered, window->bus->coalesced);
+    nordvpn_write_stats(stderr);
+    nordi_resources_write(window->resources, stderr, nordi_gui_now_ms());
+    if (window->watchdog != NULL) {
+        nordi_watchdog_write(window->watchdog, stderr);
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+nordi_gui_beat(nordi_gui_ptr window) {
+    // a disposed window stopped watching
+    if (window->watchdog != NULL) {
+        nordi_watchdog_beat(window->watchdog);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+// Watchdog post callback, runs on the watchdog thread. The heartbeat goes ahead of the default priority handlers,
+// so its latency is the time the one running takes.
+static void
+nordi_gui_post_beat(nordi_gui_ptr window) {
+    g_idle_add_full(G_PRIORITY_HIGH, G_SOURCE_FUNC(nordi_gui_beat), g_object_ref(window), g_object_unref);
+}
+
+static void
+nordi_gui_start_watchdog(nordi_gui_ptr window) {
+    const char* threshold = g_getenv(WATCHDOG_ENV);
+    if (threshold == NULL) {
+        return;
+    }
+    int threshold_ms = (int)g_ascii_strtoll(threshold, NULL, 10);
+    window->watchdog = nordi_watchdog_new(threshold_ms, (nordi_watchdog_post_t)nordi_gui_post_beat, window);
+    if (window->watchdog == NULL) {
+        g_warning("Failed to start the main loop watchdog");
+    }
+}
+
+// Refresh task, while the monitor runs
+static void
+nordi_gui_update_quality(nordi_gui_ptr window) {
+    nordi_monitor_stats_t stats;
+    nordi_monitor_stats(window->monitor, &stats);
+    if (stats.samples == 0) {
+        gtk_label_set_label(window->quality_label, stats.lost > 0 ? "No answer" : "Measuring...");
+        return;
+    }
+    // kept for the event ending the session, by then the tunnel is already gone
+    window->session_quality = stats;
+    char text[MAX_STATUS_TEXT];
+    snprintf(text, MAX_STATUS_TEXT, "%.0f ms, p95 %.0f ms, jitter %.0f ms, %.0f%% loss", stats.p50_us / 1000.0,
+             stats.p95_us / 1000.0, stats.jitter_us / 1000.0, stats.loss);
+    gtk_label_set_label(window->quality_label, text);
+}
+
+// Probe the tunnel while connected, the target can be overridden through the environment
+static void
+nordi_gui_start_monitor(nordi_gui_ptr window) {
+    if (window->monitor != NULL) {
+        return;
+    }
+    const char* target = g_getenv(MONITOR_TARGET_ENV);
+    window->monitor = nordi_monitor_new(target != NULL ? str_ref(target) : str_null, 0, 0);
+    if (window->monitor == NULL) {
+        g_warning("Failed to start the connection quality monitor");
+        return;
+    }
+    window->monitor_wakeups = 0;
+    nordi_gui_pace_samplers(window);
+    gtk_label_set_label(window->quality_label, "Measuring...");
+    nordi_gui_enable_refresh(window, window->quality_task, true);
+}
+
+static void
+nordi_gui_stop_monitor(nordi_gui_ptr window) {
+    nordi_gui_enable_refresh(window, window->quality_task, false);
+    nordi_gui_count_wakeups(window);
+    nordi_monitor_free(window->monitor);
+    window->monitor = NULL;
+    gtk_label_set_label(window->quality_label, "");
+}
+
+// Move the samples gathered so far onto the graph, on the main thread
+static gboolean
+nordi_gui_drain_traffic(nordi_gui_ptr window) {
+    nordi_watchdog_enter(window->watchdog, __func__);
+    nordi_traffic_sample_t sample;
+    while (window->traffic != NULL && nordi_traffic_pop(window->traffic, &sample)) {
+        nordi_graph_push(window->traffic_graph, sample.rx_rate, sample.tx_rate);
+    }
+    nordi_watchdog_leave(window->watchdog);
+    return G_SOURCE_REMOVE;
+}
+
+// Traffic callback, runs on the sampler thread once per batch of samples
+static void
+nordi_gui_traffic_ready(nordi_gui_ptr window) {
+    g_idle_add_full(G_PRIORITY_DEFAULT_IDLE, G_SOURCE_FUNC(nordi_gui_drain_traffic), g_object_ref(window), g_object_unref);
+}
+
+static void
+nordi_gui_update_usage_label(nordi_gui_ptr window) {
+    nordi_usage_total_t day, month;
+    time_t now = time(NULL);
+    nordi_usage_day(window->usage, now, &day);
+    nordi_usage_month(window->usage, now, &month);
+    char text[MAX_STATUS_TEXT];
+    snprintf(text, MAX_STATUS_TEXT, "%.2f GiB today, %.2f GiB this month", (day.rx + day.tx) / GIBIBYTE,
+             (month.rx + month.tx) / GIBIBYTE);
+    gtk_label_set_label(window->usage_label, text);
+}
+
+// Account the tunnel counters, flushing to disk happens at a much coarser interval inside the usage module
+// Refresh task, while the traffic is sampled
+static void
+nordi_gui_update_usage(nordi_gui_ptr window) {
+    uint64_t rx, tx;
+    if (nordi_traffic_read(window->traffic, &rx, &tx)) {
+        nordi_usage_update(window->usage, rx, tx, time(NULL));
+    }
+    nordi_gui_update_usage_label(window);
+}
+
+static void
+nordi_gui_open_usage(nordi_gui_ptr window) {
+    g_autofree char* directory = g_build_filename(g_get_user_data_dir(), "nordi", NULL);
+    g_autofree char* path = g_build_filename(directory, USAGE_FILE, NULL);
+    g_mkdir_with_parents(directory, 0700);
+    window->usage = nordi_usage_open(path, -1);
+    if (window->usage == NULL) {
+        g_warning("Failed to open the usage journal at %s", path);
+        return;
+    }
+    nordi_gui_update_usage_label(window);
+}
+
+static void
+nordi_gui_open_history(nordi_gui_ptr window) {
+    g_autofree char* path = g_build_filename(g_get_user_data_dir(), "nordi", HISTORY_FILE, NULL);
+    window->history = nordi_history_open(path);
+    if (window->history == NULL) {
+        g_warning("Failed to open the connection history at %s", path);
+        return;
+    }
+    window->selector = nordi_selector_new(0);
+    nordi_selector_load(window->selector, window->history);
+}
+
+static int
+nordi_gui_refresh_catalog(nordi_gui_ptr window) {
+    nordi_bus_publish(window->bus, BUS_PROGRESS, 0, "Updating the server list...");
+    nordi_catalog_result_t result =
+        nordi_catalog_refresh_cancellable(window->catalog, getenv(CATALOG_URL_ENV), 0, window->catalog_cancel);
+    if (result == CATALOG_CANCELLED) {
+        return thrd_success; // the window is going away
+    }
+    if (result == CATALOG_FAILED) {
+        nordi_bus_publish(window->bus, BUS_ERROR, UNKNOWN_ERROR, "update the server list");
+    }
+    nordi_bus_publish(window->bus, BUS_PROGRESS, 100,
+                      result == CATALOG_FAILED ? "Server list update failed" : "Server list updated");
+    if (result == CATALOG_FULL || result == CATALOG_DELTA) {
+        // the reference keeps the window alive until the main loop gets to it
+        g_idle_add((GSourceFunc)nordi_gui_catalog_refreshed, g_object_ref(window));
+    }
+    return thrd_success;
+}
+
+// Load the cached server catalog, refreshing it in the background when an endpoint is configured
+static void
+nordi_gui_open_catalog(nordi_gui_ptr window) {
+    g_autofree char* directory = g_build_filename(g_get_user_cache_dir(), "nordi", NULL);
+    g_autofree char* path = g_build_filename(directory, CATALOG_FILE, NULL);
+    g_mkdir_with_parents(directory, 0700);
+    window->catalog = nordi_catalog_open(path);
+    if (window->catalog == NULL || getenv(CATALOG_URL_ENV) == NULL) {
+        return;
+    }
+    window->catalog_cancel = eventfd(0, EFD_CLOEXEC);
+    window->is_catalog_refreshing = window->catalog_cancel >= 0
+        && thrd_create(&window->catalog_thread, (int (*)(void*))nordi_gui_refresh_catalog, (void*)window) == thrd_success;
+}
+
+static void
+nordi_gui_show_speedtest(nordi_gui_ptr window) {
+    nordi_speedtest_result_ptr result = &window->speed_result;
+    char text[MAX_SPEED_TEXT];
+    if (result->streams == 0) {
+        snprintf(text, MAX_SPEED_TEXT, "Couldn't reach the sink");
+    } else {
+        snprintf(text, MAX_SPEED_TEXT, "%.1f Mbit/s over %d streams, ramp-up %u ms, fairness %.2f",
+                 result->goodput_bps / MEGABIT, result->streams, result->ramp_up_ms, result->fairness);
+    }
+    gtk_label_set_label(window->speed_label, text);
+    gtk_button_set_label(window->speed_button, "Start");
+}
+
+// Show a finished speed test, on the main thread
+static gboolean
+nordi_gui_speedtest_done(nordi_gui_ptr window) {
+    // a closing window already joined the test
+    if (window->is_speed_testing) {
+        thrd_join(window->speed_thread, NULL);
+        window->is_speed_testing = false;
+        nordi_gui_show_speedtest(window);
+    }
+    g_object_unref(window);
+    return G_SOURCE_REMOVE;
+}
+
+static int
+nordi_gui_run_speedtest(nordi_gui_ptr window) {
+    nordi_speedtest_options_t options = SPEEDTEST_DEFAULT_OPTIONS;
+    options.streams = window->speed_streams_count;
+    nordi_speedtest_run(window->speed_endpoint, &options, &window->speed_result, &window->speed_cancel);
+    // the reference keeps the window alive until the main loop gets to it
+    g_idle_add((GSourceFunc)nordi_gui_speedtest_done, g_object_ref(window));
+    return thrd_success;
+}
+
+// Start a speed test on its own thread, or stop the running one
+static void
+nordi_gui_speedtest(GtkButton* button) {
+    nordi_gui_ptr window = get_nordi_gui_from(GTK_WIDGET(button));
+    if (window->is_speed_testing) {
+        window->speed_cancel = true;
+        return;
+    }
+    const char* target = gtk_editable_get_text(GTK_EDITABLE(window->speed_target));
+    if (*target == '\0') {
+        gtk_label_set_label(window->speed_label, "Enter the sink to send to");
+        return;
+    }
+    str_cpy(&(window->speed_endpoint), str_ref(target));
+    window->speed_streams_count = gtk_spin_button_get_value_as_int(window->speed_streams);
+    window->speed_cancel = false;
+    window->is_speed_testing =
+        thrd_create(&window->speed_thread, (int (*)(void*))nordi_gui_run_speedtest, (void*)window) == thrd_success;
+    if (!window->is_speed_testing) {
+        g_warning("Failed to start the speed test");
+        return;
+    }
+    gtk_label_set_label(window->speed_label, "Measuring...");
+    gtk_button_set_label(window->speed_button, "Stop");
+}
+
+static void
+nordi_gui_start_session(nordi_gui_ptr window) {
+    snprintf(window->session_server, HISTORY_MAX_SERVER, "%s", str_ptr(window->nordvpn_host->last_server));
+    window->connected_at = time(NULL);
+    window->session_quality = (nordi_monitor_stats_t){};
+}
+
+// The technology in use, from the settings if read, else from the last status
+static nordvpn_technology_t
+nordi_gui_technology(nordi_gui_ptr window) {
+    nordvpn_lock_state();
+    nordvpn_settings_ptr settings = nordvpn_get_settings();
+    nordvpn_technology_t technology = settings->is_known ? settings->technology : window->nordvpn_host->technology;
+    nordvpn_unlock_state();
+    return technology;
+}
+
+// Append an event to the connection history. Events other than connects end the current session, if any.
+static void
+nordi_gui_record(nordi_gui_ptr window, nordi_history_event_t event, const char* server, nordvpn_error_t error) {
+    nordi_history_record_t record = {
+        .event = event, .technology = nordi_gui_technology(window), .country = -1, .error = error};
+    bool is_connect = event == EVENT_CONNECT || event == EVENT_RECONNECT;
+    if (is_connect && error == OK) {
+        record.country = (int16_t)window->nordvpn_host->country;
+        record.connect_ms = window->nordvpn_host->connect_ms;
+    } else if (!is_connect) {
+        if (window->connected_at == 0) {
+            return; // no session to end
+        }
+        record.session_s = (uint32_t)(time(NULL) - window->connected_at);
+        if (window->session_quality.samples > 0) {
+            record.rtt_ms = (uint16_t)MIN(window->session_quality.p50_us / 1000 + 1, UINT16_MAX);
+            record.loss = (uint8_t)window->session_quality.loss;
+        }
+        window->connected_at = 0;
+    }
+    snprintf(record.server, HISTORY_MAX_SERVER, "%s", server);
+    if (nordi_history_append(window->history, &record)) {
+        nordi_selector_observe(window->selector, &record);
+    }
+}
+
+// Sampling follows the graph: nothing is read while the graph can't be seen
+static void
+nordi_gui_traffic_mapped(nordi_gui_ptr window) {
+    nordi_gui_pace_samplers(window);
+}
+
+static void
+nordi_gui_start_traffic(nordi_gui_ptr window) {
+    if (window->traffic != NULL) {
+        return;
+    }
+    window->traffic = nordi_traffic_new(NULL, NULL, 0, (nordi_traffic_notify_t)nordi_gui_traffic_ready, window);
+    if (window->traffic == NULL) {
+        g_warning("Failed to find the tunnel interface to sample");
+        return;
+    }
+    window->traffic_wakeups = 0;
+    nordi_gui_pace_samplers(window);
+    if (window->usage != NULL) {
+        nordi_gui_update_usage(window);
+        nordi_gui_enable_refresh(window, window->usage_task, true);
+        window->is_usage_tracked = true;
+    }
+}
+
+static void
+nordi_gui_stop_traffic(nordi_gui_ptr window) {
+    if (window->is_usage_tracked) {
+        nordi_gui_enable_refresh(window, window->usage_task, false);
+        window->is_usage_tracked = false;
+        // the interface may already be gone, in which case the last minute is lost
+        nordi_gui_update_usage(window);
+        nordi_usage_flush(window->usage);
+    }
+    nordi_gui_count_wakeups(window);
+    nordi_traffic_free(window->traffic);
+    window->traffic = NULL;
+    if (window->traffic_graph != NULL) {
+        nordi_graph_clear(window->traffic_graph);
+    }
+}
+
 static void
 nordi_gui_update_vpn_data(nordi_gui_ptr window) {
-    if (window->nordvpn_host->is_online) {
-        gtk_statusbar_push(window->status_bar, 0, "Connected");
-        gtk_label_set_label(window->ip_label, str_ptr(window->nordvpn_host->ip));
-        gtk_label_set_label(window->host_label, str_ptr(window->nordvpn_host->hostname));
-        gtk_widget_set_visible(GTK_WIDGET(window->disconnect_button), true);
-        gtk_widget_set_visible(GTK_WIDGET(window->pause_button), true);
-        gtk_widget_set_visible(GTK_WIDGET(window->connect_button), false);
+    bool is_online = window->nordvpn_host->is_online;
+    // only a transition is news, a sync that found the same connection leaves the status as it is
+    if (nordi_view_set_connection(window->view, is_online, str_ptr(window->nordvpn_host->ip),
+                                  str_ptr(window->nordvpn_host->hostname))) {
+        nordi_gui_status(window, is_online ? "Connected" : "Disconnected");
+    }
+    if (is_online) {
+        nordi_gui_start_monitor(window);
+        nordi_gui_start_traffic(window);
     } else {
-        gtk_statusbar_push(window->status_bar, 0, "Disconnected");
-        gtk_label_set_label(window->ip_label, "");
-        gtk_label_set_label(window->host_label, "");
-        gtk_widget_set_visible(GTK_WIDGET(window->disconnect_button), false);
-        gtk_widget_set_visible(GTK_WIDGET(window->pause_button), false);
-        gtk_widget_set_visible(GTK_WIDGET(window->connect_button), true);
+        window->connected_index = NO_SELECTION;
+        nordi_gui_stop_monitor(window);
+        nordi_gui_stop_traffic(window);
     }
+    nordi_gui_update_connect_button(window);
 }
 
 static void
 nordi_gui_update_account_data(nordi_gui_ptr window) {
-    if (str_is_empty(window->nordvpn_session->user)) {
-        gtk_label_set_label(window->email_label, "");
-        gtk_label_set_label(window->expire_label, "");
-        gtk_widget_set_visible(GTK_WIDGET(window->login_button), true);
-        gtk_widget_set_visible(GTK_WIDGET(window->logout_button), false);
-    } else {
-        gtk_label_set_label(window->email_label, str_ptr(window->nordvpn_session->user));
-        gtk_label_set_label(window->expire_label, str_ptr(window->nordvpn_session->expiry));
-        gtk_widget_set_visible(GTK_WIDGET(window->login_button), false);
-        gtk_widget_set_visible(GTK_WIDGET(window->logout_button), true);
+    nordi_view_set_account(window->view, str_ptr(window->nordvpn_session->user),
+                           str_ptr(window->nordvpn_session->expiry));
+    nordi_gui_schedule_view(window);
+}
+
+// Bus subscriber, the latest connection state of a batch
+static void
+nordi_gui_connection_changed(nordi_bus_event_ptr event, void* context) {
+    nordi_gui_ptr window = NORDI_GUI(context);
+    nordvpn_lock_state();
+    if (window->nordvpn_host->is_online && window->traffic == NULL) {
+        // a fresh tunnel, all traffic on its counters is new
+        nordi_usage_reset_counters(window->usage);
     }
+    nordi_gui_update_vpn_data(window);
+    nordvpn_unlock_state();
+}
+
+// Bus subscriber, the latest account change of a batch
+static void
+nordi_gui_account_changed(nordi_bus_event_ptr event, void* context) {
+    nordvpn_lock_state();
+    nordi_gui_update_account_data(NORDI_GUI(context));
+    nordvpn_unlock_state();
+}
+
+// Bus subscriber, the latest step of a long running task
+static void
+nordi_gui_progress(nordi_bus_event_ptr event, void* context) {
+    nordi_gui_status(NORDI_GUI(context), event->text);
+}
+
+// Bus subscriber, every failure
+static void
+nordi_gui_error(nordi_bus_event_ptr event, void* context) {
+    g_warning("Failed to %s: %s", event->text, str_ptr(nordvpn_error((nordvpn_error_t)event->value)));
+}
+
+static void nordi_gui_schedule_bus(nordi_gui_ptr, int);
+
+static gboolean
+nordi_gui_dispatch_bus(nordi_gui_ptr window) {
+    nordi_watchdog_enter(window->watchdog, __func__);
+    // a disposed window stopped listening
+    if (window->bus != NULL) {
+        nordi_gui_schedule_bus(window, nordi_bus_dispatch(window->bus, nordi_bus_now_ms()));
+    }
+    nordi_watchdog_leave(window->watchdog);
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+nordi_gui_settle_bus(nordi_gui_ptr window) {
+    window->bus_source = 0;
+    return nordi_gui_dispatch_bus(window);
+}
+
+// Dispatch again once the next settled event is due
+static void
+nordi_gui_schedule_bus(nordi_gui_ptr window, int deadline) {
+    if (window->bus_source != 0) {
+        g_source_remove(window->bus_source);
+        window->bus_source = 0;
+    }
+    if (deadline != BUS_NO_DEADLINE) {
+        window->bus_source = g_timeout_add_full(G_PRIORITY_DEFAULT, deadline, G_SOURCE_FUNC(nordi_gui_settle_bus),
+                                                g_object_ref(window), g_object_unref);
+    }
+}
+
+// Bus wake callback, runs on the publishing thread once per batch
+static void
+nordi_gui_wake_bus(void* context) {
+    g_idle_add_full(G_PRIORITY_DEFAULT, G_SOURCE_FUNC(nordi_gui_dispatch_bus), g_object_ref(NORDI_GUI(context)),
+                    g_object_unref);
 }
 
 static void
 nordi_gui_connect(GtkButton* button) {
     nordi_gui_ptr window = get_nordi_gui_from(GTK_WIDGET(button));
+    int selected = nordi_gui_selected(window);
+    if (selected == NO_SELECTION) {
+        return; // the button is insensitive then, an activation may still be on its way
+    }
+    nordi_watchdog_enter(window->watchdog, __func__);
     nordi_routine_cancel(window->helper_routine);
     window->helper_routine = NULL;
-    gtk_widget_set_sensitive(GTK_WIDGET(button), false);
-    gtk_statusbar_push(window->status_bar, 0, "Connecting...");
-    str server = nordvpn_node_from_index(gtk_combo_box_get_active(GTK_COMBO_BOX(window->country_combo)));
-    nordvpn_error_t result = nordvpn_server_connect(server);
-    if (!window->nordvpn_host->is_online) {
-        g_warning("Failed to connect to NordVPN");
-        gtk_statusbar_push(window->status_bar, 0, "Failed to connect to the server");
+    nordvpn_lock_state();
+    window->is_switching = window->nordvpn_host->is_online;
+    nordvpn_unlock_state();
+    nordi_gui_status(window, window->is_switching ? "Switching..." : "Connecting...");
+    const char* node = nordi_entries_node(window->entries, selected);
+    str server = node != NULL ? str_ref(node) : str_null, probed = str_null;
+    const char* filtered = NULL;
+    if (selected < NEAREST_INDEX && nordi_gui_is_filtering(window)) {
+        // the fastest of the least loaded matches if they were probed already, failing that the least loaded
+        if (nordi_speculation_take(window->speculation, selected, 0, &probed)) {
+            server = probed;
+        } else if (nordi_gui_filtered(window, selected, &filtered, 1) == 1) {
+            server = str_ref(filtered);
+        } else {
+            nordi_gui_status(window, "No server has the checked features, connecting to the selection...");
+        }
+    } else if (gtk_check_button_get_active(window->smart_check) && selected <= COUNTRY_COUNT) {
+        // the speculation ranked the best known servers by their round trip already, failing that the history
+        // alone decides. Automatic picks among every country, groups aren't learned per server.
+        if (nordi_speculation_take(window->speculation, selected, 0, &probed)) {
+            server = probed;
+        } else {
+            const char* best = nordi_selector_best(window->selector, selected - 1, time(NULL));
+            if (best != NULL) {
+                server = str_ref(best);
+            }
+        }
+    } else if (selected == NEAREST_INDEX) {
+        // the fastest of the nearest if they were probed already, failing that the nearest one
+        nordi_geo_result_t nearest;
+        if (nordi_speculation_take(window->speculation, selected, 0, &probed)) {
+            server = probed;
+        } else if (nordi_gui_nearest(window, &nearest, 1) == 1) {
+            str_cpy(&probed, str_ref(nearest.name));
+            server = probed;
+        } else {
+            nordi_gui_status(window, "No location or catalog, connecting automatically...");
+        }
+    }
+    nordi_queue_push(window->queue, COMMAND_CONNECT, server, selected);
+    str_free(probed);
+    nordi_watchdog_leave(window->watchdog);
+}
+
+static void
+nordi_gui_connect_done(nordi_gui_ptr window, nordi_gui_result_t* done) {
+    nordi_history_event_t event = done->type == COMMAND_RECONNECT ? EVENT_RECONNECT : EVENT_CONNECT;
+    if (done->result != OK || !window->nordvpn_host->is_online) {
+        if (done->result == OK) {
+            // an error was published already otherwise
+            g_warning("Failed to connect to NordVPN");
+        }
+        // the server that failed if the daemon got as far as naming it, a country or group asked for otherwise
+        str requested = event == EVENT_RECONNECT ? window->nordvpn_host->last_server : done->server;
+        if (!str_is_empty(window->nordvpn_host->tried_server)) {
+            requested = window->nordvpn_host->tried_server;
+        }
+        nordi_gui_record(window, event, str_ptr(requested), done->result != OK ? done->result : UNKNOWN_ERROR);
+        nordi_gui_status(window, done->type == COMMAND_RECONNECT ? "Failed to reconnect" : "Failed to connect to the server");
+        return;
+    }
+    window->connected_index = done->tag;
+    // a switch ends the session on the previous server
+    nordi_gui_record(window, EVENT_DISCONNECT, window->session_server, OK);
+    nordi_gui_record(window, event, str_ptr(window->nordvpn_host->last_server), OK);
+    nordi_gui_start_session(window);
+    // the connection itself is shown from its bus event, which may have come first
+    nordi_gui_update_connect_button(window);
+    char text[MAX_STATUS_TEXT];
+    bool is_switch = done->type == COMMAND_CONNECT && window->is_switching;
+    snprintf(text, MAX_STATUS_TEXT, "%s in %.1fs", is_switch ? "Switched" : "Connected", window->nordvpn_host->connect_ms / 1000.0);
+    nordi_gui_status(window, text);
+    if (window->nordvpn_host->is_partial) {
+        // reading the status after the connect failed, try again now the connection is shown
+        nordi_queue_push(window->queue, COMMAND_SYNC, str_null, 0);
     }
-    nordi_gui_update_vpn_data(window);
-    gtk_widget_set_sensitive(GTK_WIDGET(button), true);
-    nordi_gui_notify(window);
 }
 
 static void
 nordi_gui_disconnect(GtkButton* button) {
-    gtk_widget_set_sensitive(GTK_WIDGET(button), false);
     nordi_gui_ptr window = get_nordi_gui_from(GTK_WIDGET(button));
-    gtk_statusbar_push(window->status_bar, 0, "Disconnecting...");
-    nordvpn_error_t result = nordvpn_disconnect();
+    nordi_watchdog_enter(window->watchdog, __func__);
+    nordi_routine_cancel(window->helper_routine);
+    window->helper_routine = NULL;
+    nordi_gui_status(window, "Disconnecting...");
+    nordi_queue_push(window->queue, COMMAND_DISCONNECT, str_null, 0);
+    nordi_watchdog_leave(window->watchdog);
+}
+
+static void
+nordi_gui_disconnect_done(nordi_gui_ptr window, nordi_gui_result_t* done) {
     if (window->nordvpn_host->is_online) {
-        g_warning("Failed to disconnect from NordVPN");
-        gtk_statusbar_push(window->status_bar, 0, "Failed to disconnect from the server");
+        if (done->result == OK) {
+            // an error was published already otherwise
+            g_warning("Failed to disconnect from NordVPN");
+        }
+        nordi_gui_status(window, "Failed to disconnect from the server");
+    } else {
+        // only a pause leaves a routine waiting behind its disconnect
+        bool is_pause = window->helper_routine != NULL;
+        nordi_gui_record(window, is_pause ? EVENT_PAUSE : EVENT_DISCONNECT, window->session_server, done->result);
     }
-    nordi_gui_update_vpn_data(window);
-    gtk_widget_set_sensitive(GTK_WIDGET(button), true);
-    nordi_gui_notify(window);
+}
+
+// Weak reference callback, the dialog was finalized
+static void
+nordi_gui_dialog_finalized(gpointer size, GObject* dialog) {
+    nordi_resources_release(RESOURCE_GUI, GPOINTER_TO_SIZE(size));
+}
+
+// Account a dialog to the gui until it is finalized, so one kept alive after it closed shows as a leak
+static void
+nordi_gui_track_dialog(GtkDialog* dialog) {
+    GTypeQuery query;
+    g_type_query(G_OBJECT_TYPE(dialog), &query);
+    nordi_resources_alloc(RESOURCE_GUI, query.instance_size);
+    g_object_weak_ref(G_OBJECT(dialog), nordi_gui_dialog_finalized, GSIZE_TO_POINTER(query.instance_size));
 }
 
 static void
 nordi_gui_login_refresh(GtkWindow* window) {
-    nordvpn_refresh();
     nordi_gui_ptr nordi = NORDI_GUI(window);
-    nordi_gui_update_account_data(nordi);
+    nordi_queue_push(nordi->queue, COMMAND_REFRESH, str_null, 0);
     gtk_window_destroy(nordi->dialog);
     nordi->dialog = NULL;
 }
@@ -150,17 +1252,22 @@ nordi_gui_login_refresh(GtkWindow* window) {
 static void
 nordi_gui_login(GtkButton* button) {
     nordi_gui_ptr window = get_nordi_gui_from(GTK_WIDGET(button));
-    str login_link = str_null;
-    nordvpn_error_t error = nordvpn_login(&login_link);
-    if (error != OK || str_is_empty(login_link)) {
-        gtk_statusbar_push(window->status_bar, 0, "Failed to get login link");
+    nordi_watchdog_enter(window->watchdog, __func__);
+    nordi_queue_push(window->queue, COMMAND_LOGIN, str_null, 0);
+    nordi_watchdog_leave(window->watchdog);
+}
+
+static void
+nordi_gui_login_done(nordi_gui_ptr window, nordi_gui_result_t* done) {
+    if (done->result != OK || str_is_empty(done->link)) {
+        nordi_gui_status(window, "Failed to get login link");
         return;
     }
     nordi_gui_update_account_data(window);
     GtkDialog* dialog = gtk_dialog_new_with_buttons("Login to NordVPN", GTK_WINDOW(window), 0, "Ok", GTK_RESPONSE_NONE, NULL);
     GtkBox* content = gtk_dialog_get_content_area(dialog);
     GtkLabel* tip = gtk_label_new("2. Hit 'Ok' after finishing.");
-    GtkLinkButton* link = gtk_link_button_new_with_label(str_ptr(login_link), "1. Click to log in to NordVPN.");
+    GtkLinkButton* link = gtk_link_button_new_with_label(str_ptr(done->link), "1. Click to log in to NordVPN.");
     gtk_widget_set_margin_start(GTK_WIDGET(content), 10);
     gtk_widget_set_margin_end(GTK_WIDGET(content), 10);
     gtk_widget_set_margin_top(GTK_WIDGET(content), 10);
@@ -171,6 +1278,7 @@ nordi_gui_login(GtkButton* button) {
     gtk_widget_set_halign(GTK_WIDGET(tip), GTK_ALIGN_START);
     gtk_widget_set_halign(GTK_WIDGET(link), GTK_ALIGN_START);
     window->dialog = dialog;
+    nordi_gui_track_dialog(dialog);
     g_signal_connect_swapped(dialog, "response", G_CALLBACK(nordi_gui_login_refresh), window);
     gtk_widget_show(dialog);
 }
@@ -178,22 +1286,122 @@ nordi_gui_login(GtkButton* button) {
 static void
 nordi_gui_logout(GtkButton* button) {
     nordi_gui_ptr window = get_nordi_gui_from(GTK_WIDGET(button));
+    nordi_watchdog_enter(window->watchdog, __func__);
     nordi_routine_cancel(window->helper_routine);
     window->helper_routine = NULL;
-    nordvpn_logout();
-    nordi_gui_update_account_data(window);
-    nordi_gui_update_vpn_data(window);
+    nordi_queue_push(window->queue, COMMAND_LOGOUT, str_null, 0);
+    nordi_watchdog_leave(window->watchdog);
+}
+
+// Update the UI with a finished command, on the main thread
+static gboolean
+nordi_gui_apply_result(nordi_gui_result_t* done) {
+    nordi_gui_ptr window = done->window;
+    nordi_watchdog_enter(window->watchdog, __func__);
+    // a superseded command has nothing to show, and a disposed window has nothing to show it on
+    if (done->result != CANCELLED && window->queue != NULL) {
+        nordvpn_lock_state();
+        switch (done->type) {
+            case COMMAND_CONNECT:
+            case COMMAND_RECONNECT:
+                nordi_gui_connect_done(window, done);
+                break;
+            case COMMAND_DISCONNECT:
+                nordi_gui_disconnect_done(window, done);
+                break;
+            case COMMAND_LOGIN:
+                nordi_gui_login_done(window, done);
+                break;
+            case COMMAND_LOGOUT:
+                // logging out drops the connection, ending the session
+                if (!window->nordvpn_host->is_online) {
+                    nordi_gui_record(window, EVENT_DISCONNECT, window->session_server, done->result);
+                }
+                break;
+            default:
+                // connection and account changes arrive as bus events
+                break;
+        }
+        nordvpn_unlock_state();
+    }
+    nordi_watchdog_leave(window->watchdog);
+    nordi_resources_str_clear(RESOURCE_GUI, &(done->server));
+    nordi_resources_str_clear(RESOURCE_GUI, &(done->link));
+    g_object_unref(window);
+    g_free(done);
+    nordi_resources_release(RESOURCE_GUI, sizeof(nordi_gui_result_t));
+    return G_SOURCE_REMOVE;
 }
 
+// Publish what a finished command changed
 static void
-nordi_gui_pause_end(nordi_gui_ptr window) {
-    nordvpn_error_t error = nordvpn_reconnect();
-    if (error == OK) {
-        nordi_gui_notify(window);
-        nordi_gui_update_vpn_data(window);
+nordi_gui_publish_command(nordi_bus_ptr bus, nordi_command_ptr command) {
+    if (command->result == CANCELLED) {
         return;
     }
-    gtk_statusbar_push(window->status_bar, 0, "Failed to reconnect");
+    if (command->result != OK) {
+        nordi_bus_publish(bus, BUS_ERROR, command->result, COMMAND_TASKS[command->type]);
+    }
+    switch (command->type) {
+        case COMMAND_CONNECT:
+        case COMMAND_RECONNECT:
+        case COMMAND_DISCONNECT:
+        case COMMAND_LOGOUT:
+        case COMMAND_REFRESH:
+        case COMMAND_SYNC:
+        case COMMAND_STATUS: {
+            // failures too, a failed connect or disconnect leaves the tunnel in some state the window must show
+            nordvpn_lock_state();
+            nordvpn_host_ptr host = nordvpn_get_host();
+            bool is_online = host->is_online;
+            char hostname[BUS_MAX_TEXT];
+            snprintf(hostname, BUS_MAX_TEXT, "%s", is_online ? str_ptr(host->hostname) : "");
+            nordvpn_unlock_state();
+            nordi_bus_publish(bus, BUS_CONNECTION, is_online, hostname);
+            break;
+        }
+        default:
+            break;
+    }
+    if (command->result == OK && (command->type == COMMAND_LOGOUT || command->type == COMMAND_REFRESH)) {
+        nordi_bus_publish(bus, BUS_ACCOUNT, 0, NULL);
+    }
+}
+
+// Queue callback, runs on the queue worker thread
+static void
+nordi_gui_command_done(nordi_command_ptr command, void* context) {
+    bool is_connect = command->type == COMMAND_CONNECT || command->type == COMMAND_RECONNECT;
+    if (is_connect && command->result == OK) {
+        // the history records the technology, which connecting doesn't report: the settings know it, read once
+        // and kept up to date by applying them
+        nordvpn_lock_state();
+        bool is_known = nordvpn_get_settings()->is_known;
+        nordvpn_unlock_state();
+        if (!is_known) {
+            nordvpn_read_settings();
+        }
+    }
+    nordi_gui_publish_command(NORDI_GUI(context)->bus, command);
+    nordi_gui_result_t* done = g_new0(nordi_gui_result_t, 1);
+    nordi_resources_alloc(RESOURCE_GUI, sizeof(nordi_gui_result_t));
+    done->window = g_object_ref(NORDI_GUI(context));
+    done->type = command->type;
+    done->result = command->result;
+    done->tag = command->tag;
+    if (!str_is_empty(command->server)) {
+        nordi_resources_str_cpy(RESOURCE_GUI, &(done->server), command->server);
+    }
+    if (!str_is_empty(command->link)) {
+        nordi_resources_str_cpy(RESOURCE_GUI, &(done->link), command->link);
+    }
+    g_idle_add(G_SOURCE_FUNC(nordi_gui_apply_result), done);
+}
+
+// Routine callback, runs on the routine thread once the pause is over
+static void
+nordi_gui_pause_end(nordi_gui_ptr window) {
+    nordi_queue_push(window->queue, COMMAND_RECONNECT, str_null, window->paused_index);
 }
 
 static void
@@ -206,22 +1414,22 @@ nordi_gui_pause_start(nordi_gui_ptr window, int response) {
     GtkBox* content = gtk_dialog_get_content_area(window->dialog);
     GtkSpinButton* minutes = gtk_widget_get_last_child(GTK_WIDGET(content));
     int delay = gtk_spin_button_get_value_as_int(minutes) * SECONDS_IN_A_MINUTE;
+    window->paused_index = window->connected_index;
     window->helper_routine = nordi_routine_new(nordi_gui_pause_end, window, delay);
     if (window->helper_routine == NULL) {
         gtk_window_destroy(window->dialog);
         window->dialog = NULL;
         return; // routine failed to create
     }
-    nordvpn_disconnect();
-    nordi_gui_update_vpn_data(window);
+    nordi_queue_push(window->queue, COMMAND_DISCONNECT, str_null, 0);
     gtk_window_destroy(window->dialog);
     window->dialog = NULL;
-    nordi_gui_notify(window);
 }
 
 static void
 nordi_gui_pause(GtkButton* button) {
     nordi_gui_ptr window = get_nordi_gui_from(GTK_WIDGET(button));
+    nordi_watchdog_enter(window->watchdog, __func__);
     GtkDialog* dialog = gtk_dialog_new_with_buttons("Pause VPN", GTK_WINDOW(window), 0, "Pause", GTK_RESPONSE_OK, NULL);
     GtkBox* content = gtk_dialog_get_content_area(dialog);
     GtkLabel* label = gtk_label_new("Minutes");
@@ -238,14 +1446,43 @@ nordi_gui_pause(GtkButton* button) {
     gtk_widget_set_halign(GTK_WIDGET(label), GTK_ALIGN_START);
     gtk_widget_set_halign(GTK_WIDGET(minutes), GTK_ALIGN_END);
     window->dialog = dialog;
+    nordi_gui_track_dialog(dialog);
     g_signal_connect_swapped(dialog, "response", G_CALLBACK(nordi_gui_pause_start), window);
     gtk_widget_show(dialog);
+    nordi_watchdog_leave(window->watchdog);
 }
 
 static void
 nordi_gui_init(nordi_gui_ptr window) {
     gtk_widget_init_template(GTK_WIDGET(window));
     window->helper_routine = NULL;
+    window->connected_index = NO_SELECTION;
+    window->paused_index = NO_SELECTION;
+    window->selected_index = NO_SELECTION;
+    window->catalog_cancel = -1;
+    window->speed_endpoint = str_null;
+    window->view = nordi_view_new();
+    window->bus = nordi_bus_new(nordi_gui_wake_bus, window);
+    window->refresh = nordi_refresh_new();
+    window->resources = nordi_resources_new();
+    if (window->view == NULL || window->bus == NULL || window->refresh == NULL || window->resources == NULL) {
+        g_error("Failed to allocate the view model, the event bus, the refresh policy and the resources history");
+    }
+    nordi_bus_subscribe(window->bus, BUS_CONNECTION, BUS_LATEST, 0, nordi_gui_connection_changed, window);
+    nordi_bus_subscribe(window->bus, BUS_CONNECTION, BUS_SETTLED, BUS_DEFAULT_SETTLE_MS, nordi_gui_notify, window);
+    nordi_bus_subscribe(window->bus, BUS_ACCOUNT, BUS_LATEST, 0, nordi_gui_account_changed, window);
+    nordi_bus_subscribe(window->bus, BUS_PROGRESS, BUS_LATEST, 0, nordi_gui_progress, window);
+    nordi_bus_subscribe(window->bus, BUS_ERROR, BUS_EVERY, 0, nordi_gui_error, window);
+    window->quality_task = nordi_refresh_add(window->refresh, QUALITY_INTERVAL_MS,
+                                             (nordi_refresh_func_t)nordi_gui_update_quality, window);
+    window->usage_task =
+        nordi_refresh_add(window->refresh, USAGE_INTERVAL_MS, (nordi_refresh_func_t)nordi_gui_update_usage, window);
+    // the first snapshot is the baseline the trends start from
+    nordi_resources_snapshot(window->resources, nordi_gui_now_ms());
+    window->resources_source = g_timeout_add_seconds(RESOURCES_PERIOD_MS / 1000,
+                                                     G_SOURCE_FUNC(nordi_gui_snapshot_resources), window);
+    window->power_monitor = g_power_profile_monitor_dup_default();
+    nordi_gui_start_watchdog(window);
     // Load icons
     GtkIconTheme_autoptr theme = gtk_icon_theme_get_for_display(gdk_display_get_default());
     gtk_icon_theme_add_resource_path(theme, ICONS_PATH);
@@ -258,39 +1495,204 @@ nordi_gui_init(nordi_gui_ptr window) {
     // Setup NordVPN API
     window->nordvpn_session = nordvpn_get_session();
     window->nordvpn_host = nordvpn_get_host();
+    // Throughput graph, sampling pauses while it is unmapped
+    window->traffic_graph = nordi_graph_new();
+    gtk_grid_attach(window->vpn_grid, GTK_WIDGET(window->traffic_graph), 1, 6, 1, 1);
+    g_signal_connect_swapped(window->traffic_graph, "map", G_CALLBACK(nordi_gui_traffic_mapped), window);
+    g_signal_connect_swapped(window->traffic_graph, "unmap", G_CALLBACK(nordi_gui_traffic_mapped), window);
+    nordi_gui_open_usage(window);
+    nordi_gui_open_history(window);
+    nordi_gui_open_catalog(window);
+    // Populate information on widgets
+    const char* labels[SERVER_INDEX];
+    const char* nodes[SERVER_INDEX];
+    labels[0] = "Automatic";
+    nodes[0] = NULL;
+    for (int server = 1; server < NEAREST_INDEX; server++) {
+        labels[server] = nodes[server] = str_ptr(nordvpn_node_from_index(server));
+    }
+    labels[NEAREST_INDEX] = "Nearest";
+    nodes[NEAREST_INDEX] = NULL;
+    // the checks come first, filling the servers reads them
+    for (int option = 0; option < FILTER_OPTION_COUNT; option++) {
+        window->filter_checks[option] = GTK_CHECK_BUTTON(gtk_check_button_new_with_label(FILTER_OPTIONS[option].label));
+        gtk_box_append(window->filter_box, GTK_WIDGET(window->filter_checks[option]));
+    }
+    window->entries = nordi_entries_new();
+    window->server_selection = gtk_single_selection_new(G_LIST_MODEL(g_object_ref(window->entries)));
+    gtk_single_selection_set_autoselect(window->server_selection, false);
+    gtk_single_selection_set_can_unselect(window->server_selection, true);
+    nordi_entries_splice(window->entries, 0, labels, nodes, SERVER_INDEX);
+    nordi_gui_fill_servers(window);
+    GtkListItemFactory* factory = gtk_signal_list_item_factory_new();
+    g_signal_connect(factory, "setup", G_CALLBACK(nordi_gui_setup_row), NULL);
+    g_signal_connect(factory, "bind", G_CALLBACK(nordi_gui_bind_row), NULL);
+    gtk_list_view_set_model(window->server_list, GTK_SELECTION_MODEL(window->server_selection));
+    gtk_list_view_set_factory(window->server_list, factory);
+    g_object_unref(factory);
+    nordi_gui_select(window, 0);
+    window->selected_index = 0;
+    nordi_gui_update_connect_button(window);
     if (window->nordvpn_session->is_active) {
+        if (window->nordvpn_host->is_online) {
+            // select the country of the current connection, so another selection means a switch
+            window->connected_index = (int)window->nordvpn_host->country + 1;
+            window->selected_index = window->connected_index;
+            nordi_gui_select(window, window->connected_index);
+            nordi_gui_start_session(window);
+        }
         nordi_gui_update_vpn_data(window);
         nordi_gui_update_account_data(window);
+        window->is_notified_online = window->nordvpn_host->is_online;
         gtk_label_set_label(window->version_label, str_ptr(window->nordvpn_session->version));
     } else {
-        gtk_statusbar_push(window->status_bar, 0, "Session failed to start");
+        // offline and logged out, so connect and login stay offered for when the daemon comes back
+        nordi_view_set_connection(window->view, false, NULL, NULL);
+        nordi_gui_update_connect_button(window);
+        nordi_gui_update_account_data(window);
+        nordi_gui_status(window, "Session failed to start");
         gtk_label_set_label(window->version_label, "NordVPN not found");
     }
-    // Populate information on widgets
-    for (int server = 0; server < COUNTRY_COUNT + GROUP_COUNT; server++) {
-        str next_server = server < COUNTRY_COUNT ? NORDVPN_COUNTRY_STR[server] : NORDVPN_GROUP_STR[server - COUNTRY_COUNT];
-        gtk_combo_box_text_append_text(GTK_WIDGET(window->country_combo), str_ptr(next_server));
+    window->queue = nordi_queue_new(nordi_gui_command_done, window);
+    if (window->queue == NULL) {
+        g_critical("Failed to start the NordVPN command queue");
+    }
+    window->speculation = nordi_speculation_new(NULL);
+    if (window->speculation == NULL) {
+        g_warning("Failed to start the server speculation");
     }
     // Associate callbacks
+    g_signal_connect_swapped(window->server_selection, "notify::selected", G_CALLBACK(nordi_gui_server_changed), window);
+    g_signal_connect_swapped(window->server_search, "search-changed", G_CALLBACK(nordi_gui_server_searched), window);
+    g_signal_connect_swapped(window->smart_check, "toggled", G_CALLBACK(nordi_gui_speculate), window);
+    for (int option = 0; option < FILTER_OPTION_COUNT; option++) {
+        g_signal_connect_swapped(window->filter_checks[option], "toggled", G_CALLBACK(nordi_gui_filter_toggled),
+                                 window);
+    }
     g_signal_connect(window->connect_button, "clicked", G_CALLBACK(nordi_gui_connect), NULL);
     g_signal_connect(window->disconnect_button, "clicked", G_CALLBACK(nordi_gui_disconnect), NULL);
     g_signal_connect(window->pause_button, "clicked", G_CALLBACK(nordi_gui_pause), NULL);
+    g_signal_connect(window->speed_button, "clicked", G_CALLBACK(nordi_gui_speedtest), NULL);
     g_signal_connect(window->login_button, "clicked", G_CALLBACK(nordi_gui_login), NULL);
     g_signal_connect(window->logout_button, "clicked", G_CALLBACK(nordi_gui_logout), NULL);
+    g_signal_connect(window, "notify::is-active", G_CALLBACK(nordi_gui_refresh_state), NULL);
+    g_signal_connect(window, "notify::visible", G_CALLBACK(nordi_gui_refresh_state), NULL);
+    g_signal_connect(window, "realize", G_CALLBACK(nordi_gui_watch_surface), NULL);
+    if (window->power_monitor != NULL) {
+        g_signal_connect_object(window->power_monitor, "notify::power-saver-enabled",
+                                G_CALLBACK(nordi_gui_refresh_state), window, G_CONNECT_SWAPPED);
+    }
+    window->diagnostics_source =
+        g_unix_signal_add(DIAGNOSTICS_SIGNAL, G_SOURCE_FUNC(nordi_gui_dump_diagnostics), window);
+}
+
+static void
+nordi_gui_dispose(GObject* object) {
+    nordi_gui_ptr window = NORDI_GUI(object);
+    nordi_routine_cancel(window->helper_routine);
+    window->helper_routine = NULL;
+    nordi_queue_free(window->queue);
+    window->queue = NULL;
+    nordi_speculation_free(window->speculation);
+    window->speculation = NULL;
+    if (window->is_catalog_refreshing) {
+        uint64_t signal = 1;
+        ssize_t written;
+        // should it still fail, the refresh isn't cut short but its own timeouts end it
+        do {
+            written = write(window->catalog_cancel, &signal, sizeof(signal));
+        } while (written < 0 && errno == EINTR);
+        thrd_join(window->catalog_thread, NULL);
+        window->is_catalog_refreshing = false;
+    }
+    if (window->catalog_cancel >= 0) {
+        close(window->catalog_cancel);
+        window->catalog_cancel = -1;
+    }
+    if (window->is_speed_testing) {
+        window->speed_cancel = true;
+        thrd_join(window->speed_thread, NULL);
+        window->is_speed_testing = false;
+    }
+    str_clear(&(window->speed_endpoint));
+    if (window->view_tick != 0) {
+        gtk_widget_remove_tick_callback(GTK_WIDGET(window), window->view_tick);
+        window->view_tick = 0;
+    }
+    nordi_view_free(window->view);
+    window->view = NULL;
+    // the queue and the catalog refresh, its publishers, are done by now
+    if (window->bus_source != 0) {
+        g_source_remove(window->bus_source);
+        window->bus_source = 0;
+    }
+    nordi_bus_free(window->bus);
+    window->bus = NULL;
+    nordi_geo_free(window->geo);
+    window->geo = NULL;
+    nordi_filter_free(window->filter);
+    window->filter = NULL;
+    nordi_catalog_close(window->catalog);
+    window->catalog = NULL;
+    g_clear_object(&window->server_selection);
+    g_clear_object(&window->entries);
+    nordi_gui_stop_monitor(window);
+    nordi_gui_stop_traffic(window);
+    window->traffic_graph = NULL;
+    if (window->refresh_source != 0) {
+        g_source_remove(window->refresh_source);
+        window->refresh_source = 0;
+    }
+    nordi_refresh_free(window->refresh);
+    window->refresh = NULL;
+    g_clear_object(&window->power_monitor);
+    if (window->diagnostics_source != 0) {
+        g_source_remove(window->diagnostics_source);
+        window->diagnostics_source = 0;
+    }
+    if (window->resources_source != 0) {
+        g_source_remove(window->resources_source);
+        window->resources_source = 0;
+    }
+    nordi_resources_free(window->resources);
+    window->resources = NULL;
+    if (window->watchdog != NULL) {
+        nordi_watchdog_write(window->watchdog, stderr);
+        nordi_watchdog_free(window->watchdog);
+        window->watchdog = NULL;
+    }
+    nordi_usage_close(window->usage);
+    window->usage = NULL;
+    nordi_selector_free(window->selector);
+    window->selector = NULL;
+    nordi_history_close(window->history);
+    window->history = NULL;
+    G_OBJECT_CLASS(nordi_gui_parent_class)->dispose(object);
 }
 
 static void
 nordi_gui_class_init(nordi_gui_class class) {
+    G_OBJECT_CLASS(class)->dispose = nordi_gui_dispose;
     gtk_widget_class_set_template_from_resource(GTK_WIDGET_CLASS(class), "/nordi/nordi.ui");
     GtkWidgetClass* widget_class = GTK_WIDGET_CLASS(class);
     // Populate template references
-    gtk_widget_class_bind_template_child(widget_class, nordi_gui_t, country_combo);
+    gtk_widget_class_bind_template_child(widget_class, nordi_gui_t, vpn_grid);
+    gtk_widget_class_bind_template_child(widget_class, nordi_gui_t, server_search);
+    gtk_widget_class_bind_template_child(widget_class, nordi_gui_t, server_list);
     gtk_widget_class_bind_template_child(widget_class, nordi_gui_t, connect_button);
     gtk_widget_class_bind_template_child(widget_class, nordi_gui_t, disconnect_button);
     gtk_widget_class_bind_template_child(widget_class, nordi_gui_t, pause_button);
+    gtk_widget_class_bind_template_child(widget_class, nordi_gui_t, smart_check);
+    gtk_widget_class_bind_template_child(widget_class, nordi_gui_t, filter_box);
     gtk_widget_class_bind_template_child(widget_class, nordi_gui_t, status_bar);
     gtk_widget_class_bind_template_child(widget_class, nordi_gui_t, ip_label);
     gtk_widget_class_bind_template_child(widget_class, nordi_gui_t, host_label);
+    gtk_widget_class_bind_template_child(widget_class, nordi_gui_t, quality_label);
+    gtk_widget_class_bind_template_child(widget_class, nordi_gui_t, usage_label);
+    gtk_widget_class_bind_template_child(widget_class, nordi_gui_t, speed_target);
+    gtk_widget_class_bind_template_child(widget_class, nordi_gui_t, speed_streams);
+    gtk_widget_class_bind_template_child(widget_class, nordi_gui_t, speed_label);
+    gtk_widget_class_bind_template_child(widget_class, nordi_gui_t, speed_button);
     gtk_widget_class_bind_template_child(widget_class, nordi_gui_t, version_label);
     gtk_widget_class_bind_template_child(widget_class, nordi_gui_t, email_label);
     gtk_widget_class_bind_template_child(widget_class, nordi_gui_t, expire_label);
@@ -300,8 +1702,20 @@ nordi_gui_class_init(nordi_gui_class class) {
 
 nordi_gui_ptr
 nordi_gui_new(nordi_app_ptr app) {
-    return g_object_new(NORDI_GUI_TYPE, "application", app, NULL);
+    nordi_gui_ptr window = g_object_new(NORDI_GUI_TYPE, "application", app, NULL);
+    // an idle session pauses the refresh, the application only exists once constructed
+    g_signal_connect_object(app, "notify::screensaver-active", G_CALLBACK(nordi_gui_refresh_state), window,
+                            G_CONNECT_SWAPPED);
+    return window;
 }
 
 void
-nordi_gui_open(nordi_gui_ptr window, GFile* file) {}
\ No newline at end of file
+nordi_gui_open(nordi_gui_ptr window, GFile* file) {
+    // opened files are allowlists to import, merged into the current one on the queue worker
+    g_autofree char* path = g_file_get_path(file);
+    if (path == NULL) {
+        g_warning("Only local files can be imported into the allowlist");
+        return;
+    }
+    nordi_queue_push(window->queue, COMMAND_ALLOWLIST, str_ref(path), 0);
+}
\ No newline at end of file
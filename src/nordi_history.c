@@ -0,0 +1,354 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "nordi_history.h"
+
+#define HISTORY_MAGIC    "NORDIHST"
+#define HISTORY_VERSION  2
+#define INITIAL_SERVERS  64
+#define FNV_OFFSET       2166136261u
+#define FNV_PRIME        16777619u
+#define TEMPORARY_SUFFIX ".tmp"
+#define ASIDE_SUFFIX     ".old" // journals of an unknown version are moved here
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size; // guards against reading records of another layout
+} history_header_t;
+
+// Record of version 1 journals, before the session quality was recorded
+typedef struct {
+    int64_t time;
+    uint8_t event;
+    uint8_t technology;
+    int16_t country;
+    int32_t error;
+    uint32_t connect_ms;
+    uint32_t session_s;
+    char server[HISTORY_MAX_SERVER];
+} history_record_v1_t;
+
+static uint32_t
+hash_server(const char* server) {
+    uint32_t hash = FNV_OFFSET;
+    for (int index = 0; index < HISTORY_MAX_SERVER && server[index] != '\0'; index++) {
+        hash = (hash ^ (unsigned char)server[index]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+// Slot of the server in the table, either holding it or the empty one it would take
+static nordi_history_server_t*
+find_server(nordi_history_ptr history, const char* server) {
+    unsigned int mask = history->server_capacity - 1;
+    unsigned int slot = hash_server(server) & mask;
+    nordi_history_server_t* servers = history->servers;
+    while (servers[slot].server[0] != '\0' && strncmp(servers[slot].server, server, HISTORY_MAX_SERVER) != 0) {
+        slot = (slot + 1) & mask;
+    }
+    return &history->servers[slot];
+}
+
+static bool
+grow_servers(nordi_history_ptr history) {
+    unsigned int capacity = history->server_capacity > 0 ? history->server_capacity * 2 : INITIAL_SERVERS;
+    nordi_history_server_t* old = history->servers;
+    unsigned int old_capacity = history->server_capacity;
+    history->servers = (nordi_history_server_t*)calloc(capacity, sizeof(nordi_history_server_t));
+    if (history->servers == NULL) {
+        history->servers = old;
+        return false;
+    }
+    history->server_capacity = capacity;
+    for (unsigned int slot = 0; slot < old_capacity; slot++) {
+        if (old[slot].server[0] != '\0') {
+            *find_server(history, old[slot].server) = old[slot];
+        }
+    }
+    free(old);
+    return true;
+}
+
+// 4 buckets per power of two: values below 4 are exact, the rest keep their two bits below the leading one
+static int
+bucket_of(uint32_t ms) {
+    if (ms < 4) {
+        return (int)ms;
+    }
+    int octave = 31 - __builtin_clz(ms);
+    int bucket = 4 + (octave - 2) * 4 + (int)((ms >> (octave - 2)) & 3);
+    return bucket < HISTORY_BUCKETS ? bucket : HISTORY_BUCKETS - 1;
+}
+
+// Middle value of a bucket
+static unsigned int
+bucket_value(int bucket) {
+    if (bucket < 4) {
+        return (unsigned int)bucket;
+    }
+    int octave = (bucket - 4) / 4 + 2;
+    unsigned int low = (unsigned int)(4 + (bucket - 4) % 4) << (octave - 2);
+    return low + ((1u << (octave - 2)) >> 1);
+}
+
+static void
+aggregate(nordi_history_ptr history, const nordi_history_record_t* record) {
+    if (record->server[0] == '\0') {
+        return;
+    }
+    if ((history->server_count + 1) * 4 > history->server_capacity * 3 && !grow_servers(history)) {
+        return;
+    }
+    nordi_history_server_t* server = find_server(history, record->server);
+    if (server->server[0] == '\0') {
+        memcpy(server->server, record->server, HISTORY_MAX_SERVER);
+        server->server[HISTORY_MAX_SERVER - 1] = '\0';
+        history->server_count++;
+    }
+    switch (record->event) {
+        case EVENT_CONNECT:
+        case EVENT_RECONNECT:
+            server->attempts++;
+            if (record->error == 0) {
+                server->successes++;
+                server->buckets[bucket_of(record->connect_ms)]++;
+            }
+            break;
+        default:
+            server->session_s += record->session_s;
+            break;
+    }
+}
+
+// Map all records written so far, replacing the previous mapping
+static bool
+history_map(nordi_history_ptr history) {
+    if (history->map != NULL) {
+        munmap((void*)history->map, history->map_length);
+        history->map = NULL;
+        history->records = NULL;
+        history->mapped = 0;
+    }
+    if (history->count == 0) {
+        return true;
+    }
+    history->map_length = sizeof(history_header_t) + (size_t)history->count * sizeof(nordi_history_record_t);
+    void* map = mmap(NULL, history->map_length, PROT_READ, MAP_SHARED, history->fd, 0);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    history->map = map;
+    history->records = (const nordi_history_record_t*)((const char*)map + sizeof(history_header_t));
+    history->mapped = history->count;
+    return true;
+}
+
+// Rewrite a version 1 journal in the current layout, to a temporary file renamed over it once synced. The fields
+// added since are left unknown, a torn record at the end is dropped.
+static bool
+history_migrate(nordi_history_ptr history, off_t size) {
+    const history_header_t header = {
+        .magic = HISTORY_MAGIC,
+        .version = HISTORY_VERSION,
+        .record_size = sizeof(nordi_history_record_t),
+    };
+    char temporary[HISTORY_MAX_PATH + sizeof(TEMPORARY_SUFFIX)];
+    snprintf(temporary, sizeof(temporary), "%s" TEMPORARY_SUFFIX, history->path);
+    size_t count = (size_t)(size - sizeof(history_header_t)) / sizeof(history_record_v1_t);
+    history_record_v1_t* old = (history_record_v1_t*)calloc(count + 1, sizeof(history_record_v1_t));
+    nordi_history_record_t* records = (nordi_history_record_t*)calloc(count + 1, sizeof(nordi_history_record_t));
+    ssize_t old_length = (ssize_t)(count * sizeof(history_record_v1_t));
+    ssize_t length = (ssize_t)(count * sizeof(nordi_history_record_t));
+    bool is_written = old != NULL && records != NULL
+                      && pread(history->fd, old, old_length, sizeof(history_header_t)) == old_length;
+    for (size_t index = 0; is_written && index < count; index++) {
+        records[index] = (nordi_history_record_t){
+            .time = old[index].time,
+            .event = old[index].event,
+            .technology = old[index].technology,
+            .country = old[index].country,
+            .error = old[index].error,
+            .connect_ms = old[index].connect_ms,
+            .session_s = old[index].session_s,
+        };
+        memcpy(records[index].server, old[index].server, HISTORY_MAX_SERVER);
+    }
+    int fd = is_written ? open(temporary, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600) : -1;
+    is_written = fd >= 0 && pwrite(fd, &header, sizeof(header), 0) == sizeof(header)
+                 && pwrite(fd, records, length, sizeof(header)) == length && fdatasync(fd) == 0;
+    free(old);
+    free(records);
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (!is_written || rename(temporary, history->path) != 0) {
+        unlink(temporary);
+        return false;
+    }
+    return true;
+}
+
+// Bring a journal of another version to the current one and reopen it: version 1 is migrated, anything else is
+// moved aside for a new journal, as its records can't be read
+static bool
+history_upgrade(nordi_history_ptr history, const history_header_t* found, off_t size) {
+    if (found->version == 1 && found->record_size == sizeof(history_record_v1_t)) {
+        if (!history_migrate(history, size)) {
+            return false;
+        }
+    } else {
+        char aside[HISTORY_MAX_PATH + sizeof(ASIDE_SUFFIX)];
+        snprintf(aside, sizeof(aside), "%s" ASIDE_SUFFIX, history->path);
+        if (rename(history->path, aside) != 0) {
+            return false;
+        }
+        fprintf(stderr, "WARNING: history journal version %u is unknown, moved to %s\n", found->version, aside);
+    }
+    close(history->fd);
+    history->fd = open(history->path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    return history->fd >= 0;
+}
+
+static bool
+history_load(nordi_history_ptr history) {
+    struct stat info;
+    if (fstat(history->fd, &info) != 0) {
+        return false;
+    }
+    const history_header_t header = {
+        .magic = HISTORY_MAGIC,
+        .version = HISTORY_VERSION,
+        .record_size = sizeof(nordi_history_record_t),
+    };
+    if (info.st_size < (off_t)sizeof(header)) {
+        // new journal, or one torn before its header made it
+        return ftruncate(history->fd, 0) == 0 && pwrite(history->fd, &header, sizeof(header), 0) == sizeof(header);
+    }
+    history_header_t found;
+    bool is_journal = pread(history->fd, &found, sizeof(found), 0) == sizeof(found);
+    if (!is_journal || memcmp(found.magic, header.magic, sizeof(header.magic)) != 0) {
+        return false; // not a journal, left alone
+    }
+    if (memcmp(&found, &header, sizeof(header)) != 0) {
+        // the upgraded journal has the current header, so this loads it as is
+        return history_upgrade(history, &found, info.st_size) && history_load(history);
+    }
+    history->count = (unsigned int)((info.st_size - sizeof(header)) / sizeof(nordi_history_record_t));
+    // drop a torn record at the end, appends must stay aligned
+    off_t length = sizeof(header) + (off_t)history->count * sizeof(nordi_history_record_t);
+    if (length != info.st_size && ftruncate(history->fd, length) != 0) {
+        return false;
+    }
+    if (!history_map(history)) {
+        return false;
+    }
+    for (unsigned int index = 0; index < history->count; index++) {
+        aggregate(history, &history->records[index]);
+    }
+    return true;
+}
+
+nordi_history_ptr
+nordi_history_open(const char* path) {
+    nordi_history_ptr history = (nordi_history_ptr)calloc(1, sizeof(nordi_history_t));
+    if (history == NULL) {
+        return NULL;
+    }
+    snprintf(history->path, HISTORY_MAX_PATH, "%s", path);
+    history->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (history->fd < 0 || !grow_servers(history) || !history_load(history)) {
+        nordi_history_close(history);
+        return NULL;
+    }
+    return history;
+}
+
+bool
+nordi_history_append(nordi_history_ptr history, const nordi_history_record_t* record) {
+    if (history == NULL || record == NULL) {
+        return false;
+    }
+    nordi_history_record_t entry = *record;
+    if (entry.time == 0) {
+        entry.time = (int64_t)time(NULL);
+    }
+    entry.server[HISTORY_MAX_SERVER - 1] = '\0';
+    off_t offset = sizeof(history_header_t) + (off_t)history->count * sizeof(entry);
+    if (pwrite(history->fd, &entry, sizeof(entry), offset) != sizeof(entry)) {
+        return false;
+    }
+    history->count++;
+    aggregate(history, &entry);
+    return true;
+}
+
+nordi_history_record_ptr
+nordi_history_get(nordi_history_ptr history, unsigned int index) {
+    if (history == NULL || index >= history->count) {
+        return NULL;
+    }
+    // appends don't touch the mapping, extend it only once something past it is read
+    if (index >= history->mapped && !history_map(history)) {
+        return NULL;
+    }
+    return &history->records[index];
+}
+
+bool
+nordi_history_server_stats(nordi_history_ptr history, const char* server, nordi_history_stats_ptr stats) {
+    memset(stats, 0, sizeof(nordi_history_stats_t));
+    if (history == NULL || server == NULL || server[0] == '\0') {
+        return false;
+    }
+    const nordi_history_server_t* found = find_server(history, server);
+    if (found->server[0] == '\0') {
+        return false;
+    }
+    stats->attempts = found->attempts;
+    stats->successes = found->successes;
+    stats->session_s = found->session_s;
+    stats->success_rate = found->attempts > 0 ? (float)found->successes / found->attempts : 0;
+    unsigned int p50_rank = (found->successes + 1) / 2, p95_rank = (found->successes * 95 + 99) / 100;
+    unsigned int seen = 0;
+    for (int bucket = 0; bucket < HISTORY_BUCKETS && seen < p95_rank; bucket++) {
+        bool is_below_median = seen < p50_rank;
+        seen += found->buckets[bucket];
+        if (is_below_median && seen >= p50_rank) {
+            stats->p50_ms = bucket_value(bucket);
+        }
+        if (seen >= p95_rank) {
+            stats->p95_ms = bucket_value(bucket);
+        }
+    }
+    return true;
+}
+
+void
+nordi_history_close(nordi_history_ptr history) {
+    if (history == NULL) {
+        return;
+    }
+    if (history->map != NULL) {
+        munmap((void*)history->map, history->map_length);
+    }
+    if (history->fd >= 0) {
+        close(history->fd);
+    }
+    free(history->servers);
+    free(history);
+}
@@ -0,0 +1,242 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+#include "nordi_dns.h"
+#include "nordi_monitor.h"
+#include "nordi_probe.h"
+
+#define QUERY_ID_MASK 0xffff
+
+static long long
+monitor_now_us() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static void
+monitor_send(nordi_monitor_ptr monitor) {
+    unsigned char query[DNS_MAX_MESSAGE];
+    mtx_lock(&monitor->mutex);
+    unsigned int seq = monitor->next_seq++;
+    nordi_monitor_sample_t* sample = &monitor->ring[seq % MONITOR_RING_SIZE];
+    *sample = (nordi_monitor_sample_t){.seq = seq, .sent_us = monitor_now_us()};
+    mtx_unlock(&monitor->mutex);
+    // the root NS records: the smallest question any resolver answers, the ID carries the sequence
+    int length = nordi_dns_build_query(query, sizeof(query), seq & QUERY_ID_MASK, "", DNS_TYPE_NS);
+    // a failed send is just a lost probe
+    send(monitor->socket, query, length, 0);
+}
+
+static void
+monitor_receive(nordi_monitor_ptr monitor) {
+    unsigned char reply[DNS_MAX_MESSAGE];
+    ssize_t received;
+    while ((received = recv(monitor->socket, reply, sizeof(reply), MSG_DONTWAIT)) >= 0) {
+        if (received < 2) {
+            continue;
+        }
+        unsigned int id = ((unsigned int)reply[0] << 8) | reply[1];
+        long long now = monitor_now_us();
+        mtx_lock(&monitor->mutex);
+        nordi_monitor_sample_t* sample = &monitor->ring[id % MONITOR_RING_SIZE];
+        long long rtt = now - sample->sent_us;
+        // late answers were already counted as lost, keep them that way
+        if ((sample->seq & QUERY_ID_MASK) == id && !sample->is_answered && rtt <= monitor->timeout_ms * 1000LL) {
+            sample->rtt_us = (unsigned int)rtt;
+            sample->is_answered = true;
+        }
+        mtx_unlock(&monitor->mutex);
+    }
+}
+
+static int
+monitor_worker(nordi_monitor_ptr monitor) {
+    struct pollfd fds[] = {
+        {.fd = monitor->timer, .events = POLLIN},
+        {.fd = monitor->socket, .events = POLLIN},
+        {.fd = monitor->stop, .events = POLLIN},
+    };
+    monitor_send(monitor);
+    while (monitor->is_running) {
+        if (poll(fds, 3, -1) < 0) {
+            continue;
+        }
+        atomic_fetch_add(&monitor->wakeups, 1);
+        if (fds[2].revents & POLLIN) {
+            break;
+        }
+        if (fds[1].revents & POLLIN) {
+            monitor_receive(monitor);
+        }
+        if (fds[0].revents & POLLIN) {
+            uint64_t expirations;
+            if (read(monitor->timer, &expirations, sizeof(expirations)) > 0) {
+                monitor_send(monitor);
+            }
+        }
+    }
+    return thrd_success;
+}
+
+static int
+compare_rtt(const void* left, const void* right) {
+    unsigned int a = *(const unsigned int*)left, b = *(const unsigned int*)right;
+    return a < b ? -1 : a > b;
+}
+
+// Probe on every interval from now, a zero interval disarms the timer
+static bool
+monitor_arm(nordi_monitor_ptr monitor, int interval_ms) {
+    struct timespec interval = {.tv_sec = interval_ms / 1000, .tv_nsec = (interval_ms % 1000) * 1000000L};
+    struct itimerspec cadence = {.it_interval = interval, .it_value = interval};
+    return timerfd_settime(monitor->timer, 0, &cadence, NULL) == 0;
+}
+
+static bool
+monitor_open(nordi_monitor_ptr monitor, str target, int interval_ms) {
+    struct addrinfo* address = nordi_probe_resolve(target, PROBE_UDP, DNS_PORT);
+    if (address == NULL) {
+        return false;
+    }
+    monitor->socket = socket(address->ai_family, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    bool is_connected = monitor->socket >= 0 && connect(monitor->socket, address->ai_addr, address->ai_addrlen) == 0;
+    freeaddrinfo(address);
+    monitor->timer = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    monitor->stop = eventfd(0, EFD_CLOEXEC);
+    if (!is_connected || monitor->timer < 0 || monitor->stop < 0) {
+        return false;
+    }
+    return monitor_arm(monitor, interval_ms);
+}
+
+static void
+monitor_close(nordi_monitor_ptr monitor) {
+    int fds[] = {monitor->socket, monitor->timer, monitor->stop};
+    for (int index = 0; index < 3; index++) {
+        if (fds[index] >= 0) {
+            close(fds[index]);
+        }
+    }
+    mtx_destroy(&monitor->mutex);
+    free(monitor);
+}
+
+nordi_monitor_ptr
+nordi_monitor_new(str target, int interval_ms, int timeout_ms) {
+    nordi_monitor_ptr monitor = (nordi_monitor_ptr)calloc(1, sizeof(nordi_monitor_t));
+    if (monitor == NULL) {
+        return NULL;
+    }
+    monitor->socket = monitor->timer = monitor->stop = -1;
+    monitor->timeout_ms = timeout_ms > 0 ? timeout_ms : MONITOR_DEFAULT_TIMEOUT_MS;
+    if (mtx_init(&monitor->mutex, mtx_plain) != thrd_success) {
+        free(monitor);
+        return NULL;
+    }
+    if (str_is_empty(target)) {
+        target = str_lit(MONITOR_DEFAULT_TARGET);
+    }
+    if (!monitor_open(monitor, target, interval_ms > 0 ? interval_ms : MONITOR_DEFAULT_INTERVAL_MS)) {
+        monitor_close(monitor);
+        return NULL;
+    }
+    monitor->is_running = true;
+    if (thrd_create(&monitor->thread, (int (*)(void*))monitor_worker, (void*)monitor) != thrd_success) {
+        monitor_close(monitor);
+        return NULL;
+    }
+    return monitor;
+}
+
+void
+nordi_monitor_stats(nordi_monitor_ptr monitor, nordi_monitor_stats_ptr stats) {
+    memset(stats, 0, sizeof(nordi_monitor_stats_t));
+    if (monitor == NULL) {
+        return;
+    }
+    unsigned int rtts[MONITOR_RING_SIZE];
+    unsigned long long jitter_sum = 0;
+    unsigned int jitter_count = 0;
+    long long now = monitor_now_us();
+    mtx_lock(&monitor->mutex);
+    unsigned int end = monitor->next_seq;
+    unsigned int start = end > MONITOR_RING_SIZE ? end - MONITOR_RING_SIZE : 0;
+    bool has_previous = false;
+    unsigned int previous = 0;
+    // oldest to newest, so the jitter compares consecutive probes
+    for (unsigned int seq = start; seq < end; seq++) {
+        const nordi_monitor_sample_t* sample = &monitor->ring[seq % MONITOR_RING_SIZE];
+        if (!sample->is_answered) {
+            // still in flight until the timeout, lost after it
+            stats->lost += now - sample->sent_us > monitor->timeout_ms * 1000LL;
+            continue;
+        }
+        if (has_previous) {
+            jitter_sum += sample->rtt_us > previous ? sample->rtt_us - previous : previous - sample->rtt_us;
+            jitter_count++;
+        }
+        previous = sample->rtt_us;
+        has_previous = true;
+        rtts[stats->samples++] = sample->rtt_us;
+    }
+    mtx_unlock(&monitor->mutex);
+    if (stats->samples + stats->lost > 0) {
+        stats->loss = 100.0f * stats->lost / (stats->samples + stats->lost);
+    }
+    if (stats->samples == 0) {
+        return;
+    }
+    qsort(rtts, stats->samples, sizeof(unsigned int), compare_rtt);
+    // nearest rank percentiles
+    stats->p50_us = rtts[(stats->samples * 50 + 99) / 100 - 1];
+    stats->p95_us = rtts[(stats->samples * 95 + 99) / 100 - 1];
+    stats->jitter_us = jitter_count > 0 ? (unsigned int)(jitter_sum / jitter_count) : 0;
+}
+
+void
+nordi_monitor_pace(nordi_monitor_ptr monitor, int interval_ms) {
+    if (monitor == NULL) {
+        return;
+    }
+    monitor_arm(monitor, interval_ms > 0 ? interval_ms : 0);
+}
+
+void
+nordi_monitor_free(nordi_monitor_ptr monitor) {
+    if (monitor == NULL) {
+        return;
+    }
+    monitor->is_running = false;
+    uint64_t signal = 1;
+    ssize_t written;
+    do {
+        written = write(monitor->stop, &signal, sizeof(signal));
+    } while (written < 0 && errno == EINTR);
+    if (written != sizeof(signal)) {
+        // a paced down thread may never wake to be joined, it is left running with the monitor rather than block
+        fprintf(stderr, "ERROR: stopping the connection quality monitor: %s\n", strerror(errno));
+        thrd_detach(monitor->thread);
+        return;
+    }
+    thrd_join(monitor->thread, NULL);
+    monitor_close(monitor);
+}
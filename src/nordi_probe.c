@@ -0,0 +1,461 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <threads.h>
+#include <time.h>
+#include <unistd.h>
+#include "nordi_probe.h"
+
+#define MAX_HOST_LENGTH   256
+#define MAX_PORT_LENGTH   8
+#define MAX_EVENTS        32
+#define CANCEL_EVENT      UINT32_MAX
+#define RESOLVED_EVENT    (UINT32_MAX - 1)
+#define RESOLVER_THREADS  4  // lookups running at once, each blocks its thread
+#define UNWATCHED_POLL_MS 10 // how often the cancel and the lookups are checked if epoll can't watch them
+
+const nordi_probe_options_t PROBE_DEFAULT_OPTIONS = {
+    .mode = PROBE_TCP,
+    .port = PROBE_DEFAULT_PORT,
+    .concurrency = PROBE_DEFAULT_CONCURRENCY,
+    .timeout_ms = PROBE_DEFAULT_TIMEOUT_MS,
+};
+
+// a single byte is enough for an echo, and anything listening on UDP at least sees a datagram
+static const char PROBE_PAYLOAD[] = {0};
+
+typedef struct {
+    struct addrinfo* address;
+    bool is_resolved; // the address was taken from the resolver, NULL if the target didn't resolve
+    int socket;
+    long long start_us;
+} probe_t;
+
+// Resolves the targets on a few threads while the probes run. A run stopped early doesn't wait for the lookups
+// still blocking, so the last of the run and its threads to let go of it frees it.
+typedef struct {
+    mtx_t mutex;
+    atomic_int references;
+    int resolved; // eventfd, readable once a target resolved
+    int count;
+    int next; // target to resolve next
+    bool is_stopped;
+    str* targets; // copies, the results may be gone by the time a lookup returns
+    struct addrinfo** addresses;
+    bool* is_resolved;
+    nordi_probe_mode_t mode;
+    int port;
+} resolver_t;
+
+static long long
+now_us() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+// Split "host[:port]" into its host and port strings, port falls back to the default one. IPv6 literals are
+// taken whole, or in brackets when followed by a port ("[::1]:443").
+static bool
+split_target(str target, int default_port, char* host, char* port) {
+    size_t length = str_len(target);
+    const char* chars = str_ptr(target);
+    const char* start = chars;
+    const char* colon = memchr(chars, ':', length);
+    size_t host_length = colon != NULL ? (size_t)(colon - chars) : length;
+    if (length > 0 && chars[0] == '[') {
+        const char* bracket = memchr(chars, ']', length);
+        if (bracket == NULL || (bracket + 1 < chars + length && bracket[1] != ':')) {
+            return false;
+        }
+        start = chars + 1;
+        host_length = bracket - start;
+        colon = bracket + 1 < chars + length ? bracket + 1 : NULL;
+    } else if (colon != NULL && memchr(colon + 1, ':', length - (colon + 1 - chars)) != NULL) {
+        // more than one colon, a bare IPv6 literal
+        colon = NULL;
+        host_length = length;
+    }
+    if (host_length == 0 || host_length >= MAX_HOST_LENGTH) {
+        return false;
+    }
+    memcpy(host, start, host_length);
+    host[host_length] = '\0';
+    if (colon == NULL) {
+        snprintf(port, MAX_PORT_LENGTH, "%d", default_port);
+        return true;
+    }
+    size_t port_length = length - (colon + 1 - chars);
+    if (port_length == 0 || port_length >= MAX_PORT_LENGTH) {
+        return false;
+    }
+    memcpy(port, colon + 1, port_length);
+    port[port_length] = '\0';
+    return true;
+}
+
+struct addrinfo*
+nordi_probe_resolve(str target, nordi_probe_mode_t mode, int default_port) {
+    char host[MAX_HOST_LENGTH], port[MAX_PORT_LENGTH];
+    if (!split_target(target, default_port, host, port)) {
+        return NULL;
+    }
+    struct addrinfo hints = {
+        .ai_family = AF_UNSPEC,
+        .ai_socktype = mode == PROBE_UDP ? SOCK_DGRAM : SOCK_STREAM,
+    };
+    struct addrinfo* address = NULL;
+    if (getaddrinfo(host, port, &hints, &address) != 0) {
+        return NULL;
+    }
+    return address;
+}
+
+static void
+resolver_release(resolver_t* resolver) {
+    if (atomic_fetch_sub(&resolver->references, 1) > 1) {
+        return;
+    }
+    for (int index = 0; index < resolver->count; index++) {
+        if (resolver->addresses[index] != NULL) {
+            freeaddrinfo(resolver->addresses[index]);
+        }
+        str_free(resolver->targets[index]);
+    }
+    close(resolver->resolved);
+    mtx_destroy(&resolver->mutex);
+    free(resolver->targets);
+    free(resolver->addresses);
+    free(resolver->is_resolved);
+    free(resolver);
+}
+
+static int
+resolver_worker(resolver_t* resolver) {
+    mtx_lock(&resolver->mutex);
+    while (!resolver->is_stopped && resolver->next < resolver->count) {
+        int index = resolver->next++;
+        mtx_unlock(&resolver->mutex);
+        struct addrinfo* address = nordi_probe_resolve(resolver->targets[index], resolver->mode, resolver->port);
+        mtx_lock(&resolver->mutex);
+        resolver->addresses[index] = address;
+        resolver->is_resolved[index] = true;
+        uint64_t signal = 1;
+        ssize_t written;
+        // should it still fail, the prober finds the address on its next wakeup instead
+        do {
+            written = write(resolver->resolved, &signal, sizeof(signal));
+        } while (written < 0 && errno == EINTR);
+    }
+    mtx_unlock(&resolver->mutex);
+    resolver_release(resolver);
+    return thrd_success;
+}
+
+// Start resolving the targets in order, on as many threads as are useful
+static resolver_t*
+resolver_new(nordi_probe_result_ptr results, int count, nordi_probe_options_ptr options) {
+    resolver_t* resolver = (resolver_t*)calloc(1, sizeof(resolver_t));
+    if (resolver == NULL) {
+        return NULL;
+    }
+    resolver->targets = (str*)calloc(count, sizeof(str));
+    resolver->addresses = (struct addrinfo**)calloc(count, sizeof(struct addrinfo*));
+    resolver->is_resolved = (bool*)calloc(count, sizeof(bool));
+    resolver->resolved = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (resolver->targets == NULL || resolver->addresses == NULL || resolver->is_resolved == NULL
+        || resolver->resolved < 0 || mtx_init(&resolver->mutex, mtx_plain) != thrd_success) {
+        if (resolver->resolved >= 0) {
+            close(resolver->resolved);
+        }
+        free(resolver->targets);
+        free(resolver->addresses);
+        free(resolver->is_resolved);
+        free(resolver);
+        return NULL;
+    }
+    resolver->count = count;
+    resolver->mode = options->mode;
+    resolver->port = options->port;
+    for (int index = 0; index < count; index++) {
+        str_cpy(&(resolver->targets[index]), results[index].target);
+    }
+    atomic_init(&resolver->references, 1);
+    for (int worker = 0; worker < RESOLVER_THREADS && worker < count; worker++) {
+        thrd_t thread;
+        atomic_fetch_add(&resolver->references, 1);
+        if (thrd_create(&thread, (thrd_start_t)resolver_worker, resolver) == thrd_success) {
+            thrd_detach(thread);
+        } else {
+            // without a thread the lookups left run here, as they used to before probing
+            resolver_worker(resolver);
+        }
+    }
+    return resolver;
+}
+
+// Move a resolved address onto its probe. Returns false if the target isn't resolved yet.
+static bool
+resolver_take(resolver_t* resolver, int index, probe_t* probe) {
+    mtx_lock(&resolver->mutex);
+    bool is_resolved = resolver->is_resolved[index];
+    if (is_resolved) {
+        probe->address = resolver->addresses[index];
+        probe->is_resolved = true;
+        resolver->addresses[index] = NULL;
+    }
+    mtx_unlock(&resolver->mutex);
+    return is_resolved;
+}
+
+// Stop taking targets and let go of the resolver, the lookups still blocking finish on their own
+static void
+resolver_stop(resolver_t* resolver) {
+    mtx_lock(&resolver->mutex);
+    resolver->is_stopped = true;
+    mtx_unlock(&resolver->mutex);
+    resolver_release(resolver);
+}
+
+static void
+probe_finish(probe_t* probe, nordi_probe_result_ptr result, int epoll, nordi_probe_state_t state) {
+    result->state = state;
+    if (state == PROBE_OK) {
+        result->rtt_us = (unsigned int)(now_us() - probe->start_us);
+    }
+    epoll_ctl(epoll, EPOLL_CTL_DEL, probe->socket, NULL);
+    close(probe->socket);
+    probe->socket = -1;
+}
+
+// Open the probe socket and start the measurement. Returns false if the probe finished already.
+static bool
+probe_start(probe_t* probe, nordi_probe_result_ptr result, int epoll, int index, nordi_probe_options_ptr options) {
+    struct addrinfo* address = probe->address;
+    probe->socket = socket(address->ai_family, address->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, address->ai_protocol);
+    if (probe->socket < 0) {
+        result->state = PROBE_UNREACHABLE;
+        return false;
+    }
+    probe->start_us = now_us();
+    struct epoll_event event = {.events = options->mode == PROBE_UDP ? EPOLLIN : EPOLLOUT, .data.u32 = (uint32_t)index};
+    int connected = connect(probe->socket, address->ai_addr, address->ai_addrlen);
+    if (connected < 0 && errno != EINPROGRESS) {
+        result->state = errno == ECONNREFUSED ? PROBE_REFUSED : PROBE_UNREACHABLE;
+        close(probe->socket);
+        probe->socket = -1;
+        return false;
+    }
+    // a probe epoll doesn't watch would only ever time out
+    if ((options->mode == PROBE_UDP && send(probe->socket, PROBE_PAYLOAD, sizeof(PROBE_PAYLOAD), 0) < 0)
+        || epoll_ctl(epoll, EPOLL_CTL_ADD, probe->socket, &event) < 0) {
+        result->state = PROBE_UNREACHABLE;
+        close(probe->socket);
+        probe->socket = -1;
+        return false;
+    }
+    return true;
+}
+
+static void
+probe_event(probe_t* probe, nordi_probe_result_ptr result, int epoll, nordi_probe_options_ptr options) {
+    if (options->mode == PROBE_UDP) {
+        char reply[64];
+        ssize_t received = recv(probe->socket, reply, sizeof(reply), 0);
+        if (received >= 0) {
+            probe_finish(probe, result, epoll, PROBE_OK);
+        } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            // an ICMP port unreachable surfaces here as a refused receive
+            probe_finish(probe, result, epoll, errno == ECONNREFUSED ? PROBE_REFUSED : PROBE_UNREACHABLE);
+        }
+        return;
+    }
+    int error = 0;
+    socklen_t length = sizeof(error);
+    getsockopt(probe->socket, SOL_SOCKET, SO_ERROR, &error, &length);
+    if (error == 0) {
+        probe_finish(probe, result, epoll, PROBE_OK);
+    } else {
+        probe_finish(probe, result, epoll, error == ECONNREFUSED ? PROBE_REFUSED : PROBE_UNREACHABLE);
+    }
+}
+
+static bool
+is_cancelled(int cancel) {
+    struct pollfd check = {.fd = cancel, .events = POLLIN};
+    return cancel >= 0 && poll(&check, 1, 0) > 0;
+}
+
+static int
+compare_results(const void* left, const void* right) {
+    const nordi_probe_result_t* a = (const nordi_probe_result_t*)left;
+    const nordi_probe_result_t* b = (const nordi_probe_result_t*)right;
+    if ((a->state == PROBE_OK) != (b->state == PROBE_OK)) {
+        return a->state == PROBE_OK ? -1 : 1;
+    }
+    if (a->state != PROBE_OK) {
+        return 0;
+    }
+    return a->rtt_us < b->rtt_us ? -1 : a->rtt_us > b->rtt_us;
+}
+
+int
+nordi_probe_run(nordi_probe_result_ptr results, int count, nordi_probe_options_ptr options) {
+    return nordi_probe_run_cancellable(results, count, options, -1);
+}
+
+int
+nordi_probe_run_cancellable(nordi_probe_result_ptr results, int count, nordi_probe_options_ptr options, int cancel) {
+    if (results == NULL || count <= 0) {
+        return 0;
+    }
+    if (options == NULL) {
+        options = &PROBE_DEFAULT_OPTIONS;
+    }
+    int concurrency = options->concurrency > 0 ? options->concurrency : PROBE_DEFAULT_CONCURRENCY;
+    long long timeout_us = (long long)(options->timeout_ms > 0 ? options->timeout_ms : PROBE_DEFAULT_TIMEOUT_MS) * 1000;
+    probe_t* probes = (probe_t*)calloc(count, sizeof(probe_t));
+    int epoll = epoll_create1(EPOLL_CLOEXEC);
+    if (probes == NULL || epoll < 0) {
+        free(probes);
+        return 0;
+    }
+    for (int index = 0; index < count; index++) {
+        results[index].state = PROBE_PENDING;
+        results[index].rtt_us = 0;
+        probes[index].socket = -1;
+    }
+    // already cancelled, nothing even resolves
+    bool is_stopped = is_cancelled(cancel);
+    resolver_t* resolver = is_stopped ? NULL : resolver_new(results, count, options);
+    if (resolver == NULL) {
+        close(epoll);
+        free(probes);
+        return is_stopped ? -1 : 0;
+    }
+    struct epoll_event cancel_event = {.events = EPOLLIN, .data.u32 = CANCEL_EVENT};
+    struct epoll_event resolved_event = {.events = EPOLLIN, .data.u32 = RESOLVED_EVENT};
+    bool is_cancel_watched = cancel < 0 || epoll_ctl(epoll, EPOLL_CTL_ADD, cancel, &cancel_event) == 0;
+    bool is_resolved_watched = epoll_ctl(epoll, EPOLL_CTL_ADD, resolver->resolved, &resolved_event) == 0;
+    int waiting = count, inflight = 0; // targets not started yet, probes running
+    struct epoll_event events[MAX_EVENTS];
+    while (!is_stopped) {
+        // the first targets resolved go first, as many as the concurrency allows
+        for (int index = 0; index < count && inflight < concurrency; index++) {
+            if (probes[index].is_resolved || !resolver_take(resolver, index, &probes[index])) {
+                continue;
+            }
+            waiting--;
+            if (probes[index].address == NULL) {
+                results[index].state = PROBE_UNREACHABLE;
+            } else if (probe_start(&probes[index], &results[index], epoll, index, options)) {
+                inflight++;
+            }
+        }
+        if (inflight == 0 && waiting == 0) {
+            break;
+        }
+        // wake up for the earliest deadline among the probes in flight, or once a target resolves
+        long long now = now_us(), deadline = now + timeout_us;
+        for (int index = 0; index < count; index++) {
+            if (probes[index].socket >= 0 && probes[index].start_us + timeout_us < deadline) {
+                deadline = probes[index].start_us + timeout_us;
+            }
+        }
+        int wait_ms = inflight == 0 ? -1 : deadline > now ? (int)((deadline - now + 999) / 1000) : 0;
+        if (!is_cancel_watched || !is_resolved_watched) {
+            wait_ms = wait_ms < 0 || wait_ms > UNWATCHED_POLL_MS ? UNWATCHED_POLL_MS : wait_ms;
+        }
+        int ready = epoll_wait(epoll, events, MAX_EVENTS, wait_ms);
+        for (int event = 0; event < ready; event++) {
+            if (events[event].data.u32 == CANCEL_EVENT) {
+                is_stopped = true;
+                continue;
+            }
+            if (events[event].data.u32 == RESOLVED_EVENT) {
+                uint64_t signals;
+                ssize_t drained;
+                do {
+                    drained = read(resolver->resolved, &signals, sizeof(signals));
+                } while (drained < 0 && errno == EINTR);
+                continue;
+            }
+            int index = (int)events[event].data.u32;
+            probe_event(&probes[index], &results[index], epoll, options);
+            inflight -= probes[index].socket < 0;
+        }
+        is_stopped = is_stopped || (!is_cancel_watched && is_cancelled(cancel));
+        now = now_us();
+        for (int index = 0; index < count; index++) {
+            if (probes[index].socket >= 0 && now - probes[index].start_us >= timeout_us) {
+                probe_finish(&probes[index], &results[index], epoll, PROBE_TIMEOUT);
+                inflight--;
+            }
+        }
+    }
+    resolver_stop(resolver);
+    int answered = 0;
+    for (int index = 0; index < count; index++) {
+        if (probes[index].socket >= 0) {
+            // stopped while in flight, it never got its answer
+            probe_finish(&probes[index], &results[index], epoll, PROBE_PENDING);
+        }
+        answered += results[index].state == PROBE_OK;
+        if (probes[index].address != NULL) {
+            freeaddrinfo(probes[index].address);
+        }
+    }
+    close(epoll);
+    free(probes);
+    qsort(results, count, sizeof(nordi_probe_result_t), compare_results);
+    return is_stopped ? -1 : answered;
+}
+
+str
+nordi_probe_server(const nordi_probe_result_ptr result) {
+    char host[MAX_HOST_LENGTH], port[MAX_PORT_LENGTH];
+    str server = str_null;
+    if (!split_target(result->target, 0, host, port)) {
+        return server;
+    }
+    struct addrinfo hints = {.ai_flags = AI_NUMERICHOST};
+    struct addrinfo* address = NULL;
+    if (getaddrinfo(host, NULL, &hints, &address) == 0) {
+        // numeric address, nothing to drop
+        freeaddrinfo(address);
+    } else {
+        char* dot = strchr(host, '.');
+        if (dot != NULL) {
+            *dot = '\0';
+        }
+    }
+    str_cpy(&server, str_ref(host));
+    return server;
+}
+
+nordvpn_error_t
+nordi_probe_connect_best(nordi_probe_result_ptr results, int count, nordi_probe_options_ptr options) {
+    if (nordi_probe_run(results, count, options) == 0) {
+        return NOT_FOUND;
+    }
+    str server = nordi_probe_server(&results[0]);
+    nordvpn_error_t result = nordvpn_server_connect(server);
+    str_free(server);
+    return result;
+}
@@ -0,0 +1,297 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#include <stdlib.h>
+#include "nordi_queue.h"
+
+static nordi_target_t
+command_target(nordi_command_type_t type) {
+    switch (type) {
+        case COMMAND_LOGIN:
+        case COMMAND_LOGOUT:
+        case COMMAND_REFRESH:
+            return TARGET_ACCOUNT;
+        case COMMAND_SYNC:
+        case COMMAND_STATUS:
+            return TARGET_HOST;
+        case COMMAND_ALLOWLIST:
+            return TARGET_SETTINGS;
+        default:
+            return TARGET_VPN;
+    }
+}
+
+static bool
+command_equals(const nordi_command_ptr command, nordi_command_type_t type, str server) {
+    return command->type == type && str_eq(command->server, server);
+}
+
+static void
+command_clear(nordi_command_ptr command) {
+    str_clear(&(command->server));
+    str_clear(&(command->link));
+    command->type = COMMAND_NONE;
+}
+
+// Run the command through the NordVPN API, storing the result on it
+static void
+command_execute(nordi_command_ptr command) {
+    switch (command->type) {
+        case COMMAND_CONNECT:
+            command->result = nordvpn_server_connect(command->server);
+            break;
+        case COMMAND_RECONNECT:
+            command->result = nordvpn_reconnect();
+            break;
+        case COMMAND_DISCONNECT:
+            command->result = nordvpn_disconnect();
+            break;
+        case COMMAND_LOGIN:
+            command->result = nordvpn_login(&(command->link));
+            break;
+        case COMMAND_LOGOUT:
+            command->result = nordvpn_logout();
+            break;
+        case COMMAND_REFRESH:
+            nordvpn_refresh();
+            command->result = OK;
+            break;
+        case COMMAND_SYNC:
+            command->result = nordvpn_sync_host();
+            break;
+        case COMMAND_ALLOWLIST:
+            command->result = nordi_allowlist_import(command->server);
+            break;
+        case COMMAND_STATUS:
+            command->result = nordvpn_read_status();
+            break;
+        default:
+            command->result = UNKNOWN_ERROR;
+            break;
+    }
+}
+
+// Move the first pending command, by target order, in flight. Returns false if there is none.
+static bool
+queue_take_pending(nordi_queue_ptr queue) {
+    for (int target = 0; target < TARGET_COUNT; target++) {
+        if (queue->pending[target].type == COMMAND_NONE) {
+            continue;
+        }
+        queue->inflight = queue->pending[target];
+        queue->pending[target] = (nordi_command_t){.type = COMMAND_NONE};
+        queue->is_inflight_cancelled = false;
+        // a cancel only ever targets the command in flight, so start each one clean
+        nordvpn_get_session()->is_cancelled = false;
+        return true;
+    }
+    return false;
+}
+
+// Move a status read in flight, once a cancelled connection change left the state unknown and no other
+// connection change is pending. Returns false if none is due.
+static bool
+queue_take_reconcile(nordi_queue_ptr queue) {
+    if (!queue->is_reconcile_due || queue->pending[TARGET_VPN].type != COMMAND_NONE) {
+        return false;
+    }
+    queue->is_reconcile_due = false;
+    queue->reconciles++;
+    queue->inflight = (nordi_command_t){.type = COMMAND_STATUS};
+    queue->is_inflight_cancelled = false;
+    nordvpn_get_session()->is_cancelled = false;
+    return true;
+}
+
+// The command leading the connection back to where the host is now
+static nordi_command_t
+host_change() {
+    nordvpn_lock_state();
+    nordvpn_host_ptr host = nordvpn_get_host();
+    nordi_command_t change = {.type = host->is_online ? COMMAND_CONNECT : COMMAND_DISCONNECT};
+    if (host->is_online) {
+        str_cpy(&(change.server), host->last_server);
+    }
+    nordvpn_unlock_state();
+    return change;
+}
+
+// Follow up on the command that just finished, with the host as it left it
+static void
+queue_follow_up(nordi_queue_ptr queue, nordi_command_ptr host) {
+    nordi_command_ptr inflight = &(queue->inflight);
+    nordi_command_ptr last = &(queue->last_change);
+    bool is_change = command_target(inflight->type) == TARGET_VPN;
+    if (is_change && inflight->result == CANCELLED) {
+        queue->is_reconcile_due = true;
+    } else if (is_change) {
+        command_clear(last);
+        *last = *host;
+        last->tag = inflight->tag;
+        *host = (nordi_command_t){.type = COMMAND_NONE};
+    } else if (inflight->type == COMMAND_STATUS && inflight->result == OK && last->type != COMMAND_NONE
+               && !command_equals(host, last->type, last->server) && queue->pending[TARGET_VPN].type == COMMAND_NONE) {
+        // the daemon carried out the cancelled change after the one replacing it
+        nordi_command_ptr pending = &(queue->pending[TARGET_VPN]);
+        pending->type = last->type;
+        pending->tag = last->tag;
+        pending->result = OK;
+        str_cpy(&(pending->server), last->server);
+        queue->reconciled++;
+    }
+}
+
+static bool
+queue_is_busy(nordi_queue_ptr queue) {
+    for (int target = 0; target < TARGET_COUNT; target++) {
+        if (queue->pending[target].type != COMMAND_NONE) {
+            return true;
+        }
+    }
+    return queue->inflight.type != COMMAND_NONE;
+}
+
+static int
+queue_worker(nordi_queue_ptr queue) {
+    mtx_lock(&queue->mutex);
+    while (queue->is_running) {
+        if (!queue_take_pending(queue) && !queue_take_reconcile(queue)) {
+            cnd_broadcast(&queue->idle);
+            cnd_wait(&queue->wakeup, &queue->mutex);
+            continue;
+        }
+        queue->executed++;
+        mtx_unlock(&queue->mutex);
+        command_execute(&(queue->inflight));
+        if (queue->callback != NULL) {
+            queue->callback(&(queue->inflight), queue->context);
+        }
+        // read before locking the queue, the state is locked by callers pushing while holding it
+        nordi_command_t host = host_change();
+        mtx_lock(&queue->mutex);
+        queue_follow_up(queue, &host);
+        command_clear(&host);
+        command_clear(&(queue->inflight));
+    }
+    cnd_broadcast(&queue->idle);
+    mtx_unlock(&queue->mutex);
+    return thrd_success;
+}
+
+nordi_queue_ptr
+nordi_queue_new(nordi_queue_callback_t callback, void* context) {
+    nordi_queue_ptr queue = (nordi_queue_ptr)calloc(1, sizeof(nordi_queue_t));
+    if (queue == NULL) {
+        return NULL;
+    }
+    if (mtx_init(&queue->mutex, mtx_plain) != thrd_success) {
+        free(queue);
+        return NULL;
+    }
+    if (cnd_init(&queue->wakeup) != thrd_success || cnd_init(&queue->idle) != thrd_success) {
+        mtx_destroy(&queue->mutex);
+        free(queue);
+        return NULL;
+    }
+    queue->callback = callback;
+    queue->context = context;
+    queue->is_running = true;
+    if (thrd_create(&queue->thread, (int (*)(void*))queue_worker, (void*)queue) != thrd_success) {
+        cnd_destroy(&queue->wakeup);
+        cnd_destroy(&queue->idle);
+        mtx_destroy(&queue->mutex);
+        free(queue);
+        return NULL;
+    }
+    return queue;
+}
+
+void
+nordi_queue_push(nordi_queue_ptr queue, nordi_command_type_t type, str server, int tag) {
+    if (queue == NULL || type == COMMAND_NONE) {
+        return;
+    }
+    nordi_target_t target = command_target(type);
+    nordi_command_ptr pending = &(queue->pending[target]);
+    nordi_command_ptr inflight = &(queue->inflight);
+    // read before locking the queue, the state is locked by callers pushing while holding it
+    nordvpn_lock_state();
+    bool is_online = nordvpn_get_host()->is_online;
+    nordvpn_unlock_state();
+    mtx_lock(&queue->mutex);
+    if (pending->type == COMMAND_ALLOWLIST && type == COMMAND_ALLOWLIST) {
+        // every file is imported, so the pending import takes this one along in a single pass
+        str_join(&(pending->server), str_lit("\n"), pending->server, server);
+        cnd_signal(&queue->wakeup);
+        mtx_unlock(&queue->mutex);
+        return;
+    }
+    if (pending->type != COMMAND_NONE) {
+        command_clear(pending);
+        queue->superseded++;
+    }
+    bool is_inflight_target = inflight->type != COMMAND_NONE && command_target(inflight->type) == target;
+    if (is_inflight_target && !queue->is_inflight_cancelled && command_equals(inflight, type, server)) {
+        // the running command already leads to the requested state
+        queue->skipped++;
+        mtx_unlock(&queue->mutex);
+        return;
+    }
+    if (!is_inflight_target && type == COMMAND_DISCONNECT && inflight->type == COMMAND_NONE && !is_online) {
+        queue->skipped++;
+        mtx_unlock(&queue->mutex);
+        return;
+    }
+    if (is_inflight_target && target == TARGET_VPN && !queue->is_inflight_cancelled) {
+        // the running connection change is pointless now, stop it instead of waiting for it
+        nordvpn_cancel();
+        queue->is_inflight_cancelled = true;
+        queue->cancelled++;
+    }
+    pending->type = type;
+    pending->tag = tag;
+    pending->result = OK;
+    str_cpy(&(pending->server), server);
+    cnd_signal(&queue->wakeup);
+    mtx_unlock(&queue->mutex);
+}
+
+void
+nordi_queue_wait(nordi_queue_ptr queue) {
+    if (queue == NULL) {
+        return;
+    }
+    mtx_lock(&queue->mutex);
+    while (queue->is_running && queue_is_busy(queue)) {
+        cnd_wait(&queue->idle, &queue->mutex);
+    }
+    mtx_unlock(&queue->mutex);
+}
+
+void
+nordi_queue_free(nordi_queue_ptr queue) {
+    if (queue == NULL) {
+        return;
+    }
+    mtx_lock(&queue->mutex);
+    queue->is_running = false;
+    for (int target = 0; target < TARGET_COUNT; target++) {
+        command_clear(&(queue->pending[target]));
+    }
+    command_clear(&(queue->last_change));
+    if (queue->inflight.type != COMMAND_NONE) {
+        nordvpn_cancel();
+        queue->is_inflight_cancelled = true;
+    }
+    cnd_signal(&queue->wakeup);
+    mtx_unlock(&queue->mutex);
+    thrd_join(queue->thread, NULL);
+    cnd_destroy(&queue->wakeup);
+    cnd_destroy(&queue->idle);
+    mtx_destroy(&queue->mutex);
+    free(queue);
+}
@@ -0,0 +1,170 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#include <stdlib.h>
+#include "nordi_refresh.h"
+
+#define MINUTE_MS 60000
+
+const char* const NORDI_REFRESH_MODE_STR[] = {"focused", "background", "hidden", "paused"};
+
+static const int MODE_FACTOR[] = {1, REFRESH_BACKGROUND_FACTOR, REFRESH_HIDDEN_FACTOR, 0};
+
+// The deadline on the grid of the mode nearest to the task's interval, never before now. Rounding to the nearest
+// keeps a run that woke late from pushing the next one a whole step back.
+static void
+refresh_schedule(nordi_refresh_ptr refresh, nordi_refresh_task_t* task, long long now_ms) {
+    int factor = MODE_FACTOR[nordi_refresh_mode(refresh)];
+    if (factor == 0) {
+        return;
+    }
+    long long align = (long long)REFRESH_ALIGN_MS * factor;
+    long long due = task->last_ms + (long long)task->interval_ms * factor - align / 2;
+    due = due > now_ms ? due : now_ms;
+    task->deadline_ms = (due + align - 1) / align * align;
+}
+
+// Move the count on to the minute of now
+static void
+refresh_count(nordi_refresh_ptr refresh, long long now_ms) {
+    if (refresh->minute_start_ms == 0) {
+        refresh->minute_start_ms = now_ms;
+    }
+    long long minutes = (now_ms - refresh->minute_start_ms) / MINUTE_MS;
+    if (minutes > 0) {
+        refresh->last_minute_wakeups = minutes == 1 ? refresh->minute_wakeups : 0;
+        refresh->minute_wakeups = 0;
+        refresh->minute_start_ms += minutes * MINUTE_MS;
+    }
+}
+
+nordi_refresh_ptr
+nordi_refresh_new() {
+    nordi_refresh_ptr refresh = calloc(1, sizeof(nordi_refresh_t));
+    if (refresh == NULL) {
+        return NULL;
+    }
+    refresh->is_focused = true;
+    refresh->is_visible = true;
+    return refresh;
+}
+
+int
+nordi_refresh_add(nordi_refresh_ptr refresh, int interval_ms, nordi_refresh_func_t func, void* context) {
+    if (refresh->task_count == REFRESH_MAX_TASKS) {
+        return REFRESH_NO_TASK;
+    }
+    nordi_refresh_task_t* task = &refresh->tasks[refresh->task_count];
+    task->interval_ms = interval_ms;
+    task->func = func;
+    task->context = context;
+    task->is_enabled = false;
+    return refresh->task_count++;
+}
+
+void
+nordi_refresh_enable(nordi_refresh_ptr refresh, int task, bool is_enabled, long long now_ms) {
+    nordi_refresh_task_t* entry = &refresh->tasks[task];
+    if (is_enabled && !entry->is_enabled) {
+        entry->last_ms = now_ms;
+        refresh_schedule(refresh, entry, now_ms);
+    }
+    entry->is_enabled = is_enabled;
+}
+
+void
+nordi_refresh_set_state(nordi_refresh_ptr refresh, bool is_focused, bool is_visible, bool is_power_saving,
+                        bool is_idle, long long now_ms) {
+    nordi_refresh_mode_t previous = nordi_refresh_mode(refresh);
+    refresh->is_focused = is_focused;
+    refresh->is_visible = is_visible;
+    refresh->is_power_saving = is_power_saving;
+    refresh->is_idle = is_idle;
+    if (nordi_refresh_mode(refresh) == previous) {
+        return;
+    }
+    for (int task = 0; task < refresh->task_count; task++) {
+        refresh_schedule(refresh, &refresh->tasks[task], now_ms);
+    }
+}
+
+nordi_refresh_mode_t
+nordi_refresh_mode(nordi_refresh_ptr refresh) {
+    if (refresh->is_power_saving || refresh->is_idle) {
+        return REFRESH_PAUSED;
+    }
+    if (!refresh->is_visible) {
+        return REFRESH_HIDDEN;
+    }
+    return refresh->is_focused ? REFRESH_FOCUSED : REFRESH_BACKGROUND;
+}
+
+int
+nordi_refresh_scale(nordi_refresh_ptr refresh) {
+    return MODE_FACTOR[nordi_refresh_mode(refresh)];
+}
+
+int
+nordi_refresh_next(nordi_refresh_ptr refresh, long long now_ms) {
+    if (nordi_refresh_mode(refresh) == REFRESH_PAUSED) {
+        return REFRESH_NO_DEADLINE;
+    }
+    long long next = -1;
+    for (int task = 0; task < refresh->task_count; task++) {
+        const nordi_refresh_task_t* entry = &refresh->tasks[task];
+        if (entry->is_enabled && (next < 0 || entry->deadline_ms < next)) {
+            next = entry->deadline_ms;
+        }
+    }
+    if (next < 0) {
+        return REFRESH_NO_DEADLINE;
+    }
+    return next > now_ms ? (int)(next - now_ms) : 0;
+}
+
+int
+nordi_refresh_run(nordi_refresh_ptr refresh, long long now_ms) {
+    refresh_count(refresh, now_ms);
+    if (nordi_refresh_mode(refresh) == REFRESH_PAUSED) {
+        return REFRESH_NO_DEADLINE;
+    }
+    bool is_woken = false;
+    for (int task = 0; task < refresh->task_count; task++) {
+        nordi_refresh_task_t* entry = &refresh->tasks[task];
+        if (!entry->is_enabled || entry->deadline_ms > now_ms) {
+            continue;
+        }
+        entry->last_ms = now_ms;
+        refresh_schedule(refresh, entry, now_ms + 1);
+        entry->func(entry->context);
+        refresh->runs++;
+        is_woken = true;
+    }
+    if (is_woken) {
+        refresh->wakeups++;
+        refresh->minute_wakeups++;
+    }
+    return nordi_refresh_next(refresh, now_ms);
+}
+
+unsigned int
+nordi_refresh_wakeups_per_minute(nordi_refresh_ptr refresh, long long now_ms) {
+    refresh_count(refresh, now_ms);
+    return refresh->last_minute_wakeups;
+}
+
+void
+nordi_refresh_count_wakeups(nordi_refresh_ptr refresh, unsigned int count, long long now_ms) {
+    refresh_count(refresh, now_ms);
+    refresh->wakeups += count;
+    refresh->minute_wakeups += count;
+}
+
+void
+nordi_refresh_free(nordi_refresh_ptr refresh) {
+    free(refresh);
+}
@@ -0,0 +1,172 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <dirent.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nordi_resources.h"
+
+#define MINUTE_MS    60000
+#define MAX_LINE     256
+#define THREADS_KEY  "Threads:"
+
+const char* const NORDI_RESOURCE_SUBSYSTEM_STR[] = {"api", "routines", "gui", "catalog"};
+
+// Process wide, so any thread of any subsystem accounts without a handle
+static atomic_llong live_allocations[RESOURCE_SUBSYSTEMS];
+static atomic_llong live_bytes[RESOURCE_SUBSYSTEMS];
+static atomic_int live_children;
+
+// The size of the allocation a string owns, 0 if it references another's
+static size_t
+str_owned(const str source) {
+    return str_is_owner(source) ? str_len(source) + 1 : 0;
+}
+
+static int
+count_threads() {
+    FILE* status = fopen(RESOURCE_PROC_PATH "/status", "r");
+    if (status == NULL) {
+        return RESOURCE_UNKNOWN;
+    }
+    char line[MAX_LINE];
+    int threads = RESOURCE_UNKNOWN;
+    while (threads == RESOURCE_UNKNOWN && fgets(line, MAX_LINE, status) != NULL) {
+        if (strncmp(line, THREADS_KEY, strlen(THREADS_KEY)) == 0) {
+            threads = atoi(line + strlen(THREADS_KEY));
+        }
+    }
+    fclose(status);
+    return threads;
+}
+
+static int
+count_fds() {
+    DIR* directory = opendir(RESOURCE_PROC_PATH "/fd");
+    if (directory == NULL) {
+        return RESOURCE_UNKNOWN;
+    }
+    int fds = 0;
+    for (struct dirent* entry = readdir(directory); entry != NULL; entry = readdir(directory)) {
+        fds += entry->d_name[0] != '.';
+    }
+    closedir(directory);
+    return fds - 1; // the one listing them
+}
+
+// A count and its change since the oldest snapshot
+static void
+write_count(FILE* file, const char* name, long long count, long long oldest, const char* unit) {
+    fprintf(file, "%-12s %12lld %-5s %+12lld\n", name, count, unit, count - oldest);
+}
+
+// A count read from the process, which may be unknown then or at the oldest snapshot
+static void
+write_process_count(FILE* file, const char* name, int count, int oldest) {
+    if (count == RESOURCE_UNKNOWN) {
+        fprintf(file, "%-12s %12s\n", name, "?");
+        return;
+    }
+    write_count(file, name, count, oldest != RESOURCE_UNKNOWN ? oldest : count, "");
+}
+
+void
+nordi_resources_alloc(nordi_resource_subsystem_t subsystem, size_t size) {
+    atomic_fetch_add_explicit(&live_allocations[subsystem], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&live_bytes[subsystem], (long long)size, memory_order_relaxed);
+}
+
+void
+nordi_resources_release(nordi_resource_subsystem_t subsystem, size_t size) {
+    atomic_fetch_sub_explicit(&live_allocations[subsystem], 1, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&live_bytes[subsystem], (long long)size, memory_order_relaxed);
+}
+
+void
+nordi_resources_str_cpy(nordi_resource_subsystem_t subsystem, str* target, const str source) {
+    size_t previous = str_owned(*target);
+    str_cpy(target, source);
+    if (previous > 0) {
+        nordi_resources_release(subsystem, previous);
+    }
+    if (str_owned(*target) > 0) {
+        nordi_resources_alloc(subsystem, str_owned(*target));
+    }
+}
+
+void
+nordi_resources_str_clear(nordi_resource_subsystem_t subsystem, str* target) {
+    if (str_owned(*target) > 0) {
+        nordi_resources_release(subsystem, str_owned(*target));
+    }
+    str_clear(target);
+}
+
+void
+nordi_resources_child(int change) {
+    atomic_fetch_add_explicit(&live_children, change, memory_order_relaxed);
+}
+
+void
+nordi_resources_sample(nordi_resources_snapshot_t* snapshot, long long now_ms) {
+    snapshot->time_ms = now_ms;
+    for (int subsystem = 0; subsystem < RESOURCE_SUBSYSTEMS; subsystem++) {
+        snapshot->allocations[subsystem] = atomic_load_explicit(&live_allocations[subsystem], memory_order_relaxed);
+        snapshot->bytes[subsystem] = atomic_load_explicit(&live_bytes[subsystem], memory_order_relaxed);
+    }
+    snapshot->threads = count_threads();
+    snapshot->fds = count_fds();
+    snapshot->children = atomic_load_explicit(&live_children, memory_order_relaxed);
+}
+
+nordi_resources_ptr
+nordi_resources_new() {
+    return calloc(1, sizeof(nordi_resources_t));
+}
+
+void
+nordi_resources_snapshot(nordi_resources_ptr resources, long long now_ms) {
+    nordi_resources_sample(&resources->snapshots[resources->next], now_ms);
+    resources->next = (resources->next + 1) % RESOURCE_SNAPSHOTS;
+    resources->count += resources->count < RESOURCE_SNAPSHOTS;
+}
+
+const nordi_resources_snapshot_t*
+nordi_resources_at(nordi_resources_ptr resources, int age) {
+    if (age < 0 || age >= resources->count) {
+        return NULL;
+    }
+    return &resources->snapshots[(resources->next - 1 - age + RESOURCE_SNAPSHOTS) % RESOURCE_SNAPSHOTS];
+}
+
+void
+nordi_resources_write(nordi_resources_ptr resources, FILE* file, long long now_ms) {
+    nordi_resources_snapshot_t now;
+    nordi_resources_sample(&now, now_ms);
+    const nordi_resources_snapshot_t* oldest = nordi_resources_at(resources, resources->count - 1);
+    if (oldest == NULL) {
+        oldest = &now;
+    }
+    fprintf(file, "resources: %d snapshots, changes over the last %lld min\n", resources->count,
+            (now_ms - oldest->time_ms) / MINUTE_MS);
+    for (int subsystem = 0; subsystem < RESOURCE_SUBSYSTEMS; subsystem++) {
+        write_count(file, NORDI_RESOURCE_SUBSYSTEM_STR[subsystem], now.allocations[subsystem],
+                    oldest->allocations[subsystem], "live");
+        write_count(file, "", now.bytes[subsystem], oldest->bytes[subsystem], "bytes");
+    }
+    write_process_count(file, "threads", now.threads, oldest->threads);
+    write_process_count(file, "fds", now.fds, oldest->fds);
+    write_count(file, "children", now.children, oldest->children, "");
+}
+
+void
+nordi_resources_free(nordi_resources_ptr resources) {
+    free(resources);
+}
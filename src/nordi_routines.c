@@ -7,6 +7,7 @@
 
 #include <stdlib.h>
 #include <time.h>
+#include "nordi_resources.h"
 #include "nordi_routines.h"
 
 static int
@@ -57,6 +58,7 @@ nordi_routine_new(nordi_routine_func_t function, void* context, int delay) {
         free(routine);
         return NULL;
     }
+    nordi_resources_alloc(RESOURCE_ROUTINES, sizeof(nordi_routine_t));
     return routine;
 }
 
@@ -69,6 +71,7 @@ nordi_routine_join(nordi_routine_ptr routine) {
     if (result == thrd_success && routine->state != BUSY) {
         mtx_destroy(&routine->mutex);
         free(routine);
+        nordi_resources_release(RESOURCE_ROUTINES, sizeof(nordi_routine_t));
     }
 }
 
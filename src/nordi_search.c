@@ -0,0 +1,256 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "nordi_search.h"
+
+#define INITIAL_CAPACITY 64
+#define TRIGRAM_MARK     (1u << 24) // keeps every key non zero, and apart by kind
+#define PREFIX_MARK      (2u << 24)
+#define MAX_LOAD_PERCENT 70
+
+static char
+fold(char character) {
+    if (character >= 'A' && character <= 'Z') {
+        return (char)(character - 'A' + 'a');
+    }
+    return character == '_' ? ' ' : character;
+}
+
+static uint32_t
+trigram_of(const char* text) {
+    return TRIGRAM_MARK | (uint32_t)(unsigned char)text[0] << 16 | (uint32_t)(unsigned char)text[1] << 8
+           | (unsigned char)text[2];
+}
+
+// A one or two letter word prefix
+static uint32_t
+prefix_of(const char* text, size_t length) {
+    return PREFIX_MARK | (uint32_t)(unsigned char)text[0] << 16 | (length > 1 ? (uint32_t)(unsigned char)text[1] << 8 : 0);
+}
+
+static nordi_search_posting_t*
+find_slot(nordi_search_posting_t* slots, int capacity, uint32_t key) {
+    // multiplicative hash, capacity is a power of two
+    uint32_t slot = (key * 2654435761u) & (capacity - 1);
+    while (slots[slot].key != 0 && slots[slot].key != key) {
+        slot = (slot + 1) & (capacity - 1);
+    }
+    return &slots[slot];
+}
+
+static bool
+grow_slots(nordi_search_ptr search) {
+    int capacity = search->slot_capacity > 0 ? search->slot_capacity * 2 : INITIAL_CAPACITY * 16;
+    nordi_search_posting_t* slots = (nordi_search_posting_t*)calloc(capacity, sizeof(nordi_search_posting_t));
+    if (slots == NULL) {
+        return false;
+    }
+    for (int slot = 0; slot < search->slot_capacity; slot++) {
+        if (search->slots[slot].key != 0) {
+            *find_slot(slots, capacity, search->slots[slot].key) = search->slots[slot];
+        }
+    }
+    free(search->slots);
+    search->slots = slots;
+    search->slot_capacity = capacity;
+    return true;
+}
+
+static bool
+add_posting(nordi_search_ptr search, uint32_t key, int id) {
+    if ((search->slot_count + 1) * 100 > search->slot_capacity * MAX_LOAD_PERCENT && !grow_slots(search)) {
+        return false;
+    }
+    nordi_search_posting_t* posting = find_slot(search->slots, search->slot_capacity, key);
+    if (posting->key == 0) {
+        posting->key = key;
+        search->slot_count++;
+    }
+    if (posting->count > 0 && posting->ids[posting->count - 1] == id) {
+        return true; // repeated in the same text
+    }
+    if (posting->count == posting->capacity) {
+        int capacity = posting->capacity > 0 ? posting->capacity * 2 : 4;
+        int* ids = (int*)realloc(posting->ids, capacity * sizeof(int));
+        if (ids == NULL) {
+            return false;
+        }
+        posting->ids = ids;
+        posting->capacity = capacity;
+    }
+    posting->ids[posting->count++] = id;
+    return true;
+}
+
+// The texts having a word starting with a one or two letter query
+static int
+query_prefix(nordi_search_ptr search, const char* query) {
+    const nordi_search_posting_t* posting =
+        search->slot_capacity > 0 ? find_slot(search->slots, search->slot_capacity, prefix_of(query, strlen(query))) : NULL;
+    int count = 0;
+    for (int index = 0; posting != NULL && index < posting->count && posting->ids[index] < search->count; index++) {
+        search->results[count++] = posting->ids[index];
+    }
+    return count;
+}
+
+// The texts containing the query, checking those of its rarest trigram
+static int
+query_trigrams(nordi_search_ptr search, const char* query) {
+    const nordi_search_posting_t* rarest = NULL;
+    for (const char* text = query; text[1] != '\0' && text[2] != '\0'; text++) {
+        const nordi_search_posting_t* posting = search->slot_capacity > 0 ? find_slot(search->slots, search->slot_capacity, trigram_of(text)) : NULL;
+        if (posting == NULL || posting->key == 0) {
+            return 0;
+        }
+        if (rarest == NULL || posting->count < rarest->count) {
+            rarest = posting;
+        }
+    }
+    int count = 0;
+    // an add that failed half way may have left its id behind
+    for (int index = 0; index < rarest->count && rarest->ids[index] < search->count; index++) {
+        if (strstr(search->texts[rarest->ids[index]], query) != NULL) {
+            search->results[count++] = rarest->ids[index];
+        }
+    }
+    return count;
+}
+
+nordi_search_ptr
+nordi_search_new() {
+    nordi_search_ptr search = (nordi_search_ptr)calloc(1, sizeof(nordi_search_t));
+    if (search == NULL) {
+        return NULL;
+    }
+    search->texts = (char**)malloc(INITIAL_CAPACITY * sizeof(char*));
+    search->results = (int*)malloc(INITIAL_CAPACITY * sizeof(int));
+    if (search->texts == NULL || search->results == NULL) {
+        nordi_search_free(search);
+        return NULL;
+    }
+    search->capacity = INITIAL_CAPACITY;
+    return search;
+}
+
+int
+nordi_search_add(nordi_search_ptr search, const char* text) {
+    if (search == NULL || text == NULL) {
+        return -1;
+    }
+    if (search->count == search->capacity) {
+        int capacity = search->capacity * 2;
+        char** texts = (char**)realloc(search->texts, capacity * sizeof(char*));
+        if (texts == NULL) {
+            return -1;
+        }
+        search->texts = texts;
+        int* results = (int*)realloc(search->results, capacity * sizeof(int));
+        if (results == NULL) {
+            return -1;
+        }
+        search->results = results;
+        search->capacity = capacity;
+    }
+    size_t length = strlen(text);
+    char* folded = (char*)malloc(length + 1);
+    if (folded == NULL) {
+        return -1;
+    }
+    for (size_t index = 0; index <= length; index++) {
+        folded[index] = fold(text[index]);
+    }
+    int id = search->count;
+    for (size_t index = 0; index < length; index++) {
+        bool is_word = folded[index] != ' ' && (index == 0 || folded[index - 1] == ' ');
+        bool is_added = (index + 2 >= length || add_posting(search, trigram_of(folded + index), id))
+                        && (!is_word || add_posting(search, prefix_of(folded + index, 1), id))
+                        && (!is_word || index + 1 >= length || folded[index + 1] == ' '
+                            || add_posting(search, prefix_of(folded + index, 2), id));
+        if (!is_added) {
+            free(folded);
+            return -1; // postings added so far point at an id nothing holds yet, the queries skip it
+        }
+    }
+    search->texts[search->count++] = folded;
+    search->is_last_valid = false;
+    return id;
+}
+
+int
+nordi_search_query(nordi_search_ptr search, const char* query, const int** ids) {
+    if (search == NULL) {
+        return 0;
+    }
+    char folded[SEARCH_MAX_QUERY];
+    size_t length = 0;
+    for (; query != NULL && query[length] != '\0' && length < SEARCH_MAX_QUERY - 1; length++) {
+        folded[length] = fold(query[length]);
+    }
+    folded[length] = '\0';
+    *ids = search->results;
+    size_t last_length = strlen(search->last);
+    bool is_short = length < SEARCH_SHORT_QUERY;
+    if (length == 0) {
+        for (int id = 0; id < search->count; id++) {
+            search->results[id] = id;
+        }
+        search->result_count = search->count;
+    } else if (is_short) {
+        search->result_count = query_prefix(search, folded);
+    } else if (search->is_last_valid && last_length >= SEARCH_SHORT_QUERY && strstr(folded, search->last) != NULL) {
+        // typing on only narrows the matches
+        int count = 0;
+        for (int index = 0; index < search->result_count; index++) {
+            if (strstr(search->texts[search->results[index]], folded) != NULL) {
+                search->results[count++] = search->results[index];
+            }
+        }
+        search->result_count = count;
+    } else {
+        search->result_count = query_trigrams(search, folded);
+    }
+    memcpy(search->last, folded, length + 1);
+    search->is_last_valid = true;
+    return search->result_count;
+}
+
+int
+nordi_search_changed_range(const int* previous, int previous_count, const int* next, int next_count, int* removed,
+                           int* added) {
+    int start = 0;
+    while (start < previous_count && start < next_count && previous[start] == next[start]) {
+        start++;
+    }
+    int end = 0;
+    while (end < previous_count - start && end < next_count - start
+           && previous[previous_count - 1 - end] == next[next_count - 1 - end]) {
+        end++;
+    }
+    *removed = previous_count - start - end;
+    *added = next_count - start - end;
+    return start;
+}
+
+void
+nordi_search_free(nordi_search_ptr search) {
+    if (search == NULL) {
+        return;
+    }
+    for (int id = 0; id < search->count; id++) {
+        free(search->texts[id]);
+    }
+    for (int slot = 0; slot < search->slot_capacity; slot++) {
+        free(search->slots[slot].ids);
+    }
+    free(search->texts);
+    free(search->slots);
+    free(search->results);
+    free(search);
+}
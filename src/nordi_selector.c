@@ -0,0 +1,239 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nordi_selector.h"
+#include "nordvpn_server.h"
+
+#define INITIAL_SERVERS  64
+#define MAX_RANKED       64
+#define FNV_OFFSET       2166136261u
+#define FNV_PRIME        16777619u
+#define CONNECT_SCALE_MS 5000.0 // mean connect time halving the score
+#define RTT_SCALE_MS     100.0  // mean session round trip halving the score
+// neutral priors, each worth a single outcome
+#define PRIOR_CONNECT_MS CONNECT_SCALE_MS
+#define PRIOR_RTT_MS     RTT_SCALE_MS
+#define PRIOR_LOSS       0.0
+
+static uint32_t
+hash_server(const char* server) {
+    uint32_t hash = FNV_OFFSET;
+    for (int index = 0; index < HISTORY_MAX_SERVER && server[index] != '\0'; index++) {
+        hash = (hash ^ (unsigned char)server[index]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+// Slot of the server in the table, either holding it or the empty one it would take
+static int*
+find_slot(nordi_selector_ptr selector, const char* server) {
+    unsigned int mask = selector->slot_capacity - 1;
+    unsigned int slot = hash_server(server) & mask;
+    while (selector->slots[slot] >= 0
+           && strncmp(selector->servers[selector->slots[slot]].server, server, HISTORY_MAX_SERVER) != 0) {
+        slot = (slot + 1) & mask;
+    }
+    return &selector->slots[slot];
+}
+
+static bool
+grow_slots(nordi_selector_ptr selector) {
+    int capacity = selector->slot_capacity > 0 ? selector->slot_capacity * 2 : INITIAL_SERVERS * 2;
+    int* slots = (int*)malloc(capacity * sizeof(int));
+    if (slots == NULL) {
+        return false;
+    }
+    memset(slots, -1, capacity * sizeof(int));
+    free(selector->slots);
+    selector->slots = slots;
+    selector->slot_capacity = capacity;
+    for (int index = 0; index < selector->count; index++) {
+        *find_slot(selector, selector->servers[index].server) = index;
+    }
+    return true;
+}
+
+static nordi_selector_server_t*
+get_server(nordi_selector_ptr selector, const nordi_history_record_t* record) {
+    int* slot = find_slot(selector, record->server);
+    if (*slot >= 0) {
+        return &selector->servers[*slot];
+    }
+    if (selector->count == selector->capacity) {
+        int capacity = selector->capacity > 0 ? selector->capacity * 2 : INITIAL_SERVERS;
+        nordi_selector_server_t* servers =
+            (nordi_selector_server_t*)realloc(selector->servers, capacity * sizeof(nordi_selector_server_t));
+        if (servers == NULL) {
+            return NULL;
+        }
+        selector->servers = servers;
+        selector->capacity = capacity;
+    }
+    // the table stays at most half full
+    if ((selector->count + 1) * 2 > selector->slot_capacity) {
+        if (!grow_slots(selector)) {
+            return NULL;
+        }
+        slot = find_slot(selector, record->server);
+    }
+    nordi_selector_server_t* server = &selector->servers[selector->count];
+    *server = (nordi_selector_server_t){.country = -1, .next = -1, .updated = record->time};
+    memcpy(server->server, record->server, HISTORY_MAX_SERVER);
+    server->server[HISTORY_MAX_SERVER - 1] = '\0';
+    *slot = selector->count++;
+    return server;
+}
+
+static double
+decay(nordi_selector_ptr selector, int64_t elapsed_s) {
+    return elapsed_s > 0 ? exp2(-elapsed_s / selector->half_life_s) : 1.0;
+}
+
+static double
+server_score(nordi_selector_ptr selector, const nordi_selector_server_t* server, int64_t now) {
+    double weight = decay(selector, now - server->updated);
+    double success_rate = (server->successes * weight + 1) / (server->attempts * weight + 2);
+    double connect_ms = (server->connect_ms * weight + PRIOR_CONNECT_MS) / (server->successes * weight + 1);
+    double rtt_ms = (server->rtt_ms * weight + PRIOR_RTT_MS) / (server->sessions * weight + 1);
+    double loss = (server->loss * weight + PRIOR_LOSS) / (server->sessions * weight + 1);
+    return success_rate * (CONNECT_SCALE_MS / (CONNECT_SCALE_MS + connect_ms)) * (RTT_SCALE_MS / (RTT_SCALE_MS + rtt_ms))
+           * (1 - loss / 100);
+}
+
+nordi_selector_ptr
+nordi_selector_new(double half_life_s) {
+    nordi_selector_ptr selector = (nordi_selector_ptr)calloc(1, sizeof(nordi_selector_t));
+    if (selector == NULL) {
+        return NULL;
+    }
+    selector->half_life_s = half_life_s > 0 ? half_life_s : SELECTOR_DEFAULT_HALF_LIFE_S;
+    selector->heads = (int*)malloc(COUNTRY_COUNT * sizeof(int));
+    if (selector->heads == NULL || !grow_slots(selector)) {
+        nordi_selector_free(selector);
+        return NULL;
+    }
+    memset(selector->heads, -1, COUNTRY_COUNT * sizeof(int));
+    return selector;
+}
+
+void
+nordi_selector_load(nordi_selector_ptr selector, nordi_history_ptr history) {
+    if (selector == NULL || history == NULL) {
+        return;
+    }
+    for (unsigned int index = 0; index < history->count; index++) {
+        nordi_selector_observe(selector, nordi_history_get(history, index));
+    }
+}
+
+void
+nordi_selector_observe(nordi_selector_ptr selector, const nordi_history_record_t* record) {
+    if (selector == NULL || record == NULL || record->server[0] == '\0') {
+        return;
+    }
+    nordi_selector_server_t* server = get_server(selector, record);
+    if (server == NULL) {
+        return;
+    }
+    double weight = 1.0;
+    if (record->time > server->updated) {
+        double factor = decay(selector, record->time - server->updated);
+        server->attempts *= factor;
+        server->successes *= factor;
+        server->connect_ms *= factor;
+        server->sessions *= factor;
+        server->rtt_ms *= factor;
+        server->loss *= factor;
+        server->updated = record->time;
+    } else {
+        // older than what was already learned, it weighs as it would have back then
+        weight = decay(selector, server->updated - record->time);
+    }
+    switch (record->event) {
+        case EVENT_CONNECT:
+        case EVENT_RECONNECT:
+            server->attempts += weight;
+            if (record->error != 0) {
+                break;
+            }
+            server->successes += weight;
+            server->connect_ms += weight * record->connect_ms;
+            if (server->country < 0 && record->country >= 0 && record->country < COUNTRY_COUNT) {
+                server->country = record->country;
+                server->next = selector->heads[record->country];
+                selector->heads[record->country] = (int)(server - selector->servers);
+            }
+            break;
+        default:
+            if (record->rtt_ms > 0) {
+                server->sessions += weight;
+                server->rtt_ms += weight * record->rtt_ms;
+                server->loss += weight * record->loss;
+            }
+            break;
+    }
+}
+
+double
+nordi_selector_score(nordi_selector_ptr selector, const char* server, int64_t now) {
+    if (selector == NULL || server == NULL || server[0] == '\0') {
+        return -1;
+    }
+    int index = *find_slot(selector, server);
+    return index >= 0 ? server_score(selector, &selector->servers[index], now) : -1;
+}
+
+int
+nordi_selector_rank(nordi_selector_ptr selector, int country, int64_t now, const char** servers, int max) {
+    if (selector == NULL || country >= COUNTRY_COUNT || max <= 0) {
+        return 0;
+    }
+    // what a server with no outcomes scores, anything worse is better left to the daemon
+    nordi_selector_server_t untried = {};
+    double untried_score = server_score(selector, &untried, now);
+    double scores[MAX_RANKED];
+    max = max < MAX_RANKED ? max : MAX_RANKED;
+    int ranked = 0;
+    bool is_any = country < 0;
+    int index = is_any ? 0 : selector->heads[country];
+    while (index >= 0 && index < selector->count) {
+        nordi_selector_server_t* server = &selector->servers[index];
+        double score = server->country >= 0 ? server_score(selector, server, now) : -1;
+        if (score > untried_score && (ranked < max || score > scores[max - 1])) {
+            // insertion into the few kept so far
+            int position = ranked < max ? ranked++ : max - 1;
+            for (; position > 0 && scores[position - 1] < score; position--) {
+                scores[position] = scores[position - 1];
+                servers[position] = servers[position - 1];
+            }
+            scores[position] = score;
+            servers[position] = server->server;
+        }
+        index = is_any ? index + 1 : server->next;
+    }
+    return ranked;
+}
+
+const char*
+nordi_selector_best(nordi_selector_ptr selector, int country, int64_t now) {
+    const char* best = NULL;
+    return nordi_selector_rank(selector, country, now, &best, 1) > 0 ? best : NULL;
+}
+
+void
+nordi_selector_free(nordi_selector_ptr selector) {
+    if (selector == NULL) {
+        return;
+    }
+    free(selector->servers);
+    free(selector->slots);
+    free(selector->heads);
+    free(selector);
+}
@@ -0,0 +1,203 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+#include "nordi_speculation.h"
+
+static long long
+speculation_now_us() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static void
+clear_targets(nordi_probe_result_t* targets, int count) {
+    for (int index = 0; index < count; index++) {
+        str_free(targets[index].target);
+        targets[index].target = str_null;
+    }
+}
+
+// Make the running speculation stale, must hold the mutex
+static void
+speculation_invalidate(nordi_speculation_ptr speculation) {
+    speculation->generation++;
+    speculation->is_requested = false;
+    speculation->is_ready = false;
+    clear_targets(speculation->targets, speculation->target_count);
+    speculation->target_count = 0;
+    if (speculation->is_working) {
+        uint64_t signal = 1;
+        ssize_t written;
+        // should it still fail, the worker probes on until its timeout and the result is dropped as stale
+        do {
+            written = write(speculation->cancel, &signal, sizeof(signal));
+        } while (written < 0 && errno == EINTR);
+    }
+}
+
+static int
+speculation_worker(nordi_speculation_ptr speculation) {
+    nordi_probe_result_t targets[SPECULATION_MAX_TARGETS] = {};
+    mtx_lock(&speculation->mutex);
+    while (speculation->is_running) {
+        if (!speculation->is_requested) {
+            cnd_broadcast(&speculation->idle);
+            cnd_wait(&speculation->wakeup, &speculation->mutex);
+            continue;
+        }
+        // take over the request, so a newer one can be written meanwhile
+        int count = speculation->target_count, key = speculation->key;
+        unsigned int generation = speculation->generation;
+        for (int index = 0; index < count; index++) {
+            targets[index] = speculation->targets[index];
+            speculation->targets[index].target = str_null;
+        }
+        speculation->target_count = 0;
+        speculation->is_requested = false;
+        speculation->is_working = true;
+        // a cancel from before this point was meant for the previous request
+        uint64_t signals;
+        ssize_t drained;
+        do {
+            drained = read(speculation->cancel, &signals, sizeof(signals));
+        } while (drained < 0 && errno == EINTR);
+        mtx_unlock(&speculation->mutex);
+        int answered = nordi_probe_run_cancellable(targets, count, &speculation->options, speculation->cancel);
+        str best = answered > 0 ? nordi_probe_server(&targets[0]) : str_null;
+        clear_targets(targets, count);
+        mtx_lock(&speculation->mutex);
+        speculation->is_working = false;
+        if (answered < 0 || generation != speculation->generation) {
+            str_free(best);
+            speculation->cancelled++;
+            continue;
+        }
+        str_free(speculation->best);
+        speculation->best = best;
+        speculation->ready_key = key;
+        speculation->ready_us = speculation_now_us();
+        speculation->is_ready = true;
+        speculation->completed++;
+    }
+    cnd_broadcast(&speculation->idle);
+    mtx_unlock(&speculation->mutex);
+    return thrd_success;
+}
+
+nordi_speculation_ptr
+nordi_speculation_new(nordi_probe_options_ptr options) {
+    nordi_speculation_ptr speculation = (nordi_speculation_ptr)calloc(1, sizeof(nordi_speculation_t));
+    if (speculation == NULL) {
+        return NULL;
+    }
+    speculation->options = options != NULL ? *options : PROBE_DEFAULT_OPTIONS;
+    speculation->cancel = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (speculation->cancel < 0) {
+        free(speculation);
+        return NULL;
+    }
+    if (mtx_init(&speculation->mutex, mtx_plain) != thrd_success) {
+        close(speculation->cancel);
+        free(speculation);
+        return NULL;
+    }
+    if (cnd_init(&speculation->wakeup) != thrd_success || cnd_init(&speculation->idle) != thrd_success) {
+        mtx_destroy(&speculation->mutex);
+        close(speculation->cancel);
+        free(speculation);
+        return NULL;
+    }
+    speculation->is_running = true;
+    if (thrd_create(&speculation->thread, (int (*)(void*))speculation_worker, (void*)speculation) != thrd_success) {
+        cnd_destroy(&speculation->wakeup);
+        cnd_destroy(&speculation->idle);
+        mtx_destroy(&speculation->mutex);
+        close(speculation->cancel);
+        free(speculation);
+        return NULL;
+    }
+    return speculation;
+}
+
+void
+nordi_speculation_request(nordi_speculation_ptr speculation, int key, const str* targets, int count) {
+    if (speculation == NULL) {
+        return;
+    }
+    mtx_lock(&speculation->mutex);
+    speculation_invalidate(speculation);
+    count = count < SPECULATION_MAX_TARGETS ? count : SPECULATION_MAX_TARGETS;
+    for (int index = 0; index < count; index++) {
+        str_cpy(&(speculation->targets[index].target), targets[index]);
+    }
+    speculation->target_count = count > 0 ? count : 0;
+    speculation->key = key;
+    speculation->is_requested = count > 0;
+    cnd_signal(&speculation->wakeup);
+    mtx_unlock(&speculation->mutex);
+}
+
+void
+nordi_speculation_cancel(nordi_speculation_ptr speculation) {
+    nordi_speculation_request(speculation, 0, NULL, 0);
+}
+
+bool
+nordi_speculation_take(nordi_speculation_ptr speculation, int key, int max_age_ms, str* server) {
+    if (speculation == NULL) {
+        return false;
+    }
+    long long max_age_us = (long long)(max_age_ms > 0 ? max_age_ms : SPECULATION_DEFAULT_TTL_MS) * 1000;
+    mtx_lock(&speculation->mutex);
+    bool is_taken = speculation->is_ready && speculation->ready_key == key && !str_is_empty(speculation->best)
+                    && speculation_now_us() - speculation->ready_us <= max_age_us;
+    if (is_taken) {
+        str_cpy(server, speculation->best);
+    }
+    mtx_unlock(&speculation->mutex);
+    return is_taken;
+}
+
+void
+nordi_speculation_wait(nordi_speculation_ptr speculation) {
+    if (speculation == NULL) {
+        return;
+    }
+    mtx_lock(&speculation->mutex);
+    while (speculation->is_running && (speculation->is_requested || speculation->is_working)) {
+        cnd_wait(&speculation->idle, &speculation->mutex);
+    }
+    mtx_unlock(&speculation->mutex);
+}
+
+void
+nordi_speculation_free(nordi_speculation_ptr speculation) {
+    if (speculation == NULL) {
+        return;
+    }
+    mtx_lock(&speculation->mutex);
+    speculation->is_running = false;
+    speculation_invalidate(speculation);
+    cnd_signal(&speculation->wakeup);
+    mtx_unlock(&speculation->mutex);
+    thrd_join(speculation->thread, NULL);
+    str_free(speculation->best);
+    cnd_destroy(&speculation->wakeup);
+    cnd_destroy(&speculation->idle);
+    mtx_destroy(&speculation->mutex);
+    close(speculation->cancel);
+    free(speculation);
+}
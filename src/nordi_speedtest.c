@@ -0,0 +1,435 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "nordi_probe.h"
+#include "nordi_speedtest.h"
+
+#define MAX_EVENTS      32
+#define SINK_BUFFER     (64 * 1024)
+#define SINK_TURN_READS 4
+#define STOP_EVENT      UINT32_MAX
+#define LISTEN_EVENT    (UINT32_MAX - 1)
+#define DATA_SEED       0x9e3779b97f4a7c15ULL
+
+const nordi_speedtest_options_t SPEEDTEST_DEFAULT_OPTIONS = {
+    .streams = SPEEDTEST_DEFAULT_STREAMS,
+    .duration_ms = SPEEDTEST_DEFAULT_DURATION_MS,
+    .interval_ms = SPEEDTEST_DEFAULT_INTERVAL_MS,
+    .timeout_ms = SPEEDTEST_DEFAULT_TIMEOUT_MS,
+};
+
+typedef struct {
+    int socket;
+    off_t offset; // next byte of the data to send
+    unsigned long long written;
+    bool is_connected;
+} stream_t;
+
+typedef struct {
+    unsigned char* data; // `SPEEDTEST_CHUNK` bytes of noise
+    int file;            // the same bytes, sendfile source, -1 if there is none
+    FILE* backing;
+    stream_t streams[SPEEDTEST_MAX_STREAMS];
+    int count;
+    int open; // streams connecting or connected
+    int epoll;
+} test_t;
+
+static long long
+now_us() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+// Fill the data with noise, compressing links would make anything more regular look faster than it is
+static bool
+test_prepare(test_t* test) {
+    test->data = malloc(SPEEDTEST_CHUNK);
+    if (test->data == NULL) {
+        return false;
+    }
+    uint64_t state = DATA_SEED;
+    for (int index = 0; index < SPEEDTEST_CHUNK; index++) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        test->data[index] = (unsigned char)state;
+    }
+    // without a backing file the data is sent from memory instead
+    test->file = -1;
+    test->backing = tmpfile();
+    if (test->backing != NULL && fwrite(test->data, 1, SPEEDTEST_CHUNK, test->backing) == SPEEDTEST_CHUNK
+        && fflush(test->backing) == 0) {
+        test->file = fileno(test->backing);
+    }
+    return true;
+}
+
+static void
+stream_close(test_t* test, stream_t* stream) {
+    if (stream->socket < 0) {
+        return;
+    }
+    epoll_ctl(test->epoll, EPOLL_CTL_DEL, stream->socket, NULL);
+    close(stream->socket);
+    stream->socket = -1;
+    test->open--;
+}
+
+static void
+test_connect(test_t* test, const struct addrinfo* address, int count) {
+    while (test->count < count) {
+        int index = test->count++;
+        stream_t* stream = &test->streams[index];
+        *stream = (stream_t){.socket = socket(address->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)};
+        if (stream->socket < 0) {
+            continue;
+        }
+        test->open++;
+        struct epoll_event event = {.events = EPOLLOUT, .data.u32 = (uint32_t)index};
+        if ((connect(stream->socket, address->ai_addr, address->ai_addrlen) < 0 && errno != EINPROGRESS)
+            || epoll_ctl(test->epoll, EPOLL_CTL_ADD, stream->socket, &event) < 0) {
+            stream_close(test, stream);
+        }
+    }
+}
+
+// Send until the socket buffer is full, or a chunk went out so the other streams get their turn
+static void
+stream_pump(test_t* test, stream_t* stream, nordi_speedtest_result_ptr result) {
+    for (size_t pumped = 0; pumped < SPEEDTEST_CHUNK;) {
+        ssize_t sent;
+        size_t length = SPEEDTEST_CHUNK - stream->offset;
+        if (test->file >= 0) {
+            sent = sendfile(stream->socket, test->file, &stream->offset, length);
+            if (sent < 0 && (errno == EINVAL || errno == ENOSYS)) {
+                // sendfile isn't supported between these two, stay on copies from now on
+                test->file = -1;
+                result->is_zero_copy = false;
+                continue;
+            }
+        } else {
+            sent = send(stream->socket, test->data + stream->offset, length, MSG_NOSIGNAL);
+            if (sent > 0) {
+                stream->offset += sent;
+            }
+        }
+        if (sent < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                stream_close(test, stream);
+            }
+            return;
+        }
+        stream->written += sent;
+        pumped += sent;
+        if (stream->offset >= SPEEDTEST_CHUNK) {
+            stream->offset = 0;
+        }
+    }
+}
+
+// Bytes the sink acknowledged: written, minus whatever still waits in the socket
+static unsigned long long
+stream_delivered(const stream_t* stream) {
+    int pending = 0;
+    if (stream->socket < 0 || ioctl(stream->socket, TIOCOUTQ, &pending) < 0 || pending < 0) {
+        pending = 0;
+    }
+    return (unsigned long long)pending < stream->written ? stream->written - pending : 0;
+}
+
+static unsigned long long
+test_delivered(const test_t* test) {
+    unsigned long long delivered = 0;
+    for (int index = 0; index < test->count; index++) {
+        if (test->streams[index].is_connected) {
+            delivered += stream_delivered(&test->streams[index]);
+        }
+    }
+    return delivered;
+}
+
+static unsigned int
+ramp_up_ms(const double* rates, int count, int interval_ms, unsigned int elapsed_ms) {
+    if (count == 0) {
+        return elapsed_ms;
+    }
+    // the second half of the test stands for the steady rate
+    double steady = 0;
+    for (int index = count / 2; index < count; index++) {
+        steady += rates[index];
+    }
+    steady /= count - count / 2;
+    for (int index = 0; index < count; index++) {
+        if (rates[index] >= steady * SPEEDTEST_RAMP_UP_THRESHOLD) {
+            return (unsigned int)((index + 1) * interval_ms);
+        }
+    }
+    return elapsed_ms;
+}
+
+static void
+test_finish(test_t* test, nordi_speedtest_result_ptr result, long long begin_us, long long end_us) {
+    for (int index = 0; index < test->count; index++) {
+        stream_t* stream = &test->streams[index];
+        if (stream->is_connected) {
+            result->stream_bytes[result->streams++] = stream_delivered(stream);
+            result->bytes += result->stream_bytes[result->streams - 1];
+        }
+        stream_close(test, stream);
+    }
+    result->elapsed_ms = begin_us > 0 ? (unsigned int)((end_us - begin_us) / 1000) : 0;
+    if (result->elapsed_ms > 0) {
+        result->goodput_bps = result->bytes * 8000.0 / result->elapsed_ms;
+    }
+    result->fairness = nordi_speedtest_fairness(result->stream_bytes, result->streams);
+    close(test->epoll);
+    if (test->backing != NULL) {
+        fclose(test->backing);
+    }
+    free(test->data);
+}
+
+bool
+nordi_speedtest_run(str target, nordi_speedtest_options_ptr options, nordi_speedtest_result_ptr result,
+                    atomic_bool* cancel) {
+    if (options == NULL) {
+        options = &SPEEDTEST_DEFAULT_OPTIONS;
+    }
+    *result = (nordi_speedtest_result_t){};
+    int count = options->streams < 1 ? 1 : options->streams;
+    count = count > SPEEDTEST_MAX_STREAMS ? SPEEDTEST_MAX_STREAMS : count;
+    int interval_ms = options->interval_ms > 0 ? options->interval_ms : SPEEDTEST_DEFAULT_INTERVAL_MS;
+    struct addrinfo* address = nordi_probe_resolve(target, PROBE_TCP, SPEEDTEST_DEFAULT_PORT);
+    if (address == NULL) {
+        return false;
+    }
+    test_t test = {.epoll = epoll_create1(EPOLL_CLOEXEC)};
+    if (test.epoll < 0 || !test_prepare(&test)) {
+        freeaddrinfo(address);
+        test_finish(&test, result, 0, 0);
+        return false;
+    }
+    result->is_zero_copy = test.file >= 0;
+    test_connect(&test, address, count);
+    freeaddrinfo(address);
+    double rates[SPEEDTEST_MAX_SAMPLES];
+    int samples = 0;
+    unsigned long long last_delivered = 0;
+    long long now = now_us(), begin_us = 0, next_sample_us = 0;
+    long long deadline_us = now + options->timeout_ms * 1000LL;
+    bool is_cancelled = false;
+    struct epoll_event events[MAX_EVENTS];
+    while (test.open > 0) {
+        is_cancelled = cancel != NULL && *cancel;
+        if (is_cancelled || now >= deadline_us) {
+            break;
+        }
+        long long wake_us = begin_us > 0 && next_sample_us < deadline_us ? next_sample_us : deadline_us;
+        int ready = epoll_wait(test.epoll, events, MAX_EVENTS, (int)((wake_us - now + 999) / 1000));
+        for (int event = 0; event < ready; event++) {
+            stream_t* stream = &test.streams[events[event].data.u32];
+            if (stream->socket < 0) {
+                continue;
+            }
+            if (!stream->is_connected) {
+                int error = 0;
+                socklen_t length = sizeof(error);
+                getsockopt(stream->socket, SOL_SOCKET, SO_ERROR, &error, &length);
+                if (error != 0 || (events[event].events & (EPOLLERR | EPOLLHUP))) {
+                    stream_close(&test, stream);
+                    continue;
+                }
+                stream->is_connected = true;
+                if (begin_us == 0) {
+                    // the duration starts with the first stream, the rest joining late is part of the ramp up
+                    begin_us = now_us();
+                    next_sample_us = begin_us + interval_ms * 1000LL;
+                    deadline_us = begin_us + options->duration_ms * 1000LL;
+                }
+            }
+            stream_pump(&test, stream, result);
+        }
+        now = now_us();
+        while (begin_us > 0 && now >= next_sample_us && next_sample_us <= deadline_us) {
+            unsigned long long delivered = test_delivered(&test);
+            if (samples < SPEEDTEST_MAX_SAMPLES) {
+                rates[samples++] = (delivered - last_delivered) * 8000.0 / interval_ms;
+            }
+            last_delivered = delivered;
+            next_sample_us += interval_ms * 1000LL;
+        }
+    }
+    bool is_complete = begin_us > 0 && !is_cancelled && now >= deadline_us;
+    test_finish(&test, result, begin_us, now < deadline_us ? now : deadline_us);
+    result->ramp_up_ms = ramp_up_ms(rates, samples, interval_ms, result->elapsed_ms);
+    return is_complete;
+}
+
+double
+nordi_speedtest_fairness(const unsigned long long* bytes, int count) {
+    double sum = 0, squares = 0;
+    for (int index = 0; index < count; index++) {
+        sum += (double)bytes[index];
+        squares += (double)bytes[index] * bytes[index];
+    }
+    return squares > 0 ? sum * sum / (count * squares) : 0;
+}
+
+static void
+sink_drain(nordi_speedtest_sink_ptr sink, int epoll, int* client) {
+    unsigned char buffer[SINK_BUFFER];
+    // a bounded drain per turn keeps one stream from starving the others, the test would measure the sink's fairness
+    for (int turn = 0; turn < SINK_TURN_READS; turn++) {
+        // MSG_TRUNC discards TCP data in the kernel, the buffer is never written
+        ssize_t received = recv(*client, buffer, sizeof(buffer), MSG_TRUNC | MSG_DONTWAIT);
+        if (received > 0) {
+            atomic_fetch_add(&sink->bytes, (unsigned long long)received);
+            continue;
+        }
+        if (received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            epoll_ctl(epoll, EPOLL_CTL_DEL, *client, NULL);
+            close(*client);
+            *client = -1;
+        }
+        return;
+    }
+}
+
+static void
+sink_accept(nordi_speedtest_sink_ptr sink, int epoll, int* clients) {
+    int client;
+    while ((client = accept(sink->listener, NULL, NULL)) >= 0) {
+        int slot = 0;
+        while (slot < SPEEDTEST_SINK_MAX_CONNECTIONS && clients[slot] >= 0) {
+            slot++;
+        }
+        struct epoll_event event = {.events = EPOLLIN, .data.u32 = (uint32_t)slot};
+        if (slot == SPEEDTEST_SINK_MAX_CONNECTIONS || fcntl(client, F_SETFL, O_NONBLOCK) < 0
+            || fcntl(client, F_SETFD, FD_CLOEXEC) < 0 || epoll_ctl(epoll, EPOLL_CTL_ADD, client, &event) < 0) {
+            close(client);
+            continue;
+        }
+        clients[slot] = client;
+        atomic_fetch_add(&sink->connections, 1);
+    }
+}
+
+static int
+sink_worker(nordi_speedtest_sink_ptr sink) {
+    int clients[SPEEDTEST_SINK_MAX_CONNECTIONS];
+    memset(clients, -1, sizeof(clients));
+    int epoll = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event listen_event = {.events = EPOLLIN, .data.u32 = LISTEN_EVENT};
+    struct epoll_event stop_event = {.events = EPOLLIN, .data.u32 = STOP_EVENT};
+    if (epoll < 0 || epoll_ctl(epoll, EPOLL_CTL_ADD, sink->listener, &listen_event) < 0
+        || epoll_ctl(epoll, EPOLL_CTL_ADD, sink->stop, &stop_event) < 0) {
+        if (epoll >= 0) {
+            close(epoll);
+        }
+        return thrd_error;
+    }
+    struct epoll_event events[MAX_EVENTS];
+    bool is_running = true;
+    while (is_running) {
+        int ready = epoll_wait(epoll, events, MAX_EVENTS, -1);
+        for (int event = 0; event < ready; event++) {
+            uint32_t slot = events[event].data.u32;
+            if (slot == STOP_EVENT) {
+                is_running = false;
+            } else if (slot == LISTEN_EVENT) {
+                sink_accept(sink, epoll, clients);
+            } else {
+                sink_drain(sink, epoll, &clients[slot]);
+            }
+        }
+    }
+    for (int slot = 0; slot < SPEEDTEST_SINK_MAX_CONNECTIONS; slot++) {
+        if (clients[slot] >= 0) {
+            close(clients[slot]);
+        }
+    }
+    close(epoll);
+    return thrd_success;
+}
+
+nordi_speedtest_sink_ptr
+nordi_speedtest_sink_new(const char* bind_address, int port) {
+    struct sockaddr_in address = {.sin_family = AF_INET, .sin_port = htons(port)};
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind_address != NULL && inet_pton(AF_INET, bind_address, &address.sin_addr) != 1) {
+        return NULL;
+    }
+    nordi_speedtest_sink_ptr sink = calloc(1, sizeof(nordi_speedtest_sink_t));
+    if (sink == NULL) {
+        return NULL;
+    }
+    atomic_init(&sink->bytes, 0);
+    atomic_init(&sink->connections, 0);
+    sink->listener = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    sink->stop = eventfd(0, EFD_CLOEXEC);
+    socklen_t length = sizeof(address);
+    int reuse = 1;
+    if (sink->listener < 0 || sink->stop < 0
+        || setsockopt(sink->listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) < 0
+        || bind(sink->listener, (struct sockaddr*)&address, sizeof(address)) < 0
+        || listen(sink->listener, SOMAXCONN) < 0
+        || getsockname(sink->listener, (struct sockaddr*)&address, &length) < 0
+        || thrd_create(&sink->thread, (int (*)(void*))sink_worker, sink) != thrd_success) {
+        if (sink->listener >= 0) {
+            close(sink->listener);
+        }
+        if (sink->stop >= 0) {
+            close(sink->stop);
+        }
+        free(sink);
+        return NULL;
+    }
+    sink->port = ntohs(address.sin_port);
+    return sink;
+}
+
+void
+nordi_speedtest_sink_free(nordi_speedtest_sink_ptr sink) {
+    if (sink == NULL) {
+        return;
+    }
+    uint64_t signal = 1;
+    ssize_t written;
+    do {
+        written = write(sink->stop, &signal, sizeof(signal));
+    } while (written < 0 && errno == EINTR);
+    if (written != sizeof(signal)) {
+        // the thread would never wake to be joined, it is left running with the sink rather than block forever
+        fprintf(stderr, "ERROR: stopping the speed test sink: %s\n", strerror(errno));
+        thrd_detach(sink->thread);
+        return;
+    }
+    thrd_join(sink->thread, NULL);
+    close(sink->listener);
+    close(sink->stop);
+    free(sink);
+}
@@ -0,0 +1,348 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "nordi_trace.h"
+
+// A trace is text, a line per record:
+//   nordi-trace 1
+//   run <start us> <argument count>
+//   arg <argument>                     (argument count times)
+//   out <offset us> <output chunk>     (any number of times)
+//   exit <offset us> <exit code>
+// Arguments and output are escaped as C strings without the quotes, so a line holds a whole chunk.
+#define TRACE_HEADER  "nordi-trace 1"
+#define MAX_PATH      4096
+#define FIRST_RUNS    16
+#define FIRST_CHUNKS  8
+
+static long long
+now_us() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+// Escaped characters, each followed by the letter escaping it
+static const char ESCAPES[] = "\\\\\nn\rr\tt";
+
+static void
+write_escaped(FILE* file, const char* data, size_t length) {
+    for (size_t index = 0; index < length; index++) {
+        unsigned char character = (unsigned char)data[index];
+        const char* escape = character != '\0' ? strchr(ESCAPES, character) : NULL;
+        if (escape != NULL && (escape - ESCAPES) % 2 == 0) {
+            fprintf(file, "\\%c", escape[1]);
+        } else if (character < 0x20 || character >= 0x7f) {
+            fprintf(file, "\\x%02x", character);
+        } else {
+            fputc(character, file);
+        }
+    }
+}
+
+// Decode an escaped field into a new allocation, NULL if it failed to allocate
+static char*
+read_escaped(const char* text, size_t* length) {
+    char* data = malloc(strlen(text) + 1);
+    if (data == NULL) {
+        return NULL;
+    }
+    size_t count = 0;
+    for (const char* next = text; *next != '\0'; next++) {
+        if (*next != '\\' || next[1] == '\0') {
+            data[count++] = *next;
+            continue;
+        }
+        next++;
+        if (*next == 'x') {
+            char digits[3] = {next[1], next[1] != '\0' ? next[2] : '\0', '\0'};
+            data[count++] = (char)strtol(digits, NULL, 16);
+            next += strlen(digits);
+            continue;
+        }
+        const char* escape = strchr(ESCAPES, *next);
+        data[count++] = escape != NULL && (escape - ESCAPES) % 2 == 1 ? escape[-1] : *next;
+    }
+    data[count] = '\0';
+    *length = count;
+    return data;
+}
+
+static void
+run_clear(nordi_trace_run_t* run) {
+    for (int index = 0; index < run->argument_count; index++) {
+        free(run->arguments[index]);
+    }
+    for (int index = 0; index < run->chunk_count; index++) {
+        free(run->chunks[index].data);
+    }
+    free(run->chunks);
+    *run = (nordi_trace_run_t){};
+}
+
+static bool
+run_add_chunk(nordi_trace_run_t* run, long long offset_us, char* data, size_t length) {
+    if (run->chunk_count == run->chunk_capacity) {
+        int capacity = run->chunk_capacity > 0 ? run->chunk_capacity * 2 : FIRST_CHUNKS;
+        nordi_trace_chunk_t* grown = realloc(run->chunks, capacity * sizeof(nordi_trace_chunk_t));
+        if (grown == NULL) {
+            return false;
+        }
+        run->chunks = grown;
+        run->chunk_capacity = capacity;
+    }
+    run->chunks[run->chunk_count++] = (nordi_trace_chunk_t){.offset_us = offset_us, .data = data, .length = length};
+    return true;
+}
+
+// Keeps a loaded run, the trace takes what it holds
+static bool
+trace_add_run(nordi_trace_ptr trace, nordi_trace_run_t* run) {
+    if (trace->run_count == trace->run_capacity) {
+        int capacity = trace->run_capacity > 0 ? trace->run_capacity * 2 : FIRST_RUNS;
+        nordi_trace_run_t* grown = realloc(trace->runs, capacity * sizeof(nordi_trace_run_t));
+        if (grown == NULL) {
+            return false;
+        }
+        trace->runs = grown;
+        trace->run_capacity = capacity;
+    }
+    trace->runs[trace->run_count++] = *run;
+    *run = (nordi_trace_run_t){};
+    return true;
+}
+
+static bool
+run_matches(const nordi_trace_run_t* run, const char** arguments) {
+    int index = 0;
+    for (; index < run->argument_count && arguments[index + 1] != NULL; index++) {
+        if (strcmp(run->arguments[index], arguments[index + 1]) != 0) {
+            return false;
+        }
+    }
+    return index == run->argument_count && arguments[index + 1] == NULL;
+}
+
+// Sleep until the offset from the start, scaled by the speed
+static void
+trace_wait(long long start_us, long long offset_us, double speed) {
+    if (speed <= 0) {
+        return;
+    }
+    long long remaining = start_us + (long long)(offset_us / speed) - now_us();
+    if (remaining > 0) {
+        thrd_sleep(&(struct timespec){.tv_sec = remaining / 1000000, .tv_nsec = remaining % 1000000 * 1000}, NULL);
+    }
+}
+
+static bool
+write_sink(FILE* file, const char* data, size_t length) {
+    // flushed as it goes, the reader times the chunks
+    return fwrite(data, 1, length, file) == length && fflush(file) == 0;
+}
+
+static nordi_trace_ptr
+trace_new(FILE* file) {
+    nordi_trace_ptr trace = calloc(1, sizeof(nordi_trace_t));
+    if (trace == NULL) {
+        return NULL;
+    }
+    if (mtx_init(&trace->mutex, mtx_plain) != thrd_success) {
+        free(trace);
+        return NULL;
+    }
+    trace->file = file;
+    trace->start_us = now_us();
+    return trace;
+}
+
+nordi_trace_ptr
+nordi_trace_record(const char* path) {
+    FILE* file = fopen(path, "a");
+    if (file == NULL) {
+        return NULL;
+    }
+    nordi_trace_ptr trace = trace_new(file);
+    if (trace == NULL) {
+        fclose(file);
+        return NULL;
+    }
+    if (ftell(file) == 0) {
+        fprintf(file, TRACE_HEADER "\n");
+        fflush(file);
+    }
+    return trace;
+}
+
+void
+nordi_trace_begin(nordi_trace_run_t* run, const char** arguments) {
+    *run = (nordi_trace_run_t){.start_us = now_us()};
+    for (int index = 1; arguments[index] != NULL && run->argument_count < TRACE_MAX_ARGUMENTS; index++) {
+        run->arguments[run->argument_count] = strdup(arguments[index]);
+        run->argument_count += run->arguments[run->argument_count] != NULL;
+    }
+}
+
+bool
+nordi_trace_output(nordi_trace_run_t* run, const char* data, size_t length) {
+    char* copy = malloc(length);
+    if (copy == NULL) {
+        return false;
+    }
+    memcpy(copy, data, length);
+    if (!run_add_chunk(run, now_us() - run->start_us, copy, length)) {
+        free(copy);
+        return false;
+    }
+    return true;
+}
+
+void
+nordi_trace_end(nordi_trace_ptr trace, nordi_trace_run_t* run, int exit_code) {
+    long long exit_us = now_us() - run->start_us;
+    mtx_lock(&trace->mutex);
+    fprintf(trace->file, "run %lld %d\n", run->start_us - trace->start_us, run->argument_count);
+    for (int index = 0; index < run->argument_count; index++) {
+        fputs("arg ", trace->file);
+        write_escaped(trace->file, run->arguments[index], strlen(run->arguments[index]));
+        fputc('\n', trace->file);
+    }
+    for (int index = 0; index < run->chunk_count; index++) {
+        fprintf(trace->file, "out %lld ", run->chunks[index].offset_us);
+        write_escaped(trace->file, run->chunks[index].data, run->chunks[index].length);
+        fputc('\n', trace->file);
+    }
+    fprintf(trace->file, "exit %lld %d\n", exit_us, exit_code);
+    // a run is only read back whole, so a crash loses at most the one being written
+    fflush(trace->file);
+    mtx_unlock(&trace->mutex);
+    run_clear(run);
+}
+
+nordi_trace_ptr
+nordi_trace_load(const char* path) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        return NULL;
+    }
+    char* line = NULL;
+    size_t capacity = 0;
+    ssize_t length = getline(&line, &capacity, file);
+    nordi_trace_ptr trace = NULL;
+    if (length > 0 && strncmp(line, TRACE_HEADER, strlen(TRACE_HEADER)) == 0) {
+        trace = trace_new(NULL);
+    }
+    nordi_trace_run_t run = {};
+    bool is_running = false; // a run was started and hasn't exited yet
+    while (trace != NULL && (length = getline(&line, &capacity, file)) > 0) {
+        line[strcspn(line, "\n")] = '\0';
+        long long offset = 0;
+        int value = 0, field = 0;
+        size_t size = 0;
+        if (sscanf(line, "run %lld %d", &offset, &value) == 2) {
+            run_clear(&run);
+            run.start_us = offset;
+            is_running = true;
+        } else if (is_running && strncmp(line, "arg ", 4) == 0 && run.argument_count < TRACE_MAX_ARGUMENTS) {
+            run.arguments[run.argument_count] = read_escaped(line + 4, &size);
+            run.argument_count += run.arguments[run.argument_count] != NULL;
+        } else if (is_running && sscanf(line, "out %lld%n", &offset, &field) == 1 && line[field] == ' ') {
+            // the chunk starts right after the one space, its own leading spaces are output
+            char* data = read_escaped(line + field + 1, &size);
+            if (data != NULL && !run_add_chunk(&run, offset, data, size)) {
+                free(data);
+            }
+        } else if (is_running && sscanf(line, "exit %lld %d", &offset, &value) == 2) {
+            run.exit_us = offset;
+            run.exit_code = value;
+            is_running = !trace_add_run(trace, &run);
+        }
+        // anything else is skipped, as is a run cut short
+    }
+    run_clear(&run);
+    free(line);
+    fclose(file);
+    return trace;
+}
+
+const nordi_trace_run_t*
+nordi_trace_find(nordi_trace_ptr trace, const char** arguments) {
+    for (int checked = 0; checked < trace->run_count; checked++) {
+        int index = (trace->cursor + checked) % trace->run_count;
+        if (run_matches(&trace->runs[index], arguments)) {
+            trace->cursor = (index + 1) % trace->run_count;
+            return &trace->runs[index];
+        }
+    }
+    return NULL;
+}
+
+int
+nordi_trace_play(const nordi_trace_run_t* run, double speed, nordi_trace_sink_t sink, void* context) {
+    long long start_us = now_us();
+    for (int index = 0; index < run->chunk_count; index++) {
+        trace_wait(start_us, run->chunks[index].offset_us, speed);
+        if (!sink(context, run->chunks[index].data, run->chunks[index].length)) {
+            return TRACE_STOPPED;
+        }
+    }
+    trace_wait(start_us, run->exit_us, speed);
+    return run->exit_code;
+}
+
+int
+nordi_trace_serve(const char* path, double speed, const char** arguments, FILE* output) {
+    nordi_trace_ptr trace = nordi_trace_load(path);
+    if (trace == NULL) {
+        fprintf(output, "ERROR: couldn't load the trace %s\n", path);
+        return EXIT_FAILURE;
+    }
+    char cursor_path[MAX_PATH];
+    snprintf(cursor_path, MAX_PATH, "%s" TRACE_CURSOR_SUFFIX, path);
+    FILE* cursor = fopen(cursor_path, "r");
+    if (cursor != NULL) {
+        if (fscanf(cursor, "%d", &trace->cursor) != 1 || trace->cursor < 0 || trace->cursor >= trace->run_count) {
+            trace->cursor = 0;
+        }
+        fclose(cursor);
+    }
+    const nordi_trace_run_t* run = nordi_trace_find(trace, arguments);
+    if (run == NULL) {
+        fprintf(output, "ERROR: the trace holds no run of these arguments\n");
+        nordi_trace_free(trace);
+        return EXIT_FAILURE;
+    }
+    cursor = fopen(cursor_path, "w");
+    if (cursor != NULL) {
+        fprintf(cursor, "%d\n", trace->cursor);
+        fclose(cursor);
+    }
+    int exit_code = nordi_trace_play(run, speed, (nordi_trace_sink_t)write_sink, output);
+    nordi_trace_free(trace);
+    return exit_code >= 0 ? exit_code : EXIT_FAILURE;
+}
+
+void
+nordi_trace_free(nordi_trace_ptr trace) {
+    if (trace == NULL) {
+        return;
+    }
+    if (trace->file != NULL) {
+        fclose(trace->file);
+    }
+    for (int index = 0; index < trace->run_count; index++) {
+        run_clear(&trace->runs[index]);
+    }
+    free(trace->runs);
+    mtx_destroy(&trace->mutex);
+    free(trace);
+}
@@ -0,0 +1,257 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+#include "nordi_traffic.h"
+
+#define MAX_COUNTER_TEXT 32
+
+// NordLynx first, as it is the default technology, then the OpenVPN tunnels
+static const char* const TUNNEL_INTERFACES[] = {"nordlynx", "nordtun", "tun0"};
+
+static long long
+traffic_now_us() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static int
+open_counter(const char* base_path, const char* interface, const char* counter) {
+    char path[TRAFFIC_MAX_PATH];
+    snprintf(path, TRAFFIC_MAX_PATH, "%s/%s/statistics/%s", base_path, interface, counter);
+    return open(path, O_RDONLY | O_CLOEXEC);
+}
+
+static bool
+read_counter(int fd, uint64_t* value) {
+    char text[MAX_COUNTER_TEXT];
+    ssize_t length = pread(fd, text, sizeof(text) - 1, 0);
+    if (length <= 0) {
+        return false;
+    }
+    text[length] = '\0';
+    *value = strtoull(text, NULL, 10);
+    return true;
+}
+
+static void
+traffic_push(nordi_traffic_ptr traffic, const nordi_traffic_sample_t* sample) {
+    unsigned int head = atomic_load_explicit(&traffic->head, memory_order_relaxed);
+    unsigned int tail = atomic_load_explicit(&traffic->tail, memory_order_acquire);
+    if (head - tail == TRAFFIC_RING_SIZE) {
+        traffic->dropped++;
+        return;
+    }
+    traffic->ring[head % TRAFFIC_RING_SIZE] = *sample;
+    atomic_store_explicit(&traffic->head, head + 1, memory_order_release);
+    if (traffic->notify != NULL && !atomic_exchange(&traffic->is_notified, true)) {
+        traffic->notify(traffic->context);
+    }
+}
+
+// Read the counters and push their rates since the last sample. Counters going back (interface re-created)
+// and rebases only take a new baseline.
+static void
+traffic_sample(nordi_traffic_ptr traffic, long long now) {
+    uint64_t rx, tx;
+    if (!read_counter(traffic->rx_fd, &rx) || !read_counter(traffic->tx_fd, &tx)) {
+        return;
+    }
+    bool is_rebased = atomic_exchange(&traffic->is_rebased, false);
+    if (!is_rebased && now > traffic->last_us && rx >= traffic->last_rx && tx >= traffic->last_tx) {
+        double elapsed_s = (now - traffic->last_us) / 1000000.0;
+        nordi_traffic_sample_t sample = {
+            .time_us = now,
+            .rx_rate = (rx - traffic->last_rx) / elapsed_s,
+            .tx_rate = (tx - traffic->last_tx) / elapsed_s,
+        };
+        traffic_push(traffic, &sample);
+    }
+    traffic->last_rx = rx;
+    traffic->last_tx = tx;
+    traffic->last_us = now;
+}
+
+static int
+traffic_worker(nordi_traffic_ptr traffic) {
+    struct pollfd fds[] = {
+        {.fd = traffic->timer, .events = POLLIN},
+        {.fd = traffic->stop, .events = POLLIN},
+    };
+    while (true) {
+        if (poll(fds, 2, -1) < 0) {
+            continue;
+        }
+        atomic_fetch_add(&traffic->wakeups, 1);
+        if (fds[1].revents & POLLIN) {
+            break;
+        }
+        uint64_t expirations;
+        if ((fds[0].revents & POLLIN) && read(traffic->timer, &expirations, sizeof(expirations)) > 0) {
+            traffic_sample(traffic, traffic_now_us());
+        }
+    }
+    return thrd_success;
+}
+
+static bool
+traffic_arm(nordi_traffic_ptr traffic, int interval_ms) {
+    struct timespec interval = {.tv_sec = interval_ms / 1000, .tv_nsec = (interval_ms % 1000) * 1000000L};
+    struct itimerspec cadence = {.it_interval = interval, .it_value = interval};
+    return timerfd_settime(traffic->timer, 0, &cadence, NULL) == 0;
+}
+
+static bool
+traffic_open(nordi_traffic_ptr traffic, const char* base_path, const char* interface) {
+    int candidates = sizeof(TUNNEL_INTERFACES) / sizeof(*TUNNEL_INTERFACES);
+    for (int index = 0; index < candidates && traffic->rx_fd < 0; index++) {
+        const char* name = interface != NULL ? interface : TUNNEL_INTERFACES[index];
+        traffic->rx_fd = open_counter(base_path, name, "rx_bytes");
+        traffic->tx_fd = open_counter(base_path, name, "tx_bytes");
+        if (traffic->rx_fd >= 0 && traffic->tx_fd >= 0) {
+            snprintf(traffic->interface, TRAFFIC_MAX_INTERFACE, "%s", name);
+            break;
+        }
+        if (traffic->rx_fd >= 0) {
+            close(traffic->rx_fd);
+        }
+        if (traffic->tx_fd >= 0) {
+            close(traffic->tx_fd);
+        }
+        traffic->rx_fd = traffic->tx_fd = -1;
+        if (interface != NULL) {
+            break;
+        }
+    }
+    traffic->timer = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    traffic->stop = eventfd(0, EFD_CLOEXEC);
+    return traffic->rx_fd >= 0 && traffic->timer >= 0 && traffic->stop >= 0;
+}
+
+static void
+traffic_close(nordi_traffic_ptr traffic) {
+    int fds[] = {traffic->rx_fd, traffic->tx_fd, traffic->timer, traffic->stop};
+    for (int index = 0; index < 4; index++) {
+        if (fds[index] >= 0) {
+            close(fds[index]);
+        }
+    }
+    free(traffic);
+}
+
+nordi_traffic_ptr
+nordi_traffic_new(const char* base_path, const char* interface, int interval_ms, nordi_traffic_notify_t notify,
+                  void* context) {
+    nordi_traffic_ptr traffic = (nordi_traffic_ptr)calloc(1, sizeof(nordi_traffic_t));
+    if (traffic == NULL) {
+        return NULL;
+    }
+    traffic->rx_fd = traffic->tx_fd = traffic->timer = traffic->stop = -1;
+    traffic->interval_ms = interval_ms > 0 ? interval_ms : TRAFFIC_DEFAULT_INTERVAL_MS;
+    traffic->notify = notify;
+    traffic->context = context;
+    traffic->is_rebased = true;
+    if (!traffic_open(traffic, base_path != NULL ? base_path : TRAFFIC_SYSFS_PATH, interface)) {
+        traffic_close(traffic);
+        return NULL;
+    }
+    // baseline now, so the first tick already has a rate
+    traffic_sample(traffic, traffic_now_us());
+    if (!traffic_arm(traffic, traffic->interval_ms)) {
+        traffic_close(traffic);
+        return NULL;
+    }
+    if (thrd_create(&traffic->thread, (int (*)(void*))traffic_worker, (void*)traffic) != thrd_success) {
+        traffic_close(traffic);
+        return NULL;
+    }
+    return traffic;
+}
+
+bool
+nordi_traffic_pop(nordi_traffic_ptr traffic, nordi_traffic_sample_ptr sample) {
+    unsigned int tail = atomic_load_explicit(&traffic->tail, memory_order_relaxed);
+    if (tail == atomic_load_explicit(&traffic->head, memory_order_acquire)) {
+        // re-arm the notification, then check again for a sample that landed while it was still pending
+        atomic_store(&traffic->is_notified, false);
+        if (tail == atomic_load_explicit(&traffic->head, memory_order_acquire)) {
+            return false;
+        }
+    }
+    *sample = traffic->ring[tail % TRAFFIC_RING_SIZE];
+    atomic_store_explicit(&traffic->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+bool
+nordi_traffic_read(nordi_traffic_ptr traffic, uint64_t* rx, uint64_t* tx) {
+    return traffic != NULL && read_counter(traffic->rx_fd, rx) && read_counter(traffic->tx_fd, tx);
+}
+
+void
+nordi_traffic_pause(nordi_traffic_ptr traffic, bool is_paused) {
+    if (traffic == NULL) {
+        return;
+    }
+    if (is_paused == traffic->is_paused) {
+        return;
+    }
+    traffic->is_paused = is_paused;
+    if (is_paused) {
+        // a zeroed timer is disarmed, the thread stays asleep in poll
+        struct itimerspec disarm = {};
+        timerfd_settime(traffic->timer, 0, &disarm, NULL);
+        return;
+    }
+    // a rate averaged over the pause is meaningless, start over
+    traffic->is_rebased = true;
+    traffic_arm(traffic, traffic->interval_ms);
+}
+
+void
+nordi_traffic_set_interval(nordi_traffic_ptr traffic, int interval_ms) {
+    interval_ms = interval_ms > 0 ? interval_ms : TRAFFIC_DEFAULT_INTERVAL_MS;
+    if (traffic == NULL || interval_ms == traffic->interval_ms) {
+        return;
+    }
+    traffic->interval_ms = interval_ms;
+    if (!traffic->is_paused) {
+        traffic_arm(traffic, interval_ms);
+    }
+}
+
+void
+nordi_traffic_free(nordi_traffic_ptr traffic) {
+    if (traffic == NULL) {
+        return;
+    }
+    uint64_t signal = 1;
+    ssize_t written;
+    do {
+        written = write(traffic->stop, &signal, sizeof(signal));
+    } while (written < 0 && errno == EINTR);
+    if (written != sizeof(signal)) {
+        // a paused thread would never wake to be joined, it is left running with the sampler rather than block
+        fprintf(stderr, "ERROR: stopping the traffic sampler: %s\n", strerror(errno));
+        thrd_detach(traffic->thread);
+        return;
+    }
+    thrd_join(traffic->thread, NULL);
+    traffic_close(traffic);
+}
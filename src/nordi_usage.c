@@ -0,0 +1,296 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "nordi_usage.h"
+
+#define COMPACT_SLACK    64 // records allowed above two per day before compacting
+#define INITIAL_DAYS     32
+#define TEMPORARY_SUFFIX ".tmp"
+#define CRC32_POLYNOMIAL 0xedb88320u
+
+// On disk record, native byte order, as the journal never leaves the machine
+typedef struct {
+    uint32_t date;
+    uint32_t crc; // crc32 of date, rx and tx
+    uint64_t rx;
+    uint64_t tx;
+} usage_record_t;
+
+static uint32_t
+crc32_update(uint32_t crc, const void* data, size_t length) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    crc = ~crc;
+    for (size_t index = 0; index < length; index++) {
+        crc ^= bytes[index];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (CRC32_POLYNOMIAL & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+static uint32_t
+record_crc(const usage_record_t* record) {
+    uint32_t crc = crc32_update(0, &record->date, sizeof(record->date));
+    crc = crc32_update(crc, &record->rx, sizeof(record->rx));
+    return crc32_update(crc, &record->tx, sizeof(record->tx));
+}
+
+static uint32_t
+local_date(time_t when) {
+    struct tm local;
+    localtime_r(&when, &local);
+    return (uint32_t)((local.tm_year + 1900) * 10000 + (local.tm_mon + 1) * 100 + local.tm_mday);
+}
+
+// Find the day in the sorted totals, or where it would be inserted
+static int
+find_day(nordi_usage_ptr usage, uint32_t date) {
+    int low = 0, high = usage->day_count;
+    while (low < high) {
+        int middle = (low + high) / 2;
+        if (usage->days[middle].date < date) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+static nordi_usage_total_t*
+get_day(nordi_usage_ptr usage, uint32_t date) {
+    int index = find_day(usage, date);
+    if (index < usage->day_count && usage->days[index].date == date) {
+        return &usage->days[index];
+    }
+    if (usage->day_count == usage->day_capacity) {
+        int capacity = usage->day_capacity > 0 ? usage->day_capacity * 2 : INITIAL_DAYS;
+        nordi_usage_total_t* days = (nordi_usage_total_t*)realloc(usage->days, capacity * sizeof(nordi_usage_total_t));
+        if (days == NULL) {
+            return NULL;
+        }
+        usage->days = days;
+        usage->day_capacity = capacity;
+    }
+    memmove(&usage->days[index + 1], &usage->days[index], (usage->day_count - index) * sizeof(nordi_usage_total_t));
+    usage->days[index] = (nordi_usage_total_t){.date = date};
+    usage->day_count++;
+    return &usage->days[index];
+}
+
+// Sum the journal records into the day totals, stopping at the first torn or corrupt record
+static bool
+usage_load(nordi_usage_ptr usage) {
+    usage_record_t record;
+    off_t valid = 0;
+    while (pread(usage->fd, &record, sizeof(record), valid) == sizeof(record) && record.crc == record_crc(&record)) {
+        nordi_usage_total_t* day = get_day(usage, record.date);
+        if (day == NULL) {
+            return false;
+        }
+        day->rx += record.rx;
+        day->tx += record.tx;
+        usage->records++;
+        valid += sizeof(record);
+    }
+    // appends must not land after garbage
+    return ftruncate(usage->fd, valid) == 0;
+}
+
+static bool
+write_all(int fd, const void* data, size_t length) {
+    const char* bytes = (const char*)data;
+    while (length > 0) {
+        ssize_t written = write(fd, bytes, length);
+        if (written < 0) {
+            return false;
+        }
+        bytes += written;
+        length -= written;
+    }
+    return true;
+}
+
+// Rewrite the journal as one record per day, to a temporary file renamed over it once synced
+static bool
+usage_compact(nordi_usage_ptr usage) {
+    char temporary[USAGE_MAX_PATH + sizeof(TEMPORARY_SUFFIX)];
+    snprintf(temporary, sizeof(temporary), "%s" TEMPORARY_SUFFIX, usage->path);
+    int fd = open(temporary, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return false;
+    }
+    usage_record_t* records = (usage_record_t*)calloc(usage->day_count, sizeof(usage_record_t));
+    bool is_written = records != NULL;
+    for (int index = 0; is_written && index < usage->day_count; index++) {
+        records[index] = (usage_record_t){.date = usage->days[index].date, .rx = usage->days[index].rx, .tx = usage->days[index].tx};
+        records[index].crc = record_crc(&records[index]);
+    }
+    is_written = is_written && write_all(fd, records, usage->day_count * sizeof(usage_record_t)) && fdatasync(fd) == 0;
+    free(records);
+    close(fd);
+    if (!is_written || rename(temporary, usage->path) != 0) {
+        unlink(temporary);
+        return false;
+    }
+    // the old fd now appends to the unlinked journal, where nothing would ever be read back
+    close(usage->fd);
+    usage->fd = open(usage->path, O_WRONLY | O_APPEND | O_CLOEXEC);
+    if (usage->fd < 0) {
+        fprintf(stderr, "ERROR: reopening %s after compacting it: %s\n", usage->path, strerror(errno));
+    }
+    usage->records = usage->day_count;
+    usage->flushes++;
+    return true;
+}
+
+nordi_usage_ptr
+nordi_usage_open(const char* path, int flush_interval_s) {
+    nordi_usage_ptr usage = (nordi_usage_ptr)calloc(1, sizeof(nordi_usage_t));
+    if (usage == NULL) {
+        return NULL;
+    }
+    snprintf(usage->path, USAGE_MAX_PATH, "%s", path);
+    usage->flush_interval_s = flush_interval_s >= 0 ? flush_interval_s : USAGE_DEFAULT_FLUSH_S;
+    usage->last_flush = time(NULL);
+    usage->fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+    if (usage->fd < 0 || !usage_load(usage)) {
+        nordi_usage_close(usage);
+        return NULL;
+    }
+    return usage;
+}
+
+void
+nordi_usage_update(nordi_usage_ptr usage, uint64_t rx, uint64_t tx, time_t now) {
+    if (usage == NULL) {
+        return;
+    }
+    if (!usage->has_counters) {
+        usage->has_counters = true;
+        usage->last_rx = rx;
+        usage->last_tx = tx;
+        return;
+    }
+    // counters going back belong to a new interface, everything on them is new traffic
+    uint64_t rx_delta = rx >= usage->last_rx ? rx - usage->last_rx : rx;
+    uint64_t tx_delta = tx >= usage->last_tx ? tx - usage->last_tx : tx;
+    usage->last_rx = rx;
+    usage->last_tx = tx;
+    if (rx_delta > 0 || tx_delta > 0) {
+        uint32_t date = local_date(now);
+        nordi_usage_total_t* day = get_day(usage, date);
+        if (day != NULL) {
+            day->rx += rx_delta;
+            day->tx += tx_delta;
+        }
+        int index = 0;
+        while (index < usage->pending_count && usage->pending[index].date != date) {
+            index++;
+        }
+        if (index == USAGE_MAX_PENDING) {
+            if (!nordi_usage_flush(usage)) {
+                return; // kept in the totals, the journal misses it
+            }
+            index = 0;
+        }
+        if (index == usage->pending_count) {
+            usage->pending[usage->pending_count++] = (nordi_usage_total_t){.date = date};
+        }
+        usage->pending[index].rx += rx_delta;
+        usage->pending[index].tx += tx_delta;
+    }
+    if (now - usage->last_flush >= usage->flush_interval_s) {
+        nordi_usage_flush(usage);
+        usage->last_flush = now;
+    }
+}
+
+void
+nordi_usage_reset_counters(nordi_usage_ptr usage) {
+    if (usage == NULL) {
+        return;
+    }
+    usage->has_counters = true;
+    usage->last_rx = 0;
+    usage->last_tx = 0;
+}
+
+bool
+nordi_usage_flush(nordi_usage_ptr usage) {
+    if (usage == NULL || usage->pending_count == 0) {
+        return true;
+    }
+    if (usage->fd < 0 && (usage->fd = open(usage->path, O_WRONLY | O_APPEND | O_CLOEXEC)) < 0) {
+        return false; // kept in the totals until the journal reopens
+    }
+    if ((int)usage->records + usage->pending_count > 2 * usage->day_count + COMPACT_SLACK && usage_compact(usage)) {
+        // the totals already hold the pending traffic, so the compacted journal does too
+        usage->pending_count = 0;
+        return true;
+    }
+    usage_record_t records[USAGE_MAX_PENDING];
+    for (int index = 0; index < usage->pending_count; index++) {
+        records[index] = (usage_record_t){.date = usage->pending[index].date, .rx = usage->pending[index].rx, .tx = usage->pending[index].tx};
+        records[index].crc = record_crc(&records[index]);
+    }
+    // a single append, so a crash can only tear the last record
+    if (!write_all(usage->fd, records, usage->pending_count * sizeof(usage_record_t))) {
+        return false;
+    }
+    usage->records += usage->pending_count;
+    usage->pending_count = 0;
+    usage->flushes++;
+    return true;
+}
+
+void
+nordi_usage_day(nordi_usage_ptr usage, time_t when, nordi_usage_total_ptr total) {
+    uint32_t date = local_date(when);
+    *total = (nordi_usage_total_t){.date = date};
+    int index = usage != NULL ? find_day(usage, date) : 0;
+    if (usage != NULL && index < usage->day_count && usage->days[index].date == date) {
+        *total = usage->days[index];
+    }
+}
+
+void
+nordi_usage_month(nordi_usage_ptr usage, time_t when, nordi_usage_total_ptr total) {
+    uint32_t month = local_date(when) / 100 * 100;
+    *total = (nordi_usage_total_t){.date = month};
+    if (usage == NULL) {
+        return;
+    }
+    // days of a month sit together, from its day 00 onwards
+    for (int index = find_day(usage, month); index < usage->day_count && usage->days[index].date < month + 100; index++) {
+        total->rx += usage->days[index].rx;
+        total->tx += usage->days[index].tx;
+    }
+}
+
+void
+nordi_usage_close(nordi_usage_ptr usage) {
+    if (usage == NULL) {
+        return;
+    }
+    if (usage->fd >= 0) {
+        nordi_usage_flush(usage);
+        close(usage->fd);
+    }
+    free(usage->days);
+    free(usage);
+}
@@ -0,0 +1,117 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nordi_view.h"
+
+static void
+view_set_text(char* field, const char* text) {
+    snprintf(field, VIEW_MAX_TEXT, "%s", text != NULL ? text : "");
+}
+
+nordi_view_ptr
+nordi_view_new() {
+    nordi_view_ptr view = calloc(1, sizeof(nordi_view_t));
+    if (view == NULL) {
+        return NULL;
+    }
+    // as the widgets are created, so a part nothing set yet isn't hidden by the first commit
+    view->desired.is_connect_visible = true;
+    view->desired.is_connect_sensitive = true;
+    return view;
+}
+
+unsigned int
+nordi_view_diff(nordi_view_state_ptr previous, nordi_view_state_ptr next) {
+    unsigned int changed = 0;
+    changed |= previous->is_online != next->is_online ? VIEW_ONLINE : 0;
+    changed |= strcmp(previous->ip, next->ip) != 0 ? VIEW_IP : 0;
+    changed |= strcmp(previous->host, next->host) != 0 ? VIEW_HOST : 0;
+    changed |= previous->is_connect_visible != next->is_connect_visible ? VIEW_CONNECT_VISIBLE : 0;
+    changed |= previous->is_connect_sensitive != next->is_connect_sensitive ? VIEW_CONNECT_SENSITIVE : 0;
+    changed |= previous->is_logged_in != next->is_logged_in ? VIEW_LOGGED_IN : 0;
+    changed |= strcmp(previous->email, next->email) != 0 ? VIEW_EMAIL : 0;
+    changed |= strcmp(previous->expiry, next->expiry) != 0 ? VIEW_EXPIRY : 0;
+    changed |= previous->status != next->status ? VIEW_STATUS : 0;
+    return changed;
+}
+
+bool
+nordi_view_set_connection(nordi_view_ptr view, bool is_online, const char* ip, const char* host) {
+    bool is_transition = !view->is_connection_known || view->desired.is_online != is_online;
+    view->is_connection_known = true;
+    view->desired.is_online = is_online;
+    view_set_text(view->desired.ip, is_online ? ip : NULL);
+    view_set_text(view->desired.host, is_online ? host : NULL);
+    return is_transition;
+}
+
+void
+nordi_view_set_account(nordi_view_ptr view, const char* email, const char* expiry) {
+    view->desired.is_logged_in = email != NULL && email[0] != '\0';
+    view_set_text(view->desired.email, view->desired.is_logged_in ? email : NULL);
+    view_set_text(view->desired.expiry, view->desired.is_logged_in ? expiry : NULL);
+}
+
+void
+nordi_view_set_connect_visible(nordi_view_ptr view, bool is_visible) {
+    view->desired.is_connect_visible = is_visible;
+}
+
+void
+nordi_view_set_connect_sensitive(nordi_view_ptr view, bool is_sensitive) {
+    view->desired.is_connect_sensitive = is_sensitive;
+}
+
+void
+nordi_view_push_status(nordi_view_ptr view, const char* text) {
+    char message[VIEW_MAX_TEXT];
+    view_set_text(message, text);
+    if (view->desired.status > 0 && strcmp(message, nordi_view_status(view)) == 0) {
+        return;
+    }
+    memcpy(view->statuses[view->desired.status % VIEW_STATUS_RING], message, VIEW_MAX_TEXT);
+    view->desired.status++;
+}
+
+const char*
+nordi_view_status(nordi_view_ptr view) {
+    if (view->desired.status == 0) {
+        return "";
+    }
+    return view->statuses[(view->desired.status - 1) % VIEW_STATUS_RING];
+}
+
+int
+nordi_view_status_history(nordi_view_ptr view, char* text, int size, int count) {
+    int written = 0, length = 0;
+    unsigned int status = view->desired.status;
+    count = count > VIEW_STATUS_RING ? VIEW_STATUS_RING : count;
+    if (size > 0) {
+        text[0] = '\0';
+    }
+    for (; written < count && status > 0 && length < size; written++, status--) {
+        length += snprintf(text + length, size - length, "%s%s", written > 0 ? "\n" : "",
+                           view->statuses[(status - 1) % VIEW_STATUS_RING]);
+    }
+    return written;
+}
+
+unsigned int
+nordi_view_commit(nordi_view_ptr view) {
+    unsigned int changed = view->is_applied ? nordi_view_diff(&view->applied, &view->desired) : VIEW_ALL;
+    view->applied = view->desired;
+    view->is_applied = true;
+    return changed;
+}
+
+void
+nordi_view_free(nordi_view_ptr view) {
+    free(view);
+}
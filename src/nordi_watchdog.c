@@ -0,0 +1,189 @@
+/**
+ * Copyright (c) 2023 Ayzurus
+ * 
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "nordi_watchdog.h"
+
+static long long
+now_ms() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static int
+compare_offenders(const void* left, const void* right) {
+    unsigned long long a = ((const nordi_watchdog_offender_t*)left)->total_ms;
+    unsigned long long b = ((const nordi_watchdog_offender_t*)right)->total_ms;
+    return a > b ? -1 : a < b;
+}
+
+static void
+watchdog_record(nordi_watchdog_ptr watchdog, const char* name, unsigned int stall_ms) {
+    int bucket = 0;
+    for (long long bound = 2LL * watchdog->threshold_ms; stall_ms >= bound && bucket < WATCHDOG_BUCKETS - 1;
+         bound *= 2) {
+        bucket++;
+    }
+    watchdog->histogram[bucket]++;
+    watchdog->stalls++;
+    watchdog->max_ms = stall_ms > watchdog->max_ms ? stall_ms : watchdog->max_ms;
+    nordi_watchdog_offender_t* offender = NULL;
+    for (int index = 0; index < watchdog->offender_count && offender == NULL; index++) {
+        if (strcmp(watchdog->offenders[index].name, name) == 0) {
+            offender = &watchdog->offenders[index];
+        }
+    }
+    if (offender == NULL) {
+        if (watchdog->offender_count == WATCHDOG_MAX_OFFENDERS) {
+            // the histogram still counts it
+            return;
+        }
+        offender = &watchdog->offenders[watchdog->offender_count++];
+        snprintf(offender->name, WATCHDOG_MAX_NAME, "%s", name);
+    }
+    offender->stalls++;
+    offender->total_ms += stall_ms;
+    offender->max_ms = stall_ms > offender->max_ms ? stall_ms : offender->max_ms;
+}
+
+static int
+watchdog_worker(nordi_watchdog_ptr watchdog) {
+    struct timespec deadline;
+    mtx_lock(&watchdog->mutex);
+    while (watchdog->is_running) {
+        timespec_get(&deadline, TIME_UTC);
+        long long nanoseconds = deadline.tv_nsec + watchdog->threshold_ms * 500000LL;
+        deadline.tv_sec += nanoseconds / 1000000000;
+        deadline.tv_nsec = nanoseconds % 1000000000;
+        cnd_timedwait(&watchdog->wakeup, &watchdog->mutex, &deadline);
+        if (!watchdog->is_running) {
+            break;
+        }
+        long long expected = 0;
+        // a heartbeat still outstanding is a stall in progress, the next one waits for it
+        if (atomic_compare_exchange_strong(&watchdog->posted_ms, &expected, now_ms())) {
+            watchdog->post(watchdog->context);
+        }
+    }
+    mtx_unlock(&watchdog->mutex);
+    return thrd_success;
+}
+
+nordi_watchdog_ptr
+nordi_watchdog_new(int threshold_ms, nordi_watchdog_post_t post, void* context) {
+    nordi_watchdog_ptr watchdog = calloc(1, sizeof(nordi_watchdog_t));
+    if (watchdog == NULL) {
+        return NULL;
+    }
+    watchdog->threshold_ms = threshold_ms > 0 ? threshold_ms : WATCHDOG_DEFAULT_THRESHOLD_MS;
+    watchdog->post = post;
+    watchdog->context = context;
+    watchdog->is_running = true;
+    atomic_init(&watchdog->posted_ms, 0);
+    if (mtx_init(&watchdog->mutex, mtx_plain) != thrd_success) {
+        free(watchdog);
+        return NULL;
+    }
+    if (cnd_init(&watchdog->wakeup) != thrd_success) {
+        mtx_destroy(&watchdog->mutex);
+        free(watchdog);
+        return NULL;
+    }
+    if (thrd_create(&watchdog->thread, (thrd_start_t)watchdog_worker, watchdog) != thrd_success) {
+        cnd_destroy(&watchdog->wakeup);
+        mtx_destroy(&watchdog->mutex);
+        free(watchdog);
+        return NULL;
+    }
+    return watchdog;
+}
+
+void
+nordi_watchdog_enter(nordi_watchdog_ptr watchdog, const char* name) {
+    if (watchdog == NULL) {
+        return;
+    }
+    if (watchdog->depth++ == 0) {
+        watchdog->handler = name;
+        watchdog->handler_ms = now_ms();
+    }
+}
+
+void
+nordi_watchdog_leave(nordi_watchdog_ptr watchdog) {
+    if (watchdog == NULL || watchdog->depth == 0 || --watchdog->depth > 0) {
+        return;
+    }
+    long long elapsed = now_ms() - watchdog->handler_ms;
+    if (atomic_load(&watchdog->posted_ms) != 0 && elapsed > watchdog->longest_ms) {
+        watchdog->longest = watchdog->handler;
+        watchdog->longest_ms = elapsed;
+    }
+    watchdog->handler = NULL;
+}
+
+void
+nordi_watchdog_beat(nordi_watchdog_ptr watchdog) {
+    long long posted = atomic_load(&watchdog->posted_ms);
+    if (posted == 0) {
+        return;
+    }
+    long long latency = now_ms() - posted;
+    if (latency >= watchdog->threshold_ms) {
+        // a handler far shorter than the threshold didn't cause the stall, whatever ran outside the handlers did
+        bool is_blamed =
+            watchdog->longest != NULL && watchdog->longest_ms * WATCHDOG_BLAME_SHARE >= watchdog->threshold_ms;
+        watchdog_record(watchdog, is_blamed ? watchdog->longest : WATCHDOG_UNKNOWN, (unsigned int)latency);
+    }
+    watchdog->beats++;
+    watchdog->longest = NULL;
+    watchdog->longest_ms = 0;
+    atomic_store(&watchdog->posted_ms, 0);
+}
+
+void
+nordi_watchdog_write(nordi_watchdog_ptr watchdog, FILE* file) {
+    fprintf(file, "main loop: %u heartbeats, %u stalls of %d ms or more, the longest %u ms\n", watchdog->beats,
+            watchdog->stalls, watchdog->threshold_ms, watchdog->max_ms);
+    long long bound = watchdog->threshold_ms;
+    for (int bucket = 0; bucket < WATCHDOG_BUCKETS; bucket++, bound *= 2) {
+        if (watchdog->histogram[bucket] > 0) {
+            fprintf(file, "  >= %6lld ms: %u\n", bound, watchdog->histogram[bucket]);
+        }
+    }
+    if (watchdog->offender_count == 0) {
+        return;
+    }
+    nordi_watchdog_offender_t offenders[WATCHDOG_MAX_OFFENDERS];
+    memcpy(offenders, watchdog->offenders, watchdog->offender_count * sizeof(nordi_watchdog_offender_t));
+    qsort(offenders, watchdog->offender_count, sizeof(nordi_watchdog_offender_t), compare_offenders);
+    fprintf(file, "%-32s %6s %10s %8s\n", "handler", "stalls", "total", "max");
+    for (int index = 0; index < watchdog->offender_count; index++) {
+        fprintf(file, "%-32s %6u %7llu ms %5u ms\n", offenders[index].name, offenders[index].stalls,
+                offenders[index].total_ms, offenders[index].max_ms);
+    }
+}
+
+void
+nordi_watchdog_free(nordi_watchdog_ptr watchdog) {
+    if (watchdog == NULL) {
+        return;
+    }
+    mtx_lock(&watchdog->mutex);
+    watchdog->is_running = false;
+    cnd_signal(&watchdog->wakeup);
+    mtx_unlock(&watchdog->mutex);
+    thrd_join(watchdog->thread, NULL);
+    cnd_destroy(&watchdog->wakeup);
+    mtx_destroy(&watchdog->mutex);
+    free(watchdog);
+}
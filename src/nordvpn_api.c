@@ -5,20 +5,34 @@
  * https://opensource.org/licenses/MIT
  */
 
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <threads.h>
+#include <time.h>
 #include <unistd.h>
 #include <wait.h>
+#include "nordi_resources.h"
+#include "nordi_trace.h"
 #include "nordvpn_api.h"
 
 #define MAX_BUFFER         1024
+#define MAX_SETTING_BUFFER 65536 // the settings list the whole allowlist, bound by the pipe capacity
 #define STATUS_LINE_COUNT  7
 #define ACCOUNT_LINE_COUNT 3
 #define UNIQUE_LINE_COUNT  1
+#define MAX_DNS_SERVERS    3
+#define MAX_ALLOWLIST_ARGS 6 // "add ports 3000 3100 protocol TCP"
 #define DELIM              str_lit(": ")
 #define PIPEIN             1
 #define PIPEOUT            0
+#define OUTPUT_POLL_MS     10 // how often a running command is checked for exiting, and how finely its output is timed
 
 // fields
 #define F_STATUS           0
@@ -26,20 +40,80 @@
 #define F_IP               2
 #define F_                 3
 
+// command outputs
+#define CONNECTED_PREFIX   str_lit("You are connected to ")
+#define CONNECTING_PREFIX  str_lit("Connecting to ")
+#define DISCONNECTED_TEXT  str_lit("You are disconnected from NordVPN")
+#define LOGGED_OUT_TEXT    str_lit("You are logged out")
+#define ENABLED_TEXT       str_lit("enabled")
+#define DISABLED_TEXT      str_lit("disabled")
+
 // Macro to join list of strings into array of NordVPN arguments
 #define NARGS(...)         ((const char*[]){NORDVPN, __VA_ARGS__, NULL})
 
 // When API mock is enabled, change the NordVPN binary calls to a mock function
 #ifdef NORDVPN_API_UNITTEST_H_
-nordvpn_error_t _mock_execute_nordvpn(nordvpn_session_ptr, char*, const char**);
-#define execute_nordvpn(...) _mock_execute_nordvpn(__VA_ARGS__)
+nordvpn_error_t _mock_execute_nordvpn(nordvpn_session_ptr, char*, size_t, const char**);
+#define run_nordvpn(...) _mock_execute_nordvpn(__VA_ARGS__)
 #else
-#define execute_nordvpn(...) _execute_nordvpn(__VA_ARGS__)
+#define run_nordvpn(...) _execute_nordvpn(__VA_ARGS__)
 #endif
 
 // Error messages
-static const char* ERROR_MESSAGES[] = {"OK", "An unknown/unidentified error occurred", "The nordvpn binary was not found",
-                                       "Failed to execute a command on nordvpn", "Failed to read the result of a nordvpn command"};
+static const char* ERROR_MESSAGES[] = {"OK",
+                                       "An unknown/unidentified error occurred",
+                                       "No nordvpn session is active",
+                                       "The nordvpn binary was not found",
+                                       "Already logged in or out of NordVPN",
+                                       "Failed to create the pipe for nordvpn",
+                                       "Failed to start a nordvpn process",
+                                       "Failed to execute a command on nordvpn",
+                                       "Failed to read the result of a nordvpn command",
+                                       "The nordvpn command was cancelled"};
+
+const str NORDVPN_ACTION_STR[] = {
+    str_lit("open"), str_lit("refresh"), str_lit("login"), str_lit("logout"), str_lit("connect"), str_lit("disconnect"), str_lit("sync"),
+    str_lit("settings"), str_lit("apply"), str_lit("allowlist"),
+};
+
+// A setting switched with "nordvpn set <argument> on|off", reported by "nordvpn settings" as "<name>: enabled|disabled"
+typedef struct {
+    const char* name;
+    const char* argument;
+    size_t offset; // of its bool in nordvpn_settings_t
+    bool is_openvpn_only;
+} nordvpn_toggle_t;
+
+static const nordvpn_toggle_t TOGGLES[] = {
+    {"Obfuscate", "obfuscate", offsetof(nordvpn_settings_t, obfuscate), true},
+    {"Firewall", "firewall", offsetof(nordvpn_settings_t, firewall), false},
+    {"Routing", "routing", offsetof(nordvpn_settings_t, routing), false},
+    {"Kill Switch", "killswitch", offsetof(nordvpn_settings_t, killswitch), false},
+    {"Threat Protection Lite", "threatprotectionlite", offsetof(nordvpn_settings_t, threat_protection), false},
+    {"Notify", "notify", offsetof(nordvpn_settings_t, notify), false},
+    {"Auto-connect", "autoconnect", offsetof(nordvpn_settings_t, autoconnect), false},
+    {"IPv6", "ipv6", offsetof(nordvpn_settings_t, ipv6), false},
+    {"Meshnet", "meshnet", offsetof(nordvpn_settings_t, meshnet), false},
+    {"LAN Discovery", "lan-discovery", offsetof(nordvpn_settings_t, lan_discovery), false},
+};
+
+#define TOGGLE_COUNT (int)(sizeof(TOGGLES) / sizeof(TOGGLES[0]))
+
+// The user action currently being served, to which binary spawns are accounted
+static atomic_int current_action = ACTION_OPEN;
+
+// Binary being run, NORDVPN unless overridden on open
+static const char* binary = NORDVPN;
+
+// Recording of every run, NULL unless opted in on open
+static nordi_trace_ptr recorder = NULL;
+
+// Guards the session and host data against readers on other threads
+static mtx_t state_mutex;
+static once_flag state_mutex_once = ONCE_FLAG_INIT;
+
+// Guards the running child against being signalled once reaped, as its pid may be reused by then
+static mtx_t child_mutex;
 
 // remove ending and leading carriage-returns from string
 static char*
@@ -117,46 +191,216 @@ nordvpn_get_host() {
         .ip = str_null,
         .hostname = str_null,
         .last_server = str_null,
+        .tried_server = str_null,
         .proto = str_null,
     };
     return &host;
 }
 
+nordvpn_settings_ptr
+nordvpn_get_settings() {
+    static nordvpn_settings_t settings = {
+        .protocol = str_null,
+        .dns = str_null,
+        .allowlist = str_null,
+    };
+    return &settings;
+}
+
+nordvpn_stats_ptr
+nordvpn_get_stats() {
+    static nordvpn_stats_t stats = {};
+    return &stats;
+}
+
+// Marks the start of a user action, so the following binary spawns are accounted to it
+static void
+nordvpn_begin_action(nordvpn_action_t action) {
+    atomic_store(&current_action, action);
+    atomic_fetch_add(&(nordvpn_get_stats()->calls[action]), 1);
+}
+
+void
+nordvpn_write_stats(FILE* file) {
+    nordvpn_stats_ptr stats = nordvpn_get_stats();
+    for (int action = 0; action < ACTION_COUNT; action++) {
+        unsigned int calls = atomic_load(&(stats->calls[action])), spawns = atomic_load(&(stats->spawns[action]));
+        if (calls > 0) {
+            fprintf(file, "%-10s %6u calls %6u spawns (%.2f per call)\n", str_ptr(NORDVPN_ACTION_STR[action]), calls,
+                    spawns, (double)spawns / calls);
+        }
+    }
+}
+
+static void
+nordvpn_init_state_mutex() {
+    mtx_init(&state_mutex, mtx_plain | mtx_recursive);
+    mtx_init(&child_mutex, mtx_plain);
+}
+
+void
+nordvpn_lock_state() {
+    call_once(&state_mutex_once, nordvpn_init_state_mutex);
+    mtx_lock(&state_mutex);
+}
+
+void
+nordvpn_unlock_state() {
+    mtx_unlock(&state_mutex);
+}
+
 str
 nordvpn_error(nordvpn_error_t error) {
     return str_ref(ERROR_MESSAGES[error]);
 }
 
+void
+nordvpn_cancel() {
+    nordvpn_session_ptr session = nordvpn_get_session();
+    session->is_cancelled = true;
+    call_once(&state_mutex_once, nordvpn_init_state_mutex);
+    mtx_lock(&child_mutex);
+    if (session->child > 0) {
+        kill(session->child, SIGTERM);
+    }
+    mtx_unlock(&child_mutex);
+}
+
+// Reap the child once it exited, or without waiting for it, returning false if it is still running. It is only
+// waited for without reaping it, so its pid stays taken until cancels no longer signal it.
+static bool
+reap_child(nordvpn_session_ptr session, pid_t child_pid, int* status, bool is_waiting) {
+    siginfo_t info = {};
+    int result = 0;
+    do {
+        result = waitid(P_PID, child_pid, &info, WEXITED | WNOWAIT | (is_waiting ? 0 : WNOHANG));
+    } while (result < 0 && errno == EINTR);
+    if (result == 0 && info.si_pid == 0) {
+        return false;
+    }
+    call_once(&state_mutex_once, nordvpn_init_state_mutex);
+    mtx_lock(&child_mutex);
+    session->child = 0;
+    mtx_unlock(&child_mutex);
+    waitpid(child_pid, status, 0);
+    return true;
+}
+
+// Wait for the child while reading its output as it streams, so output larger than the pipe can't block it, and
+// record each chunk with the time it came at when recording. Output that doesn't fit the buffer is discarded, so it
+// doesn't leak into the next command.
+static nordvpn_error_t
+collect_output(nordvpn_session_ptr session, int child_pid, char* buffer, size_t size, const char* arguments[],
+               int* status) {
+    nordi_trace_run_t run;
+    if (recorder != NULL) {
+        nordi_trace_begin(&run, arguments);
+    }
+    struct pollfd output = {.fd = session->pipe[PIPEOUT], .events = POLLIN};
+    char chunk[MAX_BUFFER];
+    size_t length = 0;
+    bool is_exited = false;
+    nordvpn_error_t result = OK;
+    while (result == OK) {
+        // once exited, whatever is left in the pipe is the end of its output
+        if (poll(&output, 1, is_exited ? 0 : OUTPUT_POLL_MS) > 0 && (output.revents & POLLIN)) {
+            ssize_t count = read(output.fd, chunk, MAX_BUFFER);
+            if (count < 0) {
+                result = FAILED_READ;
+                break;
+            }
+            if (recorder != NULL) {
+                nordi_trace_output(&run, chunk, count);
+            }
+            size_t kept = (size_t)count < size - 1 - length ? (size_t)count : size - 1 - length;
+            memcpy(buffer + length, chunk, kept);
+            length += kept;
+            continue;
+        }
+        if (is_exited) {
+            break;
+        }
+        is_exited = reap_child(session, child_pid, status, false);
+    }
+    if (!is_exited) {
+        reap_child(session, child_pid, status, true);
+    }
+    if (recorder != NULL) {
+        nordi_trace_end(recorder, &run, WIFEXITED(*status) ? WEXITSTATUS(*status) : TRACE_NO_EXIT);
+    }
+    return result;
+}
+
 // Run a NordVPN command and fill the given buffer with its output
 static nordvpn_error_t
-_execute_nordvpn(nordvpn_session_ptr session, char* buffer, const char* arguments[]) {
+_execute_nordvpn(nordvpn_session_ptr session, char* buffer, size_t size, const char* arguments[]) {
     int child_pid = fork();
     if (child_pid < 0) {
         return FAILED_FORK;
     }
     if (child_pid == 0) {
         if (dup2(session->pipe[PIPEIN], STDOUT_FILENO) >= 0 && dup2(session->pipe[PIPEIN], STDERR_FILENO) >= 0) {
-            execv(NORDVPN, arguments);
+            execv(binary, arguments);
         }
         // either dup2 failed or execv failed if the child process arrives here
         perror("ERROR");
         fsync(session->pipe[PIPEIN]);
         exit(EXIT_FAILURE);
     }
+    session->child = child_pid;
+    nordi_resources_child(1);
     int status = 0;
-    waitpid(child_pid, &status, 0);
-    if (!WIFEXITED(status)) {
-        return FAILED_EXECUTE;
-    }
-    if (read(session->pipe[PIPEOUT], buffer, MAX_BUFFER) < 0) {
+    nordvpn_error_t result = collect_output(session, child_pid, buffer, size, arguments, &status);
+    nordi_resources_child(-1);
+    if (result != OK) {
         return FAILED_READ;
     }
+    if (!WIFEXITED(status)) {
+        return session->is_cancelled ? CANCELLED : FAILED_EXECUTE;
+    }
     if (str_has_prefix(str_ref(buffer), str_lit("ERROR:"))) {
         return FAILED_EXECUTE;
     }
     return OK;
 }
 
+// Run a NordVPN command with an output buffer of the given size, accounting the spawn to the current user action
+static nordvpn_error_t
+execute_nordvpn_sized(nordvpn_session_ptr session, char* buffer, size_t size, const char* arguments[]) {
+    if (session->is_cancelled) {
+        return CANCELLED;
+    }
+    atomic_fetch_add(&(nordvpn_get_stats()->spawns[atomic_load(&current_action)]), 1);
+    return run_nordvpn(session, buffer, size, arguments);
+}
+
+// Run a NordVPN command with an output buffer of `MAX_BUFFER`
+static nordvpn_error_t
+execute_nordvpn(nordvpn_session_ptr session, char* buffer, const char* arguments[]) {
+    return execute_nordvpn_sized(session, buffer, MAX_BUFFER, arguments);
+}
+
+// Milliseconds elapsed since the given monotonic time
+static unsigned int
+elapsed_ms(const struct timespec* start) {
+    struct timespec now = {};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned int)((now.tv_sec - start->tv_sec) * 1000 + (now.tv_nsec - start->tv_nsec) / 1000000);
+}
+
+// Clear the host data that only exists while connected
+static void
+nordvpn_clear_host(nordvpn_host_ptr host) {
+    nordvpn_lock_state();
+    host->is_online = false;
+    host->is_partial = false;
+    host->technology = TECHNOLOGY_UNKNOWN;
+    nordi_resources_str_clear(RESOURCE_API, &(host->hostname));
+    nordi_resources_str_clear(RESOURCE_API, &(host->ip));
+    nordi_resources_str_clear(RESOURCE_API, &(host->proto));
+    nordvpn_unlock_state();
+}
+
 // Update the host data for the given session
 static nordvpn_error_t
 nordvpn_update_status(nordvpn_session_ptr session) {
@@ -169,26 +413,85 @@ nordvpn_update_status(nordvpn_session_ptr session) {
     }
     str output[STATUS_LINE_COUNT];
     int output_lines = str_split_lines(buffer, output, STATUS_LINE_COUNT);
+    nordvpn_lock_state();
     host->is_online = output_lines > 1 && str_has_suffix(output[0], str_lit("Connected"));
     if (host->is_online) {
-        str_cpy(&(host->hostname), str_split_value(output[1], DELIM));
-        str_cpy(&(host->last_server), str_split_key(host->hostname, str_lit(".")));
-        str_cpy(&(host->ip), str_split_value(output[2], DELIM));
+        nordi_resources_str_cpy(RESOURCE_API, &(host->hostname), str_split_value(output[1], DELIM));
+        nordi_resources_str_cpy(RESOURCE_API, &(host->last_server), str_split_key(host->hostname, str_lit(".")));
+        nordi_resources_str_cpy(RESOURCE_API, &(host->ip), str_split_value(output[2], DELIM));
         str country = str_split_value(output[3], DELIM);
-        str_cpy(&(host->proto), str_split_value(output[STATUS_LINE_COUNT - 1], DELIM));
-        for (int n = 0; n < COUNTRY_COUNT; n++) {
-            if (str_eq(country, NORDVPN_COUNTRY_STR[n])) {
-                host->country = (nordvpn_country_t)n;
-            }
+        nordi_resources_str_cpy(RESOURCE_API, &(host->proto), str_split_value(output[STATUS_LINE_COUNT - 1], DELIM));
+        host->technology = nordvpn_technology_from_name(str_split_value(output[STATUS_LINE_COUNT - 2], DELIM));
+        int index = nordvpn_country_from_name(country);
+        if (index >= 0) {
+            host->country = (nordvpn_country_t)index;
         }
+        host->is_partial = false;
     } else {
-        str_clear(&(host->hostname));
-        str_clear(&(host->ip));
-        str_clear(&(host->proto));
+        nordvpn_clear_host(host);
     }
+    nordvpn_unlock_state();
     return OK;
 }
 
+// Update the host data from the output of a successful connect, in the format
+// "You are connected to <Country> #<number> (<hostname>)!". Returns false if the output doesn't match it.
+static bool
+nordvpn_parse_connect(char* buffer) {
+    char* connected = str_contains(str_ref(buffer), CONNECTED_PREFIX);
+    if (connected == NULL) {
+        return false;
+    }
+    char* server = connected + str_len(CONNECTED_PREFIX);
+    char* line_end = strchr(server, '\n');
+    if (line_end == NULL) {
+        line_end = server + strlen(server);
+    }
+    char* number = strstr(server, " #");
+    char* hostname = strchr(server, '(');
+    char* hostname_end = hostname == NULL ? NULL : strchr(hostname, ')');
+    if (number == NULL || number > line_end || hostname_end == NULL || hostname_end > line_end) {
+        return false;
+    }
+    nordvpn_host_ptr host = nordvpn_get_host();
+    nordvpn_lock_state();
+    nordi_resources_str_cpy(RESOURCE_API, &(host->hostname), str_ref_chars(hostname + 1, hostname_end - hostname - 1));
+    nordi_resources_str_cpy(RESOURCE_API, &(host->last_server), str_split_key(host->hostname, str_lit(".")));
+    int index = nordvpn_country_from_name(str_ref_chars(server, number - server));
+    if (index >= 0) {
+        host->country = (nordvpn_country_t)index;
+    }
+    // ip and protocol are only reported by status
+    nordi_resources_str_clear(RESOURCE_API, &(host->ip));
+    nordi_resources_str_clear(RESOURCE_API, &(host->proto));
+    host->is_online = true;
+    host->is_partial = true;
+    nordvpn_unlock_state();
+    return true;
+}
+
+// Remember the server a connect went for from its "Connecting to <Country> #<number> (<hostname>)" line, which
+// comes before the outcome whether the connect succeeds or not
+static void
+nordvpn_parse_tried(char* buffer) {
+    char* connecting = str_contains(str_ref(buffer), CONNECTING_PREFIX);
+    if (connecting == NULL) {
+        return;
+    }
+    char* line_end = strchr(connecting, '\n');
+    char* hostname = strchr(connecting, '(');
+    char* hostname_end = hostname == NULL ? NULL : strchr(hostname, ')');
+    if (hostname_end == NULL || (line_end != NULL && hostname_end > line_end)) {
+        return;
+    }
+    // the server is the hostname up to its first dot
+    char* dot = memchr(hostname, '.', hostname_end - hostname);
+    str tried = str_ref_chars(hostname + 1, (dot != NULL ? dot : hostname_end) - hostname - 1);
+    nordvpn_lock_state();
+    nordi_resources_str_cpy(RESOURCE_API, &(nordvpn_get_host()->tried_server), tried);
+    nordvpn_unlock_state();
+}
+
 // Update the account data for the given session
 static nordvpn_error_t
 nordvpn_update_account(nordvpn_session_ptr session) {
@@ -202,13 +505,116 @@ nordvpn_update_account(nordvpn_session_ptr session) {
         return result;
     }
     str output[ACCOUNT_LINE_COUNT];
-    if (str_split_lines(buffer, output, ACCOUNT_LINE_COUNT) == ACCOUNT_LINE_COUNT) {
-        str_cpy(&(session->user), str_split_value(output[1], DELIM));
-        str_cpy(&(session->expiry), str_split_value(output[2], DELIM));
+    int output_lines = str_split_lines(buffer, output, ACCOUNT_LINE_COUNT);
+    nordvpn_lock_state();
+    if (output_lines == ACCOUNT_LINE_COUNT) {
+        nordi_resources_str_cpy(RESOURCE_API, &(session->user), str_split_value(output[1], DELIM));
+        nordi_resources_str_cpy(RESOURCE_API, &(session->expiry), str_split_value(output[2], DELIM));
     } else {
-        str_clear(&(session->user));
-        str_clear(&(session->expiry));
+        nordi_resources_str_clear(RESOURCE_API, &(session->user));
+        nordi_resources_str_clear(RESOURCE_API, &(session->expiry));
+    }
+    nordvpn_unlock_state();
+    return OK;
+}
+
+// The value of a toggle in the given settings
+static bool
+nordvpn_toggle(const nordvpn_settings_t* settings, int toggle) {
+    return *(const bool*)((const char*)settings + TOGGLES[toggle].offset);
+}
+
+// Account the strings of the settings the api keeps, as taken in or dropped
+static void
+account_settings(const nordvpn_settings_t* settings, bool is_kept) {
+    const str strings[] = {settings->protocol, settings->dns, settings->allowlist};
+    for (int index = 0; index < (int)(sizeof(strings) / sizeof(strings[0])); index++) {
+        if (!str_is_owner(strings[index])) {
+            continue;
+        }
+        if (is_kept) {
+            nordi_resources_alloc(RESOURCE_API, str_len(strings[index]) + 1);
+        } else {
+            nordi_resources_release(RESOURCE_API, str_len(strings[index]) + 1);
+        }
+    }
+}
+
+// Update the settings data from a single "nordvpn settings" call
+static nordvpn_error_t
+nordvpn_update_settings(nordvpn_session_ptr session) {
+    // the allowlist can make the output much longer than other commands'
+    char* buffer = (char*)calloc(MAX_SETTING_BUFFER, 1);
+    if (buffer == NULL) {
+        return FAILED_READ;
+    }
+    nordvpn_error_t result = execute_nordvpn_sized(session, buffer, MAX_SETTING_BUFFER, NARGS("settings"));
+    if (result != OK) {
+        free(buffer);
+        return result;
+    }
+    int max_lines = 1;
+    for (const char* character = buffer; *character != 0; character++) {
+        max_lines += *character == '\n';
+    }
+    str* output = (str*)malloc(max_lines * sizeof(str));
+    if (output == NULL) {
+        free(buffer);
+        return FAILED_READ;
     }
+    int output_lines = str_split_lines(buffer, output, max_lines);
+    nordvpn_settings_t settings = {.protocol = str_null, .dns = str_null, .allowlist = str_null};
+    // the allowlisted ports and subnets are listed below their header, indented and without a delimiter,
+    // they are gathered at the start of the output lines as those are no longer needed
+    int entries = 0;
+    bool is_allowlist = false;
+    for (int line = 0; line < output_lines; line++) {
+        const char* text = str_ptr(output[line]);
+        if (str_contains(output[line], DELIM) == NULL) {
+            if (is_allowlist && (text[0] == '\t' || text[0] == ' ')) {
+                output[entries++] = str_ref(text + strspn(text, "\t "));
+            } else {
+                is_allowlist = str_has_suffix(output[line], str_lit(":"));
+            }
+            continue;
+        }
+        is_allowlist = false;
+        str key = str_split_key(output[line], DELIM);
+        str value = str_split_value(output[line], DELIM);
+        if (str_eq(key, str_lit("Technology"))) {
+            settings.technology = nordvpn_technology_from_name(value);
+        } else if (str_eq(key, str_lit("Protocol"))) {
+            str_cpy(&(settings.protocol), value);
+        } else if (str_eq(key, str_lit("DNS"))) {
+            if (!str_eq(value, DISABLED_TEXT)) {
+                str_cpy(&(settings.dns), value);
+            }
+        } else {
+            for (int toggle = 0; toggle < TOGGLE_COUNT; toggle++) {
+                if (str_eq(key, str_ref(TOGGLES[toggle].name))) {
+                    *(bool*)((char*)&settings + TOGGLES[toggle].offset) = str_eq(value, ENABLED_TEXT);
+                    break;
+                }
+            }
+        }
+    }
+    if (entries > 0) {
+        str_join_range(&(settings.allowlist), str_lit("\n"), output, entries);
+    }
+    free(output);
+    free(buffer);
+    if (settings.technology == TECHNOLOGY_UNKNOWN) {
+        nordvpn_clear_settings(&settings);
+        return FAILED_READ;
+    }
+    settings.is_known = true;
+    nordvpn_lock_state();
+    nordvpn_settings_ptr current = nordvpn_get_settings();
+    account_settings(current, false);
+    nordvpn_clear_settings(current);
+    *current = settings;
+    account_settings(current, true);
+    nordvpn_unlock_state();
     return OK;
 }
 
@@ -216,6 +622,16 @@ nordvpn_error_t
 nordvpn_open() {
     // Setup a session and update NordVPN version info
     nordvpn_session_ptr session = nordvpn_get_session();
+    nordvpn_begin_action(ACTION_OPEN);
+    const char* override = getenv(NORDVPN_BINARY_ENV);
+    binary = override != NULL && override[0] != '\0' ? override : NORDVPN;
+    const char* trace = getenv(NORDVPN_RECORD_ENV);
+    if (trace != NULL && recorder == NULL) {
+        recorder = nordi_trace_record(trace);
+        if (recorder == NULL) {
+            perror(trace);
+        }
+    }
     if (pipe(session->pipe) < 0) {
         return FAILED_PIPE;
     }
@@ -230,8 +646,10 @@ nordvpn_open() {
     if (output_lines <= 0 || !str_has_prefix(output[0], str_lit("NordVPN"))) {
         return UNKNOWN_ERROR;
     }
-    str_cpy(&(session->version), output[0]);
+    nordvpn_lock_state();
+    nordi_resources_str_cpy(RESOURCE_API, &(session->version), output[0]);
     session->is_active = true;
+    nordvpn_unlock_state();
     // Synchronize with NordVPN data
     result = nordvpn_update_account(session) + nordvpn_update_status(session);
     if (result != OK) {
@@ -243,34 +661,63 @@ nordvpn_open() {
 void
 nordvpn_close() {
     nordvpn_session_ptr session = nordvpn_get_session();
+    // the runs are over, as even a failed open may have recorded some
+    nordi_trace_free(recorder);
+    recorder = NULL;
     if (!session->is_active) {
         return;
     }
-    str_clear(&(session->user));
-    str_clear(&(session->expiry));
-    str_clear(&(session->version));
+    nordvpn_lock_state();
+    nordi_resources_str_clear(RESOURCE_API, &(session->user));
+    nordi_resources_str_clear(RESOURCE_API, &(session->expiry));
+    nordi_resources_str_clear(RESOURCE_API, &(session->version));
+    account_settings(nordvpn_get_settings(), false);
+    nordvpn_clear_settings(nordvpn_get_settings());
     close(session->pipe[PIPEIN]);
     close(session->pipe[PIPEOUT]);
     session->is_active = false;
     nordvpn_host_ptr host = nordvpn_get_host();
     if (host->is_online) {
-        str_clear(&(host->ip));
-        str_clear(&(host->hostname));
-        str_clear(&(host->last_server));
-        str_clear(&(host->proto));
+        nordvpn_clear_host(host);
+        nordi_resources_str_clear(RESOURCE_API, &(host->last_server));
     }
-    host->is_online = false;
+    nordi_resources_str_clear(RESOURCE_API, &(host->tried_server));
+    nordvpn_unlock_state();
 }
 
 void
 nordvpn_refresh() {
     nordvpn_session_ptr session = nordvpn_get_session();
     if (session->is_active) {
+        nordvpn_begin_action(ACTION_REFRESH);
         nordvpn_update_account(session);
         nordvpn_update_status(session);
     }
 }
 
+nordvpn_error_t
+nordvpn_sync_host() {
+    nordvpn_session_ptr session = nordvpn_get_session();
+    if (!session->is_active) {
+        return NO_SESSION;
+    }
+    if (!nordvpn_get_host()->is_partial) {
+        return OK;
+    }
+    nordvpn_begin_action(ACTION_SYNC);
+    return nordvpn_update_status(session);
+}
+
+nordvpn_error_t
+nordvpn_read_status() {
+    nordvpn_session_ptr session = nordvpn_get_session();
+    if (!session->is_active) {
+        return NO_SESSION;
+    }
+    nordvpn_begin_action(ACTION_SYNC);
+    return nordvpn_update_status(session);
+}
+
 nordvpn_error_t
 nordvpn_login(str* out_link) {
     *out_link = str_null;
@@ -281,6 +728,7 @@ nordvpn_login(str* out_link) {
     if (!str_is_empty(session->user)) {
         return ALREADY_LOGGED;
     }
+    nordvpn_begin_action(ACTION_LOGIN);
     char buffer[MAX_BUFFER];
     memset(buffer, 0, MAX_BUFFER);
     nordvpn_error_t result = execute_nordvpn(session, buffer, NARGS("login"));
@@ -309,10 +757,21 @@ nordvpn_logout() {
     if (str_is_empty(session->user)) {
         return ALREADY_LOGGED;
     }
+    nordvpn_begin_action(ACTION_LOGOUT);
     char buffer[MAX_BUFFER];
     memset(buffer, 0, MAX_BUFFER);
     nordvpn_error_t result = execute_nordvpn(session, buffer, NARGS("logout"));
-    nordvpn_refresh();
+    if (result == OK && str_contains(str_ref(buffer), LOGGED_OUT_TEXT) != NULL) {
+        // logging out also drops the VPN connection, so no refresh is needed
+        nordvpn_lock_state();
+        nordi_resources_str_clear(RESOURCE_API, &(session->user));
+        nordi_resources_str_clear(RESOURCE_API, &(session->expiry));
+        nordvpn_clear_host(nordvpn_get_host());
+        nordvpn_unlock_state();
+        return OK;
+    }
+    nordvpn_update_account(session);
+    nordvpn_update_status(session);
     if (result != OK && !str_is_empty(session->user)) {
         return result;
     }
@@ -330,13 +789,27 @@ nordvpn_server_connect(str server) {
     if (!session->is_active) {
         return NO_SESSION;
     }
+    nordvpn_begin_action(ACTION_CONNECT);
     char buffer[MAX_BUFFER];
     memset(buffer, 0, MAX_BUFFER);
+    struct timespec start = {};
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    nordvpn_lock_state();
+    nordi_resources_str_clear(RESOURCE_API, &(nordvpn_get_host()->tried_server));
+    nordvpn_unlock_state();
+    // while online the daemon switches servers in place, so there is no need to disconnect first
     const char** arguments = str_is_empty(server) ? NARGS("c") : NARGS("c", str_ptr(server));
     nordvpn_error_t result = execute_nordvpn(session, buffer, arguments);
+    nordvpn_parse_tried(buffer);
     if (result != OK) {
         return result;
     }
+    nordvpn_host_ptr host = nordvpn_get_host();
+    host->connect_ms = elapsed_ms(&start);
+    if (nordvpn_parse_connect(buffer)) {
+        return OK;
+    }
+    // unknown output, fall back to reading the whole status
     return nordvpn_update_status(session);
 }
 
@@ -352,11 +825,182 @@ nordvpn_disconnect() {
     if (!session->is_active) {
         return NO_SESSION;
     }
+    nordvpn_begin_action(ACTION_DISCONNECT);
     char buffer[MAX_BUFFER];
     memset(buffer, 0, MAX_BUFFER);
     nordvpn_error_t result = execute_nordvpn(session, buffer, NARGS("d"));
     if (result != OK) {
         return result;
     }
+    if (str_contains(str_ref(buffer), DISCONNECTED_TEXT) != NULL) {
+        nordvpn_clear_host(nordvpn_get_host());
+        return OK;
+    }
+    // unknown output, fall back to reading the whole status
     return nordvpn_update_status(session);
 }
+
+void
+nordvpn_copy_settings(nordvpn_settings_t* target, const nordvpn_settings_t* source) {
+    str protocol = target->protocol, dns = target->dns, allowlist = target->allowlist;
+    *target = *source;
+    target->protocol = protocol;
+    target->dns = dns;
+    target->allowlist = allowlist;
+    str_cpy(&(target->protocol), source->protocol);
+    str_cpy(&(target->dns), source->dns);
+    str_cpy(&(target->allowlist), source->allowlist);
+}
+
+void
+nordvpn_clear_settings(nordvpn_settings_t* settings) {
+    str_free(settings->protocol);
+    str_free(settings->dns);
+    str_free(settings->allowlist);
+    *settings = (nordvpn_settings_t){.protocol = str_null, .dns = str_null, .allowlist = str_null};
+}
+
+nordvpn_error_t
+nordvpn_read_settings() {
+    nordvpn_session_ptr session = nordvpn_get_session();
+    if (!session->is_active) {
+        return NO_SESSION;
+    }
+    nordvpn_begin_action(ACTION_SETTINGS);
+    return nordvpn_update_settings(session);
+}
+
+// Run "nordvpn set <argument> <value>"
+static nordvpn_error_t
+nordvpn_set(nordvpn_session_ptr session, const char* argument, const char* value) {
+    char buffer[MAX_BUFFER];
+    memset(buffer, 0, MAX_BUFFER);
+    return execute_nordvpn(session, buffer, NARGS("set", argument, value));
+}
+
+// Run "nordvpn set dns <servers...>", or "nordvpn set dns off" if there are none
+static nordvpn_error_t
+nordvpn_set_dns(nordvpn_session_ptr session, str dns) {
+    if (str_is_empty(dns)) {
+        return nordvpn_set(session, "dns", "off");
+    }
+    char servers[MAX_BUFFER];
+    snprintf(servers, MAX_BUFFER, "%s", str_ptr(dns));
+    const char* arguments[MAX_DNS_SERVERS + 4] = {NORDVPN, "set", "dns"};
+    int count = 3;
+    char* next = NULL;
+    for (char* server = strtok_r(servers, ", ", &next); server != NULL && count < MAX_DNS_SERVERS + 3;
+         server = strtok_r(NULL, ", ", &next)) {
+        arguments[count++] = server;
+    }
+    arguments[count] = NULL;
+    char buffer[MAX_BUFFER];
+    memset(buffer, 0, MAX_BUFFER);
+    return execute_nordvpn(session, buffer, arguments);
+}
+
+nordvpn_error_t
+nordvpn_apply_settings(const nordvpn_settings_t* desired) {
+    nordvpn_session_ptr session = nordvpn_get_session();
+    if (!session->is_active) {
+        return NO_SESSION;
+    }
+    nordvpn_begin_action(ACTION_APPLY);
+    // compare against a snapshot, the settings are read back and replaced from other threads
+    nordvpn_settings_t snapshot = {.protocol = str_null, .dns = str_null, .allowlist = str_null};
+    nordvpn_settings_ptr current = &snapshot;
+    nordvpn_lock_state();
+    nordvpn_copy_settings(current, nordvpn_get_settings());
+    nordvpn_unlock_state();
+    if (!current->is_known) {
+        nordvpn_error_t result = nordvpn_update_settings(session);
+        if (result != OK) {
+            nordvpn_clear_settings(current);
+            return result;
+        }
+        nordvpn_lock_state();
+        nordvpn_copy_settings(current, nordvpn_get_settings());
+        nordvpn_unlock_state();
+    }
+    nordvpn_error_t first_error = OK, result = OK;
+    int changes = 0;
+    // the technology decides whether the protocol and obfuscation can be set at all
+    nordvpn_technology_t technology = current->technology;
+    bool is_technology_set = true;
+    if (desired->technology != TECHNOLOGY_UNKNOWN && desired->technology != current->technology) {
+        result = nordvpn_set(session, "technology", str_ptr(NORDVPN_TECHNOLOGY_STR[desired->technology]));
+        first_error = first_error == OK ? result : first_error;
+        is_technology_set = result == OK;
+        technology = is_technology_set ? desired->technology : technology;
+        changes++;
+    }
+    bool is_openvpn = is_technology_set && technology == TECHNOLOGY_OPENVPN;
+    if (is_openvpn && !str_is_empty(desired->protocol) && !str_eq(desired->protocol, current->protocol)) {
+        result = nordvpn_set(session, "protocol", str_ptr(desired->protocol));
+        first_error = first_error == OK ? result : first_error;
+        changes++;
+    }
+    // disable first, so enabling a setting isn't refused over one that excludes it and is also being disabled
+    for (int is_enabling = 0; is_enabling <= 1; is_enabling++) {
+        for (int toggle = 0; toggle < TOGGLE_COUNT; toggle++) {
+            bool value = nordvpn_toggle(desired, toggle);
+            if (value != is_enabling || value == nordvpn_toggle(current, toggle)
+                || (TOGGLES[toggle].is_openvpn_only && !is_openvpn)) {
+                continue;
+            }
+            result = nordvpn_set(session, TOGGLES[toggle].argument, value ? "on" : "off");
+            first_error = first_error == OK ? result : first_error;
+            changes++;
+        }
+        if (str_is_empty(desired->dns) != is_enabling && !str_eq(desired->dns, current->dns)) {
+            result = nordvpn_set_dns(session, desired->dns);
+            first_error = first_error == OK ? result : first_error;
+            changes++;
+        }
+    }
+    if (changes > 0) {
+        // a single read back, some settings change others (such as the technology resetting the protocol)
+        result = nordvpn_update_settings(session);
+        first_error = first_error == OK ? result : first_error;
+    }
+    nordvpn_clear_settings(current);
+    return first_error;
+}
+
+nordvpn_error_t
+nordvpn_change_allowlist(str changes) {
+    nordvpn_session_ptr session = nordvpn_get_session();
+    if (!session->is_active) {
+        return NO_SESSION;
+    }
+    nordvpn_begin_action(ACTION_ALLOWLIST);
+    char line[MAX_BUFFER];
+    nordvpn_error_t first_error = OK, result = OK;
+    int changes_run = 0;
+    for (const char* start = str_ptr(changes); *start != 0;) {
+        size_t length = strcspn(start, "\n");
+        snprintf(line, MAX_BUFFER, "%.*s", (int)length, start);
+        start += start[length] == '\n' ? length + 1 : length;
+        const char* arguments[MAX_ALLOWLIST_ARGS + 3] = {NORDVPN, "allowlist"};
+        int count = 2;
+        char* next = NULL;
+        for (char* argument = strtok_r(line, " ", &next); argument != NULL && count < MAX_ALLOWLIST_ARGS + 2;
+             argument = strtok_r(NULL, " ", &next)) {
+            arguments[count++] = argument;
+        }
+        if (count == 2) {
+            continue;
+        }
+        arguments[count] = NULL;
+        char buffer[MAX_BUFFER];
+        memset(buffer, 0, MAX_BUFFER);
+        result = execute_nordvpn(session, buffer, arguments);
+        first_error = first_error == OK ? result : first_error;
+        changes_run++;
+    }
+    if (changes_run > 0) {
+        result = nordvpn_update_settings(session);
+        first_error = first_error == OK ? result : first_error;
+    }
+    return first_error;
+}
@@ -39,6 +39,13 @@ const str NORDVPN_GROUP_STR[] = {
     str_lit("The_Americas"),
 };
 
+const str NORDVPN_TECHNOLOGY_STR[] = {
+    str_lit("UNKNOWN"),
+    str_lit("NORDLYNX"),
+    str_lit("OPENVPN"),
+    str_lit("NORDWHISPER"),
+};
+
 str
 nordvpn_node_from_index(int index) {
     if (index <= 0 || index > COUNTRY_COUNT + GROUP_COUNT) {
@@ -49,3 +56,34 @@ nordvpn_node_from_index(int index) {
     }
     return NORDVPN_GROUP_STR[index - COUNTRY_COUNT - 1];
 }
+
+int
+nordvpn_country_from_name(str name) {
+    for (int country = 0; country < COUNTRY_COUNT; country++) {
+        str option = NORDVPN_COUNTRY_STR[country];
+        if (str_len(option) != str_len(name)) {
+            continue;
+        }
+        size_t c = 0;
+        for (; c < str_len(name); c++) {
+            char actual = str_ptr(name)[c] == ' ' ? '_' : str_ptr(name)[c];
+            if (actual != str_ptr(option)[c]) {
+                break;
+            }
+        }
+        if (c == str_len(name)) {
+            return country;
+        }
+    }
+    return -1;
+}
+
+nordvpn_technology_t
+nordvpn_technology_from_name(str name) {
+    for (int technology = TECHNOLOGY_NORDLYNX; technology <= TECHNOLOGY_NORDWHISPER; technology++) {
+        if (str_eq(name, NORDVPN_TECHNOLOGY_STR[technology])) {
+            return (nordvpn_technology_t)technology;
+        }
+    }
+    return TECHNOLOGY_UNKNOWN;
+}
@@ -0,0 +1,166 @@
+#include "nordi_allowlist_unittest.h"
+#include <stdio.h>
+#include <time.h>
+
+#define BENCH_LINES   100000
+#define BENCH_SLOTS   16384 // the /24 subnets of 10.0.0.0/10
+#define BENCH_NETWORK 0x0a000000u
+
+static const char* CURRENT_ENTRIES = "10.0.0.0/25\n10.0.0.128/25\n22 (UDP|TCP)\n3000 - 3100 (TCP)\n";
+
+static nordi_allowlist_ptr
+allowlist_of(const char* entries) {
+    nordi_allowlist_ptr allowlist = nordi_allowlist_new();
+    FILE* stream = fmemopen((void*)entries, strlen(entries), "r");
+    nordi_allowlist_read(allowlist, stream);
+    fclose(stream);
+    return allowlist;
+}
+
+static void
+assert_subnet(nordi_allowlist_ptr allowlist, int index, uint32_t address, int prefix) {
+    assert_uint32(allowlist->subnets[index].address, ==, address);
+    assert_int(allowlist->subnets[index].prefix, ==, prefix);
+}
+
+TEARDOWN(tear_down_test) {}
+
+TEST(test_nordi_allowlist_parse) {
+    nordi_allowlist_ptr allowlist = nordi_allowlist_new();
+    assert_true(nordi_allowlist_add(allowlist, "10.1.2.3/8\n")); // call
+    assert_true(nordi_allowlist_add(allowlist, "  192.168.0.1 # printer"));
+    assert_true(nordi_allowlist_add(allowlist, "# internal networks"));
+    assert_true(nordi_allowlist_add(allowlist, ""));
+    assert_true(nordi_allowlist_add(allowlist, "22"));
+    assert_true(nordi_allowlist_add(allowlist, "3000 - 3100 (TCP)"));
+    assert_true(nordi_allowlist_add(allowlist, "53 udp"));
+    assert_true(nordi_allowlist_add(allowlist, "8080-8081 (UDP|TCP)"));
+    assert_false(nordi_allowlist_add(allowlist, "300.1.1.1"));
+    assert_false(nordi_allowlist_add(allowlist, "10.0.0.0/33"));
+    assert_false(nordi_allowlist_add(allowlist, "10.0.0"));
+    assert_false(nordi_allowlist_add(allowlist, "0"));
+    assert_false(nordi_allowlist_add(allowlist, "3100-3000"));
+    assert_false(nordi_allowlist_add(allowlist, "22 sctp"));
+    assert_false(nordi_allowlist_add(allowlist, "fd00::/8"));
+    assert_int(allowlist->count, ==, 2);
+    assert_subnet(allowlist, 0, 0x0a000000u, 8);
+    assert_subnet(allowlist, 1, 0xc0a80001u, 32);
+    assert_uint(allowlist->lines, ==, 15);
+    assert_uint(allowlist->rejected, ==, 7);
+    uint64_t* tcp = allowlist->ports[0];
+    uint64_t* udp = allowlist->ports[1];
+    assert_true(has_port(tcp, 22) && has_port(udp, 22));
+    assert_true(has_port(tcp, 3000) && has_port(tcp, 3050) && has_port(tcp, 3100) && !has_port(tcp, 3101));
+    assert_false(has_port(udp, 3050));
+    assert_true(has_port(udp, 53) && !has_port(tcp, 53));
+    assert_true(has_port(tcp, 8081) && has_port(udp, 8080));
+    nordi_allowlist_free(allowlist);
+}
+
+TEST(test_nordi_allowlist_aggregate) {
+    nordi_allowlist_ptr allowlist = allowlist_of("10.0.0.0/25\n"
+                                                 "10.0.0.128/25\n"
+                                                 "10.0.0.5\n"
+                                                 "10.0.1.0/24\n"
+                                                 "10.0.2.0/24\n"
+                                                 "192.168.4.0/24\n"
+                                                 "192.168.0.0/16\n"
+                                                 "172.16.0.1\n"
+                                                 "172.16.0.2\n"
+                                                 "172.16.0.3\n");
+    nordi_allowlist_aggregate(allowlist); // call
+    assert_int(allowlist->count, ==, 5);
+    assert_subnet(allowlist, 0, 0x0a000000u, 23);
+    assert_subnet(allowlist, 1, 0x0a000200u, 24);
+    // 172.16.0.1 to 172.16.0.3 isn't aligned, so it takes a /32 and a /31
+    assert_subnet(allowlist, 2, 0xac100001u, 32);
+    assert_subnet(allowlist, 3, 0xac100002u, 31);
+    assert_subnet(allowlist, 4, 0xc0a80000u, 16);
+    nordi_allowlist_free(allowlist);
+}
+
+TEST(test_nordi_allowlist_diff) {
+    nordi_allowlist_ptr current = allowlist_of(CURRENT_ENTRIES);
+    nordi_allowlist_ptr desired = allowlist_of("10.0.1.0/24\n3101-3200 tcp\n53 udp\n");
+    nordi_allowlist_merge(desired, current);
+    nordi_allowlist_aggregate(desired);
+    str changes = str_null;
+    assert_int(nordi_allowlist_diff(desired, current, &changes), ==, 5); // call
+    assert_string_equal(str_ptr(changes), "add subnet 10.0.0.0/23\n"
+                                          "add port 53 protocol UDP\n"
+                                          "add ports 3101 3200 protocol TCP\n"
+                                          "remove subnet 10.0.0.0/25\n"
+                                          "remove subnet 10.0.0.128/25\n");
+    // nothing to change once in place
+    nordi_allowlist_ptr applied = allowlist_of("10.0.0.0/23\n22\n53 udp\n3000-3200 tcp\n");
+    assert_int(nordi_allowlist_diff(desired, applied, &changes), ==, 0); // call
+    assert_string_equal(str_ptr(changes), "");
+    // ports dropped for a single protocol
+    nordi_allowlist_ptr trimmed = allowlist_of("10.0.0.0/23\n22 udp\n");
+    assert_int(nordi_allowlist_diff(trimmed, applied, &changes), ==, 3); // call
+    assert_string_equal(str_ptr(changes), "remove port 22 protocol TCP\n"
+                                          "remove port 53 protocol UDP\n"
+                                          "remove ports 3000 3200 protocol TCP\n");
+    str_free(changes);
+    nordi_allowlist_free(trimmed);
+    nordi_allowlist_free(applied);
+    nordi_allowlist_free(desired);
+    nordi_allowlist_free(current);
+}
+
+TEST(test_nordi_allowlist_bench) {
+    static bool covered[BENCH_SLOTS];
+    memset(covered, 0, sizeof(covered));
+    FILE* file = tmpfile();
+    for (int line = 0; line < BENCH_LINES; line++) {
+        if (line % 10 == 0) {
+            int port = munit_rand_int_range(1, 65000);
+            fprintf(file, "%d-%d %s\n", port, port + munit_rand_int_range(0, 10), line % 20 == 0 ? "tcp" : "");
+            continue;
+        }
+        int slot = munit_rand_int_range(0, BENCH_SLOTS - 1);
+        covered[slot] = true;
+        uint32_t address = BENCH_NETWORK + ((uint32_t)slot << 8);
+        fprintf(file, "%u.%u.%u.0/24\n", address >> 24, (address >> 16) & 0xff, (address >> 8) & 0xff);
+    }
+    rewind(file);
+    nordi_allowlist_ptr current = allowlist_of(CURRENT_ENTRIES);
+    nordi_allowlist_ptr desired = nordi_allowlist_new();
+    str changes = str_null;
+    clock_t start = clock();
+    assert_int(nordi_allowlist_read(desired, file), ==, BENCH_LINES); // call
+    nordi_allowlist_merge(desired, current);
+    nordi_allowlist_aggregate(desired);
+    int count = nordi_allowlist_diff(desired, current, &changes);
+    clock_t ticks = clock() - start;
+    munit_logf(MUNIT_LOG_INFO, "%d lines: %d changes instead of %d, %.1f ms to read, aggregate and diff", BENCH_LINES,
+               count, BENCH_LINES, ticks * 1e3 / CLOCKS_PER_SEC);
+    assert_int(count, >, 0);
+    assert_int(count, <, BENCH_LINES / 4);
+    // the aggregated subnets cover exactly the /24 subnets listed, and 10.0.0.0/24 from the current ones
+    covered[0] = true;
+    for (int index = 0; index < desired->count; index++) {
+        nordi_allowlist_subnet_t subnet = desired->subnets[index];
+        assert_int(subnet.prefix, <=, 24);
+        int first = (int)((subnet.address - BENCH_NETWORK) >> 8);
+        for (int slot = first; slot < first + (1 << (24 - subnet.prefix)); slot++) {
+            assert_true(covered[slot]);
+            covered[slot] = false;
+        }
+    }
+    for (int slot = 0; slot < BENCH_SLOTS; slot++) {
+        assert_false(covered[slot]);
+    }
+    str_free(changes);
+    nordi_allowlist_free(desired);
+    nordi_allowlist_free(current);
+    fclose(file);
+}
+
+TESTS(allowlist_tests) = {
+    TESTRUN("/parse-ok", test_nordi_allowlist_parse),
+    TESTRUN("/aggregate-ok", test_nordi_allowlist_aggregate),
+    TESTRUN("/diff-ok", test_nordi_allowlist_diff),
+    TESTRUN("/bench-ok", test_nordi_allowlist_bench),
+    TESTEND,
+};
@@ -0,0 +1,7 @@
+#ifndef NORDI_ALLOWLIST_UNITTEST_H_
+#define NORDI_ALLOWLIST_UNITTEST_H_
+
+#include "../src/nordi_allowlist.c"
+#include "nordi_unittest.h"
+
+#endif /* NORDI_ALLOWLIST_UNITTEST_H_ */
@@ -0,0 +1,209 @@
+#include "nordi_bench_unittest.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <threads.h>
+#include <unistd.h>
+#include "nordvpn_fake.h"
+
+#define LOCALHOST         "127.0.0.1"
+#define MAX_TARGET        32
+#define MAX_TABLE         2048
+#define STUB_POLL_US      5000
+#define CYCLES            3
+#define NORDLYNX_DELAY_US 2000
+#define UDP_DELAY_US      15000
+#define TCP_DELAY_US      30000
+
+// local resolver standing in for the far end of the tunnel, answers by echoing the query back as a response
+typedef struct {
+    int socket;
+    thrd_t thread;
+    atomic_bool is_running;
+    char target[MAX_TARGET];
+} stub_t;
+
+static stub_t stub = {};
+static const char* const SERVERS[] = {"pt1", "de2"};
+
+static int
+stub_worker(stub_t* server) {
+    struct timeval poll = {.tv_usec = STUB_POLL_US};
+    setsockopt(server->socket, SOL_SOCKET, SO_RCVTIMEO, &poll, sizeof(poll));
+    while (server->is_running) {
+        unsigned char buffer[DNS_MAX_MESSAGE];
+        struct sockaddr_storage peer;
+        socklen_t length = sizeof(peer);
+        ssize_t received = recvfrom(server->socket, buffer, sizeof(buffer), 0, (struct sockaddr*)&peer, &length);
+        if (received < 3) {
+            continue;
+        }
+        buffer[2] |= 0x80; // response
+        sendto(server->socket, buffer, received, 0, (struct sockaddr*)&peer, length);
+    }
+    return thrd_success;
+}
+
+static const char*
+start_stub() {
+    stub.socket = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    struct sockaddr_in address = {.sin_family = AF_INET};
+    inet_pton(AF_INET, LOCALHOST, &address.sin_addr);
+    bind(stub.socket, (struct sockaddr*)&address, sizeof(address));
+    socklen_t length = sizeof(address);
+    getsockname(stub.socket, (struct sockaddr*)&address, &length);
+    snprintf(stub.target, MAX_TARGET, LOCALHOST ":%d", ntohs(address.sin_port));
+    stub.is_running = true;
+    thrd_create(&stub.thread, (int (*)(void*))stub_worker, &stub);
+    return stub.target;
+}
+
+static nordi_bench_options_t
+test_options() {
+    return (nordi_bench_options_t){
+        .cycles = CYCLES,
+        .rtt_target = start_stub(),
+        .rtt_probes = 2,
+        .rtt_timeout_ms = 100,
+    };
+}
+
+static void
+start_fake() {
+    fake_nordvpn_t* fake = fake_nordvpn();
+    fake->is_enabled = true;
+    fake->nordlynx_delay_us = NORDLYNX_DELAY_US;
+    fake->udp_delay_us = UDP_DELAY_US;
+    fake->tcp_delay_us = TCP_DELAY_US;
+    nordvpn_get_session()->is_active = true;
+}
+
+TEARDOWN(tear_down_test) {
+    if (stub.is_running) {
+        stub.is_running = false;
+        thrd_join(stub.thread, NULL);
+        close(stub.socket);
+    }
+    memset(&stub, 0, sizeof(stub_t));
+    memset(fake_nordvpn(), 0, sizeof(fake_nordvpn_t));
+    nordvpn_close();
+}
+
+TEST(test_nordi_bench_run) {
+    start_fake();
+    nordi_bench_options_t options = test_options();
+    nordi_bench_ptr bench = nordi_bench_new(SERVERS, 2, &options);
+    assert_not_null(bench);
+    assert_int(bench->count, ==, BENCH_COMBINATION_COUNT * 2);
+    assert_int(nordi_bench_run(bench), ==, OK); // call
+    assert_uint(fake_nordvpn()->connects, ==, BENCH_COMBINATION_COUNT * 2 * CYCLES);
+    for (int index = 0; index < bench->count; index++) {
+        nordi_bench_row_t* row = &bench->rows[index];
+        assert_int(row->combination, ==, index / 2);
+        assert_string_equal(row->server, SERVERS[index % 2]);
+        assert_uint(row->cycles, ==, CYCLES);
+        assert_uint(row->failures, ==, 0);
+        assert_uint(row->connect_p95_ms, >=, row->connect_p50_ms);
+        assert_uint(row->rtt_p50_us, >, 0);
+    }
+    // the injected latencies show through the normal API path
+    assert_uint(bench->rows[0].connect_p50_ms, <, bench->rows[2].connect_p50_ms);
+    assert_uint(bench->rows[2].connect_p50_ms, <, bench->rows[4].connect_p50_ms);
+    assert_uint(bench->rows[4].connect_p50_ms, >=, TCP_DELAY_US / 1000);
+    // back to the technology in place, the tunnel down
+    assert_string_equal(fake_nordvpn()->technology, "NORDLYNX");
+    assert_false(fake_nordvpn()->is_online);
+    nordi_bench_free(bench);
+    return MUNIT_OK;
+}
+
+TEST(test_nordi_bench_failures) {
+    start_fake();
+    fake_nordvpn()->fail_every = 2;
+    nordi_bench_options_t options = test_options();
+    options.cycles = 4;
+    nordi_bench_ptr bench = nordi_bench_new(NULL, 0, &options);
+    assert_int(nordi_bench_run(bench), ==, OK); // call
+    assert_int(bench->count, ==, BENCH_COMBINATION_COUNT);
+    for (int index = 0; index < bench->count; index++) {
+        assert_string_equal(bench->rows[index].server, "");
+        assert_uint(bench->rows[index].cycles, ==, 4);
+        assert_uint(bench->rows[index].failures, ==, 2);
+    }
+    assert_string_equal(fake_nordvpn()->server, "quick");
+    nordi_bench_free(bench);
+    return MUNIT_OK;
+}
+
+TEST(test_nordi_bench_write) {
+    start_fake();
+    nordi_bench_options_t options = test_options();
+    options.cycles = 1;
+    nordi_bench_ptr bench = nordi_bench_new(SERVERS, 1, &options);
+    nordi_bench_run(bench);
+    char table[MAX_TABLE] = {};
+    FILE* file = fmemopen(table, sizeof(table), "w");
+    nordi_bench_write(bench, file); // call
+    fclose(file);
+    assert_not_null(strstr(table, "technology"));
+    assert_not_null(strstr(table, "NordLynx     pt1"));
+    assert_not_null(strstr(table, "OpenVPN UDP  pt1"));
+    assert_not_null(strstr(table, "OpenVPN TCP  pt1"));
+    assert_not_null(strstr(table, "0.0%"));
+    nordi_bench_free(bench);
+    return MUNIT_OK;
+}
+
+static int
+run_bench(nordi_bench_ptr bench) {
+    return nordi_bench_run(bench);
+}
+
+TEST(test_nordi_bench_cancel) {
+    start_fake();
+    nordi_bench_options_t options = test_options();
+    nordi_bench_ptr bench = nordi_bench_new(SERVERS, 2, &options);
+    thrd_t thread;
+    thrd_create(&thread, (int (*)(void*))run_bench, bench);
+    // held in the middle of the OpenVPN UDP cycles, once the technology was switched
+    fake_nordvpn_wait_spawns(1);
+    while (strcmp(fake_nordvpn()->technology, "OPENVPN") != 0) {
+        thrd_sleep(&(struct timespec){.tv_nsec = STUB_POLL_US * 1000}, NULL);
+    }
+    fake_nordvpn()->is_held = true;
+    fake_nordvpn_wait_spawns(fake_nordvpn()->spawns + 1);
+    nordi_bench_cancel(bench); // call
+    nordi_bench_cancel(bench); // call, a second signal changes nothing
+    fake_nordvpn()->is_held = false;
+    int result;
+    thrd_join(thread, &result);
+    assert_int(result, ==, CANCELLED);
+    assert_uint(fake_nordvpn()->cancels, ==, 1);
+    assert_uint(fake_nordvpn()->connects, <, BENCH_COMBINATION_COUNT * 2 * CYCLES);
+    // back to the technology in place, the tunnel down, and commands run again
+    assert_string_equal(fake_nordvpn()->technology, "NORDLYNX");
+    assert_false(fake_nordvpn()->is_online);
+    assert_false(nordvpn_get_session()->is_cancelled);
+    // the rows of the combinations that never ran are left empty
+    assert_uint(bench->rows[bench->count - 1].cycles, ==, 0);
+    nordi_bench_free(bench);
+    return MUNIT_OK;
+}
+
+TEST(test_nordi_bench_fail_no_session) {
+    nordi_bench_ptr bench = nordi_bench_new(SERVERS, 2, NULL);
+    assert_int(nordi_bench_run(bench), ==, NO_SESSION); // call
+    nordi_bench_free(bench);
+    return MUNIT_OK;
+}
+
+TESTS(bench_tests) = {
+    TESTRUN("/run-ok", test_nordi_bench_run),
+    TESTRUN("/run-ok-failures", test_nordi_bench_failures),
+    TESTRUN("/write-ok", test_nordi_bench_write),
+    TESTRUN("/run-ok-cancelled", test_nordi_bench_cancel),
+    TESTRUN("/run-fail-no-session", test_nordi_bench_fail_no_session),
+    TESTEND,
+};
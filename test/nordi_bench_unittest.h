@@ -0,0 +1,7 @@
+#ifndef NORDI_BENCH_UNITTEST_H_
+#define NORDI_BENCH_UNITTEST_H_
+
+#include "../src/nordi_bench.c"
+#include "nordi_unittest.h"
+
+#endif /* NORDI_BENCH_UNITTEST_H_ */
@@ -0,0 +1,148 @@
+#include "nordi_bus_unittest.h"
+#include <threads.h>
+
+#define PRODUCERS        4
+#define EVENTS_PER_THREAD 10000
+#define MAX_RECEIVED     64
+#define FLAPS            5
+
+static nordi_bus_ptr bus = NULL;
+static int wakes = 0;
+static int received = 0;
+static int values[MAX_RECEIVED] = {};
+static int last_of[PRODUCERS] = {};
+static bool is_ordered = true;
+
+static void
+wake(void* context) {
+    wakes++;
+}
+
+static void
+receive(nordi_bus_event_ptr event, void* context) {
+    if (received < MAX_RECEIVED) {
+        values[received] = event->value;
+    }
+    received++;
+}
+
+// Checks that the events of each producer arrive in the order it published them
+static void
+receive_ordered(nordi_bus_event_ptr event, void* context) {
+    int producer = event->value / EVENTS_PER_THREAD;
+    is_ordered = is_ordered && event->value > last_of[producer];
+    last_of[producer] = event->value;
+    received++;
+}
+
+static int
+produce(void* data) {
+    int producer = (int)(long)data;
+    for (int event = 1; event < EVENTS_PER_THREAD; event++) {
+        nordi_bus_publish(bus, BUS_PROGRESS, producer * EVENTS_PER_THREAD + event, NULL);
+    }
+    return thrd_success;
+}
+
+TEARDOWN(tear_down_test) {
+    nordi_bus_free(bus);
+    bus = NULL;
+    wakes = 0;
+    received = 0;
+    memset(values, 0, sizeof(values));
+    memset(last_of, 0, sizeof(last_of));
+    is_ordered = true;
+}
+
+TEST(test_nordi_bus_dispatch_every) {
+    bus = nordi_bus_new(wake, NULL);
+    assert_not_null(bus);
+    assert_true(nordi_bus_subscribe(bus, BUS_ERROR, BUS_EVERY, 0, receive, NULL));
+    nordi_bus_publish(bus, BUS_ERROR, 1, "connect"); // call
+    nordi_bus_publish(bus, BUS_PROGRESS, 50, NULL); // call, nobody subscribed
+    nordi_bus_publish(bus, BUS_ERROR, 2, "login"); // call
+    assert_int(wakes, ==, 1);
+    assert_int(nordi_bus_dispatch(bus, nordi_bus_now_ms()), ==, BUS_NO_DEADLINE); // call
+    assert_int(received, ==, 2);
+    assert_int(values[0], ==, 1);
+    assert_int(values[1], ==, 2);
+    assert_uint(bus->batches, ==, 1);
+    nordi_bus_publish(bus, BUS_ERROR, 3, NULL); // call, a new batch
+    assert_int(wakes, ==, 2);
+    nordi_bus_dispatch(bus, nordi_bus_now_ms());
+    assert_int(received, ==, 3);
+    return MUNIT_OK;
+}
+
+TEST(test_nordi_bus_dispatch_latest) {
+    bus = nordi_bus_new(NULL, NULL);
+    nordi_bus_subscribe(bus, BUS_ACCOUNT, BUS_LATEST, 0, receive, NULL);
+    for (int event = 1; event <= 3; event++) {
+        nordi_bus_publish(bus, BUS_ACCOUNT, event, NULL); // call
+    }
+    assert_int(nordi_bus_dispatch(bus, nordi_bus_now_ms()), ==, BUS_NO_DEADLINE); // call
+    assert_int(received, ==, 1);
+    assert_int(values[0], ==, 3);
+    assert_uint(bus->coalesced, ==, 2);
+    nordi_bus_dispatch(bus, nordi_bus_now_ms()); // call, nothing new
+    assert_int(received, ==, 1);
+    return MUNIT_OK;
+}
+
+TEST(test_nordi_bus_dispatch_settled) {
+    bus = nordi_bus_new(NULL, NULL);
+    nordi_bus_subscribe(bus, BUS_CONNECTION, BUS_SETTLED, BUS_DEFAULT_SETTLE_MS, receive, NULL);
+    long long start = nordi_bus_now_ms();
+    for (int flap = 0; flap < FLAPS; flap++) {
+        nordi_bus_publish(bus, BUS_CONNECTION, false, NULL); // call
+        nordi_bus_publish(bus, BUS_CONNECTION, true, "de507.nordvpn.com"); // call
+        int deadline = nordi_bus_dispatch(bus, nordi_bus_now_ms()); // call, still flapping
+        assert_int(deadline, >, 0);
+        assert_int(deadline, <=, BUS_DEFAULT_SETTLE_MS);
+    }
+    assert_int(received, ==, 0);
+    assert_int(nordi_bus_dispatch(bus, start + 2 * BUS_DEFAULT_SETTLE_MS), ==, BUS_NO_DEADLINE); // call, settled
+    assert_int(received, ==, 1);
+    assert_int(values[0], ==, true);
+    assert_uint(bus->coalesced, ==, 2 * FLAPS - 1);
+    return MUNIT_OK;
+}
+
+TEST(test_nordi_bus_publish_producers) {
+    bus = nordi_bus_new(NULL, NULL);
+    nordi_bus_subscribe(bus, BUS_PROGRESS, BUS_EVERY, 0, receive_ordered, NULL);
+    thrd_t threads[PRODUCERS];
+    for (long producer = 0; producer < PRODUCERS; producer++) {
+        thrd_create(&threads[producer], produce, (void*)producer); // call
+    }
+    // dispatch while they publish, batches split anywhere
+    while (received < PRODUCERS * (EVENTS_PER_THREAD - 1)) {
+        nordi_bus_dispatch(bus, nordi_bus_now_ms()); // call
+    }
+    for (int producer = 0; producer < PRODUCERS; producer++) {
+        thrd_join(threads[producer], NULL);
+    }
+    nordi_bus_dispatch(bus, nordi_bus_now_ms());
+    assert_int(received, ==, PRODUCERS * (EVENTS_PER_THREAD - 1));
+    assert_true(is_ordered);
+    assert_uint(bus->published, ==, PRODUCERS * (EVENTS_PER_THREAD - 1));
+    return MUNIT_OK;
+}
+
+TEST(test_nordi_bus_subscribe_full) {
+    bus = nordi_bus_new(NULL, NULL);
+    for (int subscriber = 0; subscriber < BUS_MAX_SUBSCRIBERS; subscriber++) {
+        assert_true(nordi_bus_subscribe(bus, BUS_ERROR, BUS_EVERY, 0, receive, NULL)); // call
+    }
+    assert_false(nordi_bus_subscribe(bus, BUS_ERROR, BUS_EVERY, 0, receive, NULL)); // call
+    return MUNIT_OK;
+}
+
+TESTS(bus_tests) = {
+    TESTRUN("/dispatch-ok-every", test_nordi_bus_dispatch_every),
+    TESTRUN("/dispatch-ok-latest", test_nordi_bus_dispatch_latest),
+    TESTRUN("/dispatch-ok-settled", test_nordi_bus_dispatch_settled),
+    TESTRUN("/publish-ok-producers", test_nordi_bus_publish_producers),
+    TESTRUN("/subscribe-fail-full", test_nordi_bus_subscribe_full),
+    TESTEND
+};
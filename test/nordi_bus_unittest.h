@@ -0,0 +1,7 @@
+#ifndef NORDI_BUS_UNITTEST_H_
+#define NORDI_BUS_UNITTEST_H_
+
+#include "../src/nordi_bus.c"
+#include "nordi_unittest.h"
+
+#endif /* NORDI_BUS_UNITTEST_H_ */
@@ -0,0 +1,260 @@
+#include "nordi_catalog_unittest.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/eventfd.h>
+#include <time.h>
+
+#define LOCALHOST     "127.0.0.1"
+#define CACHE_PATH    "/tmp/nordi-catalog.dat"
+#define MAX_RESPONSES 4
+#define MAX_URL       64
+#define TEST_TIMEOUT  2000
+#define CANCEL_MS     20
+
+#define FULL_BODY                                                                                                                          \
+    "#full\n"                                                                                                                              \
+    "de2\tGermany\t40\tstandard,p2p\t50.110924\t8.682127\n"                                                                                \
+    "de1\tGermany\t12\tstandard\t52.52\t13.405\n"                                                                                          \
+    "us7\tUnited States\t5\tstandard,p2p,obfuscated\t-40.7128\t-74.006\tNORDLYNX,OPENVPN\n"                                                                  \
+    "garbage line\n"
+#define DELTA_BODY                                                                                                                         \
+    "#delta\n"                                                                                                                             \
+    "-de2\n"                                                                                                                               \
+    "de1\tGermany\t70\tstandard\t52.52\t13.405\n"                                                                                          \
+    "de3\tGermany\t3\tstandard,p2p\t48.1351\t11.582\n"
+
+// A local HTTP server answering one scripted response per connection, keeping the requests it got
+typedef struct {
+    int fd;
+    thrd_t thread;
+    const char* responses[MAX_RESPONSES];
+    int count;
+    char requests[MAX_RESPONSES][MAX_REQUEST];
+    char url[MAX_URL];
+} local_server_t;
+
+static local_server_t server = {.fd = -1};
+
+static int
+serve(void* data) {
+    for (int index = 0; index < server.count; index++) {
+        int client = accept(server.fd, NULL, NULL);
+        if (client < 0) {
+            return thrd_error;
+        }
+        size_t length = 0;
+        while (length < MAX_REQUEST - 1 && strstr(server.requests[index], "\r\n\r\n") == NULL) {
+            ssize_t count = recv(client, server.requests[index] + length, MAX_REQUEST - 1 - length, 0);
+            if (count <= 0) {
+                break;
+            }
+            length += count;
+        }
+        send(client, server.responses[index], strlen(server.responses[index]), MSG_NOSIGNAL);
+        close(client);
+    }
+    return thrd_success;
+}
+
+static void
+local_server_start(const char* responses[], int count) {
+    server = (local_server_t){.count = count};
+    memcpy(server.responses, responses, count * sizeof(*responses));
+    server.fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    struct sockaddr_in address = {.sin_family = AF_INET, .sin_port = 0};
+    inet_pton(AF_INET, LOCALHOST, &address.sin_addr);
+    bind(server.fd, (struct sockaddr*)&address, sizeof(address));
+    listen(server.fd, MAX_RESPONSES);
+    socklen_t length = sizeof(address);
+    getsockname(server.fd, (struct sockaddr*)&address, &length);
+    snprintf(server.url, MAX_URL, "http://" LOCALHOST ":%d/servers", ntohs(address.sin_port));
+    thrd_create(&server.thread, serve, NULL);
+}
+
+static void
+local_server_join() {
+    thrd_join(server.thread, NULL);
+    close(server.fd);
+    server.fd = -1;
+}
+
+TEARDOWN(tear_down_test) {
+    remove(CACHE_PATH);
+}
+
+TEST(test_nordi_catalog_refresh_full) {
+    remove(CACHE_PATH);
+    char response[MAX_REQUEST];
+    snprintf(response, MAX_REQUEST, "HTTP/1.1 200 OK\r\nETag: \"v1\"\r\nContent-Length: %zu\r\n\r\n%s", strlen(FULL_BODY),
+             FULL_BODY);
+    const char* responses[] = {response};
+    local_server_start(responses, 1);
+    nordi_catalog_ptr catalog = nordi_catalog_open(CACHE_PATH);
+    assert_not_null(catalog);
+    assert_int(nordi_catalog_refresh(catalog, server.url, TEST_TIMEOUT), ==, CATALOG_FULL); // call
+    local_server_join();
+    assert_not_null(strstr(server.requests[0], "GET /servers HTTP/1.1\r\n"));
+    assert_null(strstr(server.requests[0], "If-None-Match"));
+    assert_int(catalog->count, ==, 3);
+    assert_string_equal(catalog->etag, "\"v1\"");
+    nordi_catalog_server_t entry;
+    assert_true(nordi_catalog_find(catalog, "de2", &entry)); // call
+    assert_int(entry.country, ==, 1);
+    assert_int(entry.load, ==, 40);
+    assert_uint(entry.features, ==, FEATURE_STANDARD | FEATURE_P2P);
+    assert_int(entry.latitude_e6, ==, 50110924);
+    assert_int(entry.longitude_e6, ==, 8682127);
+    assert_uint(entry.technologies, ==, 0);
+    assert_true(nordi_catalog_find(catalog, "us7", &entry));
+    assert_int(entry.latitude_e6, ==, -40712800);
+    assert_uint(entry.technologies, ==, (1u << TECHNOLOGY_NORDLYNX) | (1u << TECHNOLOGY_OPENVPN));
+    assert_false(nordi_catalog_find(catalog, "de", &entry));
+    assert_false(nordi_catalog_find(catalog, "zz9", &entry));
+    nordi_catalog_close(catalog);
+    // the cache alone brings the table back
+    catalog = nordi_catalog_open(CACHE_PATH); // call
+    assert_int(catalog->count, ==, 3);
+    assert_string_equal(catalog->etag, "\"v1\"");
+    assert_true(nordi_catalog_find(catalog, "de1", &entry));
+    assert_int(entry.load, ==, 12);
+    nordi_catalog_close(catalog);
+}
+
+TEST(test_nordi_catalog_refresh_unchanged) {
+    char response[MAX_REQUEST];
+    snprintf(response, MAX_REQUEST, "HTTP/1.1 200 OK\r\nEtag: \"v1\"\r\nLast-Modified: Mon, 02 Jan 2023 10:00:00 GMT\r\n\r\n%s",
+             FULL_BODY);
+    const char* responses[] = {response, "HTTP/1.1 304 Not Modified\r\n\r\n"};
+    local_server_start(responses, 2);
+    nordi_catalog_ptr catalog = nordi_catalog_open(NULL);
+    assert_int(nordi_catalog_refresh(catalog, server.url, TEST_TIMEOUT), ==, CATALOG_FULL);
+    assert_int(nordi_catalog_refresh(catalog, server.url, TEST_TIMEOUT), ==, CATALOG_UNCHANGED); // call
+    local_server_join();
+    assert_not_null(strstr(server.requests[1], "If-None-Match: \"v1\"\r\n"));
+    assert_not_null(strstr(server.requests[1], "If-Modified-Since: Mon, 02 Jan 2023 10:00:00 GMT\r\n"));
+    assert_int(catalog->count, ==, 3);
+    assert_uint(catalog->fetches, ==, 2);
+    assert_uint(catalog->unchanged, ==, 1);
+    nordi_catalog_close(catalog);
+}
+
+TEST(test_nordi_catalog_refresh_delta) {
+    char full[MAX_REQUEST], delta[MAX_REQUEST];
+    snprintf(full, MAX_REQUEST, "HTTP/1.1 200 OK\r\nETag: \"v1\"\r\n\r\n%s", FULL_BODY);
+    snprintf(delta, MAX_REQUEST, "HTTP/1.1 200 OK\r\nETag: \"v2\"\r\n\r\n%s", DELTA_BODY);
+    const char* responses[] = {full, delta};
+    local_server_start(responses, 2);
+    nordi_catalog_ptr catalog = nordi_catalog_open(CACHE_PATH);
+    nordi_catalog_refresh(catalog, server.url, TEST_TIMEOUT);
+    assert_int(nordi_catalog_refresh(catalog, server.url, TEST_TIMEOUT), ==, CATALOG_DELTA); // call
+    local_server_join();
+    assert_int(catalog->count, ==, 3);
+    assert_string_equal(catalog->servers[0].name, "de1");
+    assert_string_equal(catalog->servers[1].name, "de3");
+    assert_string_equal(catalog->servers[2].name, "us7");
+    assert_int(catalog->servers[0].load, ==, 70);
+    assert_uint(catalog->revision, ==, 2);
+    assert_string_equal(catalog->etag, "\"v2\"");
+    nordi_catalog_close(catalog);
+    catalog = nordi_catalog_open(CACHE_PATH);
+    nordi_catalog_server_t entry;
+    assert_false(nordi_catalog_find(catalog, "de2", &entry));
+    assert_true(nordi_catalog_find(catalog, "de3", &entry));
+    nordi_catalog_close(catalog);
+}
+
+TEST(test_nordi_catalog_refresh_chunked) {
+    const char* responses[] = {"HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n"
+                               "6\r\n#full\n\r\n"
+                               "14\r\nde1\tGermany\t12\tstand\r\n"
+                               "f\r\nard\t52.52\t13.4\n\r\n"
+                               "0\r\n\r\n"};
+    local_server_start(responses, 1);
+    nordi_catalog_ptr catalog = nordi_catalog_open(NULL);
+    assert_int(nordi_catalog_refresh(catalog, server.url, TEST_TIMEOUT), ==, CATALOG_FULL); // call
+    local_server_join();
+    nordi_catalog_server_t entry;
+    assert_true(nordi_catalog_find(catalog, "de1", &entry));
+    assert_uint(entry.features, ==, FEATURE_STANDARD);
+    assert_int(entry.longitude_e6, ==, 13400000);
+    nordi_catalog_close(catalog);
+}
+
+TEST(test_nordi_catalog_refresh_fail) {
+    char full[MAX_REQUEST];
+    snprintf(full, MAX_REQUEST, "HTTP/1.1 200 OK\r\n\r\n%s", FULL_BODY);
+    const char* responses[] = {full, "HTTP/1.1 200 OK\r\n\r\nnot a catalog\n", "HTTP/1.1 500 Internal Server Error\r\n\r\n"};
+    local_server_start(responses, 3);
+    nordi_catalog_ptr catalog = nordi_catalog_open(NULL);
+    nordi_catalog_refresh(catalog, server.url, TEST_TIMEOUT);
+    assert_int(nordi_catalog_refresh(catalog, server.url, TEST_TIMEOUT), ==, CATALOG_FAILED); // call
+    assert_int(nordi_catalog_refresh(catalog, server.url, TEST_TIMEOUT), ==, CATALOG_FAILED);
+    local_server_join();
+    // nobody listens there anymore
+    assert_int(nordi_catalog_refresh(catalog, server.url, TEST_TIMEOUT), ==, CATALOG_FAILED);
+    assert_int(nordi_catalog_refresh(catalog, "https://" LOCALHOST "/servers", TEST_TIMEOUT), ==, CATALOG_FAILED);
+    assert_int(catalog->count, ==, 3);
+    nordi_catalog_close(catalog);
+}
+
+static int
+cancel_later(int* cancel) {
+    thrd_sleep(&(struct timespec){.tv_nsec = CANCEL_MS * 1000000L}, NULL);
+    uint64_t signal = 1;
+    write(*cancel, &signal, sizeof(signal));
+    return thrd_success;
+}
+
+TEST(test_nordi_catalog_refresh_cancel) {
+    // listening, but never answering
+    const char* responses[] = {NULL};
+    local_server_start(responses, 0);
+    nordi_catalog_ptr catalog = nordi_catalog_open(NULL);
+    int cancel = eventfd(0, EFD_CLOEXEC);
+    thrd_t canceller;
+    thrd_create(&canceller, (int (*)(void*))cancel_later, &cancel);
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    assert_int(nordi_catalog_refresh_cancellable(catalog, server.url, TEST_TIMEOUT, cancel), ==, CATALOG_CANCELLED); // call
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    assert_llong((end.tv_sec - start.tv_sec) * 1000 + (end.tv_nsec - start.tv_nsec) / 1000000, <, TEST_TIMEOUT / 2);
+    thrd_join(canceller, NULL);
+    // already cancelled
+    assert_int(nordi_catalog_refresh_cancellable(catalog, server.url, TEST_TIMEOUT, cancel), ==, CATALOG_CANCELLED);
+    assert_int(catalog->count, ==, 0);
+    close(cancel);
+    local_server_join();
+    nordi_catalog_close(catalog);
+}
+
+TEST(test_nordi_catalog_least_loaded) {
+    char full[MAX_REQUEST];
+    snprintf(full, MAX_REQUEST, "HTTP/1.1 200 OK\r\n\r\n%s", FULL_BODY);
+    const char* responses[] = {full};
+    local_server_start(responses, 1);
+    nordi_catalog_ptr catalog = nordi_catalog_open(NULL);
+    nordi_catalog_refresh(catalog, server.url, TEST_TIMEOUT);
+    local_server_join();
+    nordi_catalog_server_t servers[2];
+    assert_int(nordi_catalog_least_loaded(catalog, -1, 0, servers, 2), ==, 2); // call
+    assert_string_equal(servers[0].name, "us7");
+    assert_string_equal(servers[1].name, "de1");
+    assert_int(nordi_catalog_least_loaded(catalog, 1, 0, servers, 2), ==, 2);
+    assert_string_equal(servers[0].name, "de1");
+    assert_string_equal(servers[1].name, "de2");
+    assert_int(nordi_catalog_least_loaded(catalog, 1, FEATURE_P2P, servers, 2), ==, 1);
+    assert_string_equal(servers[0].name, "de2");
+    assert_int(nordi_catalog_least_loaded(catalog, -1, FEATURE_ONION, servers, 2), ==, 0);
+    nordi_catalog_close(catalog);
+}
+
+TESTS(catalog_tests) = {
+    TESTRUN("/refresh-ok-full", test_nordi_catalog_refresh_full),
+    TESTRUN("/refresh-ok-unchanged", test_nordi_catalog_refresh_unchanged),
+    TESTRUN("/refresh-ok-delta", test_nordi_catalog_refresh_delta),
+    TESTRUN("/refresh-ok-chunked", test_nordi_catalog_refresh_chunked),
+    TESTRUN("/refresh-fail", test_nordi_catalog_refresh_fail),
+    TESTRUN("/refresh-fail-cancelled", test_nordi_catalog_refresh_cancel),
+    TESTRUN("/least-loaded-ok", test_nordi_catalog_least_loaded),
+    TESTEND,
+};
@@ -0,0 +1,7 @@
+#ifndef NORDI_CATALOG_UNITTEST_H_
+#define NORDI_CATALOG_UNITTEST_H_
+
+#include "../src/nordi_catalog.c"
+#include "nordi_unittest.h"
+
+#endif /* NORDI_CATALOG_UNITTEST_H_ */
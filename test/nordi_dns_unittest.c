@@ -0,0 +1,219 @@
+#include "nordi_dns_unittest.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <sys/time.h>
+#include <threads.h>
+#include "nordvpn_fake.h"
+
+#define LOCALHOST     "127.0.0.1"
+#define MAX_TARGET    32
+#define MAX_STUBS     3
+#define STUB_POLL_US  5000
+#define SLOW_DELAY_US 6000
+#define REPETITIONS   4
+#define INTERVAL_MS   20
+#define TIMEOUT_MS    100
+
+// local stub resolver, answers every well formed query by echoing it back as a response
+typedef struct {
+    int socket;
+    thrd_t thread;
+    atomic_bool is_running;
+    int delay_us;
+    bool is_dropping; // drop every other query
+    unsigned int received;
+    char target[MAX_TARGET];
+} stub_t;
+
+static stub_t stubs[MAX_STUBS] = {};
+static const char* const NAMES[] = {"example.com", "nordvpn.com"};
+
+static int
+stub_worker(stub_t* stub) {
+    struct timeval poll = {.tv_usec = STUB_POLL_US};
+    setsockopt(stub->socket, SOL_SOCKET, SO_RCVTIMEO, &poll, sizeof(poll));
+    while (stub->is_running) {
+        unsigned char buffer[DNS_MAX_MESSAGE];
+        struct sockaddr_storage peer;
+        socklen_t length = sizeof(peer);
+        ssize_t received = recvfrom(stub->socket, buffer, sizeof(buffer), 0, (struct sockaddr*)&peer, &length);
+        // a query asks for recursion and a single question
+        if (received < HEADER_LENGTH || buffer[2] != FLAG_RECURSION || buffer[5] != 1) {
+            continue;
+        }
+        if ((stub->received++ & 1) && stub->is_dropping) {
+            continue;
+        }
+        thrd_sleep(&(struct timespec){.tv_nsec = stub->delay_us * 1000L}, NULL);
+        buffer[2] |= FLAG_RESPONSE;
+        sendto(stub->socket, buffer, received, 0, (struct sockaddr*)&peer, length);
+    }
+    return thrd_success;
+}
+
+static str
+start_stub(int index, int delay_us, bool is_dropping) {
+    stub_t* stub = &stubs[index];
+    stub->socket = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    struct sockaddr_in address = {.sin_family = AF_INET};
+    inet_pton(AF_INET, LOCALHOST, &address.sin_addr);
+    bind(stub->socket, (struct sockaddr*)&address, sizeof(address));
+    socklen_t length = sizeof(address);
+    getsockname(stub->socket, (struct sockaddr*)&address, &length);
+    snprintf(stub->target, MAX_TARGET, LOCALHOST ":%d", ntohs(address.sin_port));
+    stub->delay_us = delay_us;
+    stub->is_dropping = is_dropping;
+    stub->is_running = true;
+    thrd_create(&stub->thread, (int (*)(void*))stub_worker, stub);
+    return str_ref(stub->target);
+}
+
+static nordi_dns_options_t
+test_options() {
+    return (nordi_dns_options_t){
+        .names = NAMES,
+        .name_count = 2,
+        .repetitions = REPETITIONS,
+        .interval_ms = INTERVAL_MS,
+        .timeout_ms = TIMEOUT_MS,
+    };
+}
+
+TEARDOWN(tear_down_test) {
+    for (int index = 0; index < MAX_STUBS; index++) {
+        stub_t* stub = &stubs[index];
+        if (stub->is_running) {
+            stub->is_running = false;
+            thrd_join(stub->thread, NULL);
+            close(stub->socket);
+        }
+        memset(stub, 0, sizeof(stub_t));
+    }
+    memset(fake_nordvpn(), 0, sizeof(fake_nordvpn_t));
+    nordvpn_close();
+}
+
+TEST(test_nordi_dns_build_query) {
+    static const unsigned char expected[] = {
+        0x12, 0x34, 0x01, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        7, 'e', 'x', 'a', 'm', 'p', 'l', 'e', 3, 'c', 'o', 'm', 0,
+        0x00, 0x01, 0x00, 0x01,
+    };
+    unsigned char query[DNS_MAX_MESSAGE];
+    int length = nordi_dns_build_query(query, sizeof(query), 0x1234, "example.com", DNS_TYPE_A); // call
+    assert_int(length, ==, sizeof(expected));
+    assert_memory_equal(sizeof(expected), query, expected);
+    // a trailing dot is the same name
+    assert_int(nordi_dns_build_query(query, sizeof(query), 0x1234, "example.com.", DNS_TYPE_A), ==, length);
+    assert_memory_equal(sizeof(expected), query, expected);
+    return MUNIT_OK;
+}
+
+TEST(test_nordi_dns_build_query_root) {
+    static const unsigned char expected[] = {
+        0x00, 0x07, 0x01, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x02, 0x00, 0x01,
+    };
+    unsigned char query[DNS_MAX_MESSAGE];
+    int length = nordi_dns_build_query(query, sizeof(query), 7, "", DNS_TYPE_NS); // call
+    assert_int(length, ==, sizeof(expected));
+    assert_memory_equal(sizeof(expected), query, expected);
+    return MUNIT_OK;
+}
+
+TEST(test_nordi_dns_build_query_fail) {
+    unsigned char query[DNS_MAX_MESSAGE];
+    char label[MAX_LABEL_LENGTH + 2];
+    memset(label, 'a', MAX_LABEL_LENGTH + 1);
+    label[MAX_LABEL_LENGTH + 1] = '\0';
+    assert_int(nordi_dns_build_query(query, sizeof(query), 1, "a..b", DNS_TYPE_A), ==, -1); // call
+    assert_int(nordi_dns_build_query(query, sizeof(query), 1, label, DNS_TYPE_A), ==, -1);
+    assert_int(nordi_dns_build_query(query, 20, 1, "example.com", DNS_TYPE_A), ==, -1);
+    assert_int(nordi_dns_build_query(query, HEADER_LENGTH - 1, 1, "", DNS_TYPE_NS), ==, -1);
+    return MUNIT_OK;
+}
+
+TEST(test_nordi_dns_benchmark) {
+    nordi_dns_result_t results[] = {
+        {.resolver = start_stub(0, 0, false)},
+        {.resolver = start_stub(1, SLOW_DELAY_US, false)},
+        {.resolver = start_stub(2, 0, true)},
+        {.resolver = str_lit(LOCALHOST ":1")}, // nothing listens, every query is lost
+    };
+    nordi_dns_options_t options = test_options();
+    int best = nordi_dns_benchmark(results, 4, &options); // call
+    assert_int(best, ==, 0);
+    for (int index = 0; index < 4; index++) {
+        assert_uint(results[index].sent, ==, REPETITIONS * 2);
+    }
+    assert_uint(results[0].answered, ==, REPETITIONS * 2);
+    assert_float(results[0].loss, ==, 0.0f);
+    assert_uint(results[1].answered, ==, REPETITIONS * 2);
+    assert_uint(results[1].p50_us, >=, SLOW_DELAY_US);
+    assert_uint(results[1].p50_us, >, results[0].p50_us);
+    assert_uint(results[1].p95_us, >=, results[1].p50_us);
+    assert_uint(results[2].answered, ==, REPETITIONS);
+    assert_float(results[2].loss, ==, 50.0f);
+    assert_uint(results[3].answered, ==, 0);
+    assert_float(results[3].loss, ==, 100.0f);
+    assert_uint(results[3].p50_us, ==, 0);
+    return MUNIT_OK;
+}
+
+TEST(test_nordi_dns_benchmark_fail) {
+    nordi_dns_result_t results[] = {
+        {.resolver = str_lit(LOCALHOST ":1")},
+        {.resolver = str_lit("not an address:53")},
+    };
+    nordi_dns_options_t options = test_options();
+    options.repetitions = 1;
+    assert_int(nordi_dns_benchmark(results, 2, &options), ==, -1); // call
+    assert_float(results[0].loss, ==, 100.0f);
+    assert_float(results[1].loss, ==, 100.0f);
+    assert_int(nordi_dns_benchmark(results, 0, &options), ==, -1);
+    return MUNIT_OK;
+}
+
+TEST(test_nordi_dns_best) {
+    nordi_dns_result_t results[] = {
+        {.answered = 0, .loss = 100.0f},
+        {.answered = 9, .loss = 10.0f, .p50_us = 1000},
+        {.answered = 10, .loss = 0.0f, .p50_us = 5000},
+        {.answered = 10, .loss = 0.0f, .p50_us = 3000},
+    };
+    assert_int(nordi_dns_best(results, 4), ==, 3); // call
+    assert_int(nordi_dns_best(results, 2), ==, 1);
+    assert_int(nordi_dns_best(results, 1), ==, -1);
+    return MUNIT_OK;
+}
+
+TEST(test_nordi_dns_apply) {
+    fake_nordvpn()->is_enabled = true;
+    nordvpn_get_session()->is_active = true;
+    nordi_dns_result_t result = {.resolver = str_lit("127.0.0.1:5353")};
+    assert_int(nordi_dns_apply(&result), ==, OK); // call
+    assert_string_equal(fake_nordvpn()->dns, "127.0.0.1");
+    // settings read, threat protection off, dns set, settings read back
+    assert_int(fake_nordvpn()->spawns, ==, 4);
+    return MUNIT_OK;
+}
+
+TEST(test_nordi_dns_apply_fail) {
+    nordi_dns_result_t result = {.resolver = str_lit("127.0.0.1")};
+    assert_int(nordi_dns_apply(&result), ==, NO_SESSION); // call
+    return MUNIT_OK;
+}
+
+TESTS(dns_tests) = {
+    TESTRUN("/build-query-ok", test_nordi_dns_build_query),
+    TESTRUN("/build-query-ok-root", test_nordi_dns_build_query_root),
+    TESTRUN("/build-query-fail", test_nordi_dns_build_query_fail),
+    TESTRUN("/benchmark-ok", test_nordi_dns_benchmark),
+    TESTRUN("/benchmark-fail-unanswered", test_nordi_dns_benchmark_fail),
+    TESTRUN("/best-ok", test_nordi_dns_best),
+    TESTRUN("/apply-ok", test_nordi_dns_apply),
+    TESTRUN("/apply-fail-no-session", test_nordi_dns_apply_fail),
+    TESTEND,
+};
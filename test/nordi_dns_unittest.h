@@ -0,0 +1,7 @@
+#ifndef NORDI_DNS_UNITTEST_H_
+#define NORDI_DNS_UNITTEST_H_
+
+#include "../src/nordi_dns.c"
+#include "nordi_unittest.h"
+
+#endif /* NORDI_DNS_UNITTEST_H_ */
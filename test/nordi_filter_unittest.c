@@ -0,0 +1,131 @@
+#include "nordi_filter_unittest.h"
+#include <stdio.h>
+#include <time.h>
+
+#define BENCH_SERVERS 10000
+#define BENCH_QUERIES 2000
+#define NORDLYNX      (1u << TECHNOLOGY_NORDLYNX)
+#define OPENVPN       (1u << TECHNOLOGY_OPENVPN)
+
+static nordi_catalog_server_t
+server_of(const char* name, int country, uint8_t load, uint32_t features, uint8_t technologies) {
+    nordi_catalog_server_t server = {.country = (int16_t)country, .load = load, .features = features, .technologies = technologies};
+    snprintf(server.name, CATALOG_MAX_SERVER, "%s", name);
+    return server;
+}
+
+// The reference: every server checked against the query in turn
+static bool
+scan_matches(const nordi_catalog_server_t* server, nordi_filter_query_ptr query) {
+    return (server->features & query->features) == query->features
+           && (server->technologies & query->technologies) == query->technologies
+           && (query->countries == 0 || (server->country >= 0 && (query->countries & (1ull << server->country))));
+}
+
+TEARDOWN(tear_down_test) {}
+
+TEST(test_nordi_filter_apply) {
+    nordi_catalog_server_t servers[] = {
+        server_of("de1", GERMANY, 50, FEATURE_STANDARD | FEATURE_P2P | FEATURE_OBFUSCATED, NORDLYNX | OPENVPN),
+        server_of("de2", GERMANY, 10, FEATURE_STANDARD | FEATURE_P2P, NORDLYNX),
+        server_of("de3", GERMANY, 20, FEATURE_P2P | FEATURE_OBFUSCATED, OPENVPN),
+        server_of("us1", UNITED_STATES, 5, FEATURE_P2P | FEATURE_OBFUSCATED, NORDLYNX),
+        server_of("jp1", JAPAN, 30, FEATURE_STANDARD | FEATURE_ONION, NORDLYNX),
+        server_of("fr1", FRANCE, 40, FEATURE_STANDARD | FEATURE_P2P | FEATURE_OBFUSCATED, NORDLYNX),
+    };
+    nordi_filter_ptr filter = nordi_filter_new(servers, 6);
+    assert_not_null(filter);
+    uint64_t result[1];
+    nordi_filter_query_t query = {
+        .features = FEATURE_P2P | FEATURE_OBFUSCATED, .technologies = NORDLYNX, .countries = 1ull << GERMANY};
+    assert_int(nordi_filter_apply(filter, &query, result), ==, 1); // call
+    assert_int(nordi_filter_next(filter, result, 0), ==, 0);
+    assert_int(nordi_filter_next(filter, result, 1), ==, -1);
+    // either country
+    query.countries |= 1ull << UNITED_STATES;
+    assert_int(nordi_filter_apply(filter, &query, result), ==, 2);
+    assert_int(nordi_filter_next(filter, result, 1), ==, 3);
+    // groups by region and by feature
+    query = (nordi_filter_query_t){.groups = 1u << EUROPE};
+    assert_int(nordi_filter_apply(filter, &query, result), ==, 4);
+    query.groups = (1u << ASIA_PACIFIC) | (1u << THE_AMERICAS);
+    assert_int(nordi_filter_apply(filter, &query, result), ==, 2);
+    query.groups = 1u << ONION_OVER_VPN;
+    assert_int(nordi_filter_apply(filter, &query, result), ==, 1);
+    assert_int(nordi_filter_next(filter, result, 0), ==, 4);
+    // nothing asked, everything matches
+    query = (nordi_filter_query_t){};
+    assert_int(nordi_filter_apply(filter, &query, result), ==, 6);
+    query.features = FEATURE_DEDICATED_IP;
+    assert_int(nordi_filter_apply(filter, &query, result), ==, 0);
+    assert_int(nordi_filter_next(filter, result, 0), ==, -1);
+    nordi_filter_free(filter);
+}
+
+TEST(test_nordi_filter_least_loaded) {
+    nordi_catalog_server_t servers[130];
+    for (int index = 0; index < 130; index++) {
+        char name[CATALOG_MAX_SERVER];
+        snprintf(name, CATALOG_MAX_SERVER, "de%d", index);
+        servers[index] = server_of(name, GERMANY, (uint8_t)(100 - index % 100), FEATURE_STANDARD, NORDLYNX);
+    }
+    // spanning three words, the last one partial
+    nordi_filter_ptr filter = nordi_filter_new(servers, 130);
+    uint64_t result[3];
+    nordi_filter_query_t query = {.countries = 1ull << GERMANY};
+    assert_int(nordi_filter_apply(filter, &query, result), ==, 130);
+    int least[3];
+    assert_int(nordi_filter_least_loaded(filter, result, least, 3), ==, 3); // call
+    assert_int(filter->loads[least[0]], ==, 1);
+    assert_int(filter->loads[least[1]], ==, 2);
+    assert_int(filter->loads[least[2]], ==, 3);
+    assert_int(nordi_filter_next(filter, result, 129), ==, 129);
+    assert_int(nordi_filter_next(filter, result, 130), ==, -1);
+    nordi_filter_free(filter);
+}
+
+TEST(test_nordi_filter_bench) {
+    nordi_catalog_server_t* servers = (nordi_catalog_server_t*)malloc(BENCH_SERVERS * sizeof(nordi_catalog_server_t));
+    for (int index = 0; index < BENCH_SERVERS; index++) {
+        servers[index] = server_of("xx", munit_rand_int_range(0, COUNTRY_COUNT - 1), 0, munit_rand_uint32() & 0x3f,
+                                   (uint8_t)(munit_rand_uint32() & 0xe));
+    }
+    nordi_filter_ptr filter = nordi_filter_new(servers, BENCH_SERVERS);
+    uint64_t* result = (uint64_t*)malloc(filter->words * sizeof(uint64_t));
+    nordi_filter_query_t* queries = (nordi_filter_query_t*)malloc(BENCH_QUERIES * sizeof(nordi_filter_query_t));
+    for (int query = 0; query < BENCH_QUERIES; query++) {
+        queries[query] = (nordi_filter_query_t){
+            .features = munit_rand_uint32() & 0x3,
+            .technologies = munit_rand_uint32() & 0x2,
+            .countries = ((uint64_t)munit_rand_uint32() << 32 | munit_rand_uint32()) & ((1ull << COUNTRY_COUNT) - 1),
+        };
+    }
+    long long matches = 0, expected = 0;
+    clock_t start = clock();
+    for (int query = 0; query < BENCH_QUERIES; query++) {
+        matches += nordi_filter_apply(filter, &queries[query], result); // call
+    }
+    clock_t bitmap_ticks = clock() - start;
+    start = clock();
+    for (int query = 0; query < BENCH_QUERIES; query++) {
+        for (int server = 0; server < BENCH_SERVERS; server++) {
+            expected += scan_matches(&servers[server], &queries[query]);
+        }
+    }
+    clock_t scan_ticks = clock() - start;
+    // only logged, a loaded machine can slow either loop down
+    munit_logf(MUNIT_LOG_INFO, "%d servers: bitmaps %.1f us, scan %.1f us per filter", BENCH_SERVERS,
+               bitmap_ticks * 1e6 / CLOCKS_PER_SEC / BENCH_QUERIES, scan_ticks * 1e6 / CLOCKS_PER_SEC / BENCH_QUERIES);
+    assert_llong(matches, ==, expected);
+    free(queries);
+    free(result);
+    nordi_filter_free(filter);
+    free(servers);
+}
+
+TESTS(filter_tests) = {
+    TESTRUN("/apply-ok", test_nordi_filter_apply),
+    TESTRUN("/least-loaded-ok", test_nordi_filter_least_loaded),
+    TESTRUN("/bench-ok", test_nordi_filter_bench),
+    TESTEND,
+};
@@ -0,0 +1,7 @@
+#ifndef NORDI_FILTER_UNITTEST_H_
+#define NORDI_FILTER_UNITTEST_H_
+
+#include "../src/nordi_filter.c"
+#include "nordi_unittest.h"
+
+#endif /* NORDI_FILTER_UNITTEST_H_ */
@@ -0,0 +1,135 @@
+#include "nordi_geo_unittest.h"
+#include <stdio.h>
+#include <time.h>
+
+#define BENCH_SERVERS 10000
+#define BENCH_QUERIES 2000
+#define NEAREST       5
+
+static nordi_catalog_server_t
+server_at(const char* name, double latitude, double longitude) {
+    nordi_catalog_server_t server = {.country = -1, .latitude_e6 = (int32_t)(latitude * 1e6), .longitude_e6 = (int32_t)(longitude * 1e6)};
+    snprintf(server.name, CATALOG_MAX_SERVER, "%s", name);
+    return server;
+}
+
+static nordi_catalog_server_t*
+random_servers(int count) {
+    nordi_catalog_server_t* servers = (nordi_catalog_server_t*)malloc(count * sizeof(nordi_catalog_server_t));
+    for (int index = 0; index < count; index++) {
+        char name[CATALOG_MAX_SERVER];
+        snprintf(name, CATALOG_MAX_SERVER, "xx%d", index);
+        servers[index] = server_at(name, munit_rand_double() * 180 - 90, munit_rand_double() * 360 - 180);
+    }
+    return servers;
+}
+
+// The reference: every server's distance, keeping the nearest in order
+static int
+scan_nearest(const nordi_catalog_server_t* servers, int count, double latitude, double longitude, nordi_geo_result_ptr results,
+             int max) {
+    int size = 0;
+    for (int index = 0; index < count; index++) {
+        double distance = nordi_geo_distance_km(latitude, longitude, servers[index].latitude_e6 * MICRO, servers[index].longitude_e6 * MICRO);
+        if (size == max && distance >= results[size - 1].distance_km) {
+            continue;
+        }
+        int position = size < max ? size++ : max - 1;
+        for (; position > 0 && results[position - 1].distance_km > distance; position--) {
+            results[position] = results[position - 1];
+        }
+        results[position] = (nordi_geo_result_t){.name = servers[index].name, .distance_km = distance};
+    }
+    return size;
+}
+
+TEARDOWN(tear_down_test) {}
+
+TEST(test_nordi_geo_distance) {
+    // Berlin to Paris
+    assert_double_equal(nordi_geo_distance_km(52.52, 13.405, 48.8566, 2.3522), 877.5, 0); // call
+    assert_double_equal(nordi_geo_distance_km(10, 20, 10, 20), 0, 6);
+    // half way around, either way
+    assert_double_equal(nordi_geo_distance_km(0, 0, 0, 180), GEO_EARTH_RADIUS_KM * 3.14159265358979323846, 3);
+}
+
+TEST(test_nordi_geo_nearest) {
+    nordi_catalog_server_t servers[] = {
+        server_at("de1", 52.52, 13.405),    server_at("fr1", 48.8566, 2.3522),  server_at("us1", 40.7128, -74.006),
+        server_at("nz1", -36.8485, 174.7633), server_at("fj1", -17.7134, 178.065), server_at("jp1", 35.6762, 139.6503),
+    };
+    nordi_geo_ptr geo = nordi_geo_new(servers, 6);
+    assert_not_null(geo);
+    nordi_geo_result_t results[3];
+    // from Amsterdam
+    assert_int(nordi_geo_nearest(geo, 52.3676, 4.9041, results, 3), ==, 3); // call
+    assert_string_equal(results[0].name, "fr1");
+    assert_string_equal(results[1].name, "de1");
+    assert_string_equal(results[2].name, "us1");
+    assert_double(results[0].distance_km, <, results[1].distance_km);
+    // across the antimeridian, Samoa is nearer Fiji than anything east of it
+    assert_int(nordi_geo_nearest(geo, -13.759, -172.1046, results, 1), ==, 1);
+    assert_string_equal(results[0].name, "fj1");
+    assert_int(nordi_geo_nearest(geo, 0, 0, results, 0), ==, 0);
+    nordi_geo_free(geo);
+    geo = nordi_geo_new(NULL, 0);
+    assert_int(nordi_geo_nearest(geo, 0, 0, results, 3), ==, 0);
+    nordi_geo_free(geo);
+}
+
+TEST(test_nordi_geo_parse_location) {
+    double latitude = 0, longitude = 0;
+    assert_true(nordi_geo_parse_location("38.7223,-9.1393", &latitude, &longitude)); // call
+    assert_double_equal(latitude, 38.7223, 6);
+    assert_double_equal(longitude, -9.1393, 6);
+    assert_true(nordi_geo_parse_location(" -33.9 , 18.4", &latitude, &longitude));
+    assert_double_equal(latitude, -33.9, 6);
+    assert_false(nordi_geo_parse_location("91,0", &latitude, &longitude));
+    assert_false(nordi_geo_parse_location("10", &latitude, &longitude));
+    assert_false(nordi_geo_parse_location("10,abc", &latitude, &longitude));
+    assert_false(nordi_geo_parse_location(".,1", &latitude, &longitude));
+    assert_false(nordi_geo_parse_location(NULL, &latitude, &longitude));
+}
+
+TEST(test_nordi_geo_bench) {
+    nordi_catalog_server_t* servers = random_servers(BENCH_SERVERS);
+    nordi_geo_ptr geo = nordi_geo_new(servers, BENCH_SERVERS);
+    double* queries = (double*)malloc(2 * BENCH_QUERIES * sizeof(double));
+    for (int query = 0; query < BENCH_QUERIES; query++) {
+        queries[2 * query] = munit_rand_double() * 180 - 90;
+        queries[2 * query + 1] = munit_rand_double() * 360 - 180;
+    }
+    nordi_geo_result_t found[NEAREST], expected[NEAREST];
+    clock_t start = clock();
+    for (int query = 0; query < BENCH_QUERIES; query++) {
+        nordi_geo_nearest(geo, queries[2 * query], queries[2 * query + 1], found, NEAREST); // call
+    }
+    clock_t tree_ticks = clock() - start;
+    start = clock();
+    for (int query = 0; query < BENCH_QUERIES; query++) {
+        scan_nearest(servers, BENCH_SERVERS, queries[2 * query], queries[2 * query + 1], expected, NEAREST);
+    }
+    clock_t scan_ticks = clock() - start;
+    // only logged, a loaded machine can slow either loop down
+    munit_logf(MUNIT_LOG_INFO, "%d nearest of %d servers: tree %.1f us, scan %.1f us per query", NEAREST, BENCH_SERVERS,
+               tree_ticks * 1e6 / CLOCKS_PER_SEC / BENCH_QUERIES, scan_ticks * 1e6 / CLOCKS_PER_SEC / BENCH_QUERIES);
+    // the same servers, distances tying aside
+    for (int query = 0; query < BENCH_QUERIES; query++) {
+        assert_int(nordi_geo_nearest(geo, queries[2 * query], queries[2 * query + 1], found, NEAREST), ==, NEAREST);
+        scan_nearest(servers, BENCH_SERVERS, queries[2 * query], queries[2 * query + 1], expected, NEAREST);
+        for (int rank = 0; rank < NEAREST; rank++) {
+            assert_double_equal(found[rank].distance_km, expected[rank].distance_km, 6);
+        }
+    }
+    free(queries);
+    nordi_geo_free(geo);
+    free(servers);
+}
+
+TESTS(geo_tests) = {
+    TESTRUN("/distance-ok", test_nordi_geo_distance),
+    TESTRUN("/nearest-ok", test_nordi_geo_nearest),
+    TESTRUN("/parse-location-ok", test_nordi_geo_parse_location),
+    TESTRUN("/bench-ok", test_nordi_geo_bench),
+    TESTEND,
+};
@@ -0,0 +1,7 @@
+#ifndef NORDI_GEO_UNITTEST_H_
+#define NORDI_GEO_UNITTEST_H_
+
+#include "../src/nordi_geo.c"
+#include "nordi_unittest.h"
+
+#endif /* NORDI_GEO_UNITTEST_H_ */
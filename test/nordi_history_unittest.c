@@ -0,0 +1,231 @@
+#include "nordi_history_unittest.h"
+
+#define TIME         1683720000
+#define MANY_RECORDS 200000
+#define MANY_SERVERS 500
+#define FAST_OPEN_MS 1000
+
+static char journal[HISTORY_MAX_PATH] = {};
+
+static const char*
+make_journal() {
+    char directory[] = "/tmp/nordi-history-XXXXXX";
+    snprintf(journal, HISTORY_MAX_PATH, "%s/history.dat", mkdtemp(directory));
+    return journal;
+}
+
+static off_t
+journal_size() {
+    struct stat info;
+    stat(journal, &info);
+    return info.st_size;
+}
+
+static nordi_history_record_t
+make_record(nordi_history_event_t event, const char* server, uint32_t connect_ms, int32_t error) {
+    nordi_history_record_t record = {.time = TIME, .event = event, .country = -1, .error = error, .connect_ms = connect_ms};
+    snprintf(record.server, HISTORY_MAX_SERVER, "%s", server);
+    return record;
+}
+
+TEARDOWN(tear_down_test) {
+    char aside[HISTORY_MAX_PATH + sizeof(ASIDE_SUFFIX)];
+    snprintf(aside, sizeof(aside), "%s" ASIDE_SUFFIX, journal);
+    unlink(aside);
+    unlink(journal);
+    *strrchr(journal, '/') = '\0';
+    rmdir(journal);
+}
+
+TEST(test_nordi_history_persist) {
+    nordi_history_ptr history = nordi_history_open(make_journal());
+    assert_not_null(history);
+    nordi_history_record_t record = make_record(EVENT_CONNECT, "pt50", 1500, 0);
+    assert_true(nordi_history_append(history, &record)); // call
+    record = make_record(EVENT_DISCONNECT, "pt50", 0, 0);
+    record.session_s = 3600;
+    record.time = 0;
+    assert_true(nordi_history_append(history, &record)); // call
+    nordi_history_close(history);
+    assert_int(journal_size(), ==, sizeof(history_header_t) + 2 * sizeof(nordi_history_record_t));
+    history = nordi_history_open(journal); // call
+    assert_not_null(history);
+    assert_int(history->count, ==, 2);
+    nordi_history_record_ptr first = nordi_history_get(history, 0);
+    assert_not_null(first);
+    assert_int(first->event, ==, EVENT_CONNECT);
+    assert_llong(first->time, ==, TIME);
+    assert_string_equal(first->server, "pt50");
+    nordi_history_record_ptr second = nordi_history_get(history, 1);
+    assert_int(second->event, ==, EVENT_DISCONNECT);
+    assert_llong(second->time, >, TIME);
+    assert_null(nordi_history_get(history, 2));
+    nordi_history_close(history);
+}
+
+TEST(test_nordi_history_get_appended) {
+    nordi_history_ptr history = nordi_history_open(make_journal());
+    nordi_history_record_t record = make_record(EVENT_CONNECT, "de100", 900, 0);
+    nordi_history_append(history, &record);
+    assert_not_null(nordi_history_get(history, 0));
+    record = make_record(EVENT_PAUSE, "de100", 0, 0);
+    nordi_history_append(history, &record);
+    nordi_history_record_ptr paused = nordi_history_get(history, 1); // call, past the mapping
+    assert_not_null(paused);
+    assert_int(paused->event, ==, EVENT_PAUSE);
+    nordi_history_close(history);
+}
+
+TEST(test_nordi_history_server_stats) {
+    nordi_history_ptr history = nordi_history_open(make_journal());
+    // 1 to 100 seconds, then 25 failures
+    for (uint32_t connect_ms = 1000; connect_ms <= 100000; connect_ms += 1000) {
+        nordi_history_record_t record = make_record(EVENT_CONNECT, "us2000", connect_ms, 0);
+        nordi_history_append(history, &record);
+    }
+    for (int failure = 0; failure < 25; failure++) {
+        nordi_history_record_t record = make_record(EVENT_RECONNECT, "us2000", 0, 3);
+        nordi_history_append(history, &record);
+    }
+    nordi_history_record_t record = make_record(EVENT_DISCONNECT, "us2000", 0, 0);
+    record.session_s = 120;
+    nordi_history_append(history, &record);
+    nordi_history_stats_t stats;
+    assert_true(nordi_history_server_stats(history, "us2000", &stats)); // call
+    assert_int(stats.attempts, ==, 125);
+    assert_int(stats.successes, ==, 100);
+    assert_float(stats.success_rate, ==, 0.8f);
+    assert_int(stats.p50_ms, >=, 50000 * 0.88);
+    assert_int(stats.p50_ms, <=, 50000 * 1.12);
+    assert_int(stats.p95_ms, >=, 95000 * 0.88);
+    assert_int(stats.p95_ms, <=, 95000 * 1.12);
+    assert_llong(stats.session_s, ==, 120);
+    assert_false(nordi_history_server_stats(history, "us2001", &stats));
+    assert_int(stats.attempts, ==, 0);
+    nordi_history_close(history);
+}
+
+TEST(test_nordi_history_torn_record) {
+    nordi_history_ptr history = nordi_history_open(make_journal());
+    nordi_history_record_t record = make_record(EVENT_CONNECT, "fr10", 700, 0);
+    nordi_history_append(history, &record);
+    nordi_history_close(history);
+    // half a record, as if the machine died mid write
+    int fd = open(journal, O_WRONLY | O_APPEND);
+    write(fd, &record, sizeof(record) / 2);
+    close(fd);
+    history = nordi_history_open(journal); // call
+    assert_not_null(history);
+    assert_int(history->count, ==, 1);
+    assert_int(journal_size(), ==, sizeof(history_header_t) + sizeof(nordi_history_record_t));
+    nordi_history_append(history, &record);
+    nordi_history_close(history);
+    history = nordi_history_open(journal);
+    assert_int(history->count, ==, 2);
+    assert_string_equal(nordi_history_get(history, 1)->server, "fr10");
+    nordi_history_close(history);
+}
+
+TEST(test_nordi_history_many_records) {
+    make_journal();
+    // written directly, years worth of connects spread over many servers
+    size_t length = sizeof(history_header_t) + MANY_RECORDS * sizeof(nordi_history_record_t);
+    char* content = (char*)calloc(1, length);
+    history_header_t header = {.magic = HISTORY_MAGIC, .version = HISTORY_VERSION, .record_size = sizeof(nordi_history_record_t)};
+    memcpy(content, &header, sizeof(header));
+    nordi_history_record_t* records = (nordi_history_record_t*)(content + sizeof(header));
+    for (int index = 0; index < MANY_RECORDS; index++) {
+        char server[HISTORY_MAX_SERVER];
+        snprintf(server, HISTORY_MAX_SERVER, "se%d", index % MANY_SERVERS);
+        records[index] = make_record(EVENT_CONNECT, server, 1000 + index % 1000, 0);
+    }
+    int fd = open(journal, O_WRONLY | O_CREAT, 0600);
+    write(fd, content, length);
+    close(fd);
+    free(content);
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    nordi_history_ptr history = nordi_history_open(journal); // call
+    nordi_history_stats_t stats;
+    for (int index = 0; index < MANY_SERVERS; index++) {
+        char server[HISTORY_MAX_SERVER];
+        snprintf(server, HISTORY_MAX_SERVER, "se%d", index);
+        assert_true(nordi_history_server_stats(history, server, &stats));
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    long elapsed_ms = (end.tv_sec - start.tv_sec) * 1000 + (end.tv_nsec - start.tv_nsec) / 1000000;
+    assert_int(elapsed_ms, <, FAST_OPEN_MS);
+    assert_int(history->count, ==, MANY_RECORDS);
+    assert_int(history->server_count, ==, MANY_SERVERS);
+    assert_int(stats.attempts, ==, MANY_RECORDS / MANY_SERVERS);
+    nordi_history_close(history);
+}
+
+TEST(test_nordi_history_fail_header) {
+    make_journal();
+    int fd = open(journal, O_WRONLY | O_CREAT, 0600);
+    write(fd, "not a history journal", 21);
+    close(fd);
+    assert_null(nordi_history_open(journal)); // call
+}
+
+TEST(test_nordi_history_migrate) {
+    make_journal();
+    history_header_t header = {.magic = HISTORY_MAGIC, .version = 1, .record_size = sizeof(history_record_v1_t)};
+    history_record_v1_t records[] = {
+        {.time = TIME, .event = EVENT_CONNECT, .country = -1, .connect_ms = 1500, .server = "pt50"},
+        {.time = TIME + 60, .event = EVENT_DISCONNECT, .country = -1, .session_s = 60, .server = "pt50"},
+    };
+    int fd = open(journal, O_WRONLY | O_CREAT, 0600);
+    write(fd, &header, sizeof(header));
+    write(fd, records, sizeof(records));
+    write(fd, records, sizeof(records[0]) / 2); // torn
+    close(fd);
+    nordi_history_ptr history = nordi_history_open(journal); // call
+    assert_not_null(history);
+    assert_int(history->count, ==, 2);
+    assert_llong(journal_size(), ==, sizeof(history_header_t) + 2 * sizeof(nordi_history_record_t));
+    nordi_history_record_ptr migrated = nordi_history_get(history, 1);
+    assert_llong(migrated->time, ==, TIME + 60);
+    assert_int(migrated->session_s, ==, 60);
+    assert_int(migrated->rtt_ms, ==, 0);
+    assert_string_equal(migrated->server, "pt50");
+    nordi_history_stats_t stats;
+    assert_true(nordi_history_server_stats(history, "pt50", &stats));
+    assert_int(stats.successes, ==, 1);
+    assert_int(stats.session_s, ==, 60);
+    nordi_history_close(history);
+}
+
+TEST(test_nordi_history_unknown_version) {
+    make_journal();
+    history_header_t header = {.magic = HISTORY_MAGIC, .version = HISTORY_VERSION + 1, .record_size = 1};
+    int fd = open(journal, O_WRONLY | O_CREAT, 0600);
+    write(fd, &header, sizeof(header));
+    close(fd);
+    nordi_history_ptr history = nordi_history_open(journal); // call
+    assert_not_null(history);
+    assert_int(history->count, ==, 0);
+    nordi_history_close(history);
+    char aside[HISTORY_MAX_PATH + sizeof(ASIDE_SUFFIX)];
+    snprintf(aside, sizeof(aside), "%s" ASIDE_SUFFIX, journal);
+    assert_int(access(aside, F_OK), ==, 0);
+}
+
+TEST(test_nordi_history_fail_open) {
+    assert_null(nordi_history_open("/nonexistent/nordi/history.dat")); // call
+    snprintf(journal, HISTORY_MAX_PATH, "/tmp/nordi-none/none");
+}
+
+TESTS(history_tests) = {
+    TESTRUN("/persist-ok", test_nordi_history_persist),
+    TESTRUN("/get-ok-appended", test_nordi_history_get_appended),
+    TESTRUN("/stats-ok", test_nordi_history_server_stats),
+    TESTRUN("/load-ok-torn", test_nordi_history_torn_record),
+    TESTRUN("/load-ok-many", test_nordi_history_many_records),
+    TESTRUN("/open-fail-header", test_nordi_history_fail_header),
+    TESTRUN("/open-ok-migrated", test_nordi_history_migrate),
+    TESTRUN("/open-ok-unknown-version", test_nordi_history_unknown_version),
+    TESTRUN("/open-fail-path", test_nordi_history_fail_open),
+    TESTEND,
+};
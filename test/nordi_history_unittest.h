@@ -0,0 +1,7 @@
+#ifndef NORDI_HISTORY_UNITTEST_H_
+#define NORDI_HISTORY_UNITTEST_H_
+
+#include "../src/nordi_history.c"
+#include "nordi_unittest.h"
+
+#endif /* NORDI_HISTORY_UNITTEST_H_ */
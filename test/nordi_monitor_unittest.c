@@ -0,0 +1,159 @@
+#include "nordi_monitor_unittest.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <sys/time.h>
+
+#define LOCALHOST     "127.0.0.1"
+#define MAX_TARGET    32
+#define ECHO_POLL_US  5000
+#define ECHO_DELAY_US 2000
+#define SLOW_DELAY_US 12000
+#define INTERVAL_MS   10
+#define TIMEOUT_MS    40
+#define RUN_MS        250
+
+// local echo server standing in for the DNS target, replies can be delayed or dropped by query ID
+typedef struct {
+    int socket;
+    thrd_t thread;
+    atomic_bool is_running;
+    int delay_us;      // delay of even IDs
+    int odd_delay_us;  // delay of odd IDs
+    bool is_dropping;  // drop odd IDs instead
+    char target[MAX_TARGET];
+} echo_t;
+
+static echo_t echo = {};
+
+static int
+echo_worker(echo_t* server) {
+    struct timeval poll = {.tv_usec = ECHO_POLL_US};
+    setsockopt(server->socket, SOL_SOCKET, SO_RCVTIMEO, &poll, sizeof(poll));
+    while (server->is_running) {
+        unsigned char buffer[64];
+        struct sockaddr_storage peer;
+        socklen_t length = sizeof(peer);
+        ssize_t received = recvfrom(server->socket, buffer, sizeof(buffer), 0, (struct sockaddr*)&peer, &length);
+        if (received < 2) {
+            continue;
+        }
+        bool is_odd = buffer[1] & 1;
+        if (is_odd && server->is_dropping) {
+            continue;
+        }
+        int delay_us = is_odd ? server->odd_delay_us : server->delay_us;
+        thrd_sleep(&(struct timespec){.tv_nsec = delay_us * 1000L}, NULL);
+        sendto(server->socket, buffer, received, 0, (struct sockaddr*)&peer, length);
+    }
+    return thrd_success;
+}
+
+static str
+start_echo(int delay_us, int odd_delay_us, bool is_dropping) {
+    echo.socket = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    struct sockaddr_in address = {.sin_family = AF_INET};
+    inet_pton(AF_INET, LOCALHOST, &address.sin_addr);
+    bind(echo.socket, (struct sockaddr*)&address, sizeof(address));
+    socklen_t length = sizeof(address);
+    getsockname(echo.socket, (struct sockaddr*)&address, &length);
+    snprintf(echo.target, MAX_TARGET, LOCALHOST ":%d", ntohs(address.sin_port));
+    echo.delay_us = delay_us;
+    echo.odd_delay_us = odd_delay_us;
+    echo.is_dropping = is_dropping;
+    echo.is_running = true;
+    thrd_create(&echo.thread, (int (*)(void*))echo_worker, &echo);
+    return str_ref(echo.target);
+}
+
+static void
+run_monitor(nordi_monitor_ptr monitor, nordi_monitor_stats_ptr stats) {
+    thrd_sleep(&(struct timespec){.tv_nsec = RUN_MS * 1000000L}, NULL);
+    nordi_monitor_stats(monitor, stats);
+    nordi_monitor_free(monitor);
+}
+
+TEARDOWN(tear_down_test) {
+    if (echo.is_running) {
+        echo.is_running = false;
+        thrd_join(echo.thread, NULL);
+        close(echo.socket);
+    }
+    memset(&echo, 0, sizeof(echo_t));
+}
+
+TEST(test_nordi_monitor_rtt) {
+    nordi_monitor_ptr monitor = nordi_monitor_new(start_echo(ECHO_DELAY_US, ECHO_DELAY_US, false), INTERVAL_MS, TIMEOUT_MS); // call
+    assert_not_null(monitor);
+    nordi_monitor_stats_t stats;
+    run_monitor(monitor, &stats);
+    assert_int(stats.samples, >=, RUN_MS / INTERVAL_MS / 2);
+    assert_int(stats.lost, ==, 0);
+    assert_float(stats.loss, ==, 0.0f);
+    assert_int(stats.p50_us, >=, ECHO_DELAY_US);
+    assert_int(stats.p95_us, >=, stats.p50_us);
+    assert_int(stats.p95_us, <, TIMEOUT_MS * 1000);
+}
+
+TEST(test_nordi_monitor_jitter) {
+    nordi_monitor_ptr monitor = nordi_monitor_new(start_echo(ECHO_DELAY_US, SLOW_DELAY_US, false), INTERVAL_MS * 2, TIMEOUT_MS); // call
+    nordi_monitor_stats_t stats;
+    run_monitor(monitor, &stats);
+    assert_int(stats.samples, >=, 4);
+    // every answer alternates between the fast and slow delays
+    assert_int(stats.jitter_us, >=, (SLOW_DELAY_US - ECHO_DELAY_US) / 2);
+    assert_int(stats.p95_us, >=, SLOW_DELAY_US);
+}
+
+TEST(test_nordi_monitor_loss) {
+    nordi_monitor_ptr monitor = nordi_monitor_new(start_echo(0, 0, true), INTERVAL_MS, TIMEOUT_MS); // call
+    nordi_monitor_stats_t stats;
+    run_monitor(monitor, &stats);
+    assert_int(stats.lost, >, 0);
+    assert_float(stats.loss, >, 25.0f);
+    assert_float(stats.loss, <, 75.0f);
+}
+
+TEST(test_nordi_monitor_ring) {
+    nordi_monitor_ptr monitor = nordi_monitor_new(start_echo(0, 0, false), 1, TIMEOUT_MS); // call
+    nordi_monitor_stats_t stats;
+    run_monitor(monitor, &stats);
+    assert_int(stats.samples + stats.lost, <=, MONITOR_RING_SIZE);
+    assert_int(stats.samples, >, MONITOR_RING_SIZE / 2);
+}
+
+TEST(test_nordi_monitor_pace) {
+    nordi_monitor_ptr monitor = nordi_monitor_new(start_echo(0, 0, false), INTERVAL_MS, TIMEOUT_MS);
+    thrd_sleep(&(struct timespec){.tv_nsec = RUN_MS * 1000000L}, NULL);
+    assert_uint(monitor->wakeups, >, 0);
+    nordi_monitor_pace(monitor, 0); // call
+    thrd_sleep(&(struct timespec){.tv_nsec = TIMEOUT_MS * 1000000L}, NULL);
+    unsigned int wakeups = monitor->wakeups;
+    nordi_monitor_stats_t stats;
+    nordi_monitor_stats(monitor, &stats);
+    thrd_sleep(&(struct timespec){.tv_nsec = RUN_MS * 1000000L}, NULL);
+    assert_uint(monitor->wakeups, ==, wakeups);
+    nordi_monitor_stats_t paused;
+    nordi_monitor_stats(monitor, &paused);
+    assert_int(paused.samples + paused.lost, ==, stats.samples + stats.lost);
+    nordi_monitor_pace(monitor, INTERVAL_MS); // call
+    run_monitor(monitor, &stats);
+    assert_int(stats.samples, >, paused.samples);
+}
+
+TEST(test_nordi_monitor_fail_target) {
+    assert_null(nordi_monitor_new(str_lit("unknown.invalid:53"), INTERVAL_MS, TIMEOUT_MS)); // call
+    nordi_monitor_stats_t stats = {.samples = 1};
+    nordi_monitor_stats(NULL, &stats); // call
+    assert_int(stats.samples, ==, 0);
+}
+
+TESTS(monitor_tests) = {
+    TESTRUN("/rtt-ok", test_nordi_monitor_rtt),
+    TESTRUN("/jitter-ok", test_nordi_monitor_jitter),
+    TESTRUN("/loss-ok", test_nordi_monitor_loss),
+    TESTRUN("/ring-bounded", test_nordi_monitor_ring),
+    TESTRUN("/pace-ok", test_nordi_monitor_pace),
+    TESTRUN("/target-fail-unknown", test_nordi_monitor_fail_target),
+    TESTEND,
+};
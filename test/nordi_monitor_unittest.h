@@ -0,0 +1,7 @@
+#ifndef NORDI_MONITOR_UNITTEST_H_
+#define NORDI_MONITOR_UNITTEST_H_
+
+#include "../src/nordi_monitor.c"
+#include "nordi_unittest.h"
+
+#endif /* NORDI_MONITOR_UNITTEST_H_ */
@@ -0,0 +1,258 @@
+#include "nordi_probe_unittest.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdatomic.h>
+#include <sys/eventfd.h>
+#include <sys/time.h>
+#include <threads.h>
+
+#define LOCALHOST      "127.0.0.1"
+#define MAX_LISTENERS  4
+#define MAX_TARGET     32
+#define TEST_TIMEOUT   150
+#define ECHO_POLL_US   5000
+#define SLOW_DELAY_US  40000
+#define FAST_DELAY_US  2000
+#define MIDDLE_DELAY_US 15000
+#define LONG_TIMEOUT   2000
+
+// local UDP echo server, answering each datagram after a delay
+typedef struct {
+    int socket;
+    int port;
+    int delay_us; // negative to never answer
+    thrd_t thread;
+    atomic_bool is_running;
+} listener_t;
+
+static listener_t listeners[MAX_LISTENERS] = {};
+static int listener_count = 0;
+static char targets[MAX_LISTENERS][MAX_TARGET] = {};
+
+static int
+open_socket(int type, bool is_listening) {
+    int fd = socket(AF_INET, type | SOCK_CLOEXEC, 0);
+    struct sockaddr_in address = {.sin_family = AF_INET, .sin_port = 0};
+    inet_pton(AF_INET, LOCALHOST, &address.sin_addr);
+    bind(fd, (struct sockaddr*)&address, sizeof(address));
+    if (is_listening) {
+        listen(fd, MAX_LISTENERS);
+    }
+    return fd;
+}
+
+static int
+socket_port(int fd) {
+    struct sockaddr_in address = {};
+    socklen_t length = sizeof(address);
+    getsockname(fd, (struct sockaddr*)&address, &length);
+    return ntohs(address.sin_port);
+}
+
+static int
+echo_worker(listener_t* listener) {
+    struct timeval poll = {.tv_usec = ECHO_POLL_US};
+    setsockopt(listener->socket, SOL_SOCKET, SO_RCVTIMEO, &poll, sizeof(poll));
+    while (listener->is_running) {
+        char buffer[64];
+        struct sockaddr_storage peer;
+        socklen_t length = sizeof(peer);
+        ssize_t received = recvfrom(listener->socket, buffer, sizeof(buffer), 0, (struct sockaddr*)&peer, &length);
+        if (received < 0 || listener->delay_us < 0) {
+            continue;
+        }
+        thrd_sleep(&(struct timespec){.tv_nsec = listener->delay_us * 1000L}, NULL);
+        sendto(listener->socket, buffer, received, 0, (struct sockaddr*)&peer, length);
+    }
+    return thrd_success;
+}
+
+// Start a listener and return its "127.0.0.1:port" target. UDP listeners echo after delay_us.
+static const char*
+start_listener(int type, int delay_us) {
+    listener_t* listener = &listeners[listener_count];
+    listener->socket = open_socket(type, type == SOCK_STREAM);
+    listener->port = socket_port(listener->socket);
+    listener->delay_us = delay_us;
+    listener->is_running = type == SOCK_DGRAM;
+    if (listener->is_running) {
+        thrd_create(&listener->thread, (int (*)(void*))echo_worker, listener);
+    }
+    snprintf(targets[listener_count], MAX_TARGET, LOCALHOST ":%d", listener->port);
+    return targets[listener_count++];
+}
+
+// A TCP port nobody listens on, kept bound so no one else takes it
+static const char*
+closed_port() {
+    listener_t* listener = &listeners[listener_count];
+    listener->socket = open_socket(SOCK_STREAM, false);
+    snprintf(targets[listener_count], MAX_TARGET, LOCALHOST ":%d", socket_port(listener->socket));
+    return targets[listener_count++];
+}
+
+static long long
+elapsed_us(long long start) {
+    return now_us() - start;
+}
+
+TEARDOWN(tear_down_test) {
+    for (int index = 0; index < listener_count; index++) {
+        if (listeners[index].is_running) {
+            listeners[index].is_running = false;
+            thrd_join(listeners[index].thread, NULL);
+        }
+        close(listeners[index].socket);
+    }
+    memset(listeners, 0, sizeof(listeners));
+    listener_count = 0;
+    memset(fake_nordvpn(), 0, sizeof(fake_nordvpn_t));
+    nordvpn_close();
+}
+
+TEST(test_nordi_probe_tcp) {
+    nordi_probe_result_t results[] = {
+        {.target = str_ref(closed_port())},
+        {.target = str_ref(start_listener(SOCK_STREAM, 0))},
+        {.target = str_lit("unknown.invalid")},
+    };
+    nordi_probe_options_t options = {.mode = PROBE_TCP, .concurrency = 4, .timeout_ms = TEST_TIMEOUT};
+    int answered = nordi_probe_run(results, 3, &options); // call
+    assert_int(answered, ==, 1);
+    assert_string_equal(str_ptr(results[0].target), targets[1]);
+    assert_int(results[0].state, ==, PROBE_OK);
+    assert_int(results[1].state, !=, PROBE_OK);
+    assert_int(results[2].state, !=, PROBE_OK);
+    // sort keeps the failures in their order
+    assert_int(results[1].state, ==, PROBE_REFUSED);
+    assert_int(results[2].state, ==, PROBE_UNREACHABLE);
+}
+
+TEST(test_nordi_probe_udp_rank) {
+    nordi_probe_result_t results[] = {
+        {.target = str_ref(start_listener(SOCK_DGRAM, SLOW_DELAY_US))},
+        {.target = str_ref(start_listener(SOCK_DGRAM, -1))},
+        {.target = str_ref(start_listener(SOCK_DGRAM, FAST_DELAY_US))},
+        {.target = str_ref(start_listener(SOCK_DGRAM, MIDDLE_DELAY_US))},
+    };
+    nordi_probe_options_t options = {.mode = PROBE_UDP, .concurrency = 4, .timeout_ms = TEST_TIMEOUT};
+    int answered = nordi_probe_run(results, 4, &options); // call
+    assert_int(answered, ==, 3);
+    assert_string_equal(str_ptr(results[0].target), targets[2]);
+    assert_string_equal(str_ptr(results[1].target), targets[3]);
+    assert_string_equal(str_ptr(results[2].target), targets[0]);
+    assert_string_equal(str_ptr(results[3].target), targets[1]);
+    assert_int(results[0].rtt_us, >=, FAST_DELAY_US);
+    assert_int(results[2].rtt_us, >=, SLOW_DELAY_US);
+    assert_int(results[3].state, ==, PROBE_TIMEOUT);
+}
+
+TEST(test_nordi_probe_concurrency) {
+    nordi_probe_result_t results[] = {
+        {.target = str_ref(start_listener(SOCK_DGRAM, MIDDLE_DELAY_US))},
+        {.target = str_ref(start_listener(SOCK_DGRAM, MIDDLE_DELAY_US))},
+        {.target = str_ref(start_listener(SOCK_DGRAM, MIDDLE_DELAY_US))},
+    };
+    nordi_probe_options_t options = {.mode = PROBE_UDP, .concurrency = 1, .timeout_ms = TEST_TIMEOUT};
+    long long start = now_us();
+    assert_int(nordi_probe_run(results, 3, &options), ==, 3); // call
+    assert_llong(elapsed_us(start), >=, 3 * MIDDLE_DELAY_US);
+    options.concurrency = 3;
+    start = now_us();
+    assert_int(nordi_probe_run(results, 3, &options), ==, 3); // call
+    assert_llong(elapsed_us(start), <, 3 * MIDDLE_DELAY_US);
+}
+
+static int
+cancel_later(int* cancel) {
+    thrd_sleep(&(struct timespec){.tv_nsec = MIDDLE_DELAY_US * 1000L}, NULL);
+    uint64_t signal = 1;
+    write(*cancel, &signal, sizeof(signal));
+    return thrd_success;
+}
+
+TEST(test_nordi_probe_cancel) {
+    nordi_probe_result_t results[] = {
+        {.target = str_ref(start_listener(SOCK_DGRAM, FAST_DELAY_US))},
+        {.target = str_ref(start_listener(SOCK_DGRAM, -1))},
+    };
+    nordi_probe_options_t options = {.mode = PROBE_UDP, .concurrency = 2, .timeout_ms = LONG_TIMEOUT};
+    int cancel = eventfd(0, EFD_CLOEXEC);
+    thrd_t canceller;
+    thrd_create(&canceller, (int (*)(void*))cancel_later, &cancel);
+    long long start = now_us();
+    assert_int(nordi_probe_run_cancellable(results, 2, &options, cancel), ==, -1); // call
+    assert_llong(elapsed_us(start), <, LONG_TIMEOUT * 1000 / 2);
+    thrd_join(canceller, NULL);
+    // what answered before the cancel is kept
+    assert_int(results[0].state, ==, PROBE_OK);
+    assert_int(results[1].state, ==, PROBE_PENDING);
+    // already cancelled, nothing even resolves
+    assert_int(nordi_probe_run_cancellable(results, 2, &options, cancel), ==, -1); // call
+    assert_int(results[0].state, ==, PROBE_PENDING);
+    close(cancel);
+}
+
+TEST(test_nordi_probe_server) {
+    nordi_probe_result_t results[] = {
+        {.target = str_lit("de123.nordvpn.com:443")},
+        {.target = str_lit("pt7.nordvpn.com")},
+        {.target = str_lit("10.0.0.1:1194")},
+        {.target = str_lit("[2001:db8::1]:443")},
+        {.target = str_lit("2001:db8::1")},
+    };
+    for (int index = 0; index < 5; index++) {
+        str server = nordi_probe_server(&results[index]); // call
+        const char* expected[] = {"de123", "pt7", "10.0.0.1", "2001:db8::1", "2001:db8::1"};
+        assert_string_equal(str_ptr(server), expected[index]);
+        str_free(server);
+    }
+}
+
+TEST(test_nordi_probe_resolve_ipv6) {
+    const char* targets[] = {"[::1]:1194", "::1"};
+    const int ports[] = {1194, PROBE_DEFAULT_PORT};
+    for (int index = 0; index < 2; index++) {
+        struct addrinfo* address = nordi_probe_resolve(str_ref(targets[index]), PROBE_UDP, PROBE_DEFAULT_PORT); // call
+        assert_not_null(address);
+        assert_int(address->ai_family, ==, AF_INET6);
+        assert_int(ntohs(((struct sockaddr_in6*)address->ai_addr)->sin6_port), ==, ports[index]);
+        freeaddrinfo(address);
+    }
+    assert_null(nordi_probe_resolve(str_lit("[::1"), PROBE_UDP, PROBE_DEFAULT_PORT)); // call
+    assert_null(nordi_probe_resolve(str_lit("[::1]443"), PROBE_UDP, PROBE_DEFAULT_PORT)); // call
+}
+
+TEST(test_nordi_probe_connect_best) {
+    fake_nordvpn()->is_enabled = true;
+    nordvpn_get_session()->is_active = true;
+    nordi_probe_result_t results[] = {
+        {.target = str_ref(start_listener(SOCK_DGRAM, MIDDLE_DELAY_US))},
+        {.target = str_ref(start_listener(SOCK_DGRAM, FAST_DELAY_US))},
+    };
+    nordi_probe_options_t options = {.mode = PROBE_UDP, .concurrency = 2, .timeout_ms = TEST_TIMEOUT};
+    assert_int(nordi_probe_connect_best(results, 2, &options), ==, OK); // call
+    assert_true(fake_nordvpn()->is_online);
+    assert_string_equal(fake_nordvpn()->server, LOCALHOST);
+}
+
+TEST(test_nordi_probe_connect_none) {
+    fake_nordvpn()->is_enabled = true;
+    nordvpn_get_session()->is_active = true;
+    nordi_probe_result_t results[] = {{.target = str_ref(closed_port())}};
+    nordi_probe_options_t options = {.mode = PROBE_TCP, .concurrency = 1, .timeout_ms = TEST_TIMEOUT};
+    assert_int(nordi_probe_connect_best(results, 1, &options), ==, NOT_FOUND); // call
+    assert_int(fake_nordvpn()->spawns, ==, 0);
+}
+
+TESTS(probe_tests) = {
+    TESTRUN("/tcp-ok", test_nordi_probe_tcp),
+    TESTRUN("/udp-rank-ok", test_nordi_probe_udp_rank),
+    TESTRUN("/concurrency-ok", test_nordi_probe_concurrency),
+    TESTRUN("/cancel-ok", test_nordi_probe_cancel),
+    TESTRUN("/server-name-ok", test_nordi_probe_server),
+    TESTRUN("/resolve-ipv6-ok", test_nordi_probe_resolve_ipv6),
+    TESTRUN("/connect-best-ok", test_nordi_probe_connect_best),
+    TESTRUN("/connect-best-fail-none", test_nordi_probe_connect_none),
+    TESTEND,
+};
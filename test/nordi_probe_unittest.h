@@ -0,0 +1,8 @@
+#ifndef NORDI_PROBE_UNITTEST_H_
+#define NORDI_PROBE_UNITTEST_H_
+
+#include "../src/nordi_probe.c"
+#include "nordi_unittest.h"
+#include "nordvpn_fake.h"
+
+#endif /* NORDI_PROBE_UNITTEST_H_ */
@@ -0,0 +1,215 @@
+#include "nordi_queue_unittest.h"
+
+#define STRESS_CLICKS   500
+#define STRESS_DELAY_US 200
+#define STRESS_SEED     42
+#define ALLOWLIST_FILE  "/tmp/nordi-allowlist-%d.txt"
+
+typedef struct {
+    unsigned int calls;
+    nordvpn_error_t last_result;
+    int last_tag;
+} callback_log_t;
+
+static callback_log_t callback_log = {};
+
+static void
+log_callback(nordi_command_ptr command, void* context) {
+    callback_log.calls++;
+    callback_log.last_result = command->result;
+    callback_log.last_tag = command->tag;
+}
+
+static void
+start_fake(int delay_us) {
+    fake_nordvpn_t* fake = fake_nordvpn();
+    memset(fake, 0, sizeof(fake_nordvpn_t));
+    fake->is_enabled = true;
+    fake->delay_us = delay_us;
+    nordvpn_get_session()->is_active = true;
+}
+
+// Start a command and keep it in flight until released, however long the pushes racing it take
+static void
+start_held(nordi_queue_ptr queue, nordi_command_type_t type, str server) {
+    fake_nordvpn()->is_held = true;
+    nordi_queue_push(queue, type, server, 0);
+    fake_nordvpn_wait_spawns(fake_nordvpn()->spawns + 1);
+}
+
+static void
+release_held() {
+    fake_nordvpn()->is_held = false;
+}
+
+TEARDOWN(tear_down_test) {
+    memset(fake_nordvpn(), 0, sizeof(fake_nordvpn_t));
+    memset(&callback_log, 0, sizeof(callback_log_t));
+    nordvpn_get_session()->is_cancelled = false;
+    nordvpn_close();
+}
+
+TEST(test_nordi_queue_connect) {
+    start_fake(0);
+    nordi_queue_ptr queue = nordi_queue_new(log_callback, NULL);
+    assert_not_null(queue);
+    nordi_queue_push(queue, COMMAND_CONNECT, str_lit("pt1"), 7); // call
+    nordi_queue_wait(queue);
+    assert_true(fake_nordvpn()->is_online);
+    assert_string_equal(fake_nordvpn()->server, "pt1");
+    assert_true(nordvpn_get_host()->is_online);
+    assert_string_equal(str_ptr(nordvpn_get_host()->last_server), "pt1");
+    assert_int(callback_log.calls, ==, 1);
+    assert_int(callback_log.last_result, ==, OK);
+    assert_int(callback_log.last_tag, ==, 7);
+    nordi_queue_free(queue);
+}
+
+TEST(test_nordi_queue_latest_wins) {
+    start_fake(0);
+    nordi_queue_ptr queue = nordi_queue_new(log_callback, NULL);
+    start_held(queue, COMMAND_CONNECT, str_lit("al1"));
+    nordi_queue_push(queue, COMMAND_CONNECT, str_lit("de1"), 0); // call, cancels al1
+    nordi_queue_push(queue, COMMAND_DISCONNECT, str_null, 0);     // call, supersedes de1
+    nordi_queue_push(queue, COMMAND_CONNECT, str_lit("pl1"), 0); // call, supersedes disconnect
+    release_held();
+    nordi_queue_wait(queue);
+    assert_string_equal(fake_nordvpn()->server, "pl1");
+    assert_true(fake_nordvpn()->is_online);
+    // al1, pl1 and the status read back after the cancel
+    assert_int(fake_nordvpn()->spawns, ==, 3);
+    assert_int(fake_nordvpn()->cancels, ==, 1);
+    assert_int(queue->cancelled, ==, 1);
+    assert_int(queue->superseded, ==, 2);
+    assert_int(queue->executed, ==, 3);
+    assert_int(queue->reconciles, ==, 1);
+    assert_int(queue->reconciled, ==, 0);
+    nordi_queue_free(queue);
+}
+
+TEST(test_nordi_queue_skip_inflight) {
+    start_fake(0);
+    nordi_queue_ptr queue = nordi_queue_new(log_callback, NULL);
+    start_held(queue, COMMAND_CONNECT, str_lit("al1"));
+    nordi_queue_push(queue, COMMAND_CONNECT, str_lit("al1"), 0); // call
+    release_held();
+    nordi_queue_wait(queue);
+    assert_int(fake_nordvpn()->spawns, ==, 1);
+    assert_int(queue->skipped, ==, 1);
+    assert_int(queue->cancelled, ==, 0);
+    nordi_queue_free(queue);
+}
+
+TEST(test_nordi_queue_resume_cancelled) {
+    start_fake(0);
+    nordi_queue_ptr queue = nordi_queue_new(log_callback, NULL);
+    start_held(queue, COMMAND_CONNECT, str_lit("al1"));
+    nordi_queue_push(queue, COMMAND_DISCONNECT, str_null, 0);    // call, cancels al1
+    nordi_queue_push(queue, COMMAND_CONNECT, str_lit("al1"), 0); // call, al1 must run again
+    release_held();
+    nordi_queue_wait(queue);
+    assert_true(fake_nordvpn()->is_online);
+    assert_string_equal(fake_nordvpn()->server, "al1");
+    // both connects and the status read back after the cancel
+    assert_int(fake_nordvpn()->spawns, ==, 3);
+    nordi_queue_free(queue);
+}
+
+TEST(test_nordi_queue_reconcile_late) {
+    start_fake(0);
+    fake_nordvpn()->is_finishing_late = true;
+    nordi_queue_ptr queue = nordi_queue_new(log_callback, NULL);
+    start_held(queue, COMMAND_CONNECT, str_lit("al1"));
+    nordi_queue_push(queue, COMMAND_DISCONNECT, str_null, 0); // call, cancels al1, which the daemon still gets to
+    release_held();
+    nordi_queue_wait(queue);
+    assert_false(fake_nordvpn()->is_online);
+    assert_false(nordvpn_get_host()->is_online);
+    // al1, the disconnect, the status finding al1 connected after all, and the disconnect again
+    assert_int(fake_nordvpn()->spawns, ==, 4);
+    assert_int(queue->reconciles, ==, 1);
+    assert_int(queue->reconciled, ==, 1);
+    assert_int(callback_log.last_result, ==, OK);
+    nordi_queue_free(queue);
+}
+
+TEST(test_nordi_queue_skip_offline) {
+    start_fake(0);
+    nordi_queue_ptr queue = nordi_queue_new(log_callback, NULL);
+    nordi_queue_push(queue, COMMAND_DISCONNECT, str_null, 0); // call
+    nordi_queue_wait(queue);
+    assert_int(fake_nordvpn()->spawns, ==, 0);
+    assert_int(queue->skipped, ==, 1);
+    assert_int(callback_log.calls, ==, 0);
+    nordi_queue_free(queue);
+}
+
+TEST(test_nordi_queue_allowlist_adds_up) {
+    const char* entries[] = {"10.0.0.0/25\n443\n", "10.0.0.128/25\n"};
+    char paths[2][32];
+    for (int file = 0; file < 2; file++) {
+        snprintf(paths[file], sizeof(paths[file]), ALLOWLIST_FILE, file);
+        FILE* stream = fopen(paths[file], "w");
+        fputs(entries[file], stream);
+        fclose(stream);
+    }
+    start_fake(0);
+    nordi_queue_ptr queue = nordi_queue_new(log_callback, NULL);
+    start_held(queue, COMMAND_CONNECT, str_lit("al1"));
+    nordi_queue_push(queue, COMMAND_ALLOWLIST, str_ref(paths[0]), 0);
+    nordi_queue_push(queue, COMMAND_ALLOWLIST, str_ref(paths[1]), 0); // call, taken along the pending import
+    release_held();
+    nordi_queue_wait(queue);
+    assert_int(queue->executed, ==, 2);
+    assert_int(queue->superseded, ==, 0);
+    // both halves aggregate into a single subnet, next to the port
+    assert_int(fake_nordvpn()->allowlist_changes, ==, 2);
+    assert_int(callback_log.last_result, ==, OK);
+    nordi_queue_free(queue);
+    remove(paths[0]);
+    remove(paths[1]);
+}
+
+TEST(test_nordi_queue_stress) {
+    static const str servers[] = {str_lit("al1"), str_lit("de2"), str_lit("pl3"), str_lit("pt4")};
+    const int server_count = sizeof(servers) / sizeof(*servers);
+    start_fake(STRESS_DELAY_US);
+    srand(STRESS_SEED);
+    nordi_queue_ptr queue = nordi_queue_new(NULL, NULL);
+    int last = -1; // last requested server, -1 for disconnected
+    for (int click = 0; click < STRESS_CLICKS; click++) {
+        last = rand() % (server_count + 1) - 1;
+        if (last < 0) {
+            nordi_queue_push(queue, COMMAND_DISCONNECT, str_null, click); // call
+        } else {
+            nordi_queue_push(queue, COMMAND_CONNECT, servers[last], click); // call
+        }
+        thrd_sleep(&(struct timespec){.tv_nsec = (rand() % STRESS_DELAY_US) * 1000}, NULL);
+    }
+    nordi_queue_wait(queue);
+    fake_nordvpn_t* fake = fake_nordvpn();
+    munit_logf(MUNIT_LOG_INFO, "%d clicks: %u spawns, %u cancelled, %u superseded, %u skipped", STRESS_CLICKS, fake->spawns,
+               queue->cancelled, queue->superseded, queue->skipped);
+    assert_int(fake->is_online, ==, last >= 0);
+    assert_int(nordvpn_get_host()->is_online, ==, last >= 0);
+    if (last >= 0) {
+        assert_string_equal(fake->server, str_ptr(servers[last]));
+        assert_string_equal(str_ptr(nordvpn_get_host()->last_server), str_ptr(servers[last]));
+    }
+    assert_int(fake->spawns, <, STRESS_CLICKS);
+    assert_int(queue->executed - queue->reconciles - queue->reconciled + queue->superseded + queue->skipped, ==,
+               STRESS_CLICKS);
+    nordi_queue_free(queue);
+}
+
+TESTS(queue_tests) = {
+    TESTRUN("/connect-ok", test_nordi_queue_connect),
+    TESTRUN("/latest-wins-ok", test_nordi_queue_latest_wins),
+    TESTRUN("/skip-inflight-ok", test_nordi_queue_skip_inflight),
+    TESTRUN("/resume-cancelled-ok", test_nordi_queue_resume_cancelled),
+    TESTRUN("/reconcile-ok-late", test_nordi_queue_reconcile_late),
+    TESTRUN("/skip-offline-ok", test_nordi_queue_skip_offline),
+    TESTRUN("/allowlist-ok-adds-up", test_nordi_queue_allowlist_adds_up),
+    TESTRUN("/stress-random-clicks", test_nordi_queue_stress),
+    TESTEND,
+};
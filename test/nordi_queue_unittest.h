@@ -0,0 +1,8 @@
+#ifndef NORDI_QUEUE_UNITTEST_H_
+#define NORDI_QUEUE_UNITTEST_H_
+
+#include "../src/nordi_queue.c"
+#include "nordi_unittest.h"
+#include "nordvpn_fake.h"
+
+#endif /* NORDI_QUEUE_UNITTEST_H_ */
@@ -0,0 +1,150 @@
+#include "nordi_refresh_unittest.h"
+
+#define START_MS  1000500 // off the grid, as a real clock would be
+#define LATE_MS   7       // a wakeup never comes exactly on time
+
+static nordi_refresh_ptr refresh = NULL;
+static int fast_runs = 0;
+static int slow_runs = 0;
+
+static void
+run_fast(void* context) {
+    fast_runs++;
+}
+
+static void
+run_slow(void* context) {
+    slow_runs++;
+}
+
+// Follow the deadlines until the end, as the main loop would
+static void
+follow(long long now, long long end) {
+    int next = nordi_refresh_next(refresh, now);
+    while (next != REFRESH_NO_DEADLINE && now + next + LATE_MS <= end) {
+        now += next + LATE_MS;
+        next = nordi_refresh_run(refresh, now);
+    }
+}
+
+TEARDOWN(tear_down_test) {
+    nordi_refresh_free(refresh);
+    refresh = NULL;
+    fast_runs = 0;
+    slow_runs = 0;
+}
+
+TEST(test_nordi_refresh_mode) {
+    refresh = nordi_refresh_new();
+    assert_not_null(refresh);
+    assert_int(nordi_refresh_mode(refresh), ==, REFRESH_FOCUSED);
+    nordi_refresh_set_state(refresh, false, true, false, false, START_MS); // call
+    assert_int(nordi_refresh_mode(refresh), ==, REFRESH_BACKGROUND);
+    nordi_refresh_set_state(refresh, false, false, false, false, START_MS); // call
+    assert_int(nordi_refresh_mode(refresh), ==, REFRESH_HIDDEN);
+    nordi_refresh_set_state(refresh, true, true, true, false, START_MS); // call
+    assert_int(nordi_refresh_mode(refresh), ==, REFRESH_PAUSED);
+    nordi_refresh_set_state(refresh, true, true, false, true, START_MS); // call
+    assert_int(nordi_refresh_mode(refresh), ==, REFRESH_PAUSED);
+    return MUNIT_OK;
+}
+
+TEST(test_nordi_refresh_run_aligned) {
+    refresh = nordi_refresh_new();
+    int fast = nordi_refresh_add(refresh, 1000, run_fast, NULL);
+    int slow = nordi_refresh_add(refresh, 5000, run_slow, NULL);
+    nordi_refresh_enable(refresh, fast, true, START_MS); // call
+    nordi_refresh_enable(refresh, slow, true, START_MS + 300); // call
+    assert_int(nordi_refresh_next(refresh, START_MS), ==, 500);
+    follow(START_MS, START_MS + 20000);
+    assert_int(fast_runs, >=, 19);
+    assert_int(fast_runs, <=, 20);
+    assert_int(slow_runs, ==, 3);
+    // every slow run shared the wakeup of a fast one
+    assert_uint(refresh->wakeups, ==, fast_runs);
+    assert_uint(refresh->runs, ==, fast_runs + slow_runs);
+    return MUNIT_OK;
+}
+
+TEST(test_nordi_refresh_run_hidden) {
+    refresh = nordi_refresh_new();
+    int fast = nordi_refresh_add(refresh, 1000, run_fast, NULL);
+    nordi_refresh_enable(refresh, fast, true, START_MS);
+    nordi_refresh_set_state(refresh, false, false, false, false, START_MS); // call
+    assert_int(nordi_refresh_next(refresh, START_MS), >=, 1000 * REFRESH_HIDDEN_FACTOR / 2);
+    follow(START_MS, START_MS + 60000);
+    assert_int(fast_runs, ==, 2);
+    // shown again, the overdue task runs on the next second
+    nordi_refresh_set_state(refresh, true, true, false, false, START_MS + 61000); // call
+    assert_int(nordi_refresh_next(refresh, START_MS + 61000), <=, REFRESH_ALIGN_MS);
+    return MUNIT_OK;
+}
+
+TEST(test_nordi_refresh_run_paused) {
+    refresh = nordi_refresh_new();
+    int fast = nordi_refresh_add(refresh, 1000, run_fast, NULL);
+    nordi_refresh_enable(refresh, fast, true, START_MS);
+    nordi_refresh_set_state(refresh, true, true, true, false, START_MS); // call, battery saver
+    assert_int(nordi_refresh_next(refresh, START_MS), ==, REFRESH_NO_DEADLINE);
+    assert_int(nordi_refresh_run(refresh, START_MS + 5000), ==, REFRESH_NO_DEADLINE); // call
+    assert_int(fast_runs, ==, 0);
+    nordi_refresh_enable(refresh, fast, false, START_MS);
+    nordi_refresh_set_state(refresh, true, true, false, false, START_MS); // call
+    assert_int(nordi_refresh_next(refresh, START_MS), ==, REFRESH_NO_DEADLINE);
+    return MUNIT_OK;
+}
+
+TEST(test_nordi_refresh_wakeups_per_minute) {
+    refresh = nordi_refresh_new();
+    int fast = nordi_refresh_add(refresh, 1000, run_fast, NULL);
+    nordi_refresh_enable(refresh, fast, true, START_MS);
+    nordi_refresh_run(refresh, START_MS);
+    follow(START_MS, START_MS + 90000);
+    unsigned int wakeups = nordi_refresh_wakeups_per_minute(refresh, START_MS + 90000); // call
+    assert_uint(wakeups, >=, 59);
+    assert_uint(wakeups, <=, 61);
+    assert_uint(nordi_refresh_wakeups_per_minute(refresh, START_MS + 300000), ==, 0); // call, idle since
+    return MUNIT_OK;
+}
+
+TEST(test_nordi_refresh_scale) {
+    refresh = nordi_refresh_new();
+    assert_int(nordi_refresh_scale(refresh), ==, 1); // call
+    nordi_refresh_set_state(refresh, false, true, false, false, START_MS);
+    assert_int(nordi_refresh_scale(refresh), ==, REFRESH_BACKGROUND_FACTOR); // call
+    nordi_refresh_set_state(refresh, false, false, false, false, START_MS);
+    assert_int(nordi_refresh_scale(refresh), ==, REFRESH_HIDDEN_FACTOR); // call
+    nordi_refresh_set_state(refresh, true, true, false, true, START_MS);
+    assert_int(nordi_refresh_scale(refresh), ==, 0); // call
+    return MUNIT_OK;
+}
+
+TEST(test_nordi_refresh_count_wakeups) {
+    refresh = nordi_refresh_new();
+    nordi_refresh_count_wakeups(refresh, 40, START_MS);        // call
+    nordi_refresh_count_wakeups(refresh, 20, START_MS + 30000); // call
+    assert_uint(nordi_refresh_wakeups_per_minute(refresh, START_MS + 61000), ==, 60);
+    assert_llong(refresh->wakeups, ==, 60);
+    return MUNIT_OK;
+}
+
+TEST(test_nordi_refresh_add_full) {
+    refresh = nordi_refresh_new();
+    for (int task = 0; task < REFRESH_MAX_TASKS; task++) {
+        assert_int(nordi_refresh_add(refresh, 1000, run_fast, NULL), ==, task); // call
+    }
+    assert_int(nordi_refresh_add(refresh, 1000, run_fast, NULL), ==, REFRESH_NO_TASK); // call
+    return MUNIT_OK;
+}
+
+TESTS(refresh_tests) = {
+    TESTRUN("/mode-ok", test_nordi_refresh_mode),
+    TESTRUN("/run-ok-aligned", test_nordi_refresh_run_aligned),
+    TESTRUN("/run-ok-hidden", test_nordi_refresh_run_hidden),
+    TESTRUN("/run-ok-paused", test_nordi_refresh_run_paused),
+    TESTRUN("/wakeups-per-minute-ok", test_nordi_refresh_wakeups_per_minute),
+    TESTRUN("/scale-ok", test_nordi_refresh_scale),
+    TESTRUN("/count-wakeups-ok", test_nordi_refresh_count_wakeups),
+    TESTRUN("/add-fail-full", test_nordi_refresh_add_full),
+    TESTEND
+};
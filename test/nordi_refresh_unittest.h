@@ -0,0 +1,7 @@
+#ifndef NORDI_REFRESH_UNITTEST_H_
+#define NORDI_REFRESH_UNITTEST_H_
+
+#include "../src/nordi_refresh.c"
+#include "nordi_unittest.h"
+
+#endif /* NORDI_REFRESH_UNITTEST_H_ */
@@ -0,0 +1,147 @@
+#include "nordi_resources_unittest.h"
+#include <threads.h>
+#include <unistd.h>
+#include "nordi_routines.h"
+
+#define MAX_REPORT 4096
+
+static nordi_resources_ptr resources = NULL;
+static atomic_bool is_released = false;
+
+static int
+hold_thread(void* context) {
+    while (!atomic_load(&is_released)) {
+        thrd_yield();
+    }
+    return thrd_success;
+}
+
+static void
+do_nothing(void* context) {}
+
+TEARDOWN(tear_down_test) {
+    nordi_resources_free(resources);
+    resources = NULL;
+    atomic_store(&is_released, false);
+}
+
+TEST(test_nordi_resources_alloc) {
+    nordi_resources_snapshot_t before, after;
+    nordi_resources_sample(&before, 0);
+    nordi_resources_alloc(RESOURCE_GUI, 100); // call
+    nordi_resources_alloc(RESOURCE_GUI, 50);  // call
+    nordi_resources_release(RESOURCE_GUI, 50); // call
+    nordi_resources_sample(&after, 0);
+    assert_llong(after.allocations[RESOURCE_GUI] - before.allocations[RESOURCE_GUI], ==, 1);
+    assert_llong(after.bytes[RESOURCE_GUI] - before.bytes[RESOURCE_GUI], ==, 100);
+    assert_llong(after.bytes[RESOURCE_CATALOG], ==, before.bytes[RESOURCE_CATALOG]);
+    nordi_resources_release(RESOURCE_GUI, 100);
+    nordi_resources_sample(&after, 0);
+    assert_llong(after.allocations[RESOURCE_GUI], ==, before.allocations[RESOURCE_GUI]);
+    assert_llong(after.bytes[RESOURCE_GUI], ==, before.bytes[RESOURCE_GUI]);
+    return MUNIT_OK;
+}
+
+TEST(test_nordi_resources_str) {
+    nordi_resources_snapshot_t before, after;
+    nordi_resources_sample(&before, 0);
+    str text = str_null;
+    nordi_resources_str_cpy(RESOURCE_API, &text, str_lit("hello")); // call
+    nordi_resources_sample(&after, 0);
+    assert_llong(after.allocations[RESOURCE_API] - before.allocations[RESOURCE_API], ==, 1);
+    assert_llong(after.bytes[RESOURCE_API] - before.bytes[RESOURCE_API], ==, 6);
+    nordi_resources_str_cpy(RESOURCE_API, &text, str_lit("hi")); // call, replaces the allocation
+    nordi_resources_sample(&after, 0);
+    assert_llong(after.allocations[RESOURCE_API] - before.allocations[RESOURCE_API], ==, 1);
+    assert_llong(after.bytes[RESOURCE_API] - before.bytes[RESOURCE_API], ==, 3);
+    nordi_resources_str_clear(RESOURCE_API, &text); // call
+    nordi_resources_str_clear(RESOURCE_API, &text); // call, nothing left to release
+    nordi_resources_sample(&after, 0);
+    assert_llong(after.allocations[RESOURCE_API], ==, before.allocations[RESOURCE_API]);
+    assert_llong(after.bytes[RESOURCE_API], ==, before.bytes[RESOURCE_API]);
+    return MUNIT_OK;
+}
+
+TEST(test_nordi_resources_routines) {
+    nordi_resources_snapshot_t before, after;
+    nordi_resources_sample(&before, 0);
+    nordi_routine_ptr routine = nordi_routine_new(do_nothing, NULL, 0); // call
+    assert_not_null(routine);
+    nordi_resources_sample(&after, 0);
+    assert_llong(after.allocations[RESOURCE_ROUTINES] - before.allocations[RESOURCE_ROUTINES], ==, 1);
+    assert_llong(after.bytes[RESOURCE_ROUTINES] - before.bytes[RESOURCE_ROUTINES], ==, sizeof(nordi_routine_t));
+    nordi_routine_join(routine); // call
+    nordi_resources_sample(&after, 0);
+    assert_llong(after.allocations[RESOURCE_ROUTINES], ==, before.allocations[RESOURCE_ROUTINES]);
+    return MUNIT_OK;
+}
+
+TEST(test_nordi_resources_process) {
+    nordi_resources_snapshot_t before, after;
+    nordi_resources_sample(&before, 0);
+    assert_int(before.threads, >=, 1);
+    assert_int(before.fds, >=, 0);
+    int fds[2];
+    assert_int(pipe(fds), ==, 0);
+    thrd_t thread;
+    assert_int(thrd_create(&thread, hold_thread, NULL), ==, thrd_success);
+    nordi_resources_child(1); // call
+    nordi_resources_sample(&after, 0); // call
+    assert_int(after.fds - before.fds, ==, 2);
+    assert_int(after.threads - before.threads, ==, 1);
+    assert_int(after.children - before.children, ==, 1);
+    atomic_store(&is_released, true);
+    thrd_join(thread, NULL);
+    close(fds[0]);
+    close(fds[1]);
+    nordi_resources_child(-1); // call
+    nordi_resources_sample(&after, 0);
+    assert_int(after.fds, ==, before.fds);
+    assert_int(after.threads, ==, before.threads);
+    assert_int(after.children, ==, before.children);
+    return MUNIT_OK;
+}
+
+TEST(test_nordi_resources_snapshot) {
+    resources = nordi_resources_new();
+    assert_not_null(resources);
+    assert_null(nordi_resources_at(resources, 0));
+    for (int minute = 0; minute < RESOURCE_SNAPSHOTS + 2; minute++) {
+        nordi_resources_snapshot(resources, minute * 60000LL); // call
+    }
+    assert_int(resources->count, ==, RESOURCE_SNAPSHOTS);
+    assert_llong(nordi_resources_at(resources, 0)->time_ms, ==, (RESOURCE_SNAPSHOTS + 1) * 60000LL);
+    // the two oldest were dropped
+    assert_llong(nordi_resources_at(resources, RESOURCE_SNAPSHOTS - 1)->time_ms, ==, 2 * 60000LL);
+    assert_null(nordi_resources_at(resources, RESOURCE_SNAPSHOTS));
+    return MUNIT_OK;
+}
+
+TEST(test_nordi_resources_write) {
+    resources = nordi_resources_new();
+    nordi_resources_snapshot(resources, 0);
+    nordi_resources_alloc(RESOURCE_CATALOG, 4096);
+    char report[MAX_REPORT] = {};
+    FILE* file = fmemopen(report, MAX_REPORT, "w");
+    nordi_resources_write(resources, file, 10 * 60000LL); // call
+    fclose(file);
+    nordi_resources_release(RESOURCE_CATALOG, 4096);
+    assert_not_null(strstr(report, "1 snapshots, changes over the last 10 min"));
+    char* catalog = strstr(report, "catalog");
+    assert_not_null(catalog);
+    assert_not_null(strstr(catalog, "+1\n"));
+    assert_not_null(strstr(catalog, "+4096\n"));
+    assert_not_null(strstr(report, "threads"));
+    assert_not_null(strstr(report, "fds"));
+    return MUNIT_OK;
+}
+
+TESTS(resources_tests) = {
+    TESTRUN("/alloc-ok", test_nordi_resources_alloc),
+    TESTRUN("/str-ok", test_nordi_resources_str),
+    TESTRUN("/routines-ok", test_nordi_resources_routines),
+    TESTRUN("/process-ok", test_nordi_resources_process),
+    TESTRUN("/snapshot-ok-ring", test_nordi_resources_snapshot),
+    TESTRUN("/write-ok", test_nordi_resources_write),
+    TESTEND
+};
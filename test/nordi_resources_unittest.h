@@ -0,0 +1,7 @@
+#ifndef NORDI_RESOURCES_UNITTEST_H_
+#define NORDI_RESOURCES_UNITTEST_H_
+
+#include "../src/nordi_resources.c"
+#include "nordi_unittest.h"
+
+#endif /* NORDI_RESOURCES_UNITTEST_H_ */
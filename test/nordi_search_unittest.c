@@ -0,0 +1,126 @@
+#include "nordi_search_unittest.h"
+#include <stdio.h>
+#include <time.h>
+
+#define BENCH_TEXTS    20000
+#define MAX_TEXT       64
+#define TYPED          "United Kingdom"
+
+static const char* const TEXTS[] = {
+    "Automatic", "Germany", "United_Kingdom", "United_States", "P2P", "de101 Germany", "uk7 United Kingdom", "us12 United States",
+};
+
+static nordi_search_ptr
+search_of(const char* const* texts, int count) {
+    nordi_search_ptr search = nordi_search_new();
+    for (int index = 0; index < count; index++) {
+        nordi_search_add(search, texts[index]);
+    }
+    return search;
+}
+
+TEARDOWN(tear_down_test) {}
+
+TEST(test_nordi_search_query_word) {
+    nordi_search_ptr search = search_of(TEXTS, 8);
+    const int* ids = NULL;
+    assert_int(nordi_search_query(search, "ge", &ids), ==, 2); // call
+    assert_int(ids[0], ==, 1);
+    assert_int(ids[1], ==, 5);
+    // word starts only, "states" doesn't start with "t"
+    assert_int(nordi_search_query(search, "s", &ids), ==, 2);
+    assert_int(ids[0], ==, 3);
+    assert_int(ids[1], ==, 7);
+    assert_int(nordi_search_query(search, "", &ids), ==, 8);
+    assert_int(nordi_search_query(search, "zz", &ids), ==, 0);
+    nordi_search_free(search);
+}
+
+TEST(test_nordi_search_query_substring) {
+    nordi_search_ptr search = search_of(TEXTS, 8);
+    const int* ids = NULL;
+    assert_int(nordi_search_query(search, "ITED K", &ids), ==, 2); // call
+    assert_int(ids[0], ==, 2);
+    assert_int(ids[1], ==, 6);
+    assert_int(nordi_search_query(search, "many", &ids), ==, 2);
+    assert_int(nordi_search_query(search, "p2p", &ids), ==, 1);
+    assert_int(ids[0], ==, 4);
+    assert_int(nordi_search_query(search, "xyz", &ids), ==, 0);
+    // the rarest trigram has candidates, the query still doesn't match them
+    assert_int(nordi_search_query(search, "de1012", &ids), ==, 0);
+    nordi_search_free(search);
+}
+
+TEST(test_nordi_search_query_refine) {
+    nordi_search_ptr search = search_of(TEXTS, 8);
+    const int* ids = NULL;
+    char typed[sizeof(TYPED)] = {};
+    // every keystroke matches what a fresh index would
+    for (size_t length = 1; length < sizeof(TYPED); length++) {
+        memcpy(typed, TYPED, length);
+        int count = nordi_search_query(search, typed, &ids); // call
+        int refined[8];
+        memcpy(refined, ids, count * sizeof(int));
+        nordi_search_ptr fresh = search_of(TEXTS, 8);
+        assert_int(nordi_search_query(fresh, typed, &ids), ==, count);
+        assert_memory_equal(count * sizeof(int), ids, refined);
+        nordi_search_free(fresh);
+    }
+    // backspace searches again
+    assert_int(nordi_search_query(search, "Unit", &ids), ==, 4);
+    // an add drops the last query
+    nordi_search_add(search, "United Arab Emirates");
+    assert_int(nordi_search_query(search, "United", &ids), ==, 5);
+    nordi_search_free(search);
+}
+
+TEST(test_nordi_search_changed_range) {
+    const int all[] = {0, 1, 2, 3, 4, 5}, narrowed[] = {0, 2, 5}, widened[] = {0, 2, 3, 5};
+    int removed = 0, added = 0;
+    assert_int(nordi_search_changed_range(all, 6, narrowed, 3, &removed, &added), ==, 1); // call
+    assert_int(removed, ==, 4);
+    assert_int(added, ==, 1);
+    assert_int(nordi_search_changed_range(narrowed, 3, widened, 4, &removed, &added), ==, 2); // call
+    assert_int(removed, ==, 0);
+    assert_int(added, ==, 1);
+    assert_int(nordi_search_changed_range(all, 6, all, 6, &removed, &added), ==, 6); // call, nothing changed
+    assert_int(removed + added, ==, 0);
+    assert_int(nordi_search_changed_range(all, 6, NULL, 0, &removed, &added), ==, 0); // call
+    assert_int(removed, ==, 6);
+    assert_int(added, ==, 0);
+}
+
+TEST(test_nordi_search_bench) {
+    nordi_search_ptr search = nordi_search_new();
+    for (int index = 0; index < BENCH_TEXTS; index++) {
+        char text[MAX_TEXT];
+        snprintf(text, MAX_TEXT, "%s%d %s", index % 2 ? "uk" : "us", index, TEXTS[2 + index % 2]);
+        assert_int(nordi_search_add(search, text), ==, index);
+    }
+    const int* ids = NULL;
+    char typed[sizeof(TYPED)] = {};
+    clock_t slowest = 0;
+    for (size_t length = 1; length < sizeof(TYPED); length++) {
+        memcpy(typed, TYPED, length);
+        clock_t start = clock();
+        int count = nordi_search_query(search, typed, &ids); // call
+        clock_t elapsed = clock() - start;
+        slowest = elapsed > slowest ? elapsed : slowest;
+        // every text is in one of the two United countries, until the query tells them apart
+        assert_int(count, ==, length < sizeof("United K") - 1 ? BENCH_TEXTS : BENCH_TEXTS / 2);
+    }
+    assert_int(nordi_search_query(search, TYPED, &ids), ==, BENCH_TEXTS / 2);
+    long slowest_us = (long)(slowest * 1000000 / CLOCKS_PER_SEC);
+    // only logged, a loaded machine can slow any keystroke down
+    munit_logf(MUNIT_LOG_INFO, "%d texts: slowest keystroke %ld us", BENCH_TEXTS, slowest_us);
+    nordi_search_free(search);
+}
+
+TESTS(search_tests) = {
+    TESTRUN("/query-ok-word", test_nordi_search_query_word),
+    TESTRUN("/query-ok-substring", test_nordi_search_query_substring),
+    TESTRUN("/query-ok-refine", test_nordi_search_query_refine),
+    TESTRUN("/changed-range-ok", test_nordi_search_changed_range),
+    TESTRUN("/bench-ok", test_nordi_search_bench),
+    TESTEND,
+};
@@ -0,0 +1,7 @@
+#ifndef NORDI_SEARCH_UNITTEST_H_
+#define NORDI_SEARCH_UNITTEST_H_
+
+#include "../src/nordi_search.c"
+#include "nordi_unittest.h"
+
+#endif /* NORDI_SEARCH_UNITTEST_H_ */
@@ -0,0 +1,152 @@
+#include "nordi_selector_unittest.h"
+#include <time.h>
+
+#define NOW          1683720000
+#define DAY_S        86400
+#define GERMANY      20
+#define FRANCE       19
+#define MANY_SERVERS 5000
+#define MANY_EVENTS  200000
+#define PICKS        1000
+#define FAST_PICK_US 1000
+#define JOURNAL      "/tmp/nordi-selector-history.dat"
+
+static void
+observe(nordi_selector_ptr selector, nordi_history_event_t event, const char* server, int country, int64_t time,
+        uint32_t connect_ms, int32_t error) {
+    nordi_history_record_t record = {.time = time, .event = event, .country = country, .error = error, .connect_ms = connect_ms};
+    snprintf(record.server, HISTORY_MAX_SERVER, "%s", server);
+    nordi_selector_observe(selector, &record);
+}
+
+static void
+observe_session(nordi_selector_ptr selector, const char* server, int64_t time, uint16_t rtt_ms, uint8_t loss) {
+    nordi_history_record_t record = {.time = time, .event = EVENT_DISCONNECT, .country = -1, .rtt_ms = rtt_ms, .loss = loss};
+    snprintf(record.server, HISTORY_MAX_SERVER, "%s", server);
+    nordi_selector_observe(selector, &record);
+}
+
+TEARDOWN(tear_down_test) {
+    remove(JOURNAL);
+}
+
+TEST(test_nordi_selector_best) {
+    nordi_selector_ptr selector = nordi_selector_new(0);
+    assert_not_null(selector);
+    for (int attempt = 0; attempt < 10; attempt++) {
+        observe(selector, EVENT_CONNECT, "de100", GERMANY, NOW - attempt, 1200, 0);
+        observe(selector, EVENT_CONNECT, "de200", GERMANY, NOW - attempt, 900, attempt % 2 == 0 ? 0 : 3);
+        observe(selector, EVENT_CONNECT, "de300", GERMANY, NOW - attempt, 8000, 0);
+        observe(selector, EVENT_CONNECT, "fr10", FRANCE, NOW - attempt, 300, 0);
+    }
+    assert_string_equal(nordi_selector_best(selector, GERMANY, NOW), "de100"); // call
+    assert_string_equal(nordi_selector_best(selector, SELECTOR_ANY_COUNTRY, NOW), "fr10"); // call
+    assert_double(nordi_selector_score(selector, "de100", NOW), >, nordi_selector_score(selector, "de200", NOW));
+    assert_double(nordi_selector_score(selector, "de200", NOW), >, nordi_selector_score(selector, "de300", NOW));
+    assert_double(nordi_selector_score(selector, "de400", NOW), ==, -1);
+    nordi_selector_free(selector);
+}
+
+TEST(test_nordi_selector_rank) {
+    nordi_selector_ptr selector = nordi_selector_new(0);
+    const int connect_ms[] = {4000, 500, 2000, 1000, 3000};
+    for (int index = 0; index < 5; index++) {
+        char server[HISTORY_MAX_SERVER];
+        snprintf(server, HISTORY_MAX_SERVER, "de%d", index);
+        observe(selector, EVENT_CONNECT, server, GERMANY, NOW, connect_ms[index], 0);
+    }
+    const char* ranked[3];
+    assert_int(nordi_selector_rank(selector, GERMANY, NOW, ranked, 3), ==, 3); // call
+    assert_string_equal(ranked[0], "de1");
+    assert_string_equal(ranked[1], "de3");
+    assert_string_equal(ranked[2], "de2");
+    assert_int(nordi_selector_rank(selector, FRANCE, NOW, ranked, 3), ==, 0); // call
+    nordi_selector_free(selector);
+}
+
+TEST(test_nordi_selector_session_quality) {
+    nordi_selector_ptr selector = nordi_selector_new(0);
+    observe(selector, EVENT_CONNECT, "de100", GERMANY, NOW, 1000, 0);
+    observe(selector, EVENT_CONNECT, "de200", GERMANY, NOW, 1000, 0);
+    observe_session(selector, "de100", NOW + 3600, 250, 10); // call
+    observe_session(selector, "de200", NOW + 3600, 30, 0); // call
+    assert_string_equal(nordi_selector_best(selector, GERMANY, NOW + 3600), "de200");
+    nordi_selector_free(selector);
+}
+
+TEST(test_nordi_selector_decay) {
+    nordi_selector_ptr selector = nordi_selector_new(DAY_S);
+    // de100 failed a lot a month ago, de200 a little today
+    for (int attempt = 0; attempt < 20; attempt++) {
+        observe(selector, EVENT_CONNECT, "de100", GERMANY, NOW - 30 * DAY_S, 1000, attempt < 2 ? 0 : 3);
+    }
+    for (int attempt = 0; attempt < 4; attempt++) {
+        observe(selector, EVENT_CONNECT, "de200", GERMANY, NOW, 1000, attempt < 3 ? 0 : 3);
+    }
+    assert_string_equal(nordi_selector_best(selector, GERMANY, NOW), "de200"); // call
+    // a fresh success now counts for far more than the old failures
+    observe(selector, EVENT_CONNECT, "de100", GERMANY, NOW, 1000, 0);
+    observe(selector, EVENT_CONNECT, "de100", GERMANY, NOW, 1000, 0);
+    observe(selector, EVENT_CONNECT, "de100", GERMANY, NOW, 1000, 0);
+    observe(selector, EVENT_CONNECT, "de100", GERMANY, NOW, 1000, 0);
+    assert_string_equal(nordi_selector_best(selector, GERMANY, NOW), "de100"); // call
+    nordi_selector_free(selector);
+}
+
+TEST(test_nordi_selector_none) {
+    nordi_selector_ptr selector = nordi_selector_new(0);
+    assert_null(nordi_selector_best(selector, GERMANY, NOW)); // call
+    for (int attempt = 0; attempt < 5; attempt++) {
+        observe(selector, EVENT_CONNECT, "de100", GERMANY, NOW, 0, 3);
+    }
+    // only failures, the daemon's own pick is better
+    assert_null(nordi_selector_best(selector, GERMANY, NOW)); // call
+    // a failed node name never has a country to be picked in
+    observe(selector, EVENT_CONNECT, "Germany", -1, NOW, 0, 3);
+    assert_null(nordi_selector_best(selector, SELECTOR_ANY_COUNTRY, NOW));
+    assert_null(nordi_selector_best(NULL, GERMANY, NOW));
+    nordi_selector_free(selector);
+}
+
+TEST(test_nordi_selector_load) {
+    remove(JOURNAL);
+    nordi_history_ptr history = nordi_history_open(JOURNAL);
+    nordi_history_record_t record = {.time = NOW, .event = EVENT_CONNECT, .country = GERMANY, .connect_ms = 700};
+    snprintf(record.server, HISTORY_MAX_SERVER, "de100");
+    nordi_history_append(history, &record);
+    nordi_selector_ptr selector = nordi_selector_new(0);
+    nordi_selector_load(selector, history); // call
+    assert_string_equal(nordi_selector_best(selector, GERMANY, NOW), "de100");
+    nordi_selector_free(selector);
+    nordi_history_close(history);
+}
+
+TEST(test_nordi_selector_fast_pick) {
+    nordi_selector_ptr selector = nordi_selector_new(0);
+    for (int event = 0; event < MANY_EVENTS; event++) {
+        char server[HISTORY_MAX_SERVER];
+        snprintf(server, HISTORY_MAX_SERVER, "de%d", event % MANY_SERVERS);
+        observe(selector, EVENT_CONNECT, server, GERMANY, NOW - (MANY_EVENTS - event), 500 + event % 7919, event % 13 == 0);
+    }
+    assert_int(selector->count, ==, MANY_SERVERS);
+    const char* best = NULL;
+    clock_t start = clock();
+    for (int pick = 0; pick < PICKS; pick++) {
+        best = nordi_selector_best(selector, GERMANY, NOW + pick); // call
+    }
+    long elapsed_us = (long)((clock() - start) * 1000000 / CLOCKS_PER_SEC);
+    assert_not_null(best);
+    assert_int(elapsed_us / PICKS, <, FAST_PICK_US);
+    nordi_selector_free(selector);
+}
+
+TESTS(selector_tests) = {
+    TESTRUN("/best-ok", test_nordi_selector_best),
+    TESTRUN("/rank-ok", test_nordi_selector_rank),
+    TESTRUN("/best-ok-quality", test_nordi_selector_session_quality),
+    TESTRUN("/best-ok-decay", test_nordi_selector_decay),
+    TESTRUN("/best-fail-none", test_nordi_selector_none),
+    TESTRUN("/load-ok", test_nordi_selector_load),
+    TESTRUN("/best-ok-fast", test_nordi_selector_fast_pick),
+    TESTEND,
+};
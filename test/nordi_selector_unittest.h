@@ -0,0 +1,7 @@
+#ifndef NORDI_SELECTOR_UNITTEST_H_
+#define NORDI_SELECTOR_UNITTEST_H_
+
+#include "../src/nordi_selector.c"
+#include "nordi_unittest.h"
+
+#endif /* NORDI_SELECTOR_UNITTEST_H_ */
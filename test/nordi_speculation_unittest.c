@@ -0,0 +1,133 @@
+#include "nordi_speculation_unittest.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#define LOCALHOST     "127.0.0.1"
+#define MAX_SOCKETS   4
+#define MAX_TARGET    32
+#define KEY           7
+#define OTHER_KEY     8
+#define TEST_TIMEOUT  2000
+#define QUICK_US      500000
+
+static int sockets[MAX_SOCKETS] = {};
+static int socket_count = 0;
+static char targets[MAX_SOCKETS][MAX_TARGET] = {};
+
+// Bind a local socket and return its "127.0.0.1:port" target. TCP sockets listen, UDP ones never answer.
+static str
+local_target(int type) {
+    int fd = socket(AF_INET, type | SOCK_CLOEXEC, 0);
+    struct sockaddr_in address = {.sin_family = AF_INET, .sin_port = 0};
+    inet_pton(AF_INET, LOCALHOST, &address.sin_addr);
+    bind(fd, (struct sockaddr*)&address, sizeof(address));
+    if (type == SOCK_STREAM) {
+        listen(fd, MAX_SOCKETS);
+    }
+    socklen_t length = sizeof(address);
+    getsockname(fd, (struct sockaddr*)&address, &length);
+    sockets[socket_count] = fd;
+    snprintf(targets[socket_count], MAX_TARGET, LOCALHOST ":%d", ntohs(address.sin_port));
+    return str_ref(targets[socket_count++]);
+}
+
+TEARDOWN(tear_down_test) {
+    for (int index = 0; index < socket_count; index++) {
+        close(sockets[index]);
+    }
+    socket_count = 0;
+}
+
+TEST(test_nordi_speculation_take) {
+    nordi_probe_options_t options = {.mode = PROBE_TCP, .concurrency = 2, .timeout_ms = TEST_TIMEOUT};
+    nordi_speculation_ptr speculation = nordi_speculation_new(&options);
+    assert_not_null(speculation);
+    str candidates[] = {str_lit("unknown.invalid"), local_target(SOCK_STREAM)};
+    nordi_speculation_request(speculation, KEY, candidates, 2); // call
+    nordi_speculation_wait(speculation);
+    str server = str_null;
+    assert_false(nordi_speculation_take(speculation, OTHER_KEY, 0, &server));
+    assert_true(nordi_speculation_take(speculation, KEY, 0, &server)); // call
+    assert_string_equal(str_ptr(server), LOCALHOST);
+    assert_int(speculation->completed, ==, 1);
+    str_free(server);
+    nordi_speculation_free(speculation);
+}
+
+TEST(test_nordi_speculation_supersede) {
+    nordi_probe_options_t options = {.mode = PROBE_UDP, .concurrency = 1, .timeout_ms = TEST_TIMEOUT};
+    nordi_speculation_ptr speculation = nordi_speculation_new(&options);
+    str first[] = {local_target(SOCK_DGRAM)};
+    nordi_speculation_request(speculation, KEY, first, 1);
+    thrd_sleep(&(struct timespec){.tv_nsec = 20000000L}, NULL);
+    long long start = speculation_now_us();
+    // the selection moved on, the first probe must not run to its timeout
+    str second[] = {local_target(SOCK_DGRAM)};
+    nordi_speculation_request(speculation, OTHER_KEY, second, 1); // call
+    while (speculation->cancelled == 0 && speculation_now_us() - start < TEST_TIMEOUT * 1000) {
+        thrd_sleep(&(struct timespec){.tv_nsec = 1000000L}, NULL);
+    }
+    assert_llong(speculation_now_us() - start, <, QUICK_US);
+    assert_int(speculation->cancelled, ==, 1);
+    assert_int(speculation->completed, ==, 0);
+    nordi_speculation_free(speculation);
+}
+
+TEST(test_nordi_speculation_cancel) {
+    nordi_probe_options_t options = {.mode = PROBE_TCP, .concurrency = 1, .timeout_ms = TEST_TIMEOUT};
+    nordi_speculation_ptr speculation = nordi_speculation_new(&options);
+    str candidates[] = {local_target(SOCK_STREAM)};
+    nordi_speculation_request(speculation, KEY, candidates, 1);
+    nordi_speculation_wait(speculation);
+    nordi_speculation_cancel(speculation); // call
+    str server = str_null;
+    assert_false(nordi_speculation_take(speculation, KEY, 0, &server));
+    // a running one stops right away
+    options.mode = PROBE_UDP;
+    nordi_speculation_free(speculation);
+    speculation = nordi_speculation_new(&options);
+    str silent[] = {local_target(SOCK_DGRAM)};
+    nordi_speculation_request(speculation, KEY, silent, 1);
+    thrd_sleep(&(struct timespec){.tv_nsec = 20000000L}, NULL);
+    long long start = speculation_now_us();
+    nordi_speculation_cancel(speculation); // call
+    nordi_speculation_wait(speculation);
+    assert_llong(speculation_now_us() - start, <, QUICK_US);
+    assert_int(speculation->cancelled, ==, 1);
+    nordi_speculation_free(speculation);
+}
+
+TEST(test_nordi_speculation_stale) {
+    nordi_probe_options_t options = {.mode = PROBE_TCP, .concurrency = 1, .timeout_ms = TEST_TIMEOUT};
+    nordi_speculation_ptr speculation = nordi_speculation_new(&options);
+    str candidates[] = {local_target(SOCK_STREAM)};
+    nordi_speculation_request(speculation, KEY, candidates, 1);
+    nordi_speculation_wait(speculation);
+    speculation->ready_us -= 2000000;
+    str server = str_null;
+    assert_false(nordi_speculation_take(speculation, KEY, 1000, &server)); // call
+    assert_true(nordi_speculation_take(speculation, KEY, 3000, &server)); // call
+    str_free(server);
+    nordi_speculation_free(speculation);
+}
+
+TEST(test_nordi_speculation_free_busy) {
+    nordi_probe_options_t options = {.mode = PROBE_UDP, .concurrency = 1, .timeout_ms = TEST_TIMEOUT};
+    nordi_speculation_ptr speculation = nordi_speculation_new(&options);
+    str silent[] = {local_target(SOCK_DGRAM)};
+    nordi_speculation_request(speculation, KEY, silent, 1);
+    thrd_sleep(&(struct timespec){.tv_nsec = 20000000L}, NULL);
+    long long start = speculation_now_us();
+    nordi_speculation_free(speculation); // call
+    assert_llong(speculation_now_us() - start, <, QUICK_US);
+}
+
+TESTS(speculation_tests) = {
+    TESTRUN("/take-ok", test_nordi_speculation_take),
+    TESTRUN("/supersede-ok", test_nordi_speculation_supersede),
+    TESTRUN("/cancel-ok", test_nordi_speculation_cancel),
+    TESTRUN("/take-fail-stale", test_nordi_speculation_stale),
+    TESTRUN("/free-ok-busy", test_nordi_speculation_free_busy),
+    TESTEND,
+};
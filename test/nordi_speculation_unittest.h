@@ -0,0 +1,7 @@
+#ifndef NORDI_SPECULATION_UNITTEST_H_
+#define NORDI_SPECULATION_UNITTEST_H_
+
+#include "../src/nordi_speculation.c"
+#include "nordi_unittest.h"
+
+#endif /* NORDI_SPECULATION_UNITTEST_H_ */
@@ -0,0 +1,130 @@
+#include "nordi_speedtest_unittest.h"
+#include <arpa/inet.h>
+#include <stdio.h>
+
+#define LOCALHOST   "127.0.0.1"
+#define MAX_TARGET  32
+#define STREAMS     4
+#define DURATION_MS 300
+#define INTERVAL_MS 20
+#define TIMEOUT_MS  500
+
+static nordi_speedtest_sink_ptr sink = NULL;
+static char target[MAX_TARGET];
+
+static str
+start_sink() {
+    sink = nordi_speedtest_sink_new(NULL, 0);
+    snprintf(target, MAX_TARGET, LOCALHOST ":%d", sink != NULL ? sink->port : 0);
+    return str_ref(target);
+}
+
+// a port nothing listens on, taken from a socket bound and closed right away
+static str
+closed_port() {
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in address = {.sin_family = AF_INET};
+    inet_pton(AF_INET, LOCALHOST, &address.sin_addr);
+    bind(listener, (struct sockaddr*)&address, sizeof(address));
+    socklen_t length = sizeof(address);
+    getsockname(listener, (struct sockaddr*)&address, &length);
+    close(listener);
+    snprintf(target, MAX_TARGET, LOCALHOST ":%d", ntohs(address.sin_port));
+    return str_ref(target);
+}
+
+static nordi_speedtest_options_t
+test_options() {
+    return (nordi_speedtest_options_t){
+        .streams = STREAMS,
+        .duration_ms = DURATION_MS,
+        .interval_ms = INTERVAL_MS,
+        .timeout_ms = TIMEOUT_MS,
+    };
+}
+
+TEARDOWN(tear_down_test) {
+    nordi_speedtest_sink_free(sink);
+    sink = NULL;
+}
+
+TEST(test_nordi_speedtest_run) {
+    str endpoint = start_sink();
+    assert_not_null(sink);
+    nordi_speedtest_options_t options = test_options();
+    nordi_speedtest_result_t result;
+    assert_true(nordi_speedtest_run(endpoint, &options, &result, NULL)); // call
+    assert_int(result.streams, ==, STREAMS);
+    assert_true(result.is_zero_copy);
+    assert_uint(result.elapsed_ms, >=, DURATION_MS);
+    assert_uint(result.elapsed_ms, <, DURATION_MS + TIMEOUT_MS);
+    assert_true(result.bytes > 0);
+    unsigned long long sum = 0;
+    for (int stream = 0; stream < STREAMS; stream++) {
+        assert_true(result.stream_bytes[stream] > 0);
+        sum += result.stream_bytes[stream];
+    }
+    assert_true(sum == result.bytes);
+    assert_uint(atomic_load(&sink->connections), ==, STREAMS);
+    assert_double(result.goodput_bps, >, 0);
+    assert_double(result.fairness, >, 1.0 / STREAMS);
+    assert_double(result.fairness, <=, 1.0);
+    assert_uint(result.ramp_up_ms, <=, result.elapsed_ms);
+    munit_logf(MUNIT_LOG_INFO, "%d streams: %.2f Gbit/s, ramp-up %u ms, fairness %.3f", result.streams,
+               result.goodput_bps / 1e9, result.ramp_up_ms, result.fairness);
+    return MUNIT_OK;
+}
+
+TEST(test_nordi_speedtest_cancel) {
+    str endpoint = start_sink();
+    nordi_speedtest_options_t options = test_options();
+    options.duration_ms = 60000;
+    nordi_speedtest_result_t result;
+    atomic_bool cancel = true;
+    assert_false(nordi_speedtest_run(endpoint, &options, &result, &cancel)); // call
+    assert_uint(result.elapsed_ms, <, DURATION_MS);
+    return MUNIT_OK;
+}
+
+TEST(test_nordi_speedtest_fail_refused) {
+    nordi_speedtest_options_t options = test_options();
+    nordi_speedtest_result_t result;
+    assert_false(nordi_speedtest_run(closed_port(), &options, &result, NULL)); // call
+    assert_int(result.streams, ==, 0);
+    assert_true(result.bytes == 0);
+    assert_double(result.goodput_bps, ==, 0);
+    assert_false(nordi_speedtest_run(str_lit(""), &options, &result, NULL));
+    return MUNIT_OK;
+}
+
+TEST(test_nordi_speedtest_sink_fail_address) {
+    assert_null(nordi_speedtest_sink_new("not an address", 0)); // call
+    assert_null(nordi_speedtest_sink_new("::1", 0));            // call, IPv4 only
+}
+
+TEST(test_nordi_speedtest_fairness) {
+    unsigned long long even[] = {100, 100, 100, 100};
+    unsigned long long single[] = {400, 0, 0, 0};
+    unsigned long long none[] = {0, 0};
+    assert_double(nordi_speedtest_fairness(even, 4), ==, 1.0); // call
+    assert_double(nordi_speedtest_fairness(single, 4), ==, 0.25);
+    assert_double(nordi_speedtest_fairness(none, 2), ==, 0.0);
+    return MUNIT_OK;
+}
+
+TEST(test_nordi_speedtest_ramp_up) {
+    double rates[] = {10, 50, 95, 100, 100, 100, 100, 100};
+    assert_uint(ramp_up_ms(rates, 8, INTERVAL_MS, 160), ==, 3 * INTERVAL_MS); // call
+    assert_uint(ramp_up_ms(rates, 0, INTERVAL_MS, 160), ==, 160);
+    return MUNIT_OK;
+}
+
+TESTS(speedtest_tests) = {
+    TESTRUN("/run-ok", test_nordi_speedtest_run),
+    TESTRUN("/run-ok-cancelled", test_nordi_speedtest_cancel),
+    TESTRUN("/run-fail-refused", test_nordi_speedtest_fail_refused),
+    TESTRUN("/sink-fail-address", test_nordi_speedtest_sink_fail_address),
+    TESTRUN("/fairness-ok", test_nordi_speedtest_fairness),
+    TESTRUN("/ramp-up-ok", test_nordi_speedtest_ramp_up),
+    TESTEND,
+};
@@ -0,0 +1,7 @@
+#ifndef NORDI_SPEEDTEST_UNITTEST_H_
+#define NORDI_SPEEDTEST_UNITTEST_H_
+
+#include "../src/nordi_speedtest.c"
+#include "nordi_unittest.h"
+
+#endif /* NORDI_SPEEDTEST_UNITTEST_H_ */
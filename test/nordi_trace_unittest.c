@@ -0,0 +1,146 @@
+#include "nordi_trace_unittest.h"
+#include <unistd.h>
+
+#define TRACE_PATH  "/tmp/nordi-trace.trace"
+#define CURSOR_PATH TRACE_PATH TRACE_CURSOR_SUFFIX
+#define MAX_OUTPUT  256
+#define SPINNER     "\r-\r  \r\\\r  \r"
+
+// Two statuses around a connect, the last one cut short by a crash
+#define SESSION                                                                                                        \
+    "nordi-trace 1\n"                                                                                                  \
+    "run 0 1\narg status\nout 1000 Status: Disconnected\\n\nexit 2000 0\n"                                            \
+    "run 5000 2\narg c\narg ab999\nout 40000 You are connected\\n\nexit 40000 0\n"                                    \
+    "run 50000 1\narg status\nout 1000 Status: Connected\\n\nexit 2000 0\n"                                           \
+    "run 60000 1\narg status\nout 1000 Status: Conn"
+
+static nordi_trace_ptr trace = NULL;
+
+typedef struct {
+    char text[MAX_OUTPUT];
+    size_t length;
+    int chunks;
+} output_t;
+
+static bool
+collect(output_t* output, const char* data, size_t length) {
+    memcpy(output->text + output->length, data, length);
+    output->length += length;
+    output->chunks++;
+    return true;
+}
+
+static void
+write_trace(const char* text) {
+    FILE* file = fopen(TRACE_PATH, "w");
+    fputs(text, file);
+    fclose(file);
+}
+
+static long long
+elapsed_ms(long long start_us) {
+    return (now_us() - start_us) / 1000;
+}
+
+TEARDOWN(tear_down_test) {
+    nordi_trace_free(trace);
+    trace = NULL;
+    unlink(TRACE_PATH);
+    unlink(CURSOR_PATH);
+}
+
+TEST(test_nordi_trace_record) {
+    trace = nordi_trace_record(TRACE_PATH); // call
+    assert_not_null(trace);
+    nordi_trace_run_t run;
+    nordi_trace_begin(&run, (const char*[]){"/usr/bin/nordvpn", "c", "ab999", NULL}); // call
+    assert_true(nordi_trace_output(&run, SPINNER, strlen(SPINNER))); // call
+    assert_true(nordi_trace_output(&run, "\x01 binary\xff", 9)); // call
+    nordi_trace_end(trace, &run, 3); // call
+    nordi_trace_free(trace);
+    trace = nordi_trace_load(TRACE_PATH); // call
+    assert_not_null(trace);
+    assert_int(trace->run_count, ==, 1);
+    const nordi_trace_run_t* loaded = &trace->runs[0];
+    assert_int(loaded->argument_count, ==, 2);
+    assert_string_equal(loaded->arguments[0], "c");
+    assert_string_equal(loaded->arguments[1], "ab999");
+    assert_int(loaded->chunk_count, ==, 2);
+    assert_size(loaded->chunks[0].length, ==, strlen(SPINNER));
+    assert_memory_equal(strlen(SPINNER), loaded->chunks[0].data, SPINNER);
+    assert_memory_equal(9, loaded->chunks[1].data, "\x01 binary\xff");
+    assert_true(loaded->chunks[0].offset_us <= loaded->chunks[1].offset_us);
+    assert_true(loaded->chunks[1].offset_us <= loaded->exit_us);
+    assert_int(loaded->exit_code, ==, 3);
+    return MUNIT_OK;
+}
+
+TEST(test_nordi_trace_load_fail) {
+    assert_null(nordi_trace_load("/tmp/nordi-none/none.trace")); // call
+    write_trace("Status: Connected\n");
+    assert_null(nordi_trace_load(TRACE_PATH)); // call, not a trace
+    return MUNIT_OK;
+}
+
+TEST(test_nordi_trace_find) {
+    write_trace(SESSION);
+    trace = nordi_trace_load(TRACE_PATH);
+    assert_not_null(trace);
+    // the run cut short is dropped
+    assert_int(trace->run_count, ==, 3);
+    const char* status[] = {"/usr/bin/nordvpn", "status", NULL};
+    assert_ptr_equal(nordi_trace_find(trace, status), &trace->runs[0]); // call
+    assert_ptr_equal(nordi_trace_find(trace, (const char*[]){"/usr/bin/nordvpn", "c", "ab999", NULL}), &trace->runs[1]);
+    assert_ptr_equal(nordi_trace_find(trace, status), &trace->runs[2]); // call, the status after the connect
+    assert_ptr_equal(nordi_trace_find(trace, status), &trace->runs[0]); // call, around to the start
+    assert_null(nordi_trace_find(trace, (const char*[]){"/usr/bin/nordvpn", "c", NULL})); // call
+    assert_null(nordi_trace_find(trace, (const char*[]){"/usr/bin/nordvpn", "status", "now", NULL})); // call
+    return MUNIT_OK;
+}
+
+TEST(test_nordi_trace_play_speed) {
+    write_trace(SESSION);
+    trace = nordi_trace_load(TRACE_PATH);
+    const nordi_trace_run_t* connect = &trace->runs[1];
+    output_t output = {};
+    long long start_us = now_us();
+    assert_int(nordi_trace_play(connect, 1, (nordi_trace_sink_t)collect, &output), ==, 0); // call
+    assert_llong(elapsed_ms(start_us), >=, 40);
+    assert_string_equal(output.text, "You are connected\n");
+    start_us = now_us();
+    nordi_trace_play(connect, 4, (nordi_trace_sink_t)collect, &output); // call, a quarter of the time
+    assert_llong(elapsed_ms(start_us), >=, 10);
+    start_us = now_us();
+    nordi_trace_play(connect, 0, (nordi_trace_sink_t)collect, &output); // call, no waiting
+    assert_llong(elapsed_ms(start_us), <, 40);
+    assert_int(output.chunks, ==, 3);
+    return MUNIT_OK;
+}
+
+TEST(test_nordi_trace_serve) {
+    write_trace(SESSION);
+    const char* status[] = {"/usr/bin/nordvpn", "status", NULL};
+    char text[MAX_OUTPUT] = {};
+    for (int served = 0; served < 2; served++) {
+        FILE* output = fmemopen(text, MAX_OUTPUT, "w");
+        assert_int(nordi_trace_serve(TRACE_PATH, 0, status, output), ==, 0); // call
+        fclose(output);
+    }
+    // the second invocation went on from where the first left off
+    assert_string_equal(text, "Status: Connected\n");
+    FILE* output = fmemopen(text, MAX_OUTPUT, "w");
+    assert_int(nordi_trace_serve(TRACE_PATH, 0, (const char*[]){"/usr/bin/nordvpn", "d", NULL}, output), ==,
+               EXIT_FAILURE); // call
+    fclose(output);
+    assert_true(strncmp(text, "ERROR:", 6) == 0);
+    return MUNIT_OK;
+}
+
+TESTS(trace_tests) = {
+    TESTRUN("/record-ok", test_nordi_trace_record),
+    TESTRUN("/load-fail", test_nordi_trace_load_fail),
+    TESTRUN("/find-ok-in-order", test_nordi_trace_find),
+    TESTRUN("/play-ok-scaled", test_nordi_trace_play_speed),
+    TESTRUN("/serve-ok-resumed", test_nordi_trace_serve),
+    TESTEND
+};
@@ -0,0 +1,7 @@
+#ifndef NORDI_TRACE_UNITTEST_H_
+#define NORDI_TRACE_UNITTEST_H_
+
+#include "../src/nordi_trace.c"
+#include "nordi_unittest.h"
+
+#endif /* NORDI_TRACE_UNITTEST_H_ */
@@ -0,0 +1,193 @@
+#include "nordi_traffic_unittest.h"
+#include <sys/stat.h>
+
+#define NEVER_MS        60000
+#define FAST_MS         5
+#define RUN_WAIT        (&(struct timespec){.tv_nsec = 60000000})
+#define SECOND_US       1000000LL
+
+static char base_path[TRAFFIC_MAX_PATH] = {};
+static unsigned int notifications = 0;
+
+static void
+count_notify(void* context) {
+    notifications++;
+}
+
+static void
+write_counter(const char* interface, const char* counter, uint64_t value) {
+    char path[TRAFFIC_MAX_PATH];
+    snprintf(path, TRAFFIC_MAX_PATH, "%s/%s", base_path, interface);
+    mkdir(path, 0700);
+    snprintf(path, TRAFFIC_MAX_PATH, "%s/%s/statistics", base_path, interface);
+    mkdir(path, 0700);
+    snprintf(path, TRAFFIC_MAX_PATH, "%s/%s/statistics/%s", base_path, interface, counter);
+    FILE* file = fopen(path, "w");
+    fprintf(file, "%llu\n", (unsigned long long)value);
+    fclose(file);
+}
+
+static void
+write_counters(const char* interface, uint64_t rx, uint64_t tx) {
+    write_counter(interface, "rx_bytes", rx);
+    write_counter(interface, "tx_bytes", tx);
+}
+
+static const char*
+make_base() {
+    snprintf(base_path, TRAFFIC_MAX_PATH, "/tmp/nordi-traffic-XXXXXX");
+    return mkdtemp(base_path);
+}
+
+static unsigned int
+drain(nordi_traffic_ptr traffic) {
+    nordi_traffic_sample_t sample;
+    unsigned int count = 0;
+    while (nordi_traffic_pop(traffic, &sample)) {
+        count++;
+    }
+    return count;
+}
+
+TEARDOWN(tear_down_test) {
+    char command[TRAFFIC_MAX_PATH + 8];
+    snprintf(command, sizeof(command), "rm -rf %s", base_path);
+    system(command);
+    notifications = 0;
+}
+
+TEST(test_nordi_traffic_autodetect) {
+    make_base();
+    write_counters("eth0", 1, 1);
+    write_counters("tun0", 1, 1);
+    nordi_traffic_ptr traffic = nordi_traffic_new(base_path, NULL, NEVER_MS, NULL, NULL); // call
+    assert_not_null(traffic);
+    assert_string_equal(traffic->interface, "tun0");
+    nordi_traffic_free(traffic);
+    write_counters("nordlynx", 1, 1);
+    traffic = nordi_traffic_new(base_path, NULL, NEVER_MS, NULL, NULL); // call
+    assert_string_equal(traffic->interface, "nordlynx");
+    nordi_traffic_free(traffic);
+    traffic = nordi_traffic_new(base_path, "eth0", NEVER_MS, NULL, NULL); // call
+    assert_string_equal(traffic->interface, "eth0");
+    nordi_traffic_free(traffic);
+}
+
+TEST(test_nordi_traffic_fail_missing) {
+    make_base();
+    write_counters("eth0", 1, 1);
+    assert_null(nordi_traffic_new(base_path, NULL, NEVER_MS, NULL, NULL));   // call
+    assert_null(nordi_traffic_new(base_path, "wlan0", NEVER_MS, NULL, NULL)); // call
+}
+
+TEST(test_nordi_traffic_rate) {
+    make_base();
+    write_counters("tun0", 1000, 500);
+    nordi_traffic_ptr traffic = nordi_traffic_new(base_path, NULL, NEVER_MS, count_notify, NULL);
+    long long start = traffic->last_us;
+    write_counters("tun0", 3000, 1500);
+    traffic_sample(traffic, start + SECOND_US / 2); // call
+    nordi_traffic_sample_t sample;
+    assert_true(nordi_traffic_pop(traffic, &sample));
+    assert_double(sample.rx_rate, ==, 4000.0);
+    assert_double(sample.tx_rate, ==, 2000.0);
+    assert_llong(sample.time_us, ==, start + SECOND_US / 2);
+    assert_false(nordi_traffic_pop(traffic, &sample));
+    assert_int(notifications, ==, 1);
+    nordi_traffic_free(traffic);
+}
+
+TEST(test_nordi_traffic_reset) {
+    make_base();
+    write_counters("tun0", 5000, 5000);
+    nordi_traffic_ptr traffic = nordi_traffic_new(base_path, NULL, NEVER_MS, NULL, NULL);
+    long long start = traffic->last_us;
+    write_counters("tun0", 100, 100);
+    traffic_sample(traffic, start + SECOND_US); // call, counters went back
+    write_counters("tun0", 1100, 100);
+    traffic_sample(traffic, start + 2 * SECOND_US); // call
+    nordi_traffic_sample_t sample;
+    assert_true(nordi_traffic_pop(traffic, &sample));
+    assert_double(sample.rx_rate, ==, 1000.0);
+    assert_double(sample.tx_rate, ==, 0.0);
+    assert_false(nordi_traffic_pop(traffic, &sample));
+    nordi_traffic_free(traffic);
+}
+
+TEST(test_nordi_traffic_ring_full) {
+    make_base();
+    write_counters("tun0", 0, 0);
+    nordi_traffic_ptr traffic = nordi_traffic_new(base_path, NULL, NEVER_MS, count_notify, NULL);
+    long long start = traffic->last_us;
+    for (int tick = 1; tick <= TRAFFIC_RING_SIZE + 5; tick++) {
+        traffic_sample(traffic, start + tick * SECOND_US); // call
+    }
+    assert_int(drain(traffic), ==, TRAFFIC_RING_SIZE);
+    assert_int(traffic->dropped, ==, 5);
+    // one notification for the whole batch
+    assert_int(notifications, ==, 1);
+    traffic_sample(traffic, start + (TRAFFIC_RING_SIZE + 6) * SECOND_US);
+    assert_int(notifications, ==, 2);
+    nordi_traffic_free(traffic);
+}
+
+TEST(test_nordi_traffic_pause) {
+    make_base();
+    write_counters("tun0", 0, 0);
+    nordi_traffic_ptr traffic = nordi_traffic_new(base_path, NULL, FAST_MS, count_notify, NULL);
+    thrd_sleep(RUN_WAIT, NULL);
+    assert_int(drain(traffic), >, 0);
+    nordi_traffic_pause(traffic, true); // call
+    drain(traffic);
+    thrd_sleep(RUN_WAIT, NULL);
+    assert_int(drain(traffic), ==, 0);
+    nordi_traffic_pause(traffic, false); // call
+    thrd_sleep(RUN_WAIT, NULL);
+    assert_int(drain(traffic), >, 0);
+    nordi_traffic_free(traffic);
+}
+
+TEST(test_nordi_traffic_set_interval) {
+    make_base();
+    write_counters("tun0", 0, 0);
+    nordi_traffic_ptr traffic = nordi_traffic_new(base_path, NULL, NEVER_MS, count_notify, NULL);
+    thrd_sleep(RUN_WAIT, NULL);
+    assert_int(drain(traffic), ==, 0);
+    nordi_traffic_set_interval(traffic, FAST_MS); // call
+    thrd_sleep(RUN_WAIT, NULL);
+    assert_int(drain(traffic), >, 0);
+    assert_uint(traffic->wakeups, >, 0);
+    nordi_traffic_pause(traffic, true);
+    nordi_traffic_set_interval(traffic, FAST_MS * 2); // call, stays paused
+    drain(traffic);
+    thrd_sleep(RUN_WAIT, NULL);
+    assert_int(drain(traffic), ==, 0);
+    nordi_traffic_set_interval(traffic, 0); // call
+    assert_int(traffic->interval_ms, ==, TRAFFIC_DEFAULT_INTERVAL_MS);
+    nordi_traffic_free(traffic);
+}
+
+TEST(test_nordi_traffic_read) {
+    make_base();
+    write_counters("tun0", 10, 20);
+    nordi_traffic_ptr traffic = nordi_traffic_new(base_path, NULL, NEVER_MS, NULL, NULL);
+    write_counters("tun0", 12345, 678);
+    uint64_t rx = 0, tx = 0;
+    assert_true(nordi_traffic_read(traffic, &rx, &tx)); // call
+    assert_llong(rx, ==, 12345);
+    assert_llong(tx, ==, 678);
+    assert_false(nordi_traffic_read(NULL, &rx, &tx)); // call
+    nordi_traffic_free(traffic);
+}
+
+TESTS(traffic_tests) = {
+    TESTRUN("/autodetect-ok", test_nordi_traffic_autodetect),
+    TESTRUN("/autodetect-fail-missing", test_nordi_traffic_fail_missing),
+    TESTRUN("/rate-ok", test_nordi_traffic_rate),
+    TESTRUN("/rate-ok-reset", test_nordi_traffic_reset),
+    TESTRUN("/ring-full-drop", test_nordi_traffic_ring_full),
+    TESTRUN("/pause-ok", test_nordi_traffic_pause),
+    TESTRUN("/set-interval-ok", test_nordi_traffic_set_interval),
+    TESTRUN("/read-ok", test_nordi_traffic_read),
+    TESTEND,
+};
@@ -0,0 +1,7 @@
+#ifndef NORDI_TRAFFIC_UNITTEST_H_
+#define NORDI_TRAFFIC_UNITTEST_H_
+
+#include "../src/nordi_traffic.c"
+#include "nordi_unittest.h"
+
+#endif /* NORDI_TRAFFIC_UNITTEST_H_ */
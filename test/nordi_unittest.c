@@ -4,6 +4,28 @@ SUITES(suites) = {
     SUITE("/nordvpn-server", server_tests),
     SUITE("/nordvpn-api", api_tests),
     SUITE("/nordi-routines", routine_tests),
+    SUITE("/nordi-queue", queue_tests),
+    SUITE("/nordi-probe", probe_tests),
+    SUITE("/nordi-monitor", monitor_tests),
+    SUITE("/nordi-traffic", traffic_tests),
+    SUITE("/nordi-usage", usage_tests),
+    SUITE("/nordi-history", history_tests),
+    SUITE("/nordi-selector", selector_tests),
+    SUITE("/nordi-speculation", speculation_tests),
+    SUITE("/nordi-catalog", catalog_tests),
+    SUITE("/nordi-geo", geo_tests),
+    SUITE("/nordi-filter", filter_tests),
+    SUITE("/nordi-search", search_tests),
+    SUITE("/nordi-allowlist", allowlist_tests),
+    SUITE("/nordi-dns", dns_tests),
+    SUITE("/nordi-speedtest", speedtest_tests),
+    SUITE("/nordi-bench", bench_tests),
+    SUITE("/nordi-view", view_tests),
+    SUITE("/nordi-bus", bus_tests),
+    SUITE("/nordi-refresh", refresh_tests),
+    SUITE("/nordi-watchdog", watchdog_tests),
+    SUITE("/nordi-resources", resources_tests),
+    SUITE("/nordi-trace", trace_tests),
 };
 
 int
@@ -19,3 +19,25 @@
 extern TESTS(server_tests);
 extern TESTS(api_tests);
 extern TESTS(routine_tests);
+extern TESTS(queue_tests);
+extern TESTS(probe_tests);
+extern TESTS(monitor_tests);
+extern TESTS(traffic_tests);
+extern TESTS(usage_tests);
+extern TESTS(history_tests);
+extern TESTS(selector_tests);
+extern TESTS(speculation_tests);
+extern TESTS(catalog_tests);
+extern TESTS(geo_tests);
+extern TESTS(filter_tests);
+extern TESTS(search_tests);
+extern TESTS(allowlist_tests);
+extern TESTS(dns_tests);
+extern TESTS(speedtest_tests);
+extern TESTS(bench_tests);
+extern TESTS(view_tests);
+extern TESTS(bus_tests);
+extern TESTS(refresh_tests);
+extern TESTS(watchdog_tests);
+extern TESTS(resources_tests);
+extern TESTS(trace_tests);
@@ -0,0 +1,158 @@
+#include "nordi_usage_unittest.h"
+
+#define NOON       1683720000 // 2023-05-10 12:00 UTC, mid month and mid day in any timezone
+#define DAY_S      86400
+#define NEVER_S    1000000
+#define MIB        1048576ULL
+#define MANY_DAYS  40
+
+static char journal[USAGE_MAX_PATH] = {};
+
+static const char*
+make_journal() {
+    char directory[] = "/tmp/nordi-usage-XXXXXX";
+    snprintf(journal, USAGE_MAX_PATH, "%s/usage.dat", mkdtemp(directory));
+    return journal;
+}
+
+static off_t
+journal_size() {
+    struct stat info;
+    stat(journal, &info);
+    return info.st_size;
+}
+
+TEARDOWN(tear_down_test) {
+    char temporary[USAGE_MAX_PATH + sizeof(TEMPORARY_SUFFIX)];
+    snprintf(temporary, sizeof(temporary), "%s" TEMPORARY_SUFFIX, journal);
+    unlink(temporary);
+    unlink(journal);
+    *strrchr(journal, '/') = '\0';
+    rmdir(journal);
+}
+
+TEST(test_nordi_usage_accumulate) {
+    nordi_usage_ptr usage = nordi_usage_open(make_journal(), NEVER_S);
+    assert_not_null(usage);
+    nordi_usage_update(usage, 100 * MIB, 10 * MIB, NOON); // call, baseline only
+    nordi_usage_update(usage, 150 * MIB, 15 * MIB, NOON + 60); // call
+    nordi_usage_update(usage, 20 * MIB, 2 * MIB, NOON + 120); // call, reconnected, counters went back
+    nordi_usage_total_t total;
+    nordi_usage_day(usage, NOON, &total);
+    assert_llong(total.rx, ==, 70 * MIB);
+    assert_llong(total.tx, ==, 7 * MIB);
+    nordi_usage_reset_counters(usage);
+    nordi_usage_update(usage, 30 * MIB, 3 * MIB, NOON + 180); // call, new interface
+    nordi_usage_day(usage, NOON, &total);
+    assert_llong(total.rx, ==, 100 * MIB);
+    assert_llong(total.tx, ==, 10 * MIB);
+    nordi_usage_close(usage);
+}
+
+TEST(test_nordi_usage_persist) {
+    nordi_usage_ptr usage = nordi_usage_open(make_journal(), NEVER_S);
+    nordi_usage_update(usage, 0, 0, NOON);
+    nordi_usage_update(usage, 10 * MIB, 1 * MIB, NOON);
+    nordi_usage_update(usage, 30 * MIB, 2 * MIB, NOON + DAY_S);
+    nordi_usage_close(usage); // call
+    assert_int(journal_size(), ==, 2 * sizeof(usage_record_t));
+    usage = nordi_usage_open(journal, NEVER_S); // call
+    nordi_usage_total_t total;
+    nordi_usage_day(usage, NOON + DAY_S, &total);
+    assert_llong(total.rx, ==, 20 * MIB);
+    assert_llong(total.tx, ==, 1 * MIB);
+    nordi_usage_month(usage, NOON, &total);
+    assert_llong(total.rx, ==, 30 * MIB);
+    assert_llong(total.tx, ==, 2 * MIB);
+    assert_int(total.date % 100, ==, 0);
+    nordi_usage_day(usage, NOON - DAY_S, &total);
+    assert_llong(total.rx, ==, 0);
+    nordi_usage_close(usage);
+}
+
+TEST(test_nordi_usage_coarse_flush) {
+    nordi_usage_ptr usage = nordi_usage_open(make_journal(), 600);
+    usage->last_flush = NOON;
+    nordi_usage_update(usage, 0, 0, NOON);
+    for (int second = 1; second < 600; second++) {
+        nordi_usage_update(usage, second * MIB, second, NOON + second); // call
+    }
+    assert_int(usage->flushes, ==, 0);
+    assert_int(journal_size(), ==, 0);
+    nordi_usage_update(usage, 600 * MIB, 600, NOON + 600); // call
+    assert_int(usage->flushes, ==, 1);
+    assert_int(journal_size(), ==, sizeof(usage_record_t));
+    nordi_usage_close(usage);
+}
+
+TEST(test_nordi_usage_torn_record) {
+    nordi_usage_ptr usage = nordi_usage_open(make_journal(), 0);
+    nordi_usage_update(usage, 0, 0, NOON);
+    nordi_usage_update(usage, 5 * MIB, 5 * MIB, NOON);
+    nordi_usage_close(usage);
+    // half a record, as if the machine died mid write
+    int fd = open(journal, O_WRONLY | O_APPEND);
+    usage_record_t torn = {.date = 20230510, .rx = MIB};
+    write(fd, &torn, sizeof(torn) / 2);
+    close(fd);
+    usage = nordi_usage_open(journal, 0); // call
+    assert_not_null(usage);
+    assert_int(journal_size(), ==, sizeof(usage_record_t));
+    nordi_usage_total_t total;
+    nordi_usage_day(usage, NOON, &total);
+    assert_llong(total.rx, ==, 5 * MIB);
+    nordi_usage_close(usage);
+}
+
+TEST(test_nordi_usage_corrupt_record) {
+    nordi_usage_ptr usage = nordi_usage_open(make_journal(), 0);
+    nordi_usage_update(usage, 0, 0, NOON);
+    nordi_usage_update(usage, 5 * MIB, 0, NOON);
+    nordi_usage_close(usage);
+    int fd = open(journal, O_WRONLY | O_APPEND);
+    usage_record_t corrupt = {.date = 20230510, .crc = 1, .rx = MIB};
+    write(fd, &corrupt, sizeof(corrupt));
+    close(fd);
+    usage = nordi_usage_open(journal, 0); // call
+    nordi_usage_total_t total;
+    nordi_usage_day(usage, NOON, &total);
+    assert_llong(total.rx, ==, 5 * MIB);
+    assert_int(usage->records, ==, 1);
+    nordi_usage_close(usage);
+}
+
+TEST(test_nordi_usage_compact) {
+    nordi_usage_ptr usage = nordi_usage_open(make_journal(), 0);
+    nordi_usage_update(usage, 0, 0, NOON);
+    for (int update = 1; update <= 4 * COMPACT_SLACK; update++) {
+        nordi_usage_update(usage, update * MIB, update, NOON + (update % MANY_DAYS) * DAY_S); // call
+    }
+    assert_int(usage->records, <=, 2 * usage->day_count + COMPACT_SLACK);
+    nordi_usage_close(usage);
+    usage = nordi_usage_open(journal, 0);
+    assert_int(usage->day_count, ==, MANY_DAYS);
+    uint64_t rx = 0, tx = 0;
+    for (int day = 0; day < usage->day_count; day++) {
+        rx += usage->days[day].rx;
+        tx += usage->days[day].tx;
+    }
+    assert_llong(rx, ==, 4 * COMPACT_SLACK * MIB);
+    assert_llong(tx, ==, 4 * COMPACT_SLACK);
+    nordi_usage_close(usage);
+}
+
+TEST(test_nordi_usage_fail_open) {
+    assert_null(nordi_usage_open("/nonexistent/nordi/usage.dat", 0)); // call
+    snprintf(journal, USAGE_MAX_PATH, "/tmp/nordi-none/none");
+}
+
+TESTS(usage_tests) = {
+    TESTRUN("/accumulate-ok", test_nordi_usage_accumulate),
+    TESTRUN("/persist-ok", test_nordi_usage_persist),
+    TESTRUN("/flush-coarse", test_nordi_usage_coarse_flush),
+    TESTRUN("/load-ok-torn", test_nordi_usage_torn_record),
+    TESTRUN("/load-ok-corrupt", test_nordi_usage_corrupt_record),
+    TESTRUN("/compact-ok", test_nordi_usage_compact),
+    TESTRUN("/open-fail-path", test_nordi_usage_fail_open),
+    TESTEND,
+};
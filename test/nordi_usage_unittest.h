@@ -0,0 +1,7 @@
+#ifndef NORDI_USAGE_UNITTEST_H_
+#define NORDI_USAGE_UNITTEST_H_
+
+#include "../src/nordi_usage.c"
+#include "nordi_unittest.h"
+
+#endif /* NORDI_USAGE_UNITTEST_H_ */
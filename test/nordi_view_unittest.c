@@ -0,0 +1,103 @@
+#include "nordi_view_unittest.h"
+
+#define MANY_STATUSES (VIEW_STATUS_RING + 4)
+
+static nordi_view_ptr view = NULL;
+
+TEARDOWN(tear_down_test) {
+    nordi_view_free(view);
+    view = NULL;
+}
+
+TEST(test_nordi_view_commit_first) {
+    view = nordi_view_new();
+    assert_not_null(view);
+    assert_uint(nordi_view_commit(view), ==, VIEW_ALL); // call, nothing is shown yet
+    // what nothing set yet is applied as the widgets start, connect and login still shown
+    assert_true(view->applied.is_connect_visible);
+    assert_true(view->applied.is_connect_sensitive);
+    assert_false(view->applied.is_logged_in);
+    assert_uint(nordi_view_commit(view), ==, 0); // call
+    return MUNIT_OK;
+}
+
+TEST(test_nordi_view_commit_changed_only) {
+    view = nordi_view_new();
+    nordi_view_set_connection(view, false, NULL, NULL);
+    nordi_view_set_account(view, "user@mail.com", "Dec 1st, 2024");
+    nordi_view_commit(view);
+    nordi_view_set_connection(view, true, "10.0.0.1", "de507.nordvpn.com");
+    nordi_view_set_account(view, "user@mail.com", "Dec 1st, 2024");
+    assert_uint(nordi_view_commit(view), ==, VIEW_ONLINE | VIEW_IP | VIEW_HOST); // call
+    assert_string_equal(view->applied.host, "de507.nordvpn.com");
+    nordi_view_set_connection(view, true, "10.0.0.2", "de507.nordvpn.com");
+    assert_uint(nordi_view_commit(view), ==, VIEW_IP); // call
+    nordi_view_set_account(view, "", NULL);
+    nordi_view_set_connect_visible(view, false);
+    assert_uint(nordi_view_commit(view), ==, VIEW_LOGGED_IN | VIEW_EMAIL | VIEW_EXPIRY | VIEW_CONNECT_VISIBLE); // call
+    assert_false(view->applied.is_logged_in);
+    assert_string_equal(view->applied.expiry, "");
+    nordi_view_set_connect_sensitive(view, false);
+    assert_uint(nordi_view_commit(view), ==, VIEW_CONNECT_SENSITIVE); // call
+    return MUNIT_OK;
+}
+
+TEST(test_nordi_view_commit_coalesced) {
+    view = nordi_view_new();
+    nordi_view_set_connection(view, false, NULL, NULL);
+    nordi_view_commit(view);
+    // a flap between two frames shows nothing new
+    nordi_view_set_connection(view, true, "10.0.0.1", "de507.nordvpn.com");
+    nordi_view_set_connection(view, false, NULL, NULL);
+    assert_uint(nordi_view_commit(view), ==, 0); // call
+    return MUNIT_OK;
+}
+
+TEST(test_nordi_view_set_connection_transition) {
+    view = nordi_view_new();
+    assert_true(nordi_view_set_connection(view, false, NULL, NULL)); // call, first
+    assert_false(nordi_view_set_connection(view, false, NULL, NULL)); // call
+    assert_true(nordi_view_set_connection(view, true, "10.0.0.1", "de507.nordvpn.com")); // call
+    assert_false(nordi_view_set_connection(view, true, "10.0.0.2", "de508.nordvpn.com")); // call
+    return MUNIT_OK;
+}
+
+TEST(test_nordi_view_status_ring) {
+    view = nordi_view_new();
+    assert_string_equal(nordi_view_status(view), "");
+    char text[VIEW_MAX_TEXT];
+    for (int status = 0; status < MANY_STATUSES; status++) {
+        snprintf(text, VIEW_MAX_TEXT, "status %d", status);
+        nordi_view_push_status(view, text); // call
+    }
+    nordi_view_push_status(view, text); // call, repeated
+    assert_uint(view->desired.status, ==, MANY_STATUSES);
+    assert_string_equal(nordi_view_status(view), "status 19");
+    char history[VIEW_MAX_TEXT * VIEW_STATUS_RING];
+    assert_int(nordi_view_status_history(view, history, sizeof(history), 3), ==, 3); // call
+    assert_string_equal(history, "status 19\nstatus 18\nstatus 17");
+    assert_int(nordi_view_status_history(view, history, sizeof(history), MANY_STATUSES), ==, VIEW_STATUS_RING); // call
+    assert_string_equal(strrchr(history, '\n') + 1, "status 4");
+    assert_uint(nordi_view_commit(view) & VIEW_STATUS, ==, VIEW_STATUS);
+    nordi_view_push_status(view, "status 19"); // call, still the latest
+    assert_uint(nordi_view_commit(view), ==, 0);
+    return MUNIT_OK;
+}
+
+TEST(test_nordi_view_status_history_empty) {
+    view = nordi_view_new();
+    char history[VIEW_MAX_TEXT] = "garbage";
+    assert_int(nordi_view_status_history(view, history, sizeof(history), VIEW_STATUS_SHOWN), ==, 0); // call
+    assert_string_equal(history, "");
+    return MUNIT_OK;
+}
+
+TESTS(view_tests) = {
+    TESTRUN("/commit-ok-first", test_nordi_view_commit_first),
+    TESTRUN("/commit-ok-changed-only", test_nordi_view_commit_changed_only),
+    TESTRUN("/commit-ok-coalesced", test_nordi_view_commit_coalesced),
+    TESTRUN("/set-connection-ok-transition", test_nordi_view_set_connection_transition),
+    TESTRUN("/status-ok-ring", test_nordi_view_status_ring),
+    TESTRUN("/status-history-ok-empty", test_nordi_view_status_history_empty),
+    TESTEND
+};
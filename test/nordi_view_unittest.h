@@ -0,0 +1,7 @@
+#ifndef NORDI_VIEW_UNITTEST_H_
+#define NORDI_VIEW_UNITTEST_H_
+
+#include "../src/nordi_view.c"
+#include "nordi_unittest.h"
+
+#endif /* NORDI_VIEW_UNITTEST_H_ */
@@ -0,0 +1,121 @@
+#include "nordi_watchdog_unittest.h"
+
+#define THRESHOLD_MS 20
+#define RELAXED_MS   200 // threshold no scheduling hiccup of the test thread reaches
+#define BEATS        5
+#define MAX_REPORT   2048
+
+static nordi_watchdog_ptr watchdog = NULL;
+static atomic_bool is_posted = false;
+
+static void
+post(void* context) {
+    atomic_store(&is_posted, true);
+}
+
+static void
+sleep_ms(int milliseconds) {
+    struct timespec duration = {.tv_sec = milliseconds / 1000, .tv_nsec = (milliseconds % 1000) * 1000000L};
+    thrd_sleep(&duration, NULL);
+}
+
+// The main loop getting to the posted heartbeat
+static void
+wait_posted() {
+    while (!atomic_exchange(&is_posted, false)) {
+        sleep_ms(1);
+    }
+}
+
+TEARDOWN(tear_down_test) {
+    nordi_watchdog_free(watchdog);
+    watchdog = NULL;
+    atomic_store(&is_posted, false);
+}
+
+TEST(test_nordi_watchdog_beat_on_time) {
+    watchdog = nordi_watchdog_new(RELAXED_MS, post, NULL);
+    assert_not_null(watchdog);
+    for (int beat = 0; beat < BEATS; beat++) {
+        wait_posted();
+        nordi_watchdog_enter(watchdog, "fast_handler");
+        nordi_watchdog_leave(watchdog);
+        nordi_watchdog_beat(watchdog); // call
+    }
+    assert_uint(watchdog->beats, ==, BEATS);
+    assert_uint(watchdog->stalls, ==, 0);
+    assert_int(watchdog->offender_count, ==, 0);
+    return MUNIT_OK;
+}
+
+TEST(test_nordi_watchdog_beat_stalled) {
+    watchdog = nordi_watchdog_new(THRESHOLD_MS, post, NULL);
+    wait_posted();
+    nordi_watchdog_enter(watchdog, "slow_handler"); // call
+    nordi_watchdog_enter(watchdog, "nested_handler"); // call, part of the slow one
+    sleep_ms(3 * THRESHOLD_MS);
+    nordi_watchdog_leave(watchdog); // call
+    nordi_watchdog_leave(watchdog); // call
+    nordi_watchdog_enter(watchdog, "fast_handler");
+    nordi_watchdog_leave(watchdog);
+    nordi_watchdog_beat(watchdog); // call
+    assert_uint(watchdog->stalls, ==, 1);
+    assert_int(watchdog->offender_count, ==, 1);
+    assert_string_equal(watchdog->offenders[0].name, "slow_handler");
+    assert_uint(watchdog->offenders[0].max_ms, >=, 3 * THRESHOLD_MS);
+    unsigned int histogram = 0;
+    for (int bucket = 0; bucket < WATCHDOG_BUCKETS; bucket++) {
+        histogram += watchdog->histogram[bucket];
+    }
+    // a late wakeup can only land it in a longer bucket
+    assert_uint(histogram, ==, 1);
+    assert_uint(watchdog->histogram[0], ==, 0);
+    // no handler ran for long, the stall is still counted
+    wait_posted();
+    nordi_watchdog_enter(watchdog, "fast_handler");
+    nordi_watchdog_leave(watchdog);
+    sleep_ms(2 * THRESHOLD_MS);
+    nordi_watchdog_beat(watchdog); // call
+    assert_uint(watchdog->stalls, ==, 2);
+    assert_string_equal(watchdog->offenders[1].name, WATCHDOG_UNKNOWN);
+    return MUNIT_OK;
+}
+
+TEST(test_nordi_watchdog_write) {
+    watchdog = nordi_watchdog_new(THRESHOLD_MS, post, NULL);
+    for (int stall = 1; stall <= 2; stall++) {
+        wait_posted();
+        nordi_watchdog_enter(watchdog, stall == 1 ? "short_handler" : "long_handler");
+        sleep_ms(stall * 2 * THRESHOLD_MS);
+        nordi_watchdog_leave(watchdog);
+        nordi_watchdog_beat(watchdog);
+    }
+    char report[MAX_REPORT] = {};
+    FILE* file = fmemopen(report, MAX_REPORT, "w");
+    nordi_watchdog_write(watchdog, file); // call
+    fclose(file);
+    assert_not_null(strstr(report, "2 stalls"));
+    char* longest = strstr(report, "long_handler");
+    char* shortest = strstr(report, "short_handler");
+    assert_not_null(longest);
+    assert_not_null(shortest);
+    assert_true(longest < shortest);
+    return MUNIT_OK;
+}
+
+TEST(test_nordi_watchdog_leave_unbalanced) {
+    watchdog = nordi_watchdog_new(THRESHOLD_MS, post, NULL);
+    nordi_watchdog_leave(watchdog); // call, never entered
+    assert_int(watchdog->depth, ==, 0);
+    nordi_watchdog_enter(NULL, "handler"); // call, disabled
+    nordi_watchdog_leave(NULL); // call
+    return MUNIT_OK;
+}
+
+TESTS(watchdog_tests) = {
+    TESTRUN("/beat-ok-on-time", test_nordi_watchdog_beat_on_time),
+    TESTRUN("/beat-ok-stalled", test_nordi_watchdog_beat_stalled),
+    TESTRUN("/write-ok", test_nordi_watchdog_write),
+    TESTRUN("/leave-ok-unbalanced", test_nordi_watchdog_leave_unbalanced),
+    TESTEND
+};
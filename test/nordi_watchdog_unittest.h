@@ -0,0 +1,7 @@
+#ifndef NORDI_WATCHDOG_UNITTEST_H_
+#define NORDI_WATCHDOG_UNITTEST_H_
+
+#include "../src/nordi_watchdog.c"
+#include "nordi_unittest.h"
+
+#endif /* NORDI_WATCHDOG_UNITTEST_H_ */
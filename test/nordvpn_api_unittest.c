@@ -1,8 +1,27 @@
 #include "nordvpn_api_unittest.h"
 
+#define REPLAY_TRACE "/tmp/nordi-api-replay.trace"
+// output of a command larger than the pipe, which holds 64 KiB by default
+#define LARGE_OUTPUT      200000
+#define LARGE_OUTPUT_TEXT "200000"
+
+// A session as the binary streamed it: the connect spinner arrives in chunks ahead of the result
+#define REPLAYED_SESSION                                                                                               \
+    "nordi-trace 1\n"                                                                                                  \
+    "run 0 1\narg version\nout 8000 " MOCKED_VERSION "\\n\nexit 9000 0\n"                                              \
+    "run 10000 1\narg account\nout 180000 Account Information:\\nEmail Address: " MOCKED_EMAIL                         \
+    "\\nVPN Service: " MOCKED_EXPIRY "\\n\nexit 181000 0\n"                                                            \
+    "run 200000 1\narg status\nout 30000 Status: Disconnected\\n\nexit 31000 0\n"                                      \
+    "run 300000 1\narg c\nout 5000 \\r-\\r  \\r\nout 105000 \\\\\\r  \\r\n"                                            \
+    "out 2400000 Connecting to Portugal #999 (" MOCKED_HOSTNAME ")\\nYou are connected to Portugal #999 ("             \
+    MOCKED_HOSTNAME ")!\\n\nexit 2401000 0\n"
+
 TEARDOWN(tear_down_test) {
     reset_mock_results();
+    nordi_trace_free(_mock_trace);
+    _mock_trace = NULL;
     nordvpn_close();
+    memset(nordvpn_get_stats(), 0, sizeof(nordvpn_stats_t));
 }
 
 static void
@@ -50,6 +69,19 @@ assert_filled_host() {
     assert_string_equal(str_ptr(host->hostname), MOCKED_HOSTNAME);
     assert_string_equal(str_ptr(host->ip), MOCKED_IP);
     assert_string_equal(str_ptr(host->last_server), MOCKED_LAST_SERVER);
+    assert_int(host->technology, ==, TECHNOLOGY_NORDLYNX);
+}
+
+static void
+assert_partial_host() {
+    nordvpn_host_ptr host = nordvpn_get_host();
+    str empty_str = str_null;
+    assert_true(host->is_online);
+    assert_true(host->is_partial);
+    assert_int(host->country, ==, MOCKED_COUNTRY);
+    assert_string_equal(str_ptr(host->hostname), MOCKED_HOSTNAME);
+    assert_string_equal(str_ptr(host->last_server), MOCKED_LAST_SERVER);
+    assert_memory_equal(sizeof(str), &(host->ip), &empty_str);
 }
 
 static void
@@ -66,6 +98,7 @@ fill_host() {
     nordvpn_host_ptr host = nordvpn_get_host();
     host->is_online = true;
     host->country = MOCKED_COUNTRY;
+    host->technology = TECHNOLOGY_NORDLYNX;
     host->ip = str_lit(MOCKED_IP);
     host->hostname = str_lit(MOCKED_HOSTNAME);
     host->proto = str_lit(MOCKED_PROTO);
@@ -98,6 +131,21 @@ TEST(test_nordvpn_open_success_con) {
     assert_filled_host();
 }
 
+TEST(test_nordvpn_write_stats) {
+    add_mock_result(OK, MOCKED_VERSION, NARGS("version"));
+    add_mock_result(OK, MOCKED_ACCOUNT, NARGS("account"));
+    add_mock_result(OK, MOCKED_DISSTATUS, NARGS("status"));
+    assert_int(nordvpn_open(), ==, OK);
+    char report[MAX_BUFFER] = {};
+    FILE* file = fmemopen(report, MAX_BUFFER, "w");
+    nordvpn_write_stats(file); // call
+    fclose(file);
+    assert_not_null(strstr(report, "open"));
+    assert_not_null(strstr(report, "1 calls      3 spawns (3.00 per call)\n"));
+    // actions never requested are left out
+    assert_null(strstr(report, "connect"));
+}
+
 TEST(test_nordvpn_open_fail_version) {
     add_mock_result(FAILED_EXECUTE, "", NARGS("version")); // first call to nordvpn version
     assert_int(nordvpn_open(), ==, FAILED_EXECUTE);        // call
@@ -197,6 +245,16 @@ TEST(test_nordvpn_logout_success) {
     assert_empty_host();
 }
 
+TEST(test_nordvpn_logout_success_derived) {
+    add_mock_result(OK, MOCKED_LOGGEDOUT, NARGS("logout"));
+    fill_session();
+    fill_host();
+    assert_int(nordvpn_logout(), ==, OK); // call
+    assert_empty_user();
+    assert_empty_host();
+    assert_int(nordvpn_get_stats()->spawns[ACTION_LOGOUT], ==, 1);
+}
+
 TEST(test_nordvpn_logout_fail_no_session) {
     add_mock_result(OK, MOCKED_LOGOUT, NARGS("logout"));
     assert_int(nordvpn_logout(), ==, NO_SESSION); // call
@@ -250,6 +308,15 @@ TEST(test_nordvpn_connect_success_group) {
     assert_filled_host();
 }
 
+TEST(test_nordvpn_connect_success_derived) {
+    add_mock_result(OK, MOCKED_CONNECT, NARGS("c", "Portugal"));
+    fill_session();
+    assert_int(nordvpn_server_connect(NORDVPN_COUNTRY_STR[PORTUGAL]), ==, OK); // call
+    assert_partial_host();
+    assert_int(nordvpn_get_stats()->calls[ACTION_CONNECT], ==, 1);
+    assert_int(nordvpn_get_stats()->spawns[ACTION_CONNECT], ==, 1);
+}
+
 TEST(test_nordvpn_connect_fail_execute) {
     add_mock_result(FAILED_EXECUTE, "", NARGS("c"));
     fill_session();
@@ -265,6 +332,15 @@ TEST(test_nordvpn_connect_fail_update) {
     assert_empty_host();
 }
 
+TEST(test_nordvpn_connect_fail_tried) {
+    add_mock_result(OK, "Connecting to Portugal #999 (" MOCKED_HOSTNAME ")\n" MOCKED_CONNFAILED, NARGS("c", "Portugal"));
+    add_mock_result(OK, MOCKED_DISSTATUS, NARGS("status"));
+    fill_session();
+    assert_int(nordvpn_server_connect(NORDVPN_COUNTRY_STR[PORTUGAL]), ==, OK); // call
+    assert_empty_host();
+    assert_string_equal(str_ptr(nordvpn_get_host()->tried_server), MOCKED_LAST_SERVER);
+}
+
 TEST(test_nordvpn_disconnect_success_quick) {
     add_mock_result(OK, "", NARGS("d"));
     add_mock_result(OK, MOCKED_DISSTATUS, NARGS("status"));
@@ -276,6 +352,17 @@ TEST(test_nordvpn_disconnect_success_quick) {
     assert_string_equal(str_ptr(host->last_server), MOCKED_LAST_SERVER);
 }
 
+TEST(test_nordvpn_disconnect_success_derived) {
+    add_mock_result(OK, MOCKED_DISCONNECT, NARGS("d"));
+    fill_session();
+    fill_host();
+    nordvpn_host_ptr host = nordvpn_get_host();
+    assert_int(nordvpn_disconnect(), ==, OK); // call
+    assert_empty_host();
+    assert_string_equal(str_ptr(host->last_server), MOCKED_LAST_SERVER);
+    assert_int(nordvpn_get_stats()->spawns[ACTION_DISCONNECT], ==, 1);
+}
+
 TEST(test_nordvpn_disconnect_fail_execute) {
     add_mock_result(FAILED_EXECUTE, "", NARGS("d"));
     fill_session();
@@ -324,10 +411,192 @@ TEST(test_nordvpn_reconnect_fail_update) {
     assert_empty_host();
 }
 
+TEST(test_nordvpn_sync_success_partial) {
+    add_mock_result(OK, MOCKED_CONNECT, NARGS("c"));
+    add_mock_result(OK, MOCKED_CONSTATUS, NARGS("status"));
+    fill_session();
+    assert_int(nordvpn_connect(), ==, OK); // call
+    assert_partial_host();
+    assert_int(nordvpn_sync_host(), ==, OK); // call
+    assert_filled_host();
+    assert_false(nordvpn_get_host()->is_partial);
+    assert_int(nordvpn_sync_host(), ==, OK); // call, nothing left to sync
+    assert_int(nordvpn_get_stats()->spawns[ACTION_SYNC], ==, 1);
+}
+
+TEST(test_nordvpn_sync_fail_session) {
+    assert_int(nordvpn_sync_host(), ==, NO_SESSION); // call
+    assert_empty_host();
+}
+
+static void
+assert_openvpn_settings() {
+    nordvpn_settings_ptr settings = nordvpn_get_settings();
+    assert_true(settings->is_known);
+    assert_int(settings->technology, ==, TECHNOLOGY_OPENVPN);
+    assert_string_equal(str_ptr(settings->protocol), "TCP");
+    assert_string_equal(str_ptr(settings->dns), MOCKED_DNS);
+    assert_true(settings->obfuscate);
+    assert_true(settings->killswitch);
+    assert_false(settings->threat_protection);
+}
+
+// The settings of MOCKED_SETTINGS switched to the ones of MOCKED_OPENVPN_SETTINGS
+static void
+fill_openvpn_settings(nordvpn_settings_t* desired) {
+    nordvpn_copy_settings(desired, nordvpn_get_settings());
+    desired->technology = TECHNOLOGY_OPENVPN;
+    str_assign(&(desired->protocol), str_lit("TCP"));
+    desired->obfuscate = true;
+    desired->killswitch = true;
+    desired->threat_protection = false;
+    str_assign(&(desired->dns), str_lit(MOCKED_DNS));
+}
+
+TEST(test_nordvpn_read_settings_success) {
+    add_mock_result(OK, MOCKED_SETTINGS, NARGS("settings"));
+    fill_session();
+    assert_int(nordvpn_read_settings(), ==, OK); // call
+    nordvpn_settings_ptr settings = nordvpn_get_settings();
+    assert_true(settings->is_known);
+    assert_int(settings->technology, ==, TECHNOLOGY_NORDLYNX);
+    assert_true(str_is_empty(settings->protocol));
+    assert_true(str_is_empty(settings->dns));
+    assert_true(settings->firewall);
+    assert_true(settings->routing);
+    assert_false(settings->killswitch);
+    assert_true(settings->threat_protection);
+    assert_true(settings->notify);
+    assert_false(settings->lan_discovery);
+    assert_string_equal(str_ptr(settings->allowlist), "22 (UDP|TCP)");
+    assert_int(nordvpn_get_stats()->spawns[ACTION_SETTINGS], ==, 1);
+}
+
+TEST(test_nordvpn_read_settings_fail_read) {
+    add_mock_result(OK, MOCKED_BADLINK, NARGS("settings"));
+    fill_session();
+    assert_int(nordvpn_read_settings(), ==, FAILED_READ); // call
+    assert_false(nordvpn_get_settings()->is_known);
+}
+
+TEST(test_nordvpn_read_settings_fail_session) {
+    assert_int(nordvpn_read_settings(), ==, NO_SESSION); // call
+    assert_false(nordvpn_get_settings()->is_known);
+}
+
+TEST(test_nordvpn_apply_settings_success_diff) {
+    add_mock_result(OK, MOCKED_SETTINGS, NARGS("settings"));
+    add_mock_result(OK, "", NARGS("set", "technology", "OPENVPN"));
+    add_mock_result(OK, "", NARGS("set", "protocol", "TCP"));
+    add_mock_result(OK, "", NARGS("set", "threatprotectionlite", "off"));
+    add_mock_result(OK, "", NARGS("set", "obfuscate", "on"));
+    add_mock_result(OK, "", NARGS("set", "killswitch", "on"));
+    add_mock_result(OK, "", NARGS("set", "dns", "1.1.1.1", "8.8.8.8"));
+    add_mock_result(OK, MOCKED_OPENVPN_SETTINGS, NARGS("settings"));
+    fill_session();
+    assert_int(nordvpn_read_settings(), ==, OK);
+    nordvpn_settings_t desired = {};
+    fill_openvpn_settings(&desired);
+    assert_int(nordvpn_apply_settings(&desired), ==, OK); // call
+    assert_openvpn_settings();
+    // one spawn per changed setting and a single read back
+    assert_int(nordvpn_get_stats()->spawns[ACTION_APPLY], ==, 7);
+    nordvpn_clear_settings(&desired);
+}
+
+TEST(test_nordvpn_apply_settings_success_unchanged) {
+    add_mock_result(OK, MOCKED_OPENVPN_SETTINGS, NARGS("settings"));
+    fill_session();
+    assert_int(nordvpn_read_settings(), ==, OK);
+    nordvpn_settings_t desired = {};
+    nordvpn_copy_settings(&desired, nordvpn_get_settings());
+    assert_int(nordvpn_apply_settings(&desired), ==, OK); // call
+    assert_openvpn_settings();
+    assert_int(nordvpn_get_stats()->spawns[ACTION_APPLY], ==, 0);
+    nordvpn_clear_settings(&desired);
+}
+
+TEST(test_nordvpn_apply_settings_fail_technology) {
+    add_mock_result(OK, MOCKED_SETTINGS, NARGS("settings"));
+    add_mock_result(FAILED_EXECUTE, "", NARGS("set", "technology", "OPENVPN"));
+    add_mock_result(OK, "", NARGS("set", "threatprotectionlite", "off"));
+    add_mock_result(OK, "", NARGS("set", "killswitch", "on"));
+    add_mock_result(OK, "", NARGS("set", "dns", "1.1.1.1", "8.8.8.8"));
+    add_mock_result(OK, MOCKED_SETTINGS, NARGS("settings"));
+    fill_session();
+    nordvpn_settings_t desired = {};
+    assert_int(nordvpn_read_settings(), ==, OK);
+    fill_openvpn_settings(&desired);
+    // the protocol and obfuscation depend on the technology, the other settings are still applied
+    assert_int(nordvpn_apply_settings(&desired), ==, FAILED_EXECUTE); // call
+    assert_int(nordvpn_get_settings()->technology, ==, TECHNOLOGY_NORDLYNX);
+    assert_int(nordvpn_get_stats()->spawns[ACTION_APPLY], ==, 5);
+    nordvpn_clear_settings(&desired);
+}
+
+TEST(test_nordvpn_apply_settings_fail_session) {
+    nordvpn_settings_t desired = {};
+    assert_int(nordvpn_apply_settings(&desired), ==, NO_SESSION); // call
+}
+
+TEST(test_nordvpn_change_allowlist_success) {
+    add_mock_result(OK, "", NARGS("allowlist", "add", "subnet", "10.0.0.0/8"));
+    add_mock_result(FAILED_EXECUTE, "", NARGS("allowlist", "add", "ports", "3000", "3100", "protocol", "TCP"));
+    add_mock_result(OK, "", NARGS("allowlist", "remove", "port", "22"));
+    add_mock_result(OK, MOCKED_SETTINGS, NARGS("settings"));
+    fill_session();
+    str changes = str_lit("add subnet 10.0.0.0/8\nadd ports 3000 3100 protocol TCP\nremove port 22\n");
+    // a failed change doesn't stop the ones after it
+    assert_int(nordvpn_change_allowlist(changes), ==, FAILED_EXECUTE); // call
+    assert_true(nordvpn_get_settings()->is_known);
+    assert_int(nordvpn_get_stats()->spawns[ACTION_ALLOWLIST], ==, 4);
+}
+
+TEST(test_nordvpn_execute_large_output) {
+    nordvpn_session_ptr session = nordvpn_get_session();
+    assert_int(pipe(session->pipe), ==, 0);
+    binary = "/bin/sh";
+    // more output than the pipe holds, the child blocks until it is read
+    const char* arguments[] = {"sh", "-c", "head -c " LARGE_OUTPUT_TEXT " /dev/zero | tr '\\0' x", NULL};
+    char* buffer = (char*)calloc(LARGE_OUTPUT + 1, 1);
+    assert_int(_execute_nordvpn(session, buffer, LARGE_OUTPUT + 1, arguments), ==, OK); // call
+    assert_size(strlen(buffer), ==, LARGE_OUTPUT);
+    assert_char(buffer[LARGE_OUTPUT - 1], ==, 'x');
+    // output past the buffer is discarded, not left on the pipe for the next command
+    memset(buffer, 0, LARGE_OUTPUT + 1);
+    assert_int(_execute_nordvpn(session, buffer, MAX_BUFFER, arguments), ==, OK); // call
+    assert_size(strlen(buffer), ==, MAX_BUFFER - 1);
+    const char* echo[] = {"sh", "-c", "echo done", NULL};
+    memset(buffer, 0, LARGE_OUTPUT + 1);
+    assert_int(_execute_nordvpn(session, buffer, MAX_BUFFER, echo), ==, OK); // call
+    assert_string_equal(buffer, "done\n");
+    free(buffer);
+    binary = NORDVPN;
+    close(session->pipe[PIPEIN]);
+    close(session->pipe[PIPEOUT]);
+}
+
+TEST(test_nordvpn_replay_session) {
+    FILE* file = fopen(REPLAY_TRACE, "w");
+    fputs(REPLAYED_SESSION, file);
+    fclose(file);
+    _mock_trace = nordi_trace_load(REPLAY_TRACE);
+    unlink(REPLAY_TRACE);
+    assert_not_null(_mock_trace);
+    assert_int(nordvpn_open(), ==, OK); // call
+    assert_filled_session();
+    assert_false(nordvpn_get_host()->is_online);
+    assert_int(nordvpn_connect(), ==, OK); // call, parsed from the chunks the spinner left behind
+    assert_partial_host();
+    // the trace has no logout
+    assert_int(nordvpn_logout(), ==, FAILED_EXECUTE);
+}
+
 TESTS(api_tests) = {
     TESTRUN("/close-all", test_nordvpn_close),
     TESTRUN("/open-ok-disconnected", test_nordvpn_open_success_dc),
     TESTRUN("/open-ok-connected", test_nordvpn_open_success_con),
+    TESTRUN("/write-stats-ok", test_nordvpn_write_stats),
     TESTRUN("/open-fail-version", test_nordvpn_open_fail_version),
     TESTRUN("/open-fail-account", test_nordvpn_open_fail_account),
     TESTRUN("/open-fail-status", test_nordvpn_open_fail_status),
@@ -339,19 +608,35 @@ TESTS(api_tests) = {
     TESTRUN("/login-fail-execute", test_nordvpn_login_fail_execute),
     TESTRUN("/login-fail-badlink", test_nordvpn_login_fail_link),
     TESTRUN("/logout-ok-was-in", test_nordvpn_logout_success),
+    TESTRUN("/logout-ok-derived", test_nordvpn_logout_success_derived),
     TESTRUN("/logout-fail-was-out", test_nordvpn_logout_fail_already_out),
     TESTRUN("/logout-fail-no-session", test_nordvpn_logout_fail_no_session),
     TESTRUN("/logout-fail-execute", test_nordvpn_logout_fail_execute),
     TESTRUN("/connect-ok-quick", test_nordvpn_connect_success_quick),
     TESTRUN("/connect-ok-country", test_nordvpn_connect_success_country),
     TESTRUN("/connect-ok-group", test_nordvpn_connect_success_group),
+    TESTRUN("/connect-ok-derived", test_nordvpn_connect_success_derived),
     TESTRUN("/connect-fail-execute", test_nordvpn_connect_fail_execute),
     TESTRUN("/connect-fail-update", test_nordvpn_connect_fail_update),
+    TESTRUN("/connect-fail-tried", test_nordvpn_connect_fail_tried),
     TESTRUN("/disconnect-ok-quick", test_nordvpn_disconnect_success_quick),
+    TESTRUN("/disconnect-ok-derived", test_nordvpn_disconnect_success_derived),
     TESTRUN("/disconnect-fail-execute", test_nordvpn_disconnect_fail_execute),
     TESTRUN("/disconnect-fail-update", test_nordvpn_disconnect_fail_update),
     TESTRUN("/reconnect-ok-quick", test_nordvpn_logout_fail_execute),
     TESTRUN("/reconnect-fail-execute", test_nordvpn_logout_fail_execute),
     TESTRUN("/reconnect-fail-update", test_nordvpn_logout_fail_execute),
+    TESTRUN("/sync-ok-partial", test_nordvpn_sync_success_partial),
+    TESTRUN("/sync-fail-no-session", test_nordvpn_sync_fail_session),
+    TESTRUN("/read-settings-ok", test_nordvpn_read_settings_success),
+    TESTRUN("/read-settings-fail-read", test_nordvpn_read_settings_fail_read),
+    TESTRUN("/read-settings-fail-no-session", test_nordvpn_read_settings_fail_session),
+    TESTRUN("/apply-settings-ok-diff", test_nordvpn_apply_settings_success_diff),
+    TESTRUN("/apply-settings-ok-unchanged", test_nordvpn_apply_settings_success_unchanged),
+    TESTRUN("/apply-settings-fail-technology", test_nordvpn_apply_settings_fail_technology),
+    TESTRUN("/apply-settings-fail-no-session", test_nordvpn_apply_settings_fail_session),
+    TESTRUN("/change-allowlist-ok-partial", test_nordvpn_change_allowlist_success),
+    TESTRUN("/replay-ok-session", test_nordvpn_replay_session),
+    TESTRUN("/execute-ok-large-output", test_nordvpn_execute_large_output),
     TESTEND,
 };
@@ -3,6 +3,7 @@
 
 #include "../src/nordvpn_api.c"
 #include "nordi_unittest.h"
+#include "nordvpn_fake.h"
 
 #define MOCKED_VERSION     "NordVPN Version 3.16.6"
 #define MOCKED_EMAIL       "example@mail.org"
@@ -16,7 +17,15 @@
 #define MOCKED_GOODLINK    "Proceed here: http://nordvpn.com/api/user/loginstuff\n"
 #define MOCKED_BADLINK     "Timed out trying to get link\n"
 #define MOCKED_LOGOUT      "logout"
+#define MOCKED_LOGGEDOUT   "You are logged out.\n"
+#define MOCKED_CONNECT                                                                                                                     \
+    "\r-\r  \r\\\r  \rConnecting to Portugal #999 (ab999.nordvpn.com)\n"                                                                     \
+    "You are connected to Portugal #999 (ab999.nordvpn.com)!\n"
+#define MOCKED_DISCONNECT                                                                                                                  \
+    "You are disconnected from NordVPN.\n"                                                                                                 \
+    "How would you rate your connection quality on a scale from 1 (poor) to 5 (excellent)? Type 'nordvpn rate [1-5]'.\n"
 #define MOCKED_DISSTATUS   "Status: Disconnected\n"
+#define MOCKED_CONNFAILED  "Whoops! Connection failed. Please try again.\n"
 #define MOCKED_CONSTATUS                                                                                                                   \
     "Status: Connected\n"                                                                                                                  \
     "Hostname: ab999.nordvpn.com\n"                                                                                                        \
@@ -31,6 +40,36 @@
     "Account Information:\n"                                                                                                               \
     "Email Address: example@mail.org\n"                                                                                                    \
     "VPN Service: Active (Expires on Jan 1st, 2077)\n"
+#define MOCKED_SETTINGS                                                                                                                    \
+    "Technology: NORDLYNX\n"                                                                                                                \
+    "Firewall: enabled\n"                                                                                                                   \
+    "Firewall Mark: 0xe1f1\n"                                                                                                               \
+    "Routing: enabled\n"                                                                                                                    \
+    "Kill Switch: disabled\n"                                                                                                               \
+    "Threat Protection Lite: enabled\n"                                                                                                     \
+    "Notify: enabled\n"                                                                                                                     \
+    "Auto-connect: disabled\n"                                                                                                              \
+    "IPv6: disabled\n"                                                                                                                      \
+    "Meshnet: disabled\n"                                                                                                                   \
+    "DNS: disabled\n"                                                                                                                       \
+    "LAN Discovery: disabled\n"                                                                                                             \
+    "Allowlisted ports:\n"                                                                                                                  \
+    "\t22 (UDP|TCP)\n"
+#define MOCKED_OPENVPN_SETTINGS                                                                                                            \
+    "Technology: OPENVPN\n"                                                                                                                 \
+    "Protocol: TCP\n"                                                                                                                       \
+    "Firewall: enabled\n"                                                                                                                   \
+    "Routing: enabled\n"                                                                                                                    \
+    "Kill Switch: enabled\n"                                                                                                                \
+    "Threat Protection Lite: disabled\n"                                                                                                    \
+    "Obfuscate: enabled\n"                                                                                                                  \
+    "Notify: enabled\n"                                                                                                                     \
+    "Auto-connect: disabled\n"                                                                                                              \
+    "IPv6: disabled\n"                                                                                                                      \
+    "Meshnet: disabled\n"                                                                                                                   \
+    "DNS: 1.1.1.1, 8.8.8.8\n"                                                                                                               \
+    "LAN Discovery: disabled\n"
+#define MOCKED_DNS         "1.1.1.1, 8.8.8.8"
 
 #define MAX_API_CALLS_ 10
 
@@ -52,8 +91,144 @@ static _mock_result_t _mock_result = {};
     _mock_result.index = 0;                                                                                                                \
     _mock_result.max_index++
 
+#define FAKE_STEP_US 100
+
+fake_nordvpn_t*
+fake_nordvpn() {
+    static fake_nordvpn_t fake = {};
+    return &fake;
+}
+
+void
+fake_nordvpn_wait_spawns(unsigned int spawns) {
+    while (fake_nordvpn()->spawns < spawns) {
+        thrd_sleep(&(struct timespec){.tv_nsec = FAKE_STEP_US * 1000}, NULL);
+    }
+}
+
+static nordvpn_error_t
+_fake_run_nordvpn(nordvpn_session_ptr session, char* buffer, size_t size, const char** args) {
+    fake_nordvpn_t* fake = fake_nordvpn();
+    fake->spawns++;
+    for (int waited = 0;; waited += FAKE_STEP_US) {
+        // checked once more after the wait, a release can come along with a cancel
+        if (session->is_cancelled) {
+            fake->cancels++;
+            if (fake->is_finishing_late && strcmp(args[1], "c") == 0) {
+                snprintf(fake->late_server, MAX_FAKE_SERVER, "%s", args[2] != NULL ? args[2] : "quick");
+            }
+            return CANCELLED;
+        }
+        if (waited >= fake->delay_us && !fake->is_held) {
+            break;
+        }
+        thrd_sleep(&(struct timespec){.tv_nsec = FAKE_STEP_US * 1000}, NULL);
+    }
+    bool is_openvpn = strcmp(fake->technology, "OPENVPN") == 0, is_tcp = strcmp(fake->protocol, "TCP") == 0;
+    if (strcmp(args[1], "c") == 0) {
+        int delay_us = !is_openvpn ? fake->nordlynx_delay_us : is_tcp ? fake->tcp_delay_us : fake->udp_delay_us;
+        thrd_sleep(&(struct timespec){.tv_sec = delay_us / 1000000, .tv_nsec = (delay_us % 1000000) * 1000L}, NULL);
+        fake->connects++;
+        if (fake->fail_every > 0 && fake->connects % fake->fail_every == 0) {
+            fake->is_online = false;
+            strcpy(buffer, MOCKED_CONNFAILED);
+            return OK;
+        }
+        snprintf(fake->server, MAX_FAKE_SERVER, "%s", args[2] != NULL ? args[2] : "quick");
+        fake->is_online = true;
+        sprintf(buffer, "You are connected to Portugal #1 (%s.nordvpn.com)!\n", fake->server);
+    } else if (strcmp(args[1], "d") == 0) {
+        fake->is_online = false;
+        strcpy(buffer, MOCKED_DISCONNECT);
+    } else if (strcmp(args[1], "status") == 0 && fake->is_online) {
+        sprintf(buffer,
+                "Status: Connected\nHostname: %s.nordvpn.com\nIP: " MOCKED_IP
+                "\nCountry: Portugal\nCity: Somewhere\nCurrent technology: NORDLYNX\nCurrent protocol: UDP\n",
+                fake->server);
+    } else if (strcmp(args[1], "status") == 0) {
+        strcpy(buffer, MOCKED_DISSTATUS);
+    } else if (strcmp(args[1], "account") == 0) {
+        strcpy(buffer, MOCKED_ACCOUNT);
+    } else if (strcmp(args[1], "settings") == 0 && is_openvpn) {
+        // the technology and protocol as set, the rest as mocked
+        sprintf(buffer, "Technology: OPENVPN\nProtocol: %s\n%s", is_tcp ? "TCP" : "UDP",
+                strchr(MOCKED_SETTINGS, '\n') + 1);
+    } else if (strcmp(args[1], "settings") == 0) {
+        strcpy(buffer, MOCKED_SETTINGS);
+    } else if (strcmp(args[1], "set") == 0) {
+        if (strcmp(args[2], "dns") == 0) {
+            snprintf(fake->dns, MAX_FAKE_SERVER, "%s", args[3]);
+        } else if (strcmp(args[2], "technology") == 0) {
+            snprintf(fake->technology, MAX_FAKE_SERVER, "%s", args[3]);
+            // the daemon goes back to the default protocol along with the technology
+            fake->protocol[0] = '\0';
+        } else if (strcmp(args[2], "protocol") == 0) {
+            snprintf(fake->protocol, MAX_FAKE_SERVER, "%s", args[3]);
+        }
+    } else if (strcmp(args[1], "allowlist") == 0) {
+        fake->allowlist_changes++;
+    } else {
+        return FAILED_EXECUTE;
+    }
+    return OK;
+}
+
+static nordvpn_error_t
+_fake_execute_nordvpn(nordvpn_session_ptr session, char* buffer, size_t size, const char** args) {
+    fake_nordvpn_t* fake = fake_nordvpn();
+    bool is_late = fake->late_server[0] != '\0';
+    nordvpn_error_t result = _fake_run_nordvpn(session, buffer, size, args);
+    if (is_late && result != CANCELLED) {
+        // the daemon gets to the cancelled connect only now
+        snprintf(fake->server, MAX_FAKE_SERVER, "%s", fake->late_server);
+        fake->late_server[0] = '\0';
+        fake->is_online = true;
+    }
+    return result;
+}
+
+// Recorded runs replayed in place of the mocked results, while loaded
+static nordi_trace_ptr _mock_trace = NULL;
+static double _mock_trace_speed = 0;
+
+typedef struct {
+    nordvpn_session_ptr session;
+    char* buffer;
+    size_t size;
+    size_t length;
+} _replay_output_t;
+
+static bool
+_replay_sink(_replay_output_t* output, const char* data, size_t length) {
+    size_t kept = length < output->size - 1 - output->length ? length : output->size - 1 - output->length;
+    memcpy(output->buffer + output->length, data, kept);
+    output->length += kept;
+    return !output->session->is_cancelled;
+}
+
+// Serves a recorded run as the executor would read it from the binary
+static nordvpn_error_t
+_replay_execute_nordvpn(nordvpn_session_ptr session, char* buffer, size_t size, const char** args) {
+    const nordi_trace_run_t* run = nordi_trace_find(_mock_trace, args);
+    if (run == NULL) {
+        return FAILED_EXECUTE;
+    }
+    _replay_output_t output = {.session = session, .buffer = buffer, .size = size};
+    int exit_code = nordi_trace_play(run, _mock_trace_speed, (nordi_trace_sink_t)_replay_sink, &output);
+    if (exit_code == TRACE_STOPPED || exit_code == TRACE_NO_EXIT) {
+        return session->is_cancelled ? CANCELLED : FAILED_EXECUTE;
+    }
+    return str_has_prefix(str_ref(buffer), str_lit("ERROR:")) ? FAILED_EXECUTE : OK;
+}
+
 nordvpn_error_t
-_mock_execute_nordvpn(nordvpn_session_ptr session, char* buffer, const char** args) {
+_mock_execute_nordvpn(nordvpn_session_ptr session, char* buffer, size_t size, const char** args) {
+    if (fake_nordvpn()->is_enabled) {
+        return _fake_execute_nordvpn(session, buffer, size, args);
+    }
+    if (_mock_trace != NULL) {
+        return _replay_execute_nordvpn(session, buffer, size, args);
+    }
     if (_mock_result.index >= _mock_result.max_index) {
         // rotate if max index is reached
         _mock_result.index = 0;
@@ -68,7 +243,7 @@ _mock_execute_nordvpn(nordvpn_session_ptr session, char* buffer, const char** ar
         assert_string_equal(args[i], _mock_result.args[index][i]);
     }
     // copy mocked output to buffer
-    strcpy(buffer, _mock_result.output[index]);
+    snprintf(buffer, size, "%s", _mock_result.output[index]);
     // return mocked error
     return (nordvpn_error_t)_mock_result.error[index];
 }
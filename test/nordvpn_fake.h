@@ -0,0 +1,37 @@
+#ifndef NORDVPN_FAKE_H_
+#define NORDVPN_FAKE_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#define MAX_FAKE_SERVER 64
+
+// Stateful stand-in for the nordvpn binary, answering c, d, status, settings, set and allowlist like the daemon would.
+// Enabled through the API mock, so the API unit tests keep their scripted results.
+typedef struct {
+    bool is_enabled;
+    bool is_online;
+    char server[MAX_FAKE_SERVER];      // server of the last connect, "quick" if none was given
+    char dns[MAX_FAKE_SERVER];         // first server of the last set dns
+    char technology[MAX_FAKE_SERVER];  // technology set, NORDLYNX if none was
+    char protocol[MAX_FAKE_SERVER];    // OpenVPN protocol set, UDP if none was
+    int delay_us;                      // time each command takes, cancelling stops the wait
+    atomic_bool is_held;               // commands wait until cleared, cancelling stops the wait
+    bool is_finishing_late;            // a cancelled connect still ends connected, once the next command is done
+    char late_server[MAX_FAKE_SERVER]; // server of the cancelled connect still being carried out
+    int nordlynx_delay_us;             // extra time a connect takes over NordLynx
+    int udp_delay_us;                  // extra time a connect takes over OpenVPN UDP
+    int tcp_delay_us;                  // extra time a connect takes over OpenVPN TCP
+    unsigned int fail_every;           // every nth connect fails, 0 for none
+    atomic_uint spawns;                // commands started
+    unsigned int cancels;              // commands that were cancelled while running
+    unsigned int connects;             // connect commands run
+    unsigned int allowlist_changes;    // allowlist commands run
+} fake_nordvpn_t;
+
+fake_nordvpn_t* fake_nordvpn();
+
+// Waits until the given number of commands started, such as for one to be in flight while held
+void fake_nordvpn_wait_spawns(unsigned int);
+
+#endif /* NORDVPN_FAKE_H_ */
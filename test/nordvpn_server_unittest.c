@@ -19,10 +19,30 @@ TEST(test_nordvpn_index_out_range) {
     assert_string_equal(str_ptr(nordvpn_node_from_index(COUNTRY_COUNT + GROUP_COUNT + 1)), str_ptr(str_null));
 }
 
+TEST(test_nordvpn_country_name_ok) {
+    assert_int(nordvpn_country_from_name(str_lit("Portugal")), ==, PORTUGAL);
+    assert_int(nordvpn_country_from_name(str_lit("United States")), ==, UNITED_STATES);
+    assert_int(nordvpn_country_from_name(str_lit("United_States")), ==, UNITED_STATES);
+}
+
+TEST(test_nordvpn_country_name_unknown) {
+    assert_int(nordvpn_country_from_name(str_lit("Atlantis")), ==, -1);
+    assert_int(nordvpn_country_from_name(str_null), ==, -1);
+}
+
+TEST(test_nordvpn_technology_name_ok) {
+    assert_int(nordvpn_technology_from_name(str_lit("NORDLYNX")), ==, TECHNOLOGY_NORDLYNX);
+    assert_int(nordvpn_technology_from_name(str_lit("OPENVPN")), ==, TECHNOLOGY_OPENVPN);
+    assert_int(nordvpn_technology_from_name(str_lit("IKEv2")), ==, TECHNOLOGY_UNKNOWN);
+}
+
 TESTS(server_tests) = {
     TESTRUN("/empty-index-ok", test_nordvpn_empty_index_ok),
     TESTRUN("/country-index-ok", test_nordvpn_country_index_ok),
     TESTRUN("/group-index-ok", test_nordvpn_group_index_ok),
     TESTRUN("/out-range-index-ok", test_nordvpn_index_out_range),
+    TESTRUN("/country-name-ok", test_nordvpn_country_name_ok),
+    TESTRUN("/country-name-unknown", test_nordvpn_country_name_unknown),
+    TESTRUN("/technology-name-ok", test_nordvpn_technology_name_ok),
     TESTEND,
 };